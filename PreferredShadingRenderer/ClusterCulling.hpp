@@ -0,0 +1,275 @@
+//
+//  ClusterCulling.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef ClusterCulling_hpp
+#define ClusterCulling_hpp
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "VulkanVertex.hpp"
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ClusterCulling Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct ClusterCulling
+    {
+
+    // triangles per cluster, clusters also end wherever the
+    // direction the triangles face changes bins
+    static constexpr uint32_t CLUSTER_SIZE = 128;
+
+    // each face of the cube of directions is split into this many
+    // bins a side, narrower bins make for tighter cones
+    static constexpr uint32_t BIN_GRID = 8;
+
+    //
+    //  a run of the mesh's index buffer, bounded by a sphere and
+    //  by a cone every one of its face normals lies inside of.
+    //  Laid out to match the std430 cluster buffer in cluster.comp
+    //
+    struct Cluster {
+        glm::vec4 sphere;     // model space centre (xyz) and radius (w)
+        glm::vec4 cone;       // axis (xyz) and cutoff (w), 1 never culls
+        uint32_t  firstIndex; // relative to the start of the mesh
+        uint32_t  indexCount;
+        uint32_t  pad[2];
+    };
+
+    //
+    //  build
+    //
+    //  reorders the triangles of the mesh so that those facing the
+    //  same way and lying close together are neighbours, then cuts
+    //  the index buffer into clusters. The texture space passes
+    //  don't care what order triangles arrive in, so this is free
+    //
+    static void build (const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Cluster>& clusters);
+
+    //
+    //  backfacing
+    //
+    //  true if no triangle of the cluster can face the eye, for a
+    //  cluster placed in the world by a model matrix whose largest
+    //  axis scale is given. Assumes the scale is close to uniform
+    //
+    static bool backfacing (const Cluster& cluster, const glm::mat4& model, float scale, const glm::vec3& eye);
+
+    //
+    //  append
+    //
+    //  adds the clusters of one object that face any of the eyes to
+    //  the draw list, merging neighbouring clusters into a single
+    //  draw, and returns how many clusters were left out
+    //
+    static uint32_t append (
+        const std::vector<Cluster>&                  clusters,
+        const vk::DrawIndexedIndirectCommand&        object,
+        const glm::mat4&                             model,
+        const glm::vec3*                             eyes,
+        uint32_t                                     eyeCount,
+        std::vector<vk::DrawIndexedIndirectCommand>& draws);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ClusterCulling Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline void ClusterCulling::build (const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Cluster>& clusters)
+    { // ClusterCulling :: build
+
+    uint32_t triangles = static_cast<uint32_t>(indices.size() / 3);
+
+    glm::vec3 lower = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 upper = glm::vec3(-std::numeric_limits<float>::max());
+    for (const Vertex& v : vertices)
+        {
+        lower = glm::min(lower, v.position);
+        upper = glm::max(upper, v.position);
+        }
+
+    glm::vec3 extent = glm::max(upper - lower, glm::vec3(1e-6f));
+
+    std::vector<glm::vec3> normals (triangles);
+    std::vector<uint64_t>  keys    (triangles);
+
+    for (uint32_t t = 0; t < triangles; ++t)
+        { // for each triangle
+        const Vertex& a = vertices[indices[t * 3 + 0]];
+        const Vertex& b = vertices[indices[t * 3 + 1]];
+        const Vertex& c = vertices[indices[t * 3 + 2]];
+
+        // the winding isn't trusted, the face normal is turned to
+        // agree with the normals the mesh was authored with
+        glm::vec3 shading = a.normal + b.normal + c.normal;
+        glm::vec3 face    = glm::cross(b.position - a.position, c.position - a.position);
+
+        if (glm::length(face) < 1e-12f)
+            face = shading;
+        else if (glm::dot(face, shading) < 0.0f)
+            face = -face;
+
+        normals[t] = (glm::length(face) > 0.0f) ? glm::normalize(face) : glm::vec3(0.0f);
+
+        // the direction bin is a cell of the cube face the normal
+        // points at, found by projecting the normal onto that face
+        glm::vec3 n    = normals[t];
+        glm::vec3 mag  = glm::abs(n);
+        uint32_t  axis = (mag.x >= mag.y && mag.x >= mag.z) ? 0 : (mag.y >= mag.z) ? 1 : 2;
+        uint32_t  side = (n[axis] < 0.0f) ? 1 : 0;
+        float     span = std::max(mag[axis], 1e-6f);
+        uint32_t  u    = std::min(BIN_GRID - 1, (uint32_t)((n[(axis + 1) % 3] / span * 0.5f + 0.5f) * BIN_GRID));
+        uint32_t  v    = std::min(BIN_GRID - 1, (uint32_t)((n[(axis + 2) % 3] / span * 0.5f + 0.5f) * BIN_GRID));
+        uint64_t  bin  = (axis * 2 + side) * BIN_GRID * BIN_GRID + u * BIN_GRID + v;
+
+        // within a bin, triangles are ordered along a morton curve
+        // through the mesh's bounds to keep the spheres small
+        glm::vec3 centre = (a.position + b.position + c.position) / 3.0f;
+        glm::vec3 cell   = glm::clamp((centre - lower) / extent, 0.0f, 1.0f) * 1023.0f;
+
+        uint64_t morton = 0;
+        for (uint32_t bit = 0; bit < 10; ++bit)
+            for (uint32_t d = 0; d < 3; ++d)
+                morton |= (uint64_t)(((uint32_t)cell[d] >> bit) & 1) << (bit * 3 + d);
+
+        keys[t] = (bin << 32) | morton;
+        } // for each triangle
+
+    std::vector<uint32_t> order (triangles);
+    for (uint32_t t = 0; t < triangles; ++t)
+        order[t] = t;
+
+    std::stable_sort(order.begin(), order.end(), [&] (uint32_t l, uint32_t r) { return keys[l] < keys[r]; });
+
+    std::vector<uint32_t> sorted (indices.size());
+    for (uint32_t t = 0; t < triangles; ++t)
+        for (uint32_t k = 0; k < 3; ++k)
+            sorted[t * 3 + k] = indices[order[t] * 3 + k];
+
+    indices.swap(sorted);
+    clusters.clear();
+
+    uint32_t first = 0;
+    while (first < triangles)
+        { // for each cluster
+        uint64_t bin  = keys[order[first]] >> 32;
+        uint32_t last = first + 1;
+        while (last < triangles && last - first < CLUSTER_SIZE && (keys[order[last]] >> 32) == bin)
+            ++last;
+
+        glm::vec3 centre = glm::vec3(0.0f);
+        glm::vec3 axis   = glm::vec3(0.0f);
+        for (uint32_t t = first; t < last; ++t)
+            {
+            for (uint32_t k = 0; k < 3; ++k)
+                centre += vertices[indices[t * 3 + k]].position;
+            axis += normals[order[t]];
+            }
+        centre /= (float)((last - first) * 3);
+
+        float radius = 0.0f;
+        for (uint32_t t = first * 3; t < last * 3; ++t)
+            radius = std::max(radius, glm::length(vertices[indices[t]].position - centre));
+
+        // the cone is as wide as the normal furthest from its axis.
+        // Once that's past 90 degrees something always faces the eye
+        float cutoff = 1.0f;
+        if (glm::length(axis) > 1e-6f)
+            {
+            axis = glm::normalize(axis);
+
+            float spread = 1.0f;
+            for (uint32_t t = first; t < last; ++t)
+                spread = std::min(spread, glm::dot(axis, normals[order[t]]));
+
+            if (spread > 0.0f)
+                cutoff = std::sqrt(1.0f - spread * spread);
+            }
+
+        Cluster cluster = { };
+            cluster.sphere     = glm::vec4(centre, radius);
+            cluster.cone       = glm::vec4(axis, cutoff);
+            cluster.firstIndex = first * 3;
+            cluster.indexCount = (last - first) * 3;
+        clusters.push_back(cluster);
+
+        first = last;
+        } // for each cluster
+
+    } // ClusterCulling :: build
+
+inline bool ClusterCulling::backfacing (const Cluster& cluster, const glm::mat4& model, float scale, const glm::vec3& eye)
+    { // ClusterCulling :: backfacing
+
+    if (cluster.cone.w >= 1.0f)
+        return false;
+
+    glm::vec3 centre = glm::vec3(model * glm::vec4(glm::vec3(cluster.sphere), 1.0f));
+    glm::vec3 axis   = glm::normalize(glm::mat3(model) * glm::vec3(cluster.cone));
+    glm::vec3 view   = centre - eye;
+
+    // every normal in the cone points away from every point of the
+    // sphere as seen from the eye
+    return glm::dot(view, axis) >= cluster.cone.w * glm::length(view) + cluster.sphere.w * scale;
+
+    } // ClusterCulling :: backfacing
+
+inline uint32_t ClusterCulling::append (
+        const std::vector<Cluster>&                  clusters,
+        const vk::DrawIndexedIndirectCommand&        object,
+        const glm::mat4&                             model,
+        const glm::vec3*                             eyes,
+        uint32_t                                     eyeCount,
+        std::vector<vk::DrawIndexedIndirectCommand>& draws)
+    { // ClusterCulling :: append
+
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    uint32_t culled = 0;
+    bool     open   = false;
+
+    for (const Cluster& cluster : clusters)
+        { // for each cluster
+
+        bool hidden = true;
+        for (uint32_t e = 0; e < eyeCount && hidden; ++e)
+            hidden = backfacing(cluster, model, scale, eyes[e]);
+
+        if (hidden)
+            {
+            ++culled;
+            open = false;
+            continue;
+            }
+
+        // a cluster following one that was drawn just extends it
+        if (open)
+            {
+            draws.back().indexCount += cluster.indexCount;
+            continue;
+            }
+
+        vk::DrawIndexedIndirectCommand draw = object;
+            draw.firstIndex = object.firstIndex + cluster.firstIndex;
+            draw.indexCount = cluster.indexCount;
+        draws.push_back(draw);
+
+        open = true;
+        } // for each cluster
+
+    return culled;
+
+    } // ClusterCulling :: append
+
+#endif /* ClusterCulling_hpp */
@@ -0,0 +1,255 @@
+//
+//  FramePacer.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef FRAMEPACER_HPP
+#define FRAMEPACER_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#ifdef _WIN32
+// from timeapi.h, declared here rather than pulling windows.h and its
+// min and max macros into everything that includes the pacer
+extern "C" __declspec(dllimport) unsigned int __stdcall timeBeginPeriod (unsigned int period);
+extern "C" __declspec(dllimport) unsigned int __stdcall timeEndPeriod   (unsigned int period);
+#pragma comment(lib, "winmm.lib")
+#endif
+
+//
+//  FramePacer
+//
+//  decides when a frame is allowed to start and which present
+//  mode suits that decision.
+//
+//      eUncapped   - no waiting at all, used for benchmarking
+//      eCapped     - holds each frame to a target rate, waiting
+//                    after present
+//      eLowLatency - holds each frame to a target rate, but does
+//                    the waiting before input is sampled so the
+//                    input that ends up on screen is as fresh as
+//                    the frame's cost allows
+//
+//  sleep_for is only accurate to the scheduler quantum, so waits
+//  sleep until they're within spinThreshold of the deadline and
+//  then spin the rest of the way on the steady clock. Windows rounds
+//  sleeps up to a 15.6ms tick unless the timer resolution is raised,
+//  which the pacer does for as long as it exists, and whatever a
+//  sleep still overshoots by is kept back from the next ones
+//
+struct FramePacer
+	{
+
+	enum Mode {
+		eUncapped,
+		eCapped,
+		eLowLatency,
+		eModeCount
+	};
+
+	typedef std::chrono::steady_clock                 Clock;
+	typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+	Mode mode;
+
+	Milliseconds target;
+	Milliseconds spinThreshold = Milliseconds (2.0);
+	Milliseconds oversleep     = Milliseconds (0.0);
+
+	Clock::time_point deadline;
+	Clock::time_point inputSampled;
+
+	// moving estimate of how long a frame takes from input
+	// to present, which low latency mode waits in front of
+	Milliseconds workEstimate = Milliseconds (0.0);
+
+	// input to present totals for every mode the run has been in,
+	// so the log can compare them however often they were cycled
+	double   latencySum   [eModeCount] = { };
+	uint32_t latencyCount [eModeCount] = { };
+
+	FramePacer (Mode requested, uint32_t maxFps) :
+		mode         (requested),
+		target       (1000.0 / (double)maxFps),
+		deadline     (Clock::now()),
+		inputSampled (Clock::now())
+		{ // FramePacer :: FramePacer
+
+	#ifdef _WIN32
+		timeBeginPeriod(1);
+	#endif
+
+		} // FramePacer :: FramePacer
+
+	~FramePacer ()
+		{ // FramePacer :: ~FramePacer
+
+	#ifdef _WIN32
+		timeEndPeriod(1);
+	#endif
+
+		} // FramePacer :: ~FramePacer
+
+	//
+	//  called at the top of the frame, before any input is read
+	//
+	void beginFrame ()
+		{ // FramePacer :: beginFrame
+
+		if (mode == eLowLatency)
+			wait(deadline - std::chrono::duration_cast<Clock::duration>(workEstimate));
+
+		inputSampled = Clock::now();
+
+		} // FramePacer :: beginFrame
+
+	//
+	//  called once the frame has been handed to the presentation
+	//  engine. Note that this measures input to present on the
+	//  host, not to the photons leaving the display
+	//
+	void endFrame ()
+		{ // FramePacer :: endFrame
+
+		Clock::time_point presented = Clock::now();
+		Milliseconds      latency   = presented - inputSampled;
+
+		latencySum[mode] += latency.count();
+		latencyCount[mode]++;
+		workEstimate = workEstimate * 0.9 + latency * 0.1;
+
+		if (mode == eCapped)
+			wait(deadline);
+
+		// a frame that overran shouldn't make the next ones rush
+		// to catch up, so the schedule restarts from now
+		deadline += std::chrono::duration_cast<Clock::duration>(target);
+		if (deadline < Clock::now())
+			deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(target);
+
+		} // FramePacer :: endFrame
+
+	//
+	//  switches to the next mode, returning true if the present
+	//  mode preference changed and the swapchain needs rebuilding
+	//
+	bool cycle ()
+		{ // FramePacer :: cycle
+
+		std::vector<vk::PresentModeKHR> previous = presentModes();
+
+		mode = (Mode)((mode + 1) % eModeCount);
+		workEstimate = Milliseconds (0.0);
+		deadline     = Clock::now();
+
+		return presentModes() != previous;
+
+		} // FramePacer :: cycle
+
+	//
+	//  present modes in order of preference. Uncapped wants to
+	//  never block on the display, while the paced modes do their
+	//  own waiting and only need the engine not to queue frames
+	//  up behind them. FIFO is always available as a fallback
+	//
+	std::vector<vk::PresentModeKHR> presentModes () const
+		{ // FramePacer :: presentModes
+
+		switch (mode)
+			{
+			case eUncapped:
+				return { vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo };
+			case eLowLatency:
+				return { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eFifo };
+			default:
+				return { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifo };
+			}
+
+		} // FramePacer :: presentModes
+
+	double averageLatency () const
+		{ // FramePacer :: averageLatency
+
+		return averageLatency(mode);
+
+		} // FramePacer :: averageLatency
+
+	double averageLatency (Mode m) const
+		{ // FramePacer :: averageLatency
+
+		if (latencyCount[m] == 0) return 0.0;
+
+		return latencySum[m] / (double)latencyCount[m];
+
+		} // FramePacer :: averageLatency
+
+	//
+	//  appends a line for every mode that saw a frame, along with
+	//  how many frames its average was taken over
+	//
+	void log (uint32_t id) const
+		{ // FramePacer :: log
+
+		std::ofstream file ("latency_" + std::to_string(id) + ".txt", std::ios_base::app);
+
+		for (uint32_t m = 0; m < eModeCount; ++m)
+			if (latencyCount[m] > 0)
+				file << name((Mode)m) << " " << averageLatency((Mode)m) << " " << latencyCount[m] << "\n";
+
+		} // FramePacer :: log
+
+	const char* name () const
+		{ // FramePacer :: name
+
+		return name(mode);
+
+		} // FramePacer :: name
+
+	static const char* name (Mode m)
+		{ // FramePacer :: name
+
+		switch (m)
+			{
+			case eUncapped:   return "uncapped";
+			case eCapped:     return "capped";
+			case eLowLatency: return "low-latency";
+			default:          return "unknown";
+			}
+
+		} // FramePacer :: name
+
+	private:
+
+	void wait (Clock::time_point until)
+		{ // FramePacer :: wait
+
+		while (until - Clock::now() > spinThreshold + oversleep)
+			{
+			Clock::time_point before = Clock::now();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			// the estimate follows the worst recent overshoot, and
+			// slowly lets go of it once sleeps get shorter again
+			Milliseconds slept = Clock::now() - before;
+			oversleep = std::max(slept - Milliseconds (1.0), oversleep * 0.95);
+			}
+
+		while (Clock::now() < until)
+			std::this_thread::yield();
+
+		} // FramePacer :: wait
+
+	};
+
+#endif
@@ -0,0 +1,361 @@
+//
+//  FrustumCulling.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef FrustumCulling_hpp
+#define FrustumCulling_hpp
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <vector>
+#include <string>
+
+#include <iostream>
+#include <fstream>
+
+// AVX has to be asked for explicitly (/arch:AVX or -mavx), while
+// SSE2 is always there on x64
+#if defined(__AVX__)
+    #define FRUSTUM_CULLING_AVX
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define FRUSTUM_CULLING_SSE
+#endif
+
+#if defined(FRUSTUM_CULLING_AVX) || defined(FRUSTUM_CULLING_SSE)
+    #include <immintrin.h>
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  FrustumCulling Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct FrustumCulling
+    {
+
+    //
+    //  bounding spheres stored as separate arrays so a whole
+    //  register's worth of spheres can be loaded at once. The
+    //  arrays are padded out to a multiple of 8 with spheres that
+    //  can never pass, so the wide paths never need a scalar tail
+    //
+    struct Spheres {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> r;
+        uint32_t count = 0;
+
+        void resize (uint32_t n);
+        void set    (uint32_t i, const glm::vec3& centre, float radius);
+    };
+
+    //
+    //  the six planes of a view frustum, each as (normal, distance)
+    //  with the normal pointing inwards
+    //
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    //
+    //  extract
+    //
+    //  pulls the planes out of a combined projection * view matrix
+    //  (Gribb & Hartmann). The near plane assumes glm's default -1 ... 1
+    //  depth range, which is only ever looser than Vulkan's 0 ... 1
+    //
+    static Frustum extract (const glm::mat4& viewProjection);
+
+    //
+    //  cull
+    //
+    //  writes the indices of every sphere at least partly inside the
+    //  frustum to visible, in ascending order, using the widest
+    //  instruction set the build allows
+    //
+    static uint32_t cull       (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible);
+
+    static uint32_t cullScalar (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible);
+#ifdef FRUSTUM_CULLING_SSE
+    static uint32_t cullSSE    (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible);
+#endif
+#ifdef FRUSTUM_CULLING_AVX
+    static uint32_t cullAVX    (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible);
+#endif
+
+    //
+    //  benchmark
+    //
+    //  times each available path over randomly scattered spheres and
+    //  appends the results to culling_<id>.txt as
+    //
+    //      spheres  visible  scalar(ms)  sse(ms)  avx(ms)
+    //
+    static void benchmark (uint32_t id);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  FrustumCulling Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline void FrustumCulling::Spheres::resize (uint32_t n)
+    { // FrustumCulling :: Spheres :: resize
+
+    uint32_t padded = (n + 7) & ~7u;
+
+    count = n;
+
+    // padding sits infinitely far behind every plane with no radius
+    x.assign(padded, 0.0f);
+    y.assign(padded, 0.0f);
+    z.assign(padded, 0.0f);
+    r.assign(padded, -std::numeric_limits<float>::max());
+
+    } // FrustumCulling :: Spheres :: resize
+
+inline void FrustumCulling::Spheres::set (uint32_t i, const glm::vec3& centre, float radius)
+    { // FrustumCulling :: Spheres :: set
+
+    x[i] = centre.x;
+    y[i] = centre.y;
+    z[i] = centre.z;
+    r[i] = radius;
+
+    } // FrustumCulling :: Spheres :: set
+
+inline FrustumCulling::Frustum FrustumCulling::extract (const glm::mat4& m)
+    { // FrustumCulling :: extract
+
+    // glm is column major, so m[c][r]
+    glm::vec4 row0 = { m[0][0], m[1][0], m[2][0], m[3][0] };
+    glm::vec4 row1 = { m[0][1], m[1][1], m[2][1], m[3][1] };
+    glm::vec4 row2 = { m[0][2], m[1][2], m[2][2], m[3][2] };
+    glm::vec4 row3 = { m[0][3], m[1][3], m[2][3], m[3][3] };
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    // normalizing lets the plane distance be compared to a radius
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    return frustum;
+
+    } // FrustumCulling :: extract
+
+inline uint32_t FrustumCulling::cull (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible)
+    { // FrustumCulling :: cull
+
+#if defined(FRUSTUM_CULLING_AVX)
+    return cullAVX(frustum, spheres, visible);
+#elif defined(FRUSTUM_CULLING_SSE)
+    return cullSSE(frustum, spheres, visible);
+#else
+    return cullScalar(frustum, spheres, visible);
+#endif
+
+    } // FrustumCulling :: cull
+
+inline uint32_t FrustumCulling::cullScalar (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible)
+    { // FrustumCulling :: cullScalar
+
+    visible.clear();
+
+    for (uint32_t i = 0; i < spheres.count; ++i)
+        { // for each sphere
+
+        bool inside = true;
+        for (uint32_t p = 0; p < 6 && inside; ++p)
+            {
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+            inside = distance > -spheres.r[i];
+            }
+
+        if (inside)
+            visible.push_back(i);
+
+        } // for each sphere
+
+    return static_cast<uint32_t>(visible.size());
+
+    } // FrustumCulling :: cullScalar
+
+#ifdef FRUSTUM_CULLING_SSE
+inline uint32_t FrustumCulling::cullSSE (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible)
+    { // FrustumCulling :: cullSSE
+
+    // writing through a raw pointer into a worst case sized array
+    // is much cheaper than a push_back per survivor
+    visible.resize(spheres.x.size());
+    uint32_t* output = visible.data();
+    uint32_t  n      = 0;
+
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (uint32_t p = 0; p < 6; ++p)
+        {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+
+    for (uint32_t i = 0; i < spheres.count; i += 4)
+        { // for each group of 4 spheres
+
+        __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        __m128 r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.r[i]));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (uint32_t p = 0; p < 6; ++p)
+            {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, r));
+            }
+
+        int mask = _mm_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+            {
+            output[n] = i + lane;
+            n += (mask >> lane) & 1;
+            }
+
+        } // for each group of 4 spheres
+
+    // padding never passes, so anything past count can't be in here
+    visible.resize(n);
+
+    return n;
+
+    } // FrustumCulling :: cullSSE
+#endif
+
+#ifdef FRUSTUM_CULLING_AVX
+inline uint32_t FrustumCulling::cullAVX (const Frustum& frustum, const Spheres& spheres, std::vector<uint32_t>& visible)
+    { // FrustumCulling :: cullAVX
+
+    visible.resize(spheres.x.size());
+    uint32_t* output = visible.data();
+    uint32_t  n      = 0;
+
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (uint32_t p = 0; p < 6; ++p)
+        {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+
+    for (uint32_t i = 0; i < spheres.count; i += 8)
+        { // for each group of 8 spheres
+
+        __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+        __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+        __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+        __m256 r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.r[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (uint32_t p = 0; p < 6; ++p)
+            {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+                _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, r, _CMP_GT_OQ));
+            }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 8; ++lane)
+            {
+            output[n] = i + lane;
+            n += (mask >> lane) & 1;
+            }
+
+        } // for each group of 8 spheres
+
+    visible.resize(n);
+
+    return n;
+
+    } // FrustumCulling :: cullAVX
+#endif
+
+inline void FrustumCulling::benchmark (uint32_t id)
+    { // FrustumCulling :: benchmark
+
+    const uint32_t counts[] = { 1024, 16384, 65536 };
+    const uint32_t runs     = 200;
+
+    // a camera at the origin looking down -z into a field of
+    // spheres around it, only a small fraction of which end up in
+    // view, so the survivors are reported alongside the times
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(1.0f, 1.0f, 0.01f, 100.0f);
+
+    Frustum frustum = extract(proj * view);
+
+    std::default_random_engine            rng (0);
+    std::uniform_real_distribution<float> position (-100.0f, 100.0f);
+    std::uniform_real_distribution<float> radius   (0.1f, 2.0f);
+
+    std::vector<uint32_t> visible;
+
+    std::ofstream file ("culling_" + std::to_string(id) + ".txt", std::ios_base::app);
+
+    auto time = [&] (uint32_t (*path) (const Frustum&, const Spheres&, std::vector<uint32_t>&), const Spheres& spheres)
+        {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < runs; ++r)
+            path(frustum, spheres, visible);
+        auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / (double)runs;
+        };
+
+    for (uint32_t count : counts)
+        { // for each sphere count
+
+        Spheres spheres;
+        spheres.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+            spheres.set(i, { position(rng), position(rng), position(rng) }, radius(rng));
+
+        double scalar = time(cullScalar, spheres);
+        double sse    = 0.0;
+        double avx    = 0.0;
+#ifdef FRUSTUM_CULLING_SSE
+        sse = time(cullSSE, spheres);
+#endif
+#ifdef FRUSTUM_CULLING_AVX
+        avx = time(cullAVX, spheres);
+#endif
+
+        uint32_t survivors = cull(frustum, spheres, visible);
+
+        std::cout << "  " << count << " spheres (" << survivors << " visible, " << 100.0 * survivors / count << "%) : scalar " << scalar << "ms, sse " << sse << "ms, avx " << avx << "ms" << std::endl;
+        file << count << " " << survivors << " " << scalar << " " << sse << " " << avx << "\n";
+
+        } // for each sphere count
+
+    } // FrustumCulling :: benchmark
+
+#endif /* FrustumCulling_hpp */
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <vector>
+#include <limits>
 
 #include <iomanip>
 #include <fstream>
@@ -41,7 +42,7 @@ struct MeshIO
     
     //
     //  uses the method found in graphics gems to estimate a bounding
-    //  sphere radius for the given mesh
+    //  sphere radius for the given mesh, centred on its centroid
     //
     static float estimateBounds (const std::vector<Vertex>& vertices);
     
@@ -129,12 +130,12 @@ void MeshIO::writeMeshFile (const char* path, const std::vector<Vertex>& vertice
 float MeshIO::estimateBounds (const std::vector<Vertex>& vertices)
     { // MeshIO :: estimateBounds
     
-    float minX = std::numeric_limits<float>::max(); uint32_t minXIndex = 0;
-    float maxX = std::numeric_limits<float>::min(); uint32_t maxXIndex = 0;
-    float minY = std::numeric_limits<float>::max(); uint32_t minYIndex = 0;
-    float maxY = std::numeric_limits<float>::min(); uint32_t maxYIndex = 0;
-    float minZ = std::numeric_limits<float>::max(); uint32_t minZIndex = 0;
-    float maxZ = std::numeric_limits<float>::min(); uint32_t maxZIndex = 0;
+    float minX = std::numeric_limits<float>::max();    uint32_t minXIndex = 0;
+    float maxX = std::numeric_limits<float>::lowest(); uint32_t maxXIndex = 0;
+    float minY = std::numeric_limits<float>::max();    uint32_t minYIndex = 0;
+    float maxY = std::numeric_limits<float>::lowest(); uint32_t maxYIndex = 0;
+    float minZ = std::numeric_limits<float>::max();    uint32_t minZIndex = 0;
+    float maxZ = std::numeric_limits<float>::lowest(); uint32_t maxZIndex = 0;
     
     glm::vec3 centroid = { 0.0f, 0.0f, 0.0f };
     
@@ -169,7 +170,7 @@ float MeshIO::estimateBounds (const std::vector<Vertex>& vertices)
             glm::length(vertices[maxYIndex].position - vertices[minYIndex].position),
             glm::length(vertices[maxZIndex].position - vertices[minZIndex].position)};
         
-    float r = *std::max_element(std::begin(spans), std::end(spans));
+    float r = *std::max_element(std::begin(spans), std::end(spans)) * 0.5f;
     
     // we then make a single pass through the vertices and expand the
     // sphere whenever we encounter a point outside of it
@@ -182,7 +183,7 @@ float MeshIO::estimateBounds (const std::vector<Vertex>& vertices)
         
         } // for each position
     
-    return 0;
+    return r;
     
     } // MeshIO :: estimateBounds
 
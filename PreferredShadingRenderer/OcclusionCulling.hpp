@@ -0,0 +1,220 @@
+//
+//  OcclusionCulling.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef OcclusionCulling_hpp
+#define OcclusionCulling_hpp
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "FrustumCulling.hpp"
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  OcclusionCulling Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct OcclusionCulling
+    {
+
+    static constexpr uint32_t MAX_LEVELS = 16;
+
+    //
+    //  one level of the pyramid, laid out to match the uvec4s
+    //  hiz.comp and cull.comp index the pyramid buffer with
+    //
+    struct Level {
+        uint32_t offset = 0;
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        uint32_t pad    = 0;
+    };
+
+    //
+    //  a hierarchical depth buffer stored level after level in one
+    //  flat array of floats. Level 0 is half the depth buffer, and
+    //  every texel holds the farthest depth of the texels below it,
+    //  so anything nearer than a texel's value might be in front
+    //
+    struct Pyramid {
+        Level    levels[MAX_LEVELS];
+        uint32_t levelCount = 0;
+        uint32_t size       = 0;
+
+        void layout (uint32_t width, uint32_t height);
+
+        //
+        //  the first level small enough for the host to read back
+        //  every frame, which is the coarse end of the pyramid
+        //
+        uint32_t hostLevel (uint32_t maxWidth) const;
+    };
+
+    //
+    //  occluded
+    //
+    //  tests a world space sphere against the pyramid drawn from
+    //  the given camera, using a level where the sphere's screen
+    //  bounds cover at most 2x2 texels. depths holds the levels
+    //  from firstLevel onwards, coarser levels being used whenever
+    //  the ideal one isn't there. Anything crossing the near plane
+    //  is never occluded
+    //
+    static bool occluded (
+        const Pyramid&   pyramid,
+        uint32_t         firstLevel,
+        const float*     depths,
+        const glm::mat4& viewProjection,
+        const glm::vec3& centre,
+        float            radius);
+
+    //
+    //  cull
+    //
+    //  removes every occluded sphere from a visible list produced
+    //  by FrustumCulling::cull, keeping the order, and returns how
+    //  many were removed
+    //
+    static uint32_t cull (
+        const Pyramid&                 pyramid,
+        uint32_t                       firstLevel,
+        const float*                   depths,
+        const glm::mat4&               viewProjection,
+        const FrustumCulling::Spheres& spheres,
+        std::vector<uint32_t>&         visible);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  OcclusionCulling Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline void OcclusionCulling::Pyramid::layout (uint32_t width, uint32_t height)
+    { // OcclusionCulling :: Pyramid :: layout
+
+    levelCount = 0;
+    size       = 0;
+
+    // odd sizes round up, so the last texel of a row covers the
+    // leftover texel of the level above as well
+    uint32_t w = std::max(1u, (width  + 1) / 2);
+    uint32_t h = std::max(1u, (height + 1) / 2);
+
+    while (levelCount < MAX_LEVELS)
+        { // for each level
+        Level& level = levels[levelCount++];
+            level.offset = size;
+            level.width  = w;
+            level.height = h;
+
+        size += w * h;
+
+        if (w == 1 && h == 1)
+            break;
+
+        w = std::max(1u, (w + 1) / 2);
+        h = std::max(1u, (h + 1) / 2);
+        } // for each level
+
+    } // OcclusionCulling :: Pyramid :: layout
+
+inline uint32_t OcclusionCulling::Pyramid::hostLevel (uint32_t maxWidth) const
+    { // OcclusionCulling :: Pyramid :: hostLevel
+
+    for (uint32_t l = 0; l < levelCount; ++l)
+        if (levels[l].width <= maxWidth && levels[l].height <= maxWidth)
+            return l;
+
+    return levelCount - 1;
+
+    } // OcclusionCulling :: Pyramid :: hostLevel
+
+inline bool OcclusionCulling::occluded (
+        const Pyramid&   pyramid,
+        uint32_t         firstLevel,
+        const float*     depths,
+        const glm::mat4& viewProjection,
+        const glm::vec3& centre,
+        float            radius)
+    { // OcclusionCulling :: occluded
+
+    // the screen bounds of the sphere's box are found from its
+    // corners, the nearest of which also gives the nearest depth
+    glm::vec2 lower   = glm::vec2( 1.0f);
+    glm::vec2 upper   = glm::vec2(-1.0f);
+    float     nearest = 1.0f;
+
+    for (uint32_t c = 0; c < 8; ++c)
+        { // for each corner
+        glm::vec3 corner = centre + radius * glm::vec3(
+            (c & 1) ? 1.0f : -1.0f,
+            (c & 2) ? 1.0f : -1.0f,
+            (c & 4) ? 1.0f : -1.0f);
+
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f || clip.z < 0.0f)
+            return false;
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        lower   = glm::min(lower, glm::vec2(ndc));
+        upper   = glm::max(upper, glm::vec2(ndc));
+        nearest = std::min(nearest, ndc.z);
+        } // for each corner
+
+    lower = glm::clamp(lower * 0.5f + 0.5f, 0.0f, 1.0f);
+    upper = glm::clamp(upper * 0.5f + 0.5f, 0.0f, 1.0f);
+
+    // the level where the bounds are no wider than a texel, so they
+    // touch at most the 2x2 texels around their corners
+    float extent = std::max(
+        (upper.x - lower.x) * pyramid.levels[0].width,
+        (upper.y - lower.y) * pyramid.levels[0].height);
+
+    uint32_t level = (extent > 1.0f) ? (uint32_t)std::ceil(std::log2(extent)) : 0;
+    level = std::min(std::max(level, firstLevel), pyramid.levelCount - 1);
+
+    const Level& l    = pyramid.levels[level];
+    const float* data = depths + (l.offset - pyramid.levels[firstLevel].offset);
+
+    uint32_t x0 = std::min(l.width  - 1, (uint32_t)(lower.x * l.width));
+    uint32_t y0 = std::min(l.height - 1, (uint32_t)(lower.y * l.height));
+    uint32_t x1 = std::min(l.width  - 1, (uint32_t)(upper.x * l.width));
+    uint32_t y1 = std::min(l.height - 1, (uint32_t)(upper.y * l.height));
+
+    float farthest = 0.0f;
+    for (uint32_t y = y0; y <= y1; ++y)
+        for (uint32_t x = x0; x <= x1; ++x)
+            farthest = std::max(farthest, data[y * l.width + x]);
+
+    return nearest > farthest;
+
+    } // OcclusionCulling :: occluded
+
+inline uint32_t OcclusionCulling::cull (
+        const Pyramid&                 pyramid,
+        uint32_t                       firstLevel,
+        const float*                   depths,
+        const glm::mat4&               viewProjection,
+        const FrustumCulling::Spheres& spheres,
+        std::vector<uint32_t>&         visible)
+    { // OcclusionCulling :: cull
+
+    size_t before = visible.size();
+
+    visible.erase(std::remove_if(visible.begin(), visible.end(), [&] (uint32_t i)
+        {
+        glm::vec3 centre = { spheres.x[i], spheres.y[i], spheres.z[i] };
+        return occluded(pyramid, firstLevel, depths, viewProjection, centre, spheres.r[i]);
+        }), visible.end());
+
+    return static_cast<uint32_t>(before - visible.size());
+
+    } // OcclusionCulling :: cull
+
+#endif /* OcclusionCulling_hpp */
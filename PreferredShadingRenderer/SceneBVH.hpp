@@ -0,0 +1,724 @@
+//
+//  SceneBVH.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef SceneBVH_hpp
+#define SceneBVH_hpp
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <limits>
+#include <random>
+#include <vector>
+#include <string>
+
+#include <iostream>
+#include <fstream>
+
+#include "FrustumCulling.hpp"
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  SceneBVH Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct SceneBVH
+    {
+
+    // the most objects a leaf is allowed to hold
+    static constexpr uint32_t MAX_LEAF = 4;
+
+    // how many buckets candidate splits are binned into
+    static constexpr uint32_t BINS = 16;
+
+    // ranges at least this large have their two halves built on
+    // separate threads, down to PARALLEL_DEPTH levels
+    static constexpr uint32_t PARALLEL_MIN   = 4096;
+    static constexpr uint32_t PARALLEL_DEPTH = 3;
+
+    // past this depth ranges are split at the median instead, which
+    // keeps the tree shallow enough for the fixed query stacks
+    static constexpr uint32_t MAX_DEPTH = 40;
+
+    // refitting keeps the topology, which gets worse as objects
+    // move apart from their neighbours. Past this ratio of the cost
+    // it was built with, or this many refits, the tree is rebuilt
+    static constexpr float    REBUILD_RATIO    = 1.5f;
+    static constexpr uint32_t REBUILD_INTERVAL = 600;
+
+    //
+    //  nodes are laid out depth first, so a node's left child
+    //  always follows it and every child comes after its parent.
+    //  An interior node (count 0) keeps its right child in first,
+    //  a leaf keeps the start of its run of objects in indices
+    //
+    struct Node {
+        glm::vec3 min;
+        uint32_t  first;
+        glm::vec3 max;
+        uint32_t  count;
+    };
+
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 direction; // normalised
+        float     maxDistance;
+    };
+
+    struct Hit {
+        uint32_t index    = NONE; // NONE if nothing was hit
+        float    distance = 0.0f;
+    };
+
+    //
+    //  the results of a batch of queries, with query q's objects
+    //  at indices[offsets[q]] up to indices[offsets[q + 1]]
+    //
+    struct Results {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> indices;
+    };
+
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    std::vector<Node>      nodes;
+    std::vector<uint32_t>  indices;
+    std::vector<glm::vec4> spheres; // centre (xyz) and radius (w)
+
+    float    builtCost = 0.0f;
+    uint32_t refits    = 0;
+
+    //
+    //  update
+    //
+    //  follows a frame of the simulation, refitting the tree to
+    //  the new spheres or rebuilding it when the object count has
+    //  changed or the refitted tree has degraded too far. Returns
+    //  true if it was rebuilt
+    //
+    bool update (const std::vector<glm::vec3>& centres, float radius);
+
+    //
+    //  build
+    //
+    //  builds the tree from scratch over the current spheres using
+    //  the surface area heuristic
+    //
+    void build ();
+
+    //
+    //  refit
+    //
+    //  grows and shrinks every node around the current spheres
+    //  without changing which objects sit under which node
+    //
+    void refit ();
+
+    //
+    //  cost
+    //
+    //  the surface area heuristic's estimate of the tree's cost, as
+    //  the expected number of nodes and objects a query visits
+    //
+    float cost () const;
+
+    //
+    //  queries, which all clear their output first. Objects are
+    //  returned in ascending order, so results are the same as a
+    //  linear scan over the spheres would give
+    //
+    uint32_t frustum (const FrustumCulling::Frustum& frustum, std::vector<uint32_t>& out) const;
+    uint32_t sphere  (const glm::vec3& centre, float radius, std::vector<uint32_t>& out) const;
+    Hit      ray     (const Ray& ray) const;
+
+    void sphereBatch (const std::vector<glm::vec4>& queries, Results& results) const;
+    void rayBatch    (const std::vector<Ray>& queries, std::vector<Hit>& hits) const;
+
+    //
+    //  benchmark
+    //
+    //  times building, refitting and querying trees over randomly
+    //  scattered spheres and appends the results to bvh_<id>.txt as
+    //
+    //      objects  build(ms)  refit(ms)  frustum(ms)  sphere(us)  ray(us)
+    //
+    //  with the sphere and ray times given per query
+    //
+    static void benchmark (uint32_t id);
+
+    private:
+
+    static float area (const glm::vec3& min, const glm::vec3& max);
+
+    void buildRange (uint32_t begin, uint32_t end, uint32_t depth, std::vector<Node>& out);
+    void bound      (Node& node, uint32_t begin, uint32_t end) const;
+    bool split      (const Node& node, uint32_t begin, uint32_t end, uint32_t depth, uint32_t& middle);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  SceneBVH Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline bool SceneBVH::update (const std::vector<glm::vec3>& centres, float radius)
+    { // SceneBVH :: update
+
+    bool resized = spheres.size() != centres.size();
+
+    spheres.resize(centres.size());
+    for (size_t i = 0; i < centres.size(); ++i)
+        spheres[i] = glm::vec4(centres[i], radius);
+
+    if (!resized)
+        {
+        refit();
+        if (cost() <= builtCost * REBUILD_RATIO && refits < REBUILD_INTERVAL)
+            return false;
+        }
+
+    build();
+    return true;
+
+    } // SceneBVH :: update
+
+inline void SceneBVH::build ()
+    { // SceneBVH :: build
+
+    uint32_t n = static_cast<uint32_t>(spheres.size());
+
+    indices.resize(n);
+    for (uint32_t i = 0; i < n; ++i)
+        indices[i] = i;
+
+    nodes.clear();
+    nodes.reserve(2 * n);
+
+    if (n > 0)
+        buildRange(0, n, 0, nodes);
+
+    builtCost = cost();
+    refits    = 0;
+
+    } // SceneBVH :: build
+
+inline void SceneBVH::buildRange (uint32_t begin, uint32_t end, uint32_t depth, std::vector<Node>& out)
+    { // SceneBVH :: buildRange
+
+    Node node;
+    bound(node, begin, end);
+
+    uint32_t middle;
+    if (!split(node, begin, end, depth, middle))
+        {
+        node.first = begin;
+        node.count = end - begin;
+        out.push_back(node);
+        return;
+        }
+
+    node.count = 0;
+
+    size_t self = out.size();
+    out.push_back(node);
+
+    if (end - begin < PARALLEL_MIN || depth >= PARALLEL_DEPTH)
+        {
+        buildRange(begin, middle, depth + 1, out);
+        out[self].first = static_cast<uint32_t>(out.size());
+        buildRange(middle, end, depth + 1, out);
+        return;
+        }
+
+    // the two halves own separate runs of indices, so they can be
+    // built side by side into their own arrays and spliced after
+    std::vector<Node> left;
+    std::vector<Node> right;
+
+    std::future<void> task = std::async(std::launch::async, [&] { buildRange(begin, middle, depth + 1, left); });
+    buildRange(middle, end, depth + 1, right);
+    task.wait();
+
+    auto splice = [&out] (const std::vector<Node>& subtree)
+        {
+        uint32_t offset = static_cast<uint32_t>(out.size());
+        for (Node child : subtree)
+            {
+            if (child.count == 0)
+                child.first += offset;
+            out.push_back(child);
+            }
+        };
+
+    splice(left);
+    out[self].first = static_cast<uint32_t>(out.size());
+    splice(right);
+
+    } // SceneBVH :: buildRange
+
+inline void SceneBVH::bound (Node& node, uint32_t begin, uint32_t end) const
+    { // SceneBVH :: bound
+
+    node.min = glm::vec3( std::numeric_limits<float>::max());
+    node.max = glm::vec3(-std::numeric_limits<float>::max());
+
+    for (uint32_t i = begin; i < end; ++i)
+        {
+        const glm::vec4& s = spheres[indices[i]];
+        node.min = glm::min(node.min, glm::vec3(s) - s.w);
+        node.max = glm::max(node.max, glm::vec3(s) + s.w);
+        }
+
+    } // SceneBVH :: bound
+
+inline bool SceneBVH::split (const Node& node, uint32_t begin, uint32_t end, uint32_t depth, uint32_t& middle)
+    { // SceneBVH :: split
+
+    uint32_t count = end - begin;
+    if (count <= 1)
+        return false;
+
+    // candidate splits are spread over the centres rather than the
+    // spheres, as that's what decides which side an object goes
+    glm::vec3 low  = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 high = glm::vec3(-std::numeric_limits<float>::max());
+    for (uint32_t i = begin; i < end; ++i)
+        {
+        low  = glm::min(low,  glm::vec3(spheres[indices[i]]));
+        high = glm::max(high, glm::vec3(spheres[indices[i]]));
+        }
+
+    glm::vec3 extent = high - low;
+    uint32_t axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+
+    if (extent[axis] <= 0.0f || depth >= MAX_DEPTH)
+        {
+        // every centre is in the same place, so no plane separates
+        // them, or the tree is already deep. Either way the range is
+        // simply halved if it's too big
+        if (count <= MAX_LEAF)
+            return false;
+
+        middle = begin + count / 2;
+        return true;
+        }
+
+    struct Bin {
+        glm::vec3 min   = glm::vec3( std::numeric_limits<float>::max());
+        glm::vec3 max   = glm::vec3(-std::numeric_limits<float>::max());
+        uint32_t  count = 0;
+    } bins [BINS];
+
+    float scale = (float)BINS / extent[axis];
+    auto binOf = [&] (uint32_t index)
+        {
+        uint32_t b = static_cast<uint32_t>((spheres[index][axis] - low[axis]) * scale);
+        return (b < BINS - 1) ? b : BINS - 1;
+        };
+
+    for (uint32_t i = begin; i < end; ++i)
+        {
+        const glm::vec4& s = spheres[indices[i]];
+        Bin& bin = bins[binOf(indices[i])];
+        bin.min = glm::min(bin.min, glm::vec3(s) - s.w);
+        bin.max = glm::max(bin.max, glm::vec3(s) + s.w);
+        bin.count++;
+        }
+
+    // sweep from the right first, so the left sweep can price every
+    // split between bin b and b + 1 as it goes
+    float rightArea [BINS];
+    uint32_t rightCount [BINS];
+
+    Bin accumulated;
+    for (uint32_t b = BINS - 1; b > 0; --b)
+        {
+        accumulated.min    = glm::min(accumulated.min, bins[b].min);
+        accumulated.max    = glm::max(accumulated.max, bins[b].max);
+        accumulated.count += bins[b].count;
+        rightArea[b]  = accumulated.count ? area(accumulated.min, accumulated.max) : 0.0f;
+        rightCount[b] = accumulated.count;
+        }
+
+    float    bestCost = std::numeric_limits<float>::max();
+    uint32_t bestBin  = 0;
+
+    accumulated = Bin { };
+    for (uint32_t b = 0; b < BINS - 1; ++b)
+        {
+        accumulated.min    = glm::min(accumulated.min, bins[b].min);
+        accumulated.max    = glm::max(accumulated.max, bins[b].max);
+        accumulated.count += bins[b].count;
+
+        if (accumulated.count == 0 || rightCount[b + 1] == 0)
+            continue;
+
+        float cost = area(accumulated.min, accumulated.max) * accumulated.count + rightArea[b + 1] * rightCount[b + 1];
+        if (cost < bestCost)
+            {
+            bestCost = cost;
+            bestBin  = b;
+            }
+        }
+
+    // a small range stays a leaf unless splitting it is cheaper than
+    // testing every object in it, counting a node visit as one test
+    float leafCost = area(node.min, node.max) * count;
+    if (count <= MAX_LEAF && bestCost + area(node.min, node.max) >= leafCost)
+        return false;
+
+    if (bestCost == std::numeric_limits<float>::max())
+        {
+        middle = begin + count / 2;
+        return true;
+        }
+
+    uint32_t* pivot = std::partition(&indices[begin], &indices[begin] + count, [&] (uint32_t index) { return binOf(index) <= bestBin; });
+    middle = static_cast<uint32_t>(pivot - indices.data());
+
+    return true;
+
+    } // SceneBVH :: split
+
+inline void SceneBVH::refit ()
+    { // SceneBVH :: refit
+
+    // children always sit after their parents, so walking the nodes
+    // backwards sees every child before the node that holds it
+    for (size_t n = nodes.size(); n-- > 0; )
+        {
+        Node& node = nodes[n];
+
+        if (node.count > 0)
+            bound(node, node.first, node.first + node.count);
+        else
+            {
+            const Node& left  = nodes[n + 1];
+            const Node& right = nodes[node.first];
+            node.min = glm::min(left.min, right.min);
+            node.max = glm::max(left.max, right.max);
+            }
+        }
+
+    refits++;
+
+    } // SceneBVH :: refit
+
+inline float SceneBVH::area (const glm::vec3& min, const glm::vec3& max)
+    { // SceneBVH :: area
+
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+
+    } // SceneBVH :: area
+
+inline float SceneBVH::cost () const
+    { // SceneBVH :: cost
+
+    if (nodes.empty())
+        return 0.0f;
+
+    float root = area(nodes[0].min, nodes[0].max);
+    if (root <= 0.0f)
+        return 0.0f;
+
+    float total = 0.0f;
+    for (const Node& node : nodes)
+        total += area(node.min, node.max) / root * (node.count > 0 ? (float)node.count : 1.0f);
+
+    return total;
+
+    } // SceneBVH :: cost
+
+inline uint32_t SceneBVH::frustum (const FrustumCulling::Frustum& frustum, std::vector<uint32_t>& out) const
+    { // SceneBVH :: frustum
+
+    out.clear();
+    if (nodes.empty())
+        return 0;
+
+    uint32_t stack [64];
+    uint32_t top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+        { // while there are nodes to visit
+        const Node& node = nodes[stack[--top]];
+
+        // a box is outside if its corner furthest along a plane's
+        // normal is still behind the plane
+        bool inside = true;
+        for (uint32_t p = 0; p < 6 && inside; ++p)
+            {
+            const glm::vec4& plane = frustum.planes[p];
+            glm::vec3 corner = {
+                plane.x > 0.0f ? node.max.x : node.min.x,
+                plane.y > 0.0f ? node.max.y : node.min.y,
+                plane.z > 0.0f ? node.max.z : node.min.z };
+            inside = glm::dot(glm::vec3(plane), corner) + plane.w > 0.0f;
+            }
+
+        if (!inside)
+            continue;
+
+        if (node.count == 0)
+            {
+            stack[top++] = node.first;
+            stack[top++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            continue;
+            }
+
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+            const glm::vec4& s = spheres[indices[i]];
+
+            bool visible = true;
+            for (uint32_t p = 0; p < 6 && visible; ++p)
+                visible = glm::dot(glm::vec3(frustum.planes[p]), glm::vec3(s)) + frustum.planes[p].w > -s.w;
+
+            if (visible)
+                out.push_back(indices[i]);
+            }
+
+        } // while there are nodes to visit
+
+    std::sort(out.begin(), out.end());
+
+    return static_cast<uint32_t>(out.size());
+
+    } // SceneBVH :: frustum
+
+inline uint32_t SceneBVH::sphere (const glm::vec3& centre, float radius, std::vector<uint32_t>& out) const
+    { // SceneBVH :: sphere
+
+    out.clear();
+    if (nodes.empty())
+        return 0;
+
+    uint32_t stack [64];
+    uint32_t top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+        { // while there are nodes to visit
+        const Node& node = nodes[stack[--top]];
+
+        glm::vec3 nearest = glm::clamp(centre, node.min, node.max);
+        glm::vec3 offset  = nearest - centre;
+        if (glm::dot(offset, offset) > radius * radius)
+            continue;
+
+        if (node.count == 0)
+            {
+            stack[top++] = node.first;
+            stack[top++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            continue;
+            }
+
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+            const glm::vec4& s = spheres[indices[i]];
+            glm::vec3 d = glm::vec3(s) - centre;
+            float reach = s.w + radius;
+            if (glm::dot(d, d) < reach * reach)
+                out.push_back(indices[i]);
+            }
+
+        } // while there are nodes to visit
+
+    std::sort(out.begin(), out.end());
+
+    return static_cast<uint32_t>(out.size());
+
+    } // SceneBVH :: sphere
+
+inline SceneBVH::Hit SceneBVH::ray (const Ray& ray) const
+    { // SceneBVH :: ray
+
+    Hit hit;
+    if (nodes.empty())
+        return hit;
+
+    float     nearest = ray.maxDistance;
+    glm::vec3 inverse = 1.0f / ray.direction;
+
+    // where the ray enters a box, or max if it misses or only
+    // reaches it beyond the nearest hit so far
+    auto entry = [&] (const Node& node)
+        {
+        glm::vec3 t0 = (node.min - ray.origin) * inverse;
+        glm::vec3 t1 = (node.max - ray.origin) * inverse;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float leave = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, nearest));
+        return (enter <= leave) ? enter : std::numeric_limits<float>::max();
+        };
+
+    uint32_t stack [64];
+    uint32_t top = 0;
+    if (entry(nodes[0]) < std::numeric_limits<float>::max())
+        stack[top++] = 0;
+
+    while (top > 0)
+        { // while there are nodes to visit
+        uint32_t n = stack[--top];
+        const Node& node = nodes[n];
+
+        if (node.count == 0)
+            {
+            // visiting the nearer child first lets it shorten the ray
+            // before the further one is looked at
+            uint32_t a = n + 1;
+            uint32_t b = node.first;
+            float ta = entry(nodes[a]);
+            float tb = entry(nodes[b]);
+            if (ta > tb)
+                {
+                std::swap(a, b);
+                std::swap(ta, tb);
+                }
+
+            if (tb < std::numeric_limits<float>::max()) stack[top++] = b;
+            if (ta < std::numeric_limits<float>::max()) stack[top++] = a;
+            continue;
+            }
+
+        if (entry(node) == std::numeric_limits<float>::max())
+            continue;
+
+        for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+            const glm::vec4& s = spheres[indices[i]];
+            glm::vec3 d = ray.origin - glm::vec3(s);
+
+            float b = glm::dot(d, ray.direction);
+            float c = glm::dot(d, d) - s.w * s.w;
+            float discriminant = b * b - c;
+            if (discriminant < 0.0f)
+                continue;
+
+            // a ray starting inside a sphere hits it straight away
+            float t = std::max(-b - std::sqrt(discriminant), 0.0f);
+            if (t < nearest && -b + std::sqrt(discriminant) >= 0.0f)
+                {
+                nearest      = t;
+                hit.index    = indices[i];
+                hit.distance = t;
+                }
+            }
+
+        } // while there are nodes to visit
+
+    return hit;
+
+    } // SceneBVH :: ray
+
+inline void SceneBVH::sphereBatch (const std::vector<glm::vec4>& queries, Results& results) const
+    { // SceneBVH :: sphereBatch
+
+    results.offsets.resize(queries.size() + 1);
+    results.indices.clear();
+
+    std::vector<uint32_t> found;
+    for (size_t q = 0; q < queries.size(); ++q)
+        {
+        results.offsets[q] = static_cast<uint32_t>(results.indices.size());
+        sphere(glm::vec3(queries[q]), queries[q].w, found);
+        results.indices.insert(results.indices.end(), found.begin(), found.end());
+        }
+
+    results.offsets[queries.size()] = static_cast<uint32_t>(results.indices.size());
+
+    } // SceneBVH :: sphereBatch
+
+inline void SceneBVH::rayBatch (const std::vector<Ray>& queries, std::vector<Hit>& hits) const
+    { // SceneBVH :: rayBatch
+
+    hits.resize(queries.size());
+    for (size_t q = 0; q < queries.size(); ++q)
+        hits[q] = ray(queries[q]);
+
+    } // SceneBVH :: rayBatch
+
+inline void SceneBVH::benchmark (uint32_t id)
+    { // SceneBVH :: benchmark
+
+    const uint32_t counts[] = { 1000, 10000, 100000 };
+    const uint32_t queries  = 1000;
+
+    // the same camera as the culling benchmark, over a field that
+    // grows with the object count so the density stays the same
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(1.0f, 1.0f, 0.01f, 100.0f);
+
+    FrustumCulling::Frustum frustum = FrustumCulling::extract(proj * view);
+
+    std::default_random_engine            rng (0);
+    std::uniform_real_distribution<float> unit (-1.0f, 1.0f);
+
+    std::ofstream file ("bvh_" + std::to_string(id) + ".txt", std::ios_base::app);
+
+    auto time = [] (uint32_t runs, const std::function<void ()>& work)
+        {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < runs; ++r)
+            work();
+        auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count() / (double)runs;
+        };
+
+    for (uint32_t count : counts)
+        { // for each object count
+
+        float size = 10.0f * std::cbrt((float)count);
+
+        std::vector<glm::vec3> centres (count);
+        for (glm::vec3& centre : centres)
+            centre = glm::vec3(unit(rng), unit(rng), unit(rng)) * size;
+
+        SceneBVH bvh;
+        bvh.update(centres, 1.0f);
+
+        uint32_t runs = std::max(1000000u / count, 5u);
+
+        double build = time(runs, [&] { bvh.build(); });
+
+        // a small step for every object, like a frame of simulation
+        for (glm::vec3& centre : centres)
+            centre += glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.1f;
+        for (uint32_t i = 0; i < count; ++i)
+            bvh.spheres[i] = glm::vec4(centres[i], 1.0f);
+
+        double refit = time(runs, [&] { bvh.refit(); });
+
+        std::vector<uint32_t> visible;
+        double frustumTime = time(runs, [&] { bvh.frustum(frustum, visible); });
+
+        std::vector<glm::vec4> probes (queries);
+        std::vector<Ray>       lines  (queries);
+        for (uint32_t q = 0; q < queries; ++q)
+            {
+            probes[q] = glm::vec4(unit(rng) * size, unit(rng) * size, unit(rng) * size, 5.0f);
+            lines[q]  = { glm::vec3(probes[q]), glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + 0.001f), size };
+            }
+
+        Results          results;
+        std::vector<Hit> hits;
+        double sphereTime = time(10, [&] { bvh.sphereBatch(probes, results); }) * 1000.0 / (double)queries;
+        double rayTime    = time(10, [&] { bvh.rayBatch(lines, hits); })  * 1000.0 / (double)queries;
+
+        std::cout << "  " << count << " objects (" << bvh.nodes.size() << " nodes) : build " << build << "ms, refit " << refit << "ms, frustum " << frustumTime << "ms (" << visible.size() << " visible), sphere " << sphereTime << "us, ray " << rayTime << "us" << std::endl;
+        file << count << " " << build << " " << refit << " " << frustumTime << " " << sphereTime << " " << rayTime << "\n";
+
+        } // for each object count
+
+    } // SceneBVH :: benchmark
+
+#endif /* SceneBVH_hpp */
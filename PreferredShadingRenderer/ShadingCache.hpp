@@ -0,0 +1,248 @@
+//
+//  ShadingCache.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef ShadingCache_hpp
+#define ShadingCache_hpp
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ShadingCache Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct ShadingCache
+    {
+
+    static constexpr uint32_t MAGIC   = 0x48435053; // "SPCH"
+    static constexpr uint32_t VERSION = 1;
+
+    // the texels are rgba16f, so a texel is compared as one word, and
+    // a control word with the top bit set repeats the word after it
+    // while one without it is followed by that many words as they are.
+    // Texels repeated fewer times than MIN_RUN are left as they are
+    static constexpr uint64_t RUN     = 1ull << 63;
+    static constexpr size_t   MIN_RUN = 3;
+
+    //
+    //  the start of a cache file. The file is named by the key, the
+    //  hash of what decides where the atlas's texels are, while the
+    //  hash of that and of the materials and lights they were lit
+    //  with is kept to check a load against once they're restored
+    //
+    struct Header {
+        uint32_t  magic;
+        uint32_t  version;
+        uint64_t  key;
+        uint64_t  hash;
+        uint32_t  objects;
+        uint32_t  lightCount;
+        glm::vec4 lightPosition;
+        uint64_t  texels;  // across every level of the atlas
+        uint64_t  words;   // once compressed
+    };
+
+    //
+    //  hash
+    //
+    //  a 64 bit FNV-1a hash of the bytes, carried on from the seed
+    //
+    static uint64_t hash (const void* data, size_t bytes, uint64_t seed = 0xcbf29ce484222325ull);
+
+    //
+    //  path
+    //
+    //  the file a cache with the given key is kept in
+    //
+    static std::string path (uint64_t key);
+
+    //
+    //  compress / decompress
+    //
+    //  run length encodes the texels into words, and decodes them
+    //  again, which fails on words that don't fill exactly count
+    //
+    static void compress   (const uint64_t* texels, size_t count, std::vector<uint64_t>& words);
+    static bool decompress (const std::vector<uint64_t>& words, uint64_t* texels, size_t count);
+
+    //
+    //  writeCacheFile / readCacheFile
+    //
+    //  the header, a material for each object, and the compressed
+    //  texels, in that order. A file is only read for the number of
+    //  objects and texels given, and only as far as it's long enough
+    //  to hold what its header says it does
+    //
+    static bool writeCacheFile (const std::string& path, const Header& header, const std::vector<glm::vec4>& materials, const std::vector<uint64_t>& words);
+    static bool readCacheFile  (const std::string& path, uint32_t objects, uint64_t texels, Header& header, std::vector<glm::vec4>& materials, std::vector<uint64_t>& words);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ShadingCache Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline uint64_t ShadingCache::hash (const void* data, size_t bytes, uint64_t seed)
+    { // ShadingCache :: hash
+
+    const uint8_t* byte = static_cast<const uint8_t*>(data);
+
+    uint64_t h = seed;
+    for (size_t i = 0; i < bytes; ++i)
+        {
+        h ^= byte[i];
+        h *= 0x100000001b3ull;
+        }
+
+    return h;
+
+    } // ShadingCache :: hash
+
+inline std::string ShadingCache::path (uint64_t key)
+    { // ShadingCache :: path
+
+    char name [40];
+    snprintf(name, sizeof(name), "shading_%016llx.cache", (unsigned long long)key);
+
+    return std::string(name);
+
+    } // ShadingCache :: path
+
+inline void ShadingCache::compress (const uint64_t* texels, size_t count, std::vector<uint64_t>& words)
+    { // ShadingCache :: compress
+
+    words.clear();
+
+    size_t i = 0;
+    while (i < count)
+        { // for each run
+
+        size_t run = 1;
+        while (i + run < count && texels[i + run] == texels[i])
+            run++;
+
+        if (run >= MIN_RUN)
+            {
+            words.push_back(RUN | run);
+            words.push_back(texels[i]);
+            i += run;
+            continue;
+            }
+
+        // the texels up to the next run long enough to be worth one
+        // are kept as they are, behind a count filled in after them
+        size_t control = words.size();
+        size_t first   = i;
+        words.push_back(0);
+
+        while (i < count)
+            {
+            size_t repeat = 1;
+            while (i + repeat < count && repeat < MIN_RUN && texels[i + repeat] == texels[i])
+                repeat++;
+
+            if (repeat >= MIN_RUN)
+                break;
+
+            words.push_back(texels[i++]);
+            }
+
+        words[control] = i - first;
+        } // for each run
+
+    } // ShadingCache :: compress
+
+inline bool ShadingCache::decompress (const std::vector<uint64_t>& words, uint64_t* texels, size_t count)
+    { // ShadingCache :: decompress
+
+    size_t i = 0;
+    size_t w = 0;
+
+    while (w < words.size())
+        { // for each run
+        uint64_t control = words[w++];
+        uint64_t length  = control & ~RUN;
+
+        if (length > count - i)
+            return false;
+
+        if (control & RUN)
+            {
+            if (w >= words.size())
+                return false;
+
+            uint64_t texel = words[w++];
+            for (uint64_t n = 0; n < length; ++n)
+                texels[i++] = texel;
+            }
+        else
+            {
+            if (length > words.size() - w)
+                return false;
+
+            for (uint64_t n = 0; n < length; ++n)
+                texels[i++] = words[w++];
+            }
+        } // for each run
+
+    return i == count;
+
+    } // ShadingCache :: decompress
+
+inline bool ShadingCache::writeCacheFile (const std::string& path, const Header& header, const std::vector<glm::vec4>& materials, const std::vector<uint64_t>& words)
+    { // ShadingCache :: writeCacheFile
+
+    std::ofstream output (path, std::ios::binary);
+    if (!output)
+        return false;
+
+    output.write((const char*)&header, sizeof(Header));
+    output.write((const char*)materials.data(), sizeof(glm::vec4) * materials.size());
+    output.write((const char*)words.data(), sizeof(uint64_t) * words.size());
+
+    output.close();
+
+    return !output.fail();
+
+    } // ShadingCache :: writeCacheFile
+
+inline bool ShadingCache::readCacheFile (const std::string& path, uint32_t objects, uint64_t texels, Header& header, std::vector<glm::vec4>& materials, std::vector<uint64_t>& words)
+    { // ShadingCache :: readCacheFile
+
+    std::ifstream input (path, std::ios::binary | std::ios::ate);
+    if (!input)
+        return false;
+
+    uint64_t size = (uint64_t)input.tellg();
+    input.seekg(0);
+
+    // a file from another version, or for another atlas, is as good
+    // as none, and nothing is sized from it before that's ruled out
+    input.read((char*)&header, sizeof(Header));
+    if (!input || header.magic != MAGIC || header.version != VERSION || header.objects != objects || header.texels != texels || header.words > 2 * texels)
+        return false;
+
+    // as is one cut short
+    if (size != sizeof(Header) + sizeof(glm::vec4) * (uint64_t)objects + sizeof(uint64_t) * header.words)
+        return false;
+
+    materials.resize(header.objects);
+    words.resize(header.words);
+
+    input.read((char*)materials.data(), sizeof(glm::vec4) * materials.size());
+    input.read((char*)words.data(), sizeof(uint64_t) * words.size());
+
+    return !input.fail();
+
+    } // ShadingCache :: readCacheFile
+
+#endif /* ShadingCache_hpp */
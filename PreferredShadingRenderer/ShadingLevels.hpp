@@ -0,0 +1,115 @@
+//
+//  ShadingLevels.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef ShadingLevels_hpp
+#define ShadingLevels_hpp
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ShadingLevels Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct ShadingLevels
+    {
+
+    // an object at level l is shaded into the corner of its atlas
+    // tile 1/2^l a side, so level 3 costs 1/64th of level 0
+    static constexpr uint32_t MAX_LEVEL = 3;
+
+    // how far past a level boundary, in levels, the ideal level has
+    // to move before an object switches, so objects sitting on a
+    // boundary don't flicker between the two
+    static constexpr float HYSTERESIS = 0.25f;
+
+    //
+    //  projectedSize
+    //
+    //  an estimate of the height in pixels of a world space sphere
+    //  on a screen of the given height. Spheres around the eye are
+    //  reported as infinitely large
+    //
+    static float projectedSize (
+        const glm::mat4& view,
+        const glm::mat4& proj,
+        float            screenHeight,
+        const glm::vec3& centre,
+        float            radius);
+
+    //
+    //  select
+    //
+    //  the level an object at the current level moves to, for a tile
+    //  of the given size in texels covering the given pixels on screen
+    //
+    static uint32_t select (uint32_t current, float tileSize, float pixels);
+
+    //
+    //  transform
+    //
+    //  the scale (xy) and offset (zw) that move uvs laid out by
+    //  MeshIO::atlas into the corner of their tile at the given level
+    //
+    static glm::vec4 transform (const glm::vec2& tileOrigin, uint32_t level);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ShadingLevels Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline float ShadingLevels::projectedSize (
+        const glm::mat4& view,
+        const glm::mat4& proj,
+        float            screenHeight,
+        const glm::vec3& centre,
+        float            radius)
+    { // ShadingLevels :: projectedSize
+
+    // the depth along the view direction rather than the distance,
+    // which overestimates spheres away from the centre of the screen
+    float depth = -(view * glm::vec4(centre, 1.0f)).z;
+    if (depth <= radius)
+        return std::numeric_limits<float>::max();
+
+    return radius * std::abs(proj[1][1]) * screenHeight / depth;
+
+    } // ShadingLevels :: projectedSize
+
+inline uint32_t ShadingLevels::select (uint32_t current, float tileSize, float pixels)
+    { // ShadingLevels :: select
+
+    if (pixels <= 0.0f)
+        return MAX_LEVEL;
+
+    // the level at which the tile has as many texels a side as the
+    // object covers pixels
+    float ideal = std::log2(tileSize / pixels);
+
+    if (ideal >= (float)current + 1.0f + HYSTERESIS)
+        current = (uint32_t)std::floor(ideal - HYSTERESIS);
+    else if (ideal < (float)current - HYSTERESIS)
+        current = (uint32_t)std::max(0.0f, std::floor(ideal + HYSTERESIS));
+
+    return (current < MAX_LEVEL) ? current : MAX_LEVEL;
+
+    } // ShadingLevels :: select
+
+inline glm::vec4 ShadingLevels::transform (const glm::vec2& tileOrigin, uint32_t level)
+    { // ShadingLevels :: transform
+
+    float scale = 1.0f / (float)(1u << level);
+
+    return glm::vec4(scale, scale, tileOrigin * (1.0f - scale));
+
+    } // ShadingLevels :: transform
+
+#endif /* ShadingLevels_hpp */
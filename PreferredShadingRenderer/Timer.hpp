@@ -12,10 +12,12 @@ struct Timer
 
 	uint32_t id;
 
-	std::chrono::high_resolution_clock::time_point start;
-	std::chrono::high_resolution_clock::time_point stop;
+	// the steady clock can't jump with wall time adjustments, and
+	// deltas are kept as fractional milliseconds since a 120hz
+	// frame is only 8.3ms long
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point stop;
 
-	double minDelta = 0;
 	double delta    = 0;
 
 	double timer    = 0;
@@ -28,9 +30,8 @@ struct Timer
 	std::vector<double> deltas;
 	bool shouldClose = false;
 
-	Timer (uint32_t maxFps) :
-		minDelta ((1.0f / (float)maxFps) * 1000),
-		start    (std::chrono::high_resolution_clock::now())
+	Timer () :
+		start (std::chrono::steady_clock::now())
 		{ // Timer :: Timer
 
 		} // Timer :: Timer
@@ -45,27 +46,12 @@ struct Timer
 	void update ()
 		{ // Timer :: update
 	
-		/*
-
-		stop  = std::chrono::high_resolution_clock::now();
-		delta = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
-
-		if (delta < minDelta)
-			{
-
-			double nextFrame = minDelta - delta;
-			std::chrono::milliseconds waitTime ((int)nextFrame);
-			std::this_thread::sleep_for (waitTime);
-
-			}
-
-		*/
-
-		stop  = std::chrono::high_resolution_clock::now();
-		delta = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+		// frame limiting lives in the FramePacer now, this only measures
+		stop  = std::chrono::steady_clock::now();
+		delta = std::chrono::duration<double, std::milli>(stop - start).count();
 		frame = frame + 1;
-		fps   = (uint32_t)(1000.0f / delta);
-		start = std::chrono::high_resolution_clock::now();
+		fps   = (delta > 0.0) ? (uint32_t)(1000.0 / delta) : 0;
+		start = stop;
 
 		deltas.push_back(delta);
 
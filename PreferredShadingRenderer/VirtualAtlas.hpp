@@ -0,0 +1,574 @@
+//
+//  VirtualAtlas.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef VirtualAtlas_hpp
+#define VirtualAtlas_hpp
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ShadingLevels.hpp"
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  VirtualAtlas Interface
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+struct VirtualAtlas
+    {
+
+    // a page holds one object's tile at shading level 0, and splits
+    // into quarters for every level below it, down to cells of the
+    // coarsest level. Which cells of a page are taken is kept as a
+    // bit each, so a page can't have more than 64 of them
+    static constexpr uint32_t CELLS = 1u << ShadingLevels::MAX_LEVEL;
+    static_assert(CELLS * CELLS <= 64, "a page's cells have to fit its mask");
+
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    //
+    //  the page table entry of an object, the square of cells it
+    //  was given, in cells from its page's corner, and the frame it
+    //  was last asked for in, which eviction goes by
+    //
+    struct Entry {
+        bool     resident = false;
+        uint32_t page     = 0;
+        uint32_t level    = 0;
+        uint32_t x        = 0;
+        uint32_t y        = 0;
+        uint64_t used     = 0;
+    };
+
+    uint32_t pageSize     = 0; // texels a side, a multiple of CELLS
+    uint32_t pagesPerSide = 0;
+
+    std::vector<uint64_t> pages;
+    std::vector<Entry>    entries;
+
+    // the pages with an aligned block free at each level, lowest
+    // first so tiles pack the way scanning the pages would place
+    // them, and the levels each page is listed under. Only the page
+    // a tile goes into or leaves is looked at again, so placing one
+    // doesn't mean going over every page once the atlas is full
+    std::set<uint32_t>   open [ShadingLevels::MAX_LEVEL + 1];
+    std::vector<uint8_t> fits;
+
+    // the resident objects in the order they were last asked for,
+    // and the cells of those asked for in the current frame, so that
+    // neither eviction nor the room it could make means going over
+    // every object, which with a large scene is most of the frame
+    std::set<std::pair<uint64_t, uint32_t>> lru;
+    uint64_t current = 0;
+    uint32_t touched = 0;
+
+    uint32_t freeCells = 0;
+    uint32_t evictions = 0;
+
+    //
+    //  init
+    //
+    //  an empty table for the given number of objects over a square
+    //  of pages, none of which are resident
+    //
+    void init (uint32_t _pageSize, uint32_t _pagesPerSide, uint32_t objects);
+
+    //
+    //  request
+    //
+    //  makes an object resident at the given level, or the finest
+    //  coarser one that fits, keeping reserve cells for the objects
+    //  still to be asked for this frame. The least recently used
+    //  objects not yet asked for this frame are evicted to make room.
+    //  An object already resident at the level only has its use noted
+    //
+    bool request (uint32_t id, uint32_t level, uint64_t frame, uint32_t reserve);
+
+    //
+    //  release
+    //
+    //  gives the object's cells back, leaving it without a page
+    //
+    void release (uint32_t id);
+
+    //
+    //  touch
+    //
+    //  notes a resident object as asked for in the frame, which
+    //  keeps it from being evicted until a later one
+    //
+    void touch (uint32_t id, uint64_t frame);
+
+    //
+    //  rect
+    //
+    //  the texels the object was given, origin (xy) to limit (zw),
+    //  and the texels of a whole page
+    //
+    glm::uvec4 rect (uint32_t id) const;
+    glm::uvec4 pageRect (uint32_t page) const;
+
+    //
+    //  transform
+    //
+    //  the scale (xy) and offset (zw) that move uvs laid out in the
+    //  virtual tile at the given origin and size, as MeshIO::atlas
+    //  gives each object, onto the texels the object was given
+    //
+    glm::vec4 transform (uint32_t id, const glm::vec2& tileOrigin, float tileSize) const;
+
+    // the pages holding anything
+    uint32_t pagesUsed () const;
+
+    static uint32_t cells  (uint32_t level);
+    static uint64_t mask   (uint32_t level, uint32_t x, uint32_t y);
+    static uint8_t  levels (uint64_t page);
+
+    //
+    //  allocate
+    //
+    //  places the object at the level in the given page, or in the
+    //  lowest page with room at it when none is given
+    //
+    bool     allocate  (uint32_t id, uint32_t level, uint32_t page = NONE);
+    void     reopen    (uint32_t page);
+    uint32_t victim    (uint64_t frame) const;
+    uint32_t evictable (uint64_t frame) const;
+
+    //
+    //  benchmark
+    //
+    //  times a frame of requests, made the way selectResidency makes
+    //  them, over tables for more and more objects with pages for a
+    //  tenth of them. A twentieth of the objects are asked for each
+    //  frame, from a window that drifts along so that there's always
+    //  something to evict. Results are appended to atlas_<id>.txt as
+    //
+    //      objects  pages  frame(ms)  evictions  table(bytes/object)
+    //
+    //  with the evictions given per frame
+    //
+    static void benchmark (uint32_t id);
+
+    };
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  VirtualAtlas Implementation
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+inline void VirtualAtlas::init (uint32_t _pageSize, uint32_t _pagesPerSide, uint32_t objects)
+    { // VirtualAtlas :: init
+
+    pageSize     = _pageSize;
+    pagesPerSide = _pagesPerSide;
+
+    pages.assign(pagesPerSide * pagesPerSide, 0);
+    entries.assign(objects, Entry { });
+    lru.clear();
+
+    // an empty page has room at every level
+    fits.assign(pages.size(), levels(0));
+    for (std::set<uint32_t>& level : open)
+        {
+        level.clear();
+        for (uint32_t p = 0; p < pages.size(); ++p)
+            level.insert(level.end(), p);
+        }
+
+    current   = 0;
+    touched   = 0;
+    freeCells = static_cast<uint32_t>(pages.size()) * CELLS * CELLS;
+    evictions = 0;
+
+    } // VirtualAtlas :: init
+
+inline bool VirtualAtlas::request (uint32_t id, uint32_t level, uint64_t frame, uint32_t reserve)
+    { // VirtualAtlas :: request
+
+    Entry& entry = entries[id];
+
+    if (entry.resident && entry.level == level)
+        {
+        touch(id, frame);
+        return true;
+        }
+
+    // a tile changing level is drawn again from scratch anyway, so
+    // it's free to move wherever its new size fits
+    if (entry.resident)
+        release(id);
+
+    for (uint32_t l = level; l <= ShadingLevels::MAX_LEVEL; ++l)
+        { // for each level, finest first
+
+        // the coarsest level only ever takes one cell, so while the
+        // reserve holds every object left finds room at it
+        if (freeCells + evictable(frame) < cells(l) + reserve)
+            continue;
+
+        // a block can be out of reach with enough cells free when
+        // they're spread over pages, so objects are evicted until
+        // one is free or nothing more can be. Only the victim's page
+        // has changed after each, so it's the only one looked at again
+        if (!allocate(id, l))
+            while (true)
+                { // evict
+                uint32_t v = victim(frame);
+                if (v == NONE)
+                    break;
+
+                uint32_t page = entries[v].page;
+                release(v);
+                evictions++;
+
+                if (allocate(id, l, page))
+                    break;
+                } // evict
+
+        if (entry.resident)
+            {
+            touch(id, frame);
+            return true;
+            }
+        } // for each level, finest first
+
+    return false;
+
+    } // VirtualAtlas :: request
+
+inline void VirtualAtlas::release (uint32_t id)
+    { // VirtualAtlas :: release
+
+    Entry& entry = entries[id];
+    if (!entry.resident)
+        return;
+
+    pages[entry.page] &= ~mask(entry.level, entry.x, entry.y);
+    freeCells += cells(entry.level);
+    entry.resident = false;
+    reopen(entry.page);
+
+    lru.erase(std::make_pair(entry.used, id));
+    if (entry.used == current)
+        touched -= cells(entry.level);
+
+    } // VirtualAtlas :: release
+
+inline glm::uvec4 VirtualAtlas::rect (uint32_t id) const
+    { // VirtualAtlas :: rect
+
+    const Entry& entry = entries[id];
+
+    glm::uvec4 page = pageRect(entry.page);
+    uint32_t   cell = pageSize / CELLS;
+    uint32_t   side = pageSize >> entry.level;
+
+    glm::uvec2 origin = glm::uvec2(page.x + entry.x * cell, page.y + entry.y * cell);
+
+    return glm::uvec4(origin, origin + glm::uvec2(side));
+
+    } // VirtualAtlas :: rect
+
+inline glm::uvec4 VirtualAtlas::pageRect (uint32_t page) const
+    { // VirtualAtlas :: pageRect
+
+    glm::uvec2 origin = glm::uvec2(page % pagesPerSide, page / pagesPerSide) * pageSize;
+
+    return glm::uvec4(origin, origin + glm::uvec2(pageSize));
+
+    } // VirtualAtlas :: pageRect
+
+inline glm::vec4 VirtualAtlas::transform (uint32_t id, const glm::vec2& tileOrigin, float tileSize) const
+    { // VirtualAtlas :: transform
+
+    glm::uvec4 texels = rect(id);
+    float      size   = (float)(pageSize * pagesPerSide);
+
+    float     scale  = ((float)(texels.z - texels.x) / size) / tileSize;
+    glm::vec2 origin = glm::vec2(texels.x, texels.y) / size;
+
+    return glm::vec4(scale, scale, origin - tileOrigin * scale);
+
+    } // VirtualAtlas :: transform
+
+inline uint32_t VirtualAtlas::pagesUsed () const
+    { // VirtualAtlas :: pagesUsed
+
+    uint32_t used = 0;
+    for (uint64_t page : pages)
+        used += (page != 0) ? 1 : 0;
+
+    return used;
+
+    } // VirtualAtlas :: pagesUsed
+
+inline uint32_t VirtualAtlas::cells (uint32_t level)
+    { // VirtualAtlas :: cells
+
+    uint32_t side = CELLS >> level;
+    return side * side;
+
+    } // VirtualAtlas :: cells
+
+inline uint64_t VirtualAtlas::mask (uint32_t level, uint32_t x, uint32_t y)
+    { // VirtualAtlas :: mask
+
+    uint32_t side = CELLS >> level;
+    uint64_t row  = ((1ull << side) - 1) << x;
+
+    uint64_t bits = 0;
+    for (uint32_t r = 0; r < side; ++r)
+        bits |= row << ((y + r) * CELLS);
+
+    return bits;
+
+    } // VirtualAtlas :: mask
+
+inline uint8_t VirtualAtlas::levels (uint64_t page)
+    { // VirtualAtlas :: levels
+
+    // the cells each level's blocks start at, aligned to their size
+    static const std::vector<uint64_t> corners = [] ()
+        {
+        std::vector<uint64_t> out (ShadingLevels::MAX_LEVEL + 1);
+        for (uint32_t l = 0; l <= ShadingLevels::MAX_LEVEL; ++l)
+            for (uint32_t y = 0; y < CELLS; y += CELLS >> l)
+                for (uint32_t x = 0; x < CELLS; x += CELLS >> l)
+                    out[l] |= 1ull << (y * CELLS + x);
+        return out;
+        } ();
+
+    // a bit stays set for each free block of twice the last side,
+    // from the four free blocks it's made of, so the whole mask is
+    // tested a level at a time rather than a block at a time. A
+    // block free at a level holds free blocks at every coarser one,
+    // so the search stops at the first level without one
+    uint64_t free   = ~page;
+    uint8_t  levels = 0;
+
+    for (uint32_t l = ShadingLevels::MAX_LEVEL + 1; l-- > 0; )
+        { // for each level, coarsest first
+        uint32_t half = (CELLS >> l) / 2;
+
+        if (half > 0)
+            free &= (free >> half) & (free >> (half * CELLS)) & (free >> (half * CELLS + half));
+
+        free &= corners[l];
+        if (free == 0)
+            break;
+
+        levels |= (uint8_t)(1u << l);
+        } // for each level, coarsest first
+
+    return levels;
+
+    } // VirtualAtlas :: levels
+
+inline void VirtualAtlas::touch (uint32_t id, uint64_t frame)
+    { // VirtualAtlas :: touch
+
+    // nothing was asked for yet in a new frame
+    if (frame != current)
+        {
+        current = frame;
+        touched = 0;
+        }
+
+    Entry& entry = entries[id];
+    if (entry.used == current)
+        return;
+
+    lru.erase(std::make_pair(entry.used, id));
+    entry.used = current;
+    lru.insert(std::make_pair(entry.used, id));
+
+    touched += cells(entry.level);
+
+    } // VirtualAtlas :: touch
+
+inline bool VirtualAtlas::allocate (uint32_t id, uint32_t level, uint32_t page)
+    { // VirtualAtlas :: allocate
+
+    uint32_t side = CELLS >> level;
+
+    if (page == NONE)
+        {
+        if (open[level].empty())
+            return false;
+
+        page = *open[level].begin();
+        }
+    else if ((fits[page] & (1u << level)) == 0)
+        return false;
+
+    // blocks sit aligned to their own size, like a quadtree's nodes,
+    // so a page never fragments into pieces no level can use
+    for (uint32_t y = 0; y < CELLS; y += side)
+        for (uint32_t x = 0; x < CELLS; x += side)
+            {
+            uint64_t bits = mask(level, x, y);
+            if (pages[page] & bits)
+                continue;
+
+            pages[page] |= bits;
+            freeCells -= cells(level);
+            reopen(page);
+
+            Entry& entry = entries[id];
+                entry.resident = true;
+                entry.page     = page;
+                entry.level    = level;
+                entry.x        = x;
+                entry.y        = y;
+
+            lru.insert(std::make_pair(entry.used, id));
+            if (entry.used == current)
+                touched += cells(level);
+
+            return true;
+            }
+
+    return false;
+
+    } // VirtualAtlas :: allocate
+
+inline void VirtualAtlas::reopen (uint32_t page)
+    { // VirtualAtlas :: reopen
+
+    uint8_t now     = levels(pages[page]);
+    uint8_t changed = now ^ fits[page];
+
+    for (uint32_t l = 0; l <= ShadingLevels::MAX_LEVEL; ++l)
+        {
+        if ((changed & (1u << l)) == 0)
+            continue;
+
+        if (now & (1u << l))
+            open[l].insert(page);
+        else open[l].erase(page);
+        }
+
+    fits[page] = now;
+
+    } // VirtualAtlas :: reopen
+
+inline uint32_t VirtualAtlas::victim (uint64_t frame) const
+    { // VirtualAtlas :: victim
+
+    // nothing is ever asked for in a frame later than this one, so
+    // when the oldest was asked for in it every other one was too
+    if (lru.empty() || lru.begin()->first == frame)
+        return NONE;
+
+    return lru.begin()->second;
+
+    } // VirtualAtlas :: victim
+
+inline uint32_t VirtualAtlas::evictable (uint64_t frame) const
+    { // VirtualAtlas :: evictable
+
+    uint32_t resident = static_cast<uint32_t>(pages.size()) * CELLS * CELLS - freeCells;
+
+    return (frame == current) ? resident - touched : resident;
+
+    } // VirtualAtlas :: evictable
+
+inline void VirtualAtlas::benchmark (uint32_t id)
+    { // VirtualAtlas :: benchmark
+
+    const uint32_t counts[] = { 1000, 10000, 100000 };
+    const uint32_t frames   = 100;
+
+    std::default_random_engine              rng (0);
+    std::uniform_int_distribution<uint32_t> level (0, ShadingLevels::MAX_LEVEL);
+
+    std::ofstream file ("atlas_" + std::to_string(id) + ".txt", std::ios_base::app);
+
+    for (uint32_t count : counts)
+        { // for each object count
+
+        // every object still has to fit at the coarsest level
+        uint32_t perSide = std::max(1u, (uint32_t)std::ceil(std::sqrt(count / 10.0f)));
+        while (perSide * perSide * CELLS * CELLS < count)
+            perSide++;
+
+        VirtualAtlas table;
+        table.init(CELLS * 16, perSide, count);
+
+        uint32_t window = std::max(1u, count / 20);
+        uint32_t step   = std::max(1u, window / 10);
+
+        std::vector<uint32_t> requests (window);
+        std::vector<uint32_t> levels   (count);
+
+        double   total     = 0.0;
+        uint32_t evictions = 0;
+
+        for (uint64_t frame = 1; frame <= frames; ++frame)
+            { // for each frame
+            uint32_t first = (uint32_t)((frame * step) % count);
+            for (uint32_t r = 0; r < window; ++r)
+                {
+                requests[r]          = (first + r) % count;
+                levels[requests[r]]  = level(rng);
+                }
+
+            table.evictions = 0;
+
+            auto start = std::chrono::steady_clock::now();
+
+            uint32_t reserve = 0;
+            for (uint32_t i : requests)
+                {
+                if (table.entries[i].resident)
+                    table.touch(i, frame);
+                else reserve++;
+                }
+
+            for (uint32_t i : requests)
+                {
+                if (!table.entries[i].resident)
+                    reserve--;
+
+                table.request(i, levels[i], frame, reserve);
+                }
+
+            auto stop = std::chrono::steady_clock::now();
+
+            total     += std::chrono::duration<double, std::milli>(stop - start).count();
+            evictions += table.evictions;
+            } // for each frame
+
+        // an entry per object, and a node of the set for each of those
+        // resident, which is at least its value and three links. The
+        // pages, with the levels they fit and their nodes of the open
+        // sets, are shared out over the objects too
+        size_t nodes = 0;
+        for (const std::set<uint32_t>& level : table.open)
+            nodes += level.size();
+
+        double pageBytes = table.pages.size() * (sizeof(uint64_t) + sizeof(uint8_t)) + nodes * (sizeof(uint32_t) + 3 * sizeof(void*));
+        double bytes     = sizeof(Entry) + (double)table.lru.size() / count * (sizeof(std::pair<uint64_t, uint32_t>) + 3 * sizeof(void*)) + pageBytes / count;
+
+        std::cout << "  " << count << " objects (" << table.pages.size() << " pages) : frame " << total / frames << "ms, " << evictions / frames << " evictions, " << bytes << " bytes an object" << std::endl;
+        file << count << " " << table.pages.size() << " " << total / frames << " " << evictions / frames << " " << bytes << "\n";
+
+        } // for each object count
+
+    } // VirtualAtlas :: benchmark
+
+#endif /* VirtualAtlas_hpp */
@@ -67,6 +67,48 @@ float dragStartY = 0.0f;
 bool leftMouseButton  = false;
 bool rightMouseButton = false;
 
+bool framebufferResized = false;
+
+bool cyclePacing = false;
+
+bool cycleRecording = false;
+bool runRecordingBenchmark = false;
+
+bool toggleCulling = false;
+bool runCullingBenchmark = false;
+bool toggleGpuCulling = false;
+
+bool toggleFeedback = false;
+
+bool toggleOcclusion = false;
+
+bool toggleClusters = false;
+
+bool toggleLevels = false;
+
+bool togglePrediction = false;
+
+bool toggleGeometryCache = false;
+
+bool toggleTiledLighting = false;
+
+bool cycleLights = false;
+bool runLightingBenchmark = false;
+
+bool toggleTemporal = false;
+bool cycleTemporalSubset = false;
+
+bool cycleSpecular = false;
+
+bool toggleShadows = false;
+
+static void framebufferResizeCallback (GLFWwindow* window, int width, int height)
+	{
+
+	framebufferResized = true;
+
+	}
+
 static void mouseScrollCallback (GLFWwindow* window, double xoffset, double yoffset)
 	{
 
@@ -179,6 +221,63 @@ void keyCallback (GLFWwindow* window, int key, int scancode, int action, int mod
 
 	if (key == GLFW_KEY_R && action == GLFW_PRESS)
 		reset = (reset + 1) % 3;
+
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		cyclePacing = true;
+
+	if (key == GLFW_KEY_M && action == GLFW_PRESS)
+		cycleRecording = true;
+
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+		runRecordingBenchmark = true;
+
+	if (key == GLFW_KEY_V && action == GLFW_PRESS)
+		toggleCulling = true;
+
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+		runCullingBenchmark = true;
+
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		toggleGpuCulling = true;
+
+	if (key == GLFW_KEY_O && action == GLFW_PRESS)
+		toggleFeedback = true;
+
+	if (key == GLFW_KEY_H && action == GLFW_PRESS)
+		toggleOcclusion = true;
+
+	if (key == GLFW_KEY_K && action == GLFW_PRESS)
+		toggleClusters = true;
+
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+		toggleLevels = true;
+
+	if (key == GLFW_KEY_N && action == GLFW_PRESS)
+		togglePrediction = true;
+
+	if (key == GLFW_KEY_X && action == GLFW_PRESS)
+		toggleGeometryCache = true;
+
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		toggleTiledLighting = true;
+
+	if (key == GLFW_KEY_U && action == GLFW_PRESS)
+		cycleLights = true;
+
+	if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+		runLightingBenchmark = true;
+
+	if (key == GLFW_KEY_I && action == GLFW_PRESS)
+		toggleTemporal = true;
+
+	if (key == GLFW_KEY_J && action == GLFW_PRESS)
+		cycleTemporalSubset = true;
+
+	if (key == GLFW_KEY_Y && action == GLFW_PRESS)
+		cycleSpecular = true;
+
+	if (key == GLFW_KEY_1 && action == GLFW_PRESS)
+		toggleShadows = true;
     }
 
 
@@ -200,12 +299,15 @@ VulkanApp::VulkanApp (uint32_t width, uint32_t height, std::string title, uint32
         WINDOW_TITLE  (title),
         WINDOW_CLEAR  ({ clear.x, clear.y, clear.z, 1.0f }),
         window        (nullptr),
-	timing        (MAX_FPS),
+	pacer         (FramePacer::eCapped, MAX_FPS),
 	nObjects      (objects)
     { // VulkanApp :: VulkanApp
 
     shading.BUFFER_SIZE = resolution;
     shading.interval = interval;
+
+    // the camera starts still, wherever it was placed
+    prediction.lastEye = eyePosition;
     
     runID = id;
     timing.id = runID;
@@ -219,26 +321,52 @@ VulkanApp::VulkanApp (uint32_t width, uint32_t height, std::string title, uint32
     if (createSwapChain             () != vk::Result::eSuccess) ErrorHandler::fatal    ("Swapchain Creation failure");
     if (createDepthBuffer           () != vk::Result::eSuccess) ErrorHandler::fatal    ("Depth Buffer Creation failure");
     if (createCommandPool           () != vk::Result::eSuccess) ErrorHandler::fatal.   ("Command Pool Creation Failure");
+    if (createCommandRecorder       () != vk::Result::eSuccess) ErrorHandler::fatal    ("Command Recorder Creation Failure");
+    if (createVirtualAtlas          () != vk::Result::eSuccess) ErrorHandler::fatal    ("Virtual Atlas Creation Failure");
     if (createShadingResources      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Resource Creation Failure");
-    if (createGeometryUniformBuffer () != vk::Result::eSuccess) ErrorHandler::fatal    ("Geometry Uniform Buffer Creationn failure");
+    if (createCoverageBuffer        () != vk::Result::eSuccess) ErrorHandler::fatal    ("Coverage Buffer Creation Failure");
+    if (createObjectBuffers         () != vk::Result::eSuccess) ErrorHandler::fatal    ("Object Buffer Creation failure");
     if (createShadingUniformBuffer  () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Uniform Buffer Creationn failure");
+    if (createLightBuffer           () != vk::Result::eSuccess) ErrorHandler::fatal    ("Light Buffer Creation failure");
     if (createRasterUniformBuffer   () != vk::Result::eSuccess) ErrorHandler::fatal    ("Raster Uniform Buffer Creationn failure");
+    if (createCullingBuffers        () != vk::Result::eSuccess) ErrorHandler::fatal    ("Culling Buffer Creation failure");
+    if (createVisibilityBuffer      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Visibility Buffer Creation failure");
+    if (createFeedbackBuffers       () != vk::Result::eSuccess) ErrorHandler::fatal    ("Feedback Buffer Creation failure");
+    if (createLightingBuffers       () != vk::Result::eSuccess) ErrorHandler::fatal    ("Lighting Buffer Creation failure");
+    if (createMipBuffers            () != vk::Result::eSuccess) ErrorHandler::fatal    ("Mip Buffer Creation failure");
+    if (createDepthPyramid          () != vk::Result::eSuccess) ErrorHandler::fatal    ("Depth Pyramid Creation failure");
+    if (createShadowMaps            () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shadow Map Creation failure");
     if (createDescriptorPool        () != vk::Result::eSuccess) ErrorHandler::fatal    ("Descriptor Pool Creation Failure");
     if (createGeometryDescriptorSet () != vk::Result::eSuccess) ErrorHandler::fatal    ("Geometry Descriptor Set Creation Failure");
     if (createShadingDescriptorSet  () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Descriptor Set Creation failure");
     if (createRasterDescriptorSet   () != vk::Result::eSuccess) ErrorHandler::fatal    ("Raster Descriptor Set Creation failure");
+    if (createCullingDescriptorSet  () != vk::Result::eSuccess) ErrorHandler::fatal    ("Culling Descriptor Set Creation failure");
+    if (createFeedbackDescriptorSet () != vk::Result::eSuccess) ErrorHandler::fatal    ("Feedback Descriptor Set Creation failure");
+    if (createLightingDescriptorSet () != vk::Result::eSuccess) ErrorHandler::fatal    ("Lighting Descriptor Set Creation failure");
+    if (createMipDescriptorSets     () != vk::Result::eSuccess) ErrorHandler::fatal    ("Mip Descriptor Set Creation failure");
+    if (createOcclusionDescriptorSet() != vk::Result::eSuccess) ErrorHandler::fatal    ("Occlusion Descriptor Set Creation failure");
+    if (createShadowDescriptorSet   () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shadow Descriptor Set Creation failure");
     if (createSemaphores            () != vk::Result::eSuccess) ErrorHandler::fatal    ("Semaphore creation failure");
     if (createShadingRenderPass     () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Render Pass Creation");
     if (createRasterRenderPass      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Raster Render Pass Creation failure");
     if (createShadingFrameBuffer    () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading framebuffer creation failure");
     if (createRasterFrameBuffers    () != vk::Result::eSuccess) ErrorHandler::fatal    ("Raster framebuffer Creation failure");
+    if (createShadowRenderPass      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shadow Render Pass Creation failure");
     if (createVertexBuffers         () != vk::Result::eSuccess) ErrorHandler::fatal    ("Vertex Buffer Creation failure");
     if (createIndexBuffers          () != vk::Result::eSuccess) ErrorHandler::fatal    ("Index Buffer Creation failure");
     if (createGeometryPipeline      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Geometry Graphics Pipeline Creation Failure");
     if (createShadingPipeline       () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Graphics Pipeline Creation Failure");
     if (createRasterPipeline        () != vk::Result::eSuccess) ErrorHandler::fatal    ("Raster Pipeline Creation failure");
+    if (createCullingPipeline       () != vk::Result::eSuccess) ErrorHandler::fatal    ("Culling Pipeline Creation failure");
+    if (createFeedbackPipeline      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Feedback Pipeline Creation failure");
+    if (createLightingPipeline      () != vk::Result::eSuccess) ErrorHandler::fatal    ("Lighting Pipeline Creation failure");
+    if (createMipPipeline           () != vk::Result::eSuccess) ErrorHandler::fatal    ("Mip Pipeline Creation failure");
+    if (createOcclusionPipeline     () != vk::Result::eSuccess) ErrorHandler::fatal    ("Occlusion Pipeline Creation failure");
+    if (createShadowPipeline        () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shadow Pipeline Creation failure");
+    if (createShadingCache          () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Cache Creation failure");
     if (createShadingCommandBuffers () != vk::Result::eSuccess) ErrorHandler::fatal    ("Shading Command Pool/Buffer creation failure");
     if (createRasterCommandBuffers  () != vk::Result::eSuccess) ErrorHandler::fatal    ("Raster Command Pool/Buffer creation failure");
+    if (createInitialUploads        () != vk::Result::eSuccess) ErrorHandler::fatal    ("Initial Upload failure");
 
     createPhysicsState();
     arrangeObjects();
@@ -254,15 +382,35 @@ VulkanApp::VulkanApp (uint32_t width, uint32_t height, std::string title, uint32
 //
 VulkanApp::~VulkanApp ()
     { // VulkanApp :: ~VulkanApp
+
+    // nothing can be torn down while the device is still using it
+    core.logicalDevice.waitIdle();
+
+    // the cache file may still be being written from the staging
+    // buffer, or read into it
+    if (shadingCache.writer.joinable())
+        shadingCache.writer.join();
+    if (shadingCache.reader.valid())
+        shadingCache.reader.wait();
     
     // destroy graphics pipeline
     core.logicalDevice.destroyPipeline(pipelines.raster.pipeline);
+    core.logicalDevice.destroyPipeline(pipelines.culling.pipeline);
+    core.logicalDevice.destroyPipeline(pipelines.culling.clusterPipeline);
+    core.logicalDevice.destroyPipeline(pipelines.feedback.pipeline);
+    core.logicalDevice.destroyPipeline(pipelines.lighting.pipeline);
+    core.logicalDevice.destroyPipeline(pipelines.mips.pipeline);
+    core.logicalDevice.destroyPipeline(pipelines.occlusion.pipeline);
+    core.logicalDevice.destroyPipeline(pipelines.shadows.pipeline);
     
     // destroy semaphores
-    core.logicalDevice.destroySemaphore(semaphores.presentReady);
-    core.logicalDevice.destroySemaphore(semaphores.renderComplete);
-    core.logicalDevice.destroySemaphore(semaphores.shadingComplete);
-    core.logicalDevice.destroySemaphore(semaphores.rasterComplete);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        {
+        core.logicalDevice.destroySemaphore(semaphores.presentReady[i]);
+        core.logicalDevice.destroySemaphore(semaphores.renderComplete[i]);
+        }
+
+    timeline.tidy();
 
     // destroy vertex buffer
     core.logicalDevice.destroyBuffer(buffers.sceneVertex.buffer);
@@ -278,12 +426,59 @@ VulkanApp::~VulkanApp ()
     core.logicalDevice.destroyBuffer(buffers.quadIndex.buffer);
     core.logicalDevice.freeMemory(buffers.quadIndex.memory);
 
-    // destroy framebuffers
-    for (uint32_t i = 0; i < swapchain.nImages; ++i)
-        core.logicalDevice.destroyFramebuffer(swapchain.framebuffers[i]);
+    // destroy culling buffers
+    for (VulkanBuffers::VulkanBuffer* buffer : { &buffers.cullingClusters, &buffers.geometryIndirect, &buffers.rasterIndirect, &buffers.cullingCount, &buffers.visibility, &buffers.sampledBlocks, &buffers.shadingMask, &buffers.shadingCache })
+        {
+        core.logicalDevice.destroyBuffer(buffer->buffer);
+        core.logicalDevice.freeMemory(buffer->memory);
+        }
+
+    for (VulkanBuffers::VulkanBuffer& buffer : buffers.frameReadback)
+        {
+        core.logicalDevice.destroyBuffer(buffer.buffer);
+        core.logicalDevice.freeMemory(buffer.memory);
+        }
+
+    // destroy the buffers the host stages its writes to, freeing the
+    // staging memory unmaps it
+    for (VulkanBuffers::VulkanStagedBuffer* buffer : { &buffers.shadingUniform, &buffers.rasterUniform, &buffers.geometryObjects, &buffers.shadingObjects, &buffers.rasterObjects, &buffers.cullingUniform, &buffers.cullingObjects, &buffers.feedbackUniform, &buffers.refreshBlocks, &buffers.lightingTiles, &buffers.lights, &buffers.mipTiles })
+        {
+        for (VulkanBuffers::VulkanBuffer& staging : buffer->staging)
+            {
+            core.logicalDevice.destroyBuffer(staging.buffer);
+            core.logicalDevice.freeMemory(staging.memory);
+            }
+
+        core.logicalDevice.destroyBuffer(buffer->buffer);
+        core.logicalDevice.freeMemory(buffer->memory);
+        }
+
+    // destroy the atlas coverage stencil
+    core.logicalDevice.destroyImageView(shading.coverage.view);
+    core.logicalDevice.destroyImage(shading.coverage.image);
+    core.logicalDevice.freeMemory(shading.coverage.memory);
+
+    // destroy the shadow layers
+    for (uint32_t l = 0; l < ShadowState::eLayerCount; ++l)
+        {
+        core.logicalDevice.destroyFramebuffer(shadows.framebuffers[l]);
+        core.logicalDevice.destroyImageView(shadows.layerViews[l]);
+        }
+
+    core.logicalDevice.destroyImageView(shadows.view);
+    core.logicalDevice.destroyImage(shadows.image);
+    core.logicalDevice.freeMemory(shadows.memory);
+    core.logicalDevice.destroySampler(shadows.sampler);
+
+    // destroy framebuffers, depth buffer and swapchain views, and
+    // whatever swapchains were replaced along the way
+    destroyRetiredSwapChains(true);
+    destroySwapChainResources();
+    core.logicalDevice.destroySwapchainKHR(swapchain.swapchain);
     
     // destroy render pass
     core.logicalDevice.destroyRenderPass(pipelines.raster.renderPass);
+    core.logicalDevice.destroyRenderPass(pipelines.shadows.renderPass);
     
     // destroy descriptor pool
     core.logicalDevice.destroyDescriptorPool(pipelines.descriptorPool);
@@ -291,27 +486,25 @@ VulkanApp::~VulkanApp ()
     // destroy pipeline layout
     core.logicalDevice.destroyDescriptorSetLayout(pipelines.raster.descriptorLayout);
     core.logicalDevice.destroyPipelineLayout(pipelines.raster.layout);
-    
-    // destroy uniform buffer
-    core.logicalDevice.destroyBuffer(buffers.shadingUniform.buffer);
-    core.logicalDevice.destroyBuffer(buffers.rasterUniform.buffer);
-    core.logicalDevice.destroyBuffer(buffers.geometryUniform.buffer);
 
-    core.logicalDevice.freeMemory(buffers.shadingUniform.memory);
-    core.logicalDevice.freeMemory(buffers.rasterUniform.memory);
-    core.logicalDevice.freeMemory(buffers.geometryUniform.memory);
-    
-    // destroy depth buffer
-    core.logicalDevice.destroyImageView(depth.view);
-    core.logicalDevice.destroyImage(depth.image);
-    core.logicalDevice.freeMemory(depth.memory);
-    
-    // destroy swap chain
-    for (uint32_t i = 0; i < swapchain.nImages; ++i)
-        core.logicalDevice.destroyImageView(swapchain.views[i]);
-    core.logicalDevice.destroySwapchainKHR(swapchain.swapchain);
+    core.logicalDevice.destroyDescriptorSetLayout(pipelines.culling.descriptorLayout);
+    core.logicalDevice.destroyPipelineLayout(pipelines.culling.layout);
+
+    core.logicalDevice.destroyDescriptorSetLayout(pipelines.feedback.descriptorLayout);
+    core.logicalDevice.destroyPipelineLayout(pipelines.feedback.layout);
+
+    core.logicalDevice.destroyDescriptorSetLayout(pipelines.lighting.descriptorLayout);
+    core.logicalDevice.destroyPipelineLayout(pipelines.lighting.layout);
+
+    core.logicalDevice.destroyDescriptorSetLayout(pipelines.occlusion.descriptorLayout);
+    core.logicalDevice.destroyPipelineLayout(pipelines.occlusion.layout);
+    core.logicalDevice.destroySampler(occlusion.sampler);
+
+    core.logicalDevice.destroyDescriptorSetLayout(pipelines.shadows.descriptorLayout);
+    core.logicalDevice.destroyPipelineLayout(pipelines.shadows.layout);
     
-    // destroy command pool
+    // destroy command pools
+    command.recorder.tidy();
     core.logicalDevice.destroyCommandPool(command.pool, nullptr);
     
     VulkanDebug::DestroyDebugReportCallbackEXT((VkInstance)core.instance, callback, nullptr);
@@ -349,6 +542,7 @@ vk::Result VulkanApp::createWindow ()
     glfwSetCursorPosCallback(window, mouseMovementCallback);
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
     glfwSetScrollCallback(window, mouseScrollCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 
     if (window == nullptr)
         return vk::Result::eIncomplete;
@@ -397,14 +591,30 @@ vk::Result VulkanApp::createSceneMesh ()
 
 	} // for each mesh
 
+    // the triangles are reordered into clusters before batching, so
+    // every object's copy of the mesh shares the same clusters
+    ClusterCulling::build(vBuffers[0], iBuffers[0], clusters.list);
+
     for (uint32_t i = 0; i < nObjects; ++i)
 	{ // for each objectssss
 	uint32_t model = 0;
+
+	vk::DrawIndexedIndirectCommand draw = { };
+		draw.indexCount    = static_cast<uint32_t>(iBuffers[model].size());
+		draw.instanceCount = 1;
+		draw.firstIndex    = static_cast<uint32_t>(meshes.scene.indices.size());
+		draw.vertexOffset  = 0;
+		draw.firstInstance = i;
+	meshes.objects.push_back(draw);
+
 	MeshIO::assign(vBuffers[model], i);
 	MeshIO::merge(meshes.scene.vertices, meshes.scene.indices, vBuffers[model], iBuffers[model]);
 	} // for each object
 
     MeshIO::atlas (meshes.scene.vertices, nObjects, shading.BUFFER_SIZE);
+
+    // every object shares the one mesh, so one sphere bounds them all
+    culling.meshBounds = glm::vec4(MeshIO::centroid(vBuffers[0]), MeshIO::estimateBounds(vBuffers[0]));
     
     return vk::Result::eSuccess;
     
@@ -617,8 +827,18 @@ vk::Result VulkanApp::createDevice ()
     const std::vector<const char*> extensions =
         { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
         
+    vk::PhysicalDeviceFeatures supported = core.physicalDevice.getFeatures();
+
+    // multi draw indirect lets the culled draw list go out in a
+    // single call, without it we fall back to one call per object
     vk::PhysicalDeviceFeatures features = { };
         features.samplerAnisotropy = VK_TRUE;
+        features.multiDrawIndirect = supported.multiDrawIndirect;
+
+    // visibility feedback is written from the raster fragment shader
+        features.fragmentStoresAndAtomics = supported.fragmentStoresAndAtomics;
+
+    core.features = features;
 
     vk::DeviceCreateInfo deviceCreateInfo = { };
         deviceCreateInfo.queueCreateInfoCount    = static_cast<uint32_t>(queueCreationInfos.size());
@@ -656,7 +876,7 @@ vk::Result VulkanApp::createSwapChain ()
 
     // Choose a swap surface present format
     vk::SurfaceFormatKHR format      = VulkanHelpers::querySwapChainSurfaceFormat(swapchain.supported.formats);
-    vk::PresentModeKHR   presentMode = VulkanHelpers::querySwapChainPresentMode(swapchain.supported.presentModes);
+    vk::PresentModeKHR   presentMode = VulkanHelpers::querySwapChainPresentMode(swapchain.supported.presentModes, pacer.presentModes());
     vk::Extent2D         extent      = VulkanHelpers::querySwapChainExtents(swapchain.supported.capabilities, window);
 
     // Set an image count
@@ -695,7 +915,14 @@ vk::Result VulkanApp::createSwapChain ()
         createInfo.presentMode    = presentMode;
         createInfo.clipped        = VK_TRUE;
 
+        // when recreating, handing over the retired swapchain lets the
+        // presentation engine keep showing its images until ours are ready
+        createInfo.oldSwapchain   = swapchain.swapchain;
+
+    // the retired swapchain is left to destroyRetiredSwapChains
     result = core.logicalDevice.createSwapchainKHR(&createInfo, nullptr, &swapchain.swapchain);
+    if (result != vk::Result::eSuccess)
+        return result;
     
     core.logicalDevice.getSwapchainImagesKHR(swapchain.swapchain, &swapchain.nImages, nullptr);
     swapchain.images.resize(swapchain.nImages);
@@ -744,12 +971,27 @@ vk::Result VulkanApp::createDepthBuffer ()
     vk::FormatProperties depthProperties;
     core.physicalDevice.getFormatProperties (pipelines.raster.depthFormat, &depthProperties);
 
+    // occlusion culling reduces the depth buffer in a compute shader,
+    // so a tiling that can also be sampled is preferred
+    vk::FormatFeatureFlags sampledDepth = vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage;
+
+    occlusion.supported = true;
+
     vk::ImageCreateInfo createInfo = { };
-    if (depthProperties.linearTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
-        createInfo.tiling = vk::ImageTiling::eLinear;
-    else if (depthProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+    if ((depthProperties.optimalTilingFeatures & sampledDepth) == sampledDepth)
         createInfo.tiling = vk::ImageTiling::eOptimal;
-    else ErrorHandler::fatal("depth format unsupported");
+    else if ((depthProperties.linearTilingFeatures & sampledDepth) == sampledDepth)
+        createInfo.tiling = vk::ImageTiling::eLinear;
+    else
+        {
+        occlusion.supported = false;
+        if (depthProperties.linearTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+            createInfo.tiling = vk::ImageTiling::eLinear;
+        else if (depthProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+            createInfo.tiling = vk::ImageTiling::eOptimal;
+        else ErrorHandler::fatal("depth format unsupported");
+        }
+
         createInfo.imageType             = vk::ImageType::e2D;
         createInfo.format                = pipelines.raster.depthFormat;
         createInfo.extent.width          = swapchain.extent.width;
@@ -761,6 +1003,9 @@ vk::Result VulkanApp::createDepthBuffer ()
         createInfo.initialLayout         = vk::ImageLayout::eUndefined;
         createInfo.usage                 = vk::ImageUsageFlagBits::eDepthStencilAttachment;
         createInfo.queueFamilyIndexCount = 0;
+    if (occlusion.supported)
+        createInfo.usage |= vk::ImageUsageFlagBits::eSampled;
+
         createInfo.pQueueFamilyIndices   = nullptr;
         createInfo.sharingMode           = vk::SharingMode::eExclusive;
     
@@ -821,6 +1066,61 @@ vk::Result VulkanApp::createCommandPool ()
 	
 	} // VulkanApp :: createCommandPool
 
+//
+//  createCommandRecorder
+//
+//  sets up the worker threads and the per thread, per frame
+//  pools used to re-record object draws
+//
+vk::Result VulkanApp::createCommandRecorder ()
+	{ // VulkanApp :: createCommandRecorder
+
+	// one extra set of pools holds the cached recordings
+	return command.recorder.init(core.logicalDevice, queues.graphicsIndex, MAX_FRAMES_IN_FLIGHT + 1);
+
+	} // VulkanApp :: createCommandRecorder
+
+//
+//  createVirtualAtlas
+//
+//  sizes the pages of the atlas to the tiles the requested resolution
+//  would have split into, and lays out as many of them as the device
+//  and the budget allow, which becomes the size of the atlas
+//
+vk::Result VulkanApp::createVirtualAtlas ()
+    { // VulkanApp :: createVirtualAtlas
+    vk::Result result = vk::Result::eSuccess;
+
+    uint32_t cells = VirtualAtlas::CELLS;
+    uint32_t m     = std::max(1u, (uint32_t)sqrt(nObjects));
+
+    // a page is split into whole cells at every shading level
+    uint32_t pageSize = (shading.BUFFER_SIZE / m) / cells * cells;
+    if (pageSize < cells)
+        pageSize = cells;
+
+    // enough pages for every object to have one, as far as the
+    // position, normal, colour, result and history images at eight
+    // bytes a texel fit the budget and the largest image
+    uint64_t budget  = (uint64_t)paging.budget * 1000 * 1000;
+    uint64_t texel   = 5 * sizeof(uint16_t) * 4;
+    uint32_t largest = core.physicalDevice.getProperties().limits.maxImageDimension2D;
+
+    uint32_t perSide = (uint32_t)ceil(sqrt((float)nObjects));
+    while (perSide > 1 && (perSide * pageSize > largest || (uint64_t)perSide * perSide * pageSize * pageSize * texel > budget))
+        perSide--;
+
+    // every object has to fit at the coarsest level whatever the budget
+    while (perSide * perSide * cells * cells < nObjects)
+        perSide++;
+
+    shading.BUFFER_SIZE = perSide * pageSize;
+    paging.table.init(pageSize, perSide, nObjects);
+
+    return result;
+    } // VulkanApp :: createVirtualAtlas
+
+
 //
 //
 //
@@ -840,74 +1140,264 @@ vk::Result VulkanApp::createShadingResources ()
     if (result != vk::Result::eSuccess) 
         return result;
 
-    result = shading.result.init(core.logicalDevice, core.physicalDevice, pipelines.shading.format, shading.BUFFER_SIZE);
+    // the result carries a mip chain wherever downsample.comp can
+    // write it as storage, down to a page being TILE_MIN texels a side
+    vk::FormatProperties properties = core.physicalDevice.getFormatProperties(pipelines.shading.format);
+    if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage)
+        {
+        uint32_t texels = paging.table.pageSize;
+
+        while (mips.levels < MipState::MAX_LEVELS && (texels >> mips.levels) >= MipState::TILE_MIN)
+            mips.levels++;
+        }
+
+    result = shading.result.init(core.logicalDevice, core.physicalDevice, pipelines.shading.format, shading.BUFFER_SIZE, mips.levels);
+    if (result != vk::Result::eSuccess) 
+        return result;
+
+    result = shading.history.init(core.logicalDevice, core.physicalDevice, pipelines.shading.format, shading.BUFFER_SIZE);
     if (result != vk::Result::eSuccess) 
         return result;
 
+    // texels outside every uv chart are never lit, as the coverage
+    // mask rejects them, so the lighting buffer starts out cleared
+    // for filtering across chart edges to blend towards. The geometry
+    // buffers are kept between passes, so they start out cleared too
+    vk::ClearColorValue color = { WINDOW_CLEAR };
+
+    vk::ImageSubresourceRange range = { };
+        range.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        range.baseMipLevel   = 0;
+        range.levelCount     = 1;
+        range.baseArrayLayer = 0;
+        range.layerCount     = 1;
+
     vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
-	shading.position .transition(commandBuffer, vk::ImageLayout::eColorAttachmentOptimal);
-	shading.normal   .transition(commandBuffer, vk::ImageLayout::eColorAttachmentOptimal);
-	shading.color    .transition(commandBuffer, vk::ImageLayout::eColorAttachmentOptimal);
-	shading.result   .transition(commandBuffer, vk::ImageLayout::eColorAttachmentOptimal);
+	for (VulkanShadingResource* resource : { &shading.position, &shading.normal, &shading.color, &shading.result })
+		{
+		resource->transition(commandBuffer, vk::ImageLayout::eTransferDstOptimal);
+		commandBuffer.clearColorImage(resource->image, vk::ImageLayout::eTransferDstOptimal, &color, 1, &range);
+		resource->transition(commandBuffer, vk::ImageLayout::eColorAttachmentOptimal);
+		}
+
+	// no texel has been lit yet, which an id of 0 in the history says
+	vk::ClearColorValue empty = { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 0.0f } };
+
+	shading.history.transition(commandBuffer, vk::ImageLayout::eTransferDstOptimal);
+	commandBuffer.clearColorImage(shading.history.image, vk::ImageLayout::eTransferDstOptimal, &empty, 1, &range);
+	shading.history.transition(commandBuffer, vk::ImageLayout::eGeneral);
+
+	// the levels below the first are only ever written as storage and
+	// sampled, so they're cleared once and stay in the general layout
+	if (mips.levels > 1)
+		{ // mip chain
+		vk::ImageMemoryBarrier barrier = { };
+			barrier.srcAccessMask       = vk::AccessFlagBits { };
+			barrier.dstAccessMask       = vk::AccessFlagBits::eTransferWrite;
+			barrier.oldLayout           = vk::ImageLayout::eUndefined;
+			barrier.newLayout           = vk::ImageLayout::eTransferDstOptimal;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image               = shading.result.image;
+			barrier.subresourceRange    = vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 1, mips.levels - 1, 0, 1 };
+
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTopOfPipe,
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		commandBuffer.clearColorImage(shading.result.image, vk::ImageLayout::eTransferDstOptimal, &color, 1, &barrier.subresourceRange);
+
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+		barrier.oldLayout     = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout     = vk::ImageLayout::eGeneral;
+
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+			vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 1, &barrier);
+		} // mip chain
 	VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
 
+    // nothing has been drawn into the geometry buffers yet
+    geometryCache.valid  .assign(nObjects, 0);
+    geometryCache.level  .assign(nObjects, 0);
+    geometryCache.redraw .assign(nObjects, 1);
+    geometryCache.redrawCount = nObjects;
+
     return result;
     } // VulkanApp :: createShadingResources
 
 
 //
+//  createCoverageBuffer
 //
+//  creates the stencil attachment the geometry subpass marks every
+//  texel it draws in, and the lighting subpass tests against. It's
+//  kept alongside the geometry buffers while they're cached
 //
-vk::Result VulkanApp::createGeometryUniformBuffer ()
-    { // VulkanApp :: createGeometryUniformBuffer
+vk::Result VulkanApp::createCoverageBuffer ()
+    { // VulkanApp :: createCoverageBuffer
     vk::Result result = vk::Result::eSuccess;
 
-    // then once we have an acceptable default we can set up
-    // a buffer that we'll use to pass the data to the GPU
-    vk::DeviceSize size = sizeof(UniformBufferObjects::GeometryUBO);
-    
-    vk::BufferCreateInfo bufferCreateInfo = { };
-        bufferCreateInfo.usage                 = vk::BufferUsageFlagBits::eUniformBuffer;
-        bufferCreateInfo.size                  = size;
-        bufferCreateInfo.queueFamilyIndexCount = 0;
-        bufferCreateInfo.pQueueFamilyIndices   = nullptr;
-        bufferCreateInfo.sharingMode           = vk::SharingMode::eExclusive;
-        
-    result = core.logicalDevice.createBuffer(&bufferCreateInfo, nullptr, &buffers.geometryUniform.buffer);
+    // a stencil only format is the smallest, but isn't required to
+    // be supported, while at least one of the combined formats is
+    vk::Format candidates [] = {
+        vk::Format::eS8Uint,
+        vk::Format::eD16UnormS8Uint,
+        vk::Format::eD24UnormS8Uint,
+        vk::Format::eD32SfloatS8Uint };
+
+    bool found = false;
+    for (vk::Format format : candidates)
+        {
+        vk::FormatProperties properties;
+        core.physicalDevice.getFormatProperties(format, &properties);
+
+        if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+            {
+            pipelines.shading.coverageFormat = format;
+            found = true;
+            break;
+            }
+        }
+
+    if (!found)
+        return vk::Result::eErrorFormatNotSupported;
+
+    vk::ImageCreateInfo createInfo = { };
+        createInfo.imageType             = vk::ImageType::e2D;
+        createInfo.format                = pipelines.shading.coverageFormat;
+        createInfo.extent.width          = shading.BUFFER_SIZE;
+        createInfo.extent.height         = shading.BUFFER_SIZE;
+        createInfo.extent.depth          = 1;
+        createInfo.mipLevels             = 1;
+        createInfo.arrayLayers           = 1;
+        createInfo.samples               = vk::SampleCountFlagBits::e1;
+        createInfo.tiling                = vk::ImageTiling::eOptimal;
+        createInfo.initialLayout         = vk::ImageLayout::eUndefined;
+        createInfo.usage                 = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferDst;
+        createInfo.queueFamilyIndexCount = 0;
+        createInfo.pQueueFamilyIndices   = nullptr;
+        createInfo.sharingMode           = vk::SharingMode::eExclusive;
+
+    result = core.logicalDevice.createImage(&createInfo, nullptr, &shading.coverage.image);
+
     if (result != vk::Result::eSuccess)
         return result;
-    
-    // once we've created the buffer we can allocate some VRAM
-    // to store our uniform data
-    vk::MemoryRequirements bufferRequirements = { };
-    core.logicalDevice.getBufferMemoryRequirements(buffers.geometryUniform.buffer, &bufferRequirements);
+
+    vk::MemoryRequirements memoryRequirements = { };
+        core.logicalDevice.getImageMemoryRequirements(shading.coverage.image, &memoryRequirements);
 
     vk::MemoryAllocateInfo allocationInfo = { };
-        allocationInfo.allocationSize  = bufferRequirements.size;
-        allocationInfo.memoryTypeIndex = VulkanHelpers::findMemoryType(
-            core.physicalDevice,
-            bufferRequirements.memoryTypeBits,
-            vk::MemoryPropertyFlagBits::eHostVisible |
-            vk::MemoryPropertyFlagBits::eHostCoherent);
-        
-    result = core.logicalDevice.allocateMemory(&allocationInfo, nullptr, &buffers.geometryUniform.memory);
+        allocationInfo.allocationSize  = memoryRequirements.size;
+        allocationInfo.memoryTypeIndex = VulkanHelpers::findMemoryType(core.physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    result = core.logicalDevice.allocateMemory(&allocationInfo, nullptr, &shading.coverage.memory);
+
     if (result != vk::Result::eSuccess)
         return result;
-    
-    // finally we can map the data across to the GPU
-    void* data;
 
-    result = core.logicalDevice.mapMemory(buffers.geometryUniform.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data);
-    if (result != vk::Result::eSuccess) 
+    core.logicalDevice.bindImageMemory(shading.coverage.image, shading.coverage.memory, 0);
+
+    // a framebuffer attachment's view has to include every aspect
+    // of a combined format, even though only the stencil is used
+    vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eStencil;
+    if (pipelines.shading.coverageFormat != vk::Format::eS8Uint)
+        aspects |= vk::ImageAspectFlagBits::eDepth;
+
+    vk::ImageViewCreateInfo viewCreateInfo = { };
+        viewCreateInfo.image                           = shading.coverage.image;
+        viewCreateInfo.format                          = pipelines.shading.coverageFormat;
+        viewCreateInfo.components.r                    = vk::ComponentSwizzle::eR;
+        viewCreateInfo.components.g                    = vk::ComponentSwizzle::eG;
+        viewCreateInfo.components.b                    = vk::ComponentSwizzle::eB;
+        viewCreateInfo.components.a                    = vk::ComponentSwizzle::eA;
+        viewCreateInfo.subresourceRange.aspectMask     = aspects;
+        viewCreateInfo.subresourceRange.baseMipLevel   = 0;
+        viewCreateInfo.subresourceRange.levelCount     = 1;
+        viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        viewCreateInfo.subresourceRange.layerCount     = 1;
+        viewCreateInfo.viewType                        = vk::ImageViewType::e2D;
+
+    result = core.logicalDevice.createImageView(&viewCreateInfo, nullptr, &shading.coverage.view);
+
+    if (result != vk::Result::eSuccess)
         return result;
 
-    memcpy(data, &ubo.geometry, (size_t)size);
+    // the cached render pass loads the coverage, so it starts out
+    // cleared and in the layout that pass expects
+    vk::ImageMemoryBarrier barrier = { };
+        barrier.oldLayout           = vk::ImageLayout::eUndefined;
+        barrier.newLayout           = vk::ImageLayout::eTransferDstOptimal;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image               = shading.coverage.image;
+        barrier.subresourceRange    = viewCreateInfo.subresourceRange;
+        barrier.srcAccessMask       = vk::AccessFlagBits { };
+        barrier.dstAccessMask       = vk::AccessFlagBits::eTransferWrite;
+
+    vk::ClearDepthStencilValue clear = { 1.0f, 0 };
+
+    vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 1, &barrier);
+    commandBuffer.clearDepthStencilImage(shading.coverage.image, vk::ImageLayout::eTransferDstOptimal, &clear, 1, &barrier.subresourceRange);
+
+        barrier.oldLayout     = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout     = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eEarlyFragmentTests, vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 1, &barrier);
+    VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
+
+    return result;
+    } // VulkanApp :: createCoverageBuffer
+
+
+//
+//  createObjectBuffers
+//
+//  the transforms, materials and atlas placements the geometry,
+//  shading and raster passes index by object id, in storage buffers
+//  sized by how many objects there are
+//
+vk::Result VulkanApp::createObjectBuffers ()
+    { // VulkanApp :: createObjectBuffers
+    vk::Result result = vk::Result::eSuccess;
+
+    // every object starts out shading its whole tile
+    lod.target.assign(nObjects, 0);
+    lod.shaded.assign(nObjects, 0);
+    lod.pixels.assign(nObjects, 0.0f);
+
+    objects.model.assign(nObjects, glm::mat4(1.0f));
+    objects.atlas.assign(nObjects, glm::vec4(1.0f, 1.0f, 0.0f, 0.0f));
+    objects.shading.resize(nObjects);
+    objects.raster.resize(nObjects);
+
+    std::uniform_real_distribution<float> dist (0.0, 1.0);
+    rng.seed(time(0));
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        objects.shading[i].model    = objects.model[i];
+        objects.shading[i].material = { dist(rng), dist(rng), dist(rng), dist(rng) };
+        objects.raster[i].model     = objects.model[i];
+        objects.raster[i].atlas     = objects.atlas[i];
+        objects.raster[i].material  = objects.shading[i].material;
+        } // for each object
 
-    core.logicalDevice.unmapMemory(buffers.geometryUniform.memory);
-    core.logicalDevice.bindBufferMemory(buffers.geometryUniform.buffer, buffers.geometryUniform.memory, 0);
+    createStagedBuffer(sizeof(glm::vec4) * nObjects,           vk::BufferUsageFlagBits::eStorageBuffer, buffers.geometryObjects);
+    createStagedBuffer(sizeof(ObjectData::Shading) * nObjects, vk::BufferUsageFlagBits::eStorageBuffer, buffers.shadingObjects);
+    createStagedBuffer(sizeof(ObjectData::Raster) * nObjects,  vk::BufferUsageFlagBits::eStorageBuffer, buffers.rasterObjects);
+
+    memcpy(stageBuffer(buffers.geometryObjects, 0, sizeof(glm::vec4) * nObjects),           objects.atlas.data(),   sizeof(glm::vec4) * nObjects);
+    memcpy(stageBuffer(buffers.shadingObjects,  0, sizeof(ObjectData::Shading) * nObjects), objects.shading.data(), sizeof(ObjectData::Shading) * nObjects);
+    memcpy(stageBuffer(buffers.rasterObjects,   0, sizeof(ObjectData::Raster) * nObjects),  objects.raster.data(),  sizeof(ObjectData::Raster) * nObjects);
 
     return result;
-    } // VulkanApp :: createGeometryUniformBuffer
+    } // VulkanApp :: createObjectBuffers
 
 
 //
@@ -921,58 +1411,34 @@ vk::Result VulkanApp::createShadingUniformBuffer ()
 
     ubo.shading.lightPosition = glm::vec4(lightPosition.x, lightPosition.y, lightPosition.z, 1.0);
     ubo.shading.eyePosition   = glm::vec4(eyePosition.x, eyePosition.y, eyePosition.z, 1.0);
-
-    std::uniform_real_distribution<float> dist (0.0, 1.0);
-    rng.seed(time(0));
-    for (uint32_t i = 0; i < nObjects; ++i)
-        ubo.shading.materials[i] = { dist(rng), dist(rng), dist(rng), dist(rng) };
     
     // then once we have an acceptable default we can set up
     // a buffer that we'll use to pass the data to the GPU
     vk::DeviceSize size = sizeof(UniformBufferObjects::ShadingUBO);
-    
-    vk::BufferCreateInfo bufferCreateInfo = { };
-        bufferCreateInfo.usage                 = vk::BufferUsageFlagBits::eUniformBuffer;
-        bufferCreateInfo.size                  = size;
-        bufferCreateInfo.queueFamilyIndexCount = 0;
-        bufferCreateInfo.pQueueFamilyIndices   = nullptr;
-        bufferCreateInfo.sharingMode           = vk::SharingMode::eExclusive;
-        
-    result = core.logicalDevice.createBuffer(&bufferCreateInfo, nullptr, &buffers.shadingUniform.buffer);
-    if (result != vk::Result::eSuccess)
-        return result;
-    
-    // once we've created the buffer we can allocate some VRAM
-    // to store our uniform data
-    vk::MemoryRequirements bufferRequirements = { };
-    core.logicalDevice.getBufferMemoryRequirements(buffers.shadingUniform.buffer, &bufferRequirements);
 
-    vk::MemoryAllocateInfo allocationInfo = { };
-        allocationInfo.allocationSize  = bufferRequirements.size;
-        allocationInfo.memoryTypeIndex = VulkanHelpers::findMemoryType(
-            core.physicalDevice,
-            bufferRequirements.memoryTypeBits,
-            vk::MemoryPropertyFlagBits::eHostVisible |
-            vk::MemoryPropertyFlagBits::eHostCoherent);
-        
-    result = core.logicalDevice.allocateMemory(&allocationInfo, nullptr, &buffers.shadingUniform.memory);
-    if (result != vk::Result::eSuccess)
-        return result;
-    
-    // finally we can map the data across to the GPU
-    void* data;
+    createStagedBuffer(size, vk::BufferUsageFlagBits::eUniformBuffer, buffers.shadingUniform);
+    memcpy(stageBuffer(buffers.shadingUniform, 0, size), &ubo.shading, (size_t)size);
 
-    result = core.logicalDevice.mapMemory(buffers.shadingUniform.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data);
-    if (result != vk::Result::eSuccess) 
-        return result;
+    return result;
+    } // VulkanApp :: createShadingUniformBuffer
+
+
+//
+//  createLightBuffer
+//
+//  sized for the most point lights there can be, so changing how
+//  many there are only ever rewrites it
+//
+vk::Result VulkanApp::createLightBuffer ()
+    { // VulkanApp :: createLightBuffer
+    vk::Result result = vk::Result::eSuccess;
 
-    memcpy(data, &ubo.shading, (size_t)size);
+    createStagedBuffer(sizeof(LightState::Light) * LightState::MAX_LIGHTS, vk::BufferUsageFlagBits::eStorageBuffer, buffers.lights);
 
-    core.logicalDevice.unmapMemory(buffers.shadingUniform.memory);
-    core.logicalDevice.bindBufferMemory(buffers.shadingUniform.buffer, buffers.shadingUniform.memory, 0);
+    generateLights();
 
     return result;
-    } // VulkanApp :: createShadingUniformBuffer
+    } // VulkanApp :: createLightBuffer
 
 
 //
@@ -993,46 +1459,9 @@ vk::Result VulkanApp::createRasterUniformBuffer ()
     // then once we have an acceptable default we can set up
     // a buffer that we'll use to pass the data to the GPU
     vk::DeviceSize size = sizeof(UniformBufferObjects::RasterUBO);
-    
-    vk::BufferCreateInfo bufferCreateInfo = { };
-        bufferCreateInfo.usage                 = vk::BufferUsageFlagBits::eUniformBuffer;
-        bufferCreateInfo.size                  = size;
-        bufferCreateInfo.queueFamilyIndexCount = 0;
-        bufferCreateInfo.pQueueFamilyIndices   = nullptr;
-        bufferCreateInfo.sharingMode           = vk::SharingMode::eExclusive;
-        
-    result = core.logicalDevice.createBuffer(&bufferCreateInfo, nullptr, &buffers.rasterUniform.buffer);
-    if (result != vk::Result::eSuccess)
-        return result;
-    
-    // once we've created the buffer we can allocate some VRAM
-    // to store our uniform data
-    vk::MemoryRequirements bufferRequirements = { };
-    core.logicalDevice.getBufferMemoryRequirements(buffers.rasterUniform.buffer, &bufferRequirements);
-
-    vk::MemoryAllocateInfo allocationInfo = { };
-        allocationInfo.allocationSize  = bufferRequirements.size;
-        allocationInfo.memoryTypeIndex = VulkanHelpers::findMemoryType(
-            core.physicalDevice,
-            bufferRequirements.memoryTypeBits,
-            vk::MemoryPropertyFlagBits::eHostVisible |
-            vk::MemoryPropertyFlagBits::eHostCoherent);
-        
-    result = core.logicalDevice.allocateMemory(&allocationInfo, nullptr, &buffers.rasterUniform.memory);
-    if (result != vk::Result::eSuccess)
-        return result;
-    
-    // finally we can map the data across to the GPU
-    void* data;
-
-    result = core.logicalDevice.mapMemory(buffers.rasterUniform.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data);
-    if (result != vk::Result::eSuccess) 
-        return result;
 
-    memcpy(data, &ubo.raster, (size_t)size);
-
-    core.logicalDevice.unmapMemory(buffers.rasterUniform.memory);
-    core.logicalDevice.bindBufferMemory(buffers.rasterUniform.buffer, buffers.rasterUniform.memory, 0);
+    createStagedBuffer(size, vk::BufferUsageFlagBits::eUniformBuffer, buffers.rasterUniform);
+    memcpy(stageBuffer(buffers.rasterUniform, 0, size), &ubo.raster, (size_t)size);
 
     return result;
     } // VulkanApp :: createRasterUniformBuffer
@@ -1044,20 +1473,26 @@ vk::Result VulkanApp::createDescriptorPool ()
     { // VulkanApp :: createDescriptorPool
     vk::Result result = vk::Result::eSuccess;
     
-    vk::DescriptorPoolSize sizes [3];
+    vk::DescriptorPoolSize sizes [5];
         sizes[0].type             = vk::DescriptorType::eUniformBuffer;
-        sizes[0].descriptorCount  = 3;
+        sizes[0].descriptorCount  = 6;
         
         sizes[1].type             = vk::DescriptorType::eInputAttachment;
         sizes[1].descriptorCount  = 3;
 
 	sizes[2].type             = vk::DescriptorType::eCombinedImageSampler;
-	sizes[2].descriptorCount  = 1;
+	sizes[2].descriptorCount  = 5;
+
+        sizes[3].type             = vk::DescriptorType::eStorageBuffer;
+        sizes[3].descriptorCount  = 27;
+
+        sizes[4].type             = vk::DescriptorType::eStorageImage;
+        sizes[4].descriptorCount  = 20;
         
     vk::DescriptorPoolCreateInfo poolCreateInfo = { };
-        poolCreateInfo.poolSizeCount = 3;
+        poolCreateInfo.poolSizeCount = 5;
         poolCreateInfo.pPoolSizes    = sizes;
-        poolCreateInfo.maxSets       = 3;
+        poolCreateInfo.maxSets       = 13;
         
     result = core.logicalDevice.createDescriptorPool (
         &poolCreateInfo,
@@ -1080,12 +1515,12 @@ vk::Result VulkanApp::createGeometryDescriptorSet ()
     { // VulkanApp :: createGeometryDescriptorSet
     vk::Result result = vk::Result::eSuccess;
     
-    // The geometry pipeline will have only a uniform
-    // buffer containing model transform data
+    // The geometry pipeline will have only a storage
+    // buffer placing each object in the atlas
     vk::DescriptorSetLayoutBinding layoutBindings [1];
         layoutBindings[0].binding             = 0;
         layoutBindings[0].descriptorCount     = 1;
-        layoutBindings[0].descriptorType      = vk::DescriptorType::eUniformBuffer;
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eStorageBuffer;
         layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eVertex;
         layoutBindings[0].pImmutableSamplers  = nullptr;
     
@@ -1120,15 +1555,15 @@ vk::Result VulkanApp::createGeometryDescriptorSet ()
         
     // following the allocation we can create the descriptor set
     vk::DescriptorBufferInfo bufferInfo = { };
-        bufferInfo.buffer = buffers.geometryUniform.buffer;
+        bufferInfo.buffer = buffers.geometryObjects.buffer;
         bufferInfo.offset = 0;
-        bufferInfo.range  = sizeof(UniformBufferObjects::GeometryUBO);
+        bufferInfo.range  = VK_WHOLE_SIZE;
         
     vk::WriteDescriptorSet descriptorWrite = { };
         descriptorWrite.dstSet           = pipelines.shading.geometryDescriptorSet;
         descriptorWrite.dstBinding       = 0;
         descriptorWrite.dstArrayElement  = 0;
-        descriptorWrite.descriptorType   = vk::DescriptorType::eUniformBuffer;
+        descriptorWrite.descriptorType   = vk::DescriptorType::eStorageBuffer;
         descriptorWrite.descriptorCount  = 1;
         descriptorWrite.pBufferInfo      = &bufferInfo;
         
@@ -1145,8 +1580,10 @@ vk::Result VulkanApp::createShadingDescriptorSet ()
     vk::Result result = vk::Result::eSuccess;
     
     // The shading pipeline will need 3 samplers and a uniform
-    // buffer to compute the shading results
-    vk::DescriptorSetLayoutBinding layoutBindings [4];
+    // buffer to compute the shading results, plus the mask of
+    // blocks it's allowed to shade, the point lights, the
+    // objects' transforms and materials and the shadow layers
+    vk::DescriptorSetLayoutBinding layoutBindings [8];
     
         // Uniform Buffer
         layoutBindings[0].binding             = 0;
@@ -1176,8 +1613,36 @@ vk::Result VulkanApp::createShadingDescriptorSet ()
         layoutBindings[3].stageFlags          = vk::ShaderStageFlagBits::eFragment;
         layoutBindings[3].pImmutableSamplers  = nullptr;
 
+        // Shading Mask
+        layoutBindings[4].binding             = 4;
+        layoutBindings[4].descriptorCount     = 1;
+        layoutBindings[4].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[4].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[4].pImmutableSamplers  = nullptr;
+
+        // Point Lights
+        layoutBindings[5].binding             = 5;
+        layoutBindings[5].descriptorCount     = 1;
+        layoutBindings[5].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[5].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[5].pImmutableSamplers  = nullptr;
+
+        // Objects
+        layoutBindings[6].binding             = 6;
+        layoutBindings[6].descriptorCount     = 1;
+        layoutBindings[6].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[6].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[6].pImmutableSamplers  = nullptr;
+
+        // Shadow Layers
+        layoutBindings[7].binding             = 7;
+        layoutBindings[7].descriptorCount     = 1;
+        layoutBindings[7].descriptorType      = vk::DescriptorType::eCombinedImageSampler;
+        layoutBindings[7].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[7].pImmutableSamplers  = nullptr;
+
     vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
-        layoutCreateInfo.bindingCount  = 4;
+        layoutCreateInfo.bindingCount  = 8;
         layoutCreateInfo.pBindings     = layoutBindings;
         
     result = core.logicalDevice.createDescriptorSetLayout(
@@ -1227,8 +1692,28 @@ vk::Result VulkanApp::createShadingDescriptorSet ()
         imageInfo[2].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
         imageInfo[2].imageView   = shading.color.view;
         imageInfo[2].sampler     = shading.color.sampler;
+
+    vk::DescriptorBufferInfo maskInfo = { };
+        maskInfo.buffer = buffers.shadingMask.buffer;
+        maskInfo.offset = 0;
+        maskInfo.range  = VK_WHOLE_SIZE;
+
+    vk::DescriptorBufferInfo lightInfo = { };
+        lightInfo.buffer = buffers.lights.buffer;
+        lightInfo.offset = 0;
+        lightInfo.range  = VK_WHOLE_SIZE;
+
+    vk::DescriptorBufferInfo objectInfo = { };
+        objectInfo.buffer = buffers.shadingObjects.buffer;
+        objectInfo.offset = 0;
+        objectInfo.range  = VK_WHOLE_SIZE;
+
+    vk::DescriptorImageInfo shadowInfo = { };
+        shadowInfo.imageLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+        shadowInfo.imageView   = shadows.view;
+        shadowInfo.sampler     = shadows.sampler;
         
-    vk::WriteDescriptorSet descriptorWrites [4];
+    vk::WriteDescriptorSet descriptorWrites [8];
     
         // Uniform Buffer
         descriptorWrites[0].dstSet           = pipelines.shading.shadingDescriptorSet;
@@ -1261,8 +1746,40 @@ vk::Result VulkanApp::createShadingDescriptorSet ()
         descriptorWrites[3].descriptorType   = vk::DescriptorType::eInputAttachment;
         descriptorWrites[3].descriptorCount  = 1;
         descriptorWrites[3].pImageInfo       = &imageInfo[2];
-    
-    core.logicalDevice.updateDescriptorSets (4, descriptorWrites, 0, nullptr);
+
+        // Shading Mask
+        descriptorWrites[4].dstSet           = pipelines.shading.shadingDescriptorSet;
+        descriptorWrites[4].dstBinding       = 4;
+        descriptorWrites[4].dstArrayElement  = 0;
+        descriptorWrites[4].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[4].descriptorCount  = 1;
+        descriptorWrites[4].pBufferInfo      = &maskInfo;
+
+        // Point Lights
+        descriptorWrites[5].dstSet           = pipelines.shading.shadingDescriptorSet;
+        descriptorWrites[5].dstBinding       = 5;
+        descriptorWrites[5].dstArrayElement  = 0;
+        descriptorWrites[5].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[5].descriptorCount  = 1;
+        descriptorWrites[5].pBufferInfo      = &lightInfo;
+
+        // Objects
+        descriptorWrites[6].dstSet           = pipelines.shading.shadingDescriptorSet;
+        descriptorWrites[6].dstBinding       = 6;
+        descriptorWrites[6].dstArrayElement  = 0;
+        descriptorWrites[6].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[6].descriptorCount  = 1;
+        descriptorWrites[6].pBufferInfo      = &objectInfo;
+
+        // Shadow Layers
+        descriptorWrites[7].dstSet           = pipelines.shading.shadingDescriptorSet;
+        descriptorWrites[7].dstBinding       = 7;
+        descriptorWrites[7].dstArrayElement  = 0;
+        descriptorWrites[7].descriptorType   = vk::DescriptorType::eCombinedImageSampler;
+        descriptorWrites[7].descriptorCount  = 1;
+        descriptorWrites[7].pImageInfo       = &shadowInfo;
+    
+    core.logicalDevice.updateDescriptorSets (8, descriptorWrites, 0, nullptr);
     
     return result;
     } // VulkanApp :: createShadingDescriptorSet
@@ -1275,14 +1792,18 @@ vk::Result VulkanApp::createRasterDescriptorSet ()
     vk::Result result = vk::Result::eSuccess;
     
     // The raster pipeline will need 1 sampler and a uniform
-    // buffer to compute the screen-space positions
-    vk::DescriptorSetLayoutBinding layoutBindings [2];
+    // buffer to compute the screen-space positions and light the
+    // view dependent layer with, plus the storage buffers it
+    // reports visibility and sampling through and the one holding
+    // each object's transform, placement and material. The shadow
+    // layers shadow whatever the pass lights per pixel
+    vk::DescriptorSetLayoutBinding layoutBindings [6];
     
         // Uniform Buffer
         layoutBindings[0].binding             = 0;
         layoutBindings[0].descriptorCount     = 1;
         layoutBindings[0].descriptorType      = vk::DescriptorType::eUniformBuffer;
-        layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eVertex;
+        layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
         layoutBindings[0].pImmutableSamplers  = nullptr;
 
         // G-Buffers
@@ -1292,8 +1813,36 @@ vk::Result VulkanApp::createRasterDescriptorSet ()
         layoutBindings[1].stageFlags          = vk::ShaderStageFlagBits::eFragment;
         layoutBindings[1].pImmutableSamplers  = nullptr;
 
+        // Visibility Feedback
+        layoutBindings[2].binding             = 2;
+        layoutBindings[2].descriptorCount     = 1;
+        layoutBindings[2].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[2].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[2].pImmutableSamplers  = nullptr;
+
+        // Sampled Blocks
+        layoutBindings[3].binding             = 3;
+        layoutBindings[3].descriptorCount     = 1;
+        layoutBindings[3].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[3].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[3].pImmutableSamplers  = nullptr;
+
+        // Objects
+        layoutBindings[4].binding             = 4;
+        layoutBindings[4].descriptorCount     = 1;
+        layoutBindings[4].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[4].stageFlags          = vk::ShaderStageFlagBits::eVertex;
+        layoutBindings[4].pImmutableSamplers  = nullptr;
+
+        // Shadow Layers
+        layoutBindings[5].binding             = 5;
+        layoutBindings[5].descriptorCount     = 1;
+        layoutBindings[5].descriptorType      = vk::DescriptorType::eCombinedImageSampler;
+        layoutBindings[5].stageFlags          = vk::ShaderStageFlagBits::eFragment;
+        layoutBindings[5].pImmutableSamplers  = nullptr;
+
     vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
-        layoutCreateInfo.bindingCount  = 2;
+        layoutCreateInfo.bindingCount  = 6;
         layoutCreateInfo.pBindings     = layoutBindings;
         
     result = core.logicalDevice.createDescriptorSetLayout(
@@ -1331,11 +1880,30 @@ vk::Result VulkanApp::createRasterDescriptorSet ()
         
         // Position Buffer
         imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imageInfo.imageView   = shading.result.view;
+        imageInfo.imageView   = shading.result.sampledView;
         imageInfo.sampler     = shading.result.sampler;
 
+    vk::DescriptorBufferInfo visibilityInfo = { };
+        visibilityInfo.buffer = buffers.visibility.buffer;
+        visibilityInfo.offset = 0;
+        visibilityInfo.range  = VK_WHOLE_SIZE;
+
+    vk::DescriptorBufferInfo sampledInfo = { };
+        sampledInfo.buffer = buffers.sampledBlocks.buffer;
+        sampledInfo.offset = 0;
+        sampledInfo.range  = VK_WHOLE_SIZE;
+
+    vk::DescriptorBufferInfo objectInfo = { };
+        objectInfo.buffer = buffers.rasterObjects.buffer;
+        objectInfo.offset = 0;
+        objectInfo.range  = VK_WHOLE_SIZE;
+
+    vk::DescriptorImageInfo shadowInfo = { };
+        shadowInfo.imageLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+        shadowInfo.imageView   = shadows.view;
+        shadowInfo.sampler     = shadows.sampler;
         
-    vk::WriteDescriptorSet descriptorWrites [2];
+    vk::WriteDescriptorSet descriptorWrites [6];
     
         // Uniform Buffer
         descriptorWrites[0].dstSet           = pipelines.raster.descriptorSet;
@@ -1353,7 +1921,39 @@ vk::Result VulkanApp::createRasterDescriptorSet ()
         descriptorWrites[1].descriptorCount  = 1;
         descriptorWrites[1].pImageInfo       = &imageInfo;
 
-    core.logicalDevice.updateDescriptorSets (2, descriptorWrites, 0, nullptr);
+        // Visibility Feedback
+        descriptorWrites[2].dstSet           = pipelines.raster.descriptorSet;
+        descriptorWrites[2].dstBinding       = 2;
+        descriptorWrites[2].dstArrayElement  = 0;
+        descriptorWrites[2].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[2].descriptorCount  = 1;
+        descriptorWrites[2].pBufferInfo      = &visibilityInfo;
+
+        // Sampled Blocks
+        descriptorWrites[3].dstSet           = pipelines.raster.descriptorSet;
+        descriptorWrites[3].dstBinding       = 3;
+        descriptorWrites[3].dstArrayElement  = 0;
+        descriptorWrites[3].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[3].descriptorCount  = 1;
+        descriptorWrites[3].pBufferInfo      = &sampledInfo;
+
+        // Objects
+        descriptorWrites[4].dstSet           = pipelines.raster.descriptorSet;
+        descriptorWrites[4].dstBinding       = 4;
+        descriptorWrites[4].dstArrayElement  = 0;
+        descriptorWrites[4].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[4].descriptorCount  = 1;
+        descriptorWrites[4].pBufferInfo      = &objectInfo;
+
+        // Shadow Layers
+        descriptorWrites[5].dstSet           = pipelines.raster.descriptorSet;
+        descriptorWrites[5].dstBinding       = 5;
+        descriptorWrites[5].dstArrayElement  = 0;
+        descriptorWrites[5].descriptorType   = vk::DescriptorType::eCombinedImageSampler;
+        descriptorWrites[5].descriptorCount  = 1;
+        descriptorWrites[5].pImageInfo       = &shadowInfo;
+
+    core.logicalDevice.updateDescriptorSets (6, descriptorWrites, 0, nullptr);
     
     return result;
     } // VulkanApp :: createRasterDescriptorSet
@@ -1369,19 +1969,20 @@ vk::Result VulkanApp::createSemaphores ()
     vk::SemaphoreCreateInfo semaphoreCreateInfo = { };
 		semaphoreCreateInfo.flags = vk::SemaphoreCreateFlagBits{};
 
-    result = core.logicalDevice.createSemaphore (&semaphoreCreateInfo, nullptr, &semaphores.presentReady);
-    if (result != vk::Result::eSuccess)
-        return result;
+    // the swapchain needs a binary pair for each frame that can be in flight
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        { // for each frame in flight
+        result = core.logicalDevice.createSemaphore (&semaphoreCreateInfo, nullptr, &semaphores.presentReady[i]);
+        if (result != vk::Result::eSuccess)
+            return result;
 
-    result = core.logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &semaphores.renderComplete);
-    if (result != vk::Result::eSuccess)
-	return result;
+        result = core.logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &semaphores.renderComplete[i]);
+        if (result != vk::Result::eSuccess)
+	    return result;
+        } // for each frame in flight
 
-    result = core.logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &semaphores.shadingComplete);
-    if (result != vk::Result::eSuccess)
- 	return result;
-        
-    result = core.logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &semaphores.rasterComplete);
+    // while each pass of the frame signals its own timeline
+    result = timeline.init(core.logicalDevice);
     if (result != vk::Result::eSuccess)
  	return result;
 
@@ -1400,7 +2001,7 @@ vk::Result VulkanApp::createShadingRenderPass ()
     // each attachment used by the render pass will require a
     // description regardless of if it's used for reading, writing
     // or both
-    vk::AttachmentDescription attachmentDescriptions[4];
+    vk::AttachmentDescription attachmentDescriptions[5];
         
         // position buffer attachment
         attachmentDescriptions[0].format         = pipelines.shading.format;
@@ -1432,15 +2033,27 @@ vk::Result VulkanApp::createShadingRenderPass ()
         attachmentDescriptions[2].initialLayout  = vk::ImageLayout::eUndefined;
         attachmentDescriptions[2].finalLayout    = vk::ImageLayout::eColorAttachmentOptimal;
         
-        // lighting buffer attachment
+        // lighting buffer attachment, which is loaded rather than
+        // cleared so tiles skipped by this pass keep their last shading
         attachmentDescriptions[3].format         = pipelines.shading.format;
         attachmentDescriptions[3].samples        = vk::SampleCountFlagBits::e1;
-        attachmentDescriptions[3].loadOp         = vk::AttachmentLoadOp::eClear;
+        attachmentDescriptions[3].loadOp         = vk::AttachmentLoadOp::eLoad;
         attachmentDescriptions[3].storeOp        = vk::AttachmentStoreOp::eStore;
         attachmentDescriptions[3].stencilLoadOp  = vk::AttachmentLoadOp::eDontCare;
         attachmentDescriptions[3].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-        attachmentDescriptions[3].initialLayout  = vk::ImageLayout::eUndefined;
+        attachmentDescriptions[3].initialLayout  = vk::ImageLayout::eColorAttachmentOptimal;
         attachmentDescriptions[3].finalLayout    = vk::ImageLayout::eColorAttachmentOptimal;
+
+        // coverage attachment, cleared so that only texels drawn by
+        // this pass's geometry subpass are lit
+        attachmentDescriptions[4].format         = pipelines.shading.coverageFormat;
+        attachmentDescriptions[4].samples        = vk::SampleCountFlagBits::e1;
+        attachmentDescriptions[4].loadOp         = vk::AttachmentLoadOp::eDontCare;
+        attachmentDescriptions[4].storeOp        = vk::AttachmentStoreOp::eDontCare;
+        attachmentDescriptions[4].stencilLoadOp  = vk::AttachmentLoadOp::eClear;
+        attachmentDescriptions[4].stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        attachmentDescriptions[4].initialLayout  = vk::ImageLayout::eUndefined;
+        attachmentDescriptions[4].finalLayout    = vk::ImageLayout::eDepthStencilAttachmentOptimal;
     
     // our shading pipeline will have 2 render passes. One to populate the
     // geometry buffers with information about the mesh and one to run the
@@ -1453,10 +2066,12 @@ vk::Result VulkanApp::createShadingRenderPass ()
         geometryBufferAttachments[1] = { 1, vk::ImageLayout::eColorAttachmentOptimal };
         geometryBufferAttachments[2] = { 2, vk::ImageLayout::eColorAttachmentOptimal };
 
+    vk::AttachmentReference coverageAttachment = { 4, vk::ImageLayout::eDepthStencilAttachmentOptimal };
+
         subpasses[0].pipelineBindPoint        = vk::PipelineBindPoint::eGraphics;
         subpasses[0].colorAttachmentCount     = 3;
         subpasses[0].pColorAttachments        = geometryBufferAttachments;
-        subpasses[0].pDepthStencilAttachment  = nullptr;
+        subpasses[0].pDepthStencilAttachment  = &coverageAttachment;
     
     // Subpass Two: Compute Shading Results
     vk::AttachmentReference shadingBufferAttachment = { };
@@ -1471,7 +2086,7 @@ vk::Result VulkanApp::createShadingRenderPass ()
         subpasses[1].pipelineBindPoint        = vk::PipelineBindPoint::eGraphics;
         subpasses[1].colorAttachmentCount     = 1;
         subpasses[1].pColorAttachments        = &shadingBufferAttachment;
-        subpasses[1].pDepthStencilAttachment  = nullptr;
+        subpasses[1].pDepthStencilAttachment  = &coverageAttachment;
         subpasses[1].inputAttachmentCount     = 3;
         subpasses[1].pInputAttachments        = inputBufferAttachments;
         
@@ -1493,10 +2108,10 @@ vk::Result VulkanApp::createShadingRenderPass ()
         // buffer attachments shader readable for the lighting pass
         dependencies[1].srcSubpass       = 0;
         dependencies[1].dstSubpass       = 1;
-        dependencies[1].srcStageMask     = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependencies[1].dstStageMask     = vk::PipelineStageFlagBits::eFragmentShader;
-        dependencies[1].srcAccessMask    = vk::AccessFlagBits::eShaderRead;
-        dependencies[1].dstAccessMask    = vk::AccessFlagBits::eColorAttachmentWrite;
+        dependencies[1].srcStageMask     = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependencies[1].dstStageMask     = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        dependencies[1].srcAccessMask    = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependencies[1].dstAccessMask    = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead;
         dependencies[1].dependencyFlags  = vk::DependencyFlagBits::eByRegion;
      
         // the dependency for exit out of the render pass
@@ -1509,7 +2124,7 @@ vk::Result VulkanApp::createShadingRenderPass ()
         dependencies[2].dependencyFlags  = vk::DependencyFlagBits::eByRegion;
     
     vk::RenderPassCreateInfo createInfo = { };
-        createInfo.attachmentCount  = 4;
+        createInfo.attachmentCount  = 5;
         createInfo.pAttachments     = attachmentDescriptions;
         createInfo.subpassCount     = 2;
         createInfo.pSubpasses       = subpasses;
@@ -1519,7 +2134,28 @@ vk::Result VulkanApp::createShadingRenderPass ()
     result = core.logicalDevice.createRenderPass(&createInfo, nullptr, &pipelines.shading.renderPass);
     
     if (result != vk::Result::eSuccess)
+        {
         std::cout << "Shading RenderPass ERROR: " << vk::to_string(result);
+        return result;
+        }
+
+    // the cached pass only differs in what it loads and stores, so it
+    // stays compatible with the framebuffer and pipelines made for the
+    // first. The geometry subpass clears whatever tiles it redraws
+    for (uint32_t a = 0; a < 3; ++a)
+        {
+        attachmentDescriptions[a].loadOp        = vk::AttachmentLoadOp::eLoad;
+        attachmentDescriptions[a].initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        }
+
+        attachmentDescriptions[4].stencilLoadOp  = vk::AttachmentLoadOp::eLoad;
+        attachmentDescriptions[4].stencilStoreOp = vk::AttachmentStoreOp::eStore;
+        attachmentDescriptions[4].initialLayout  = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+    result = core.logicalDevice.createRenderPass(&createInfo, nullptr, &pipelines.shading.cachedRenderPass);
+
+    if (result != vk::Result::eSuccess)
+        std::cout << "Cached Shading RenderPass ERROR: " << vk::to_string(result);
     
     return result;
     } // VulkanApp :: createShadingRenderPass
@@ -1566,6 +2202,13 @@ vk::Result VulkanApp::createRasterRenderPass ()
         attachmentDescriptions[2].stencilStoreOp  = vk::AttachmentStoreOp::eDontCare;
         attachmentDescriptions[2].initialLayout   = vk::ImageLayout::eUndefined;
         attachmentDescriptions[2].finalLayout     = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+    // the depth outlives the pass when it's reduced into the pyramid
+    if (occlusion.supported)
+        {
+        attachmentDescriptions[2].storeOp         = vk::AttachmentStoreOp::eStore;
+        attachmentDescriptions[2].finalLayout     = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+        }
     
     // the raster pipeline only contains one subpass to rasterize to the screen
     vk::SubpassDescription subpass [1];
@@ -1586,15 +2229,23 @@ vk::Result VulkanApp::createRasterRenderPass ()
     subpass[0].pInputAttachments       = &rasterInputAttachments[0];
         
     // we can now define the subpass dependency graph
-    vk::SubpassDependency dependencies = { };
-        dependencies.srcSubpass    = VK_SUBPASS_EXTERNAL;
-        dependencies.dstSubpass    = 0;
-        dependencies.srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependencies.dstStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependencies.srcAccessMask = vk::AccessFlagBits { };
-        dependencies.dstAccessMask =
+    vk::SubpassDependency dependencies [2];
+        dependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass    = 0;
+        dependencies[0].srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependencies[0].dstStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependencies[0].srcAccessMask = vk::AccessFlagBits { };
+        dependencies[0].dstAccessMask =
             vk::AccessFlagBits::eColorAttachmentRead |
             vk::AccessFlagBits::eColorAttachmentWrite;
+
+        // the pyramid is built from the depth once the pass is over
+        dependencies[1].srcSubpass    = 0;
+        dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask  = vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependencies[1].dstStageMask  = vk::PipelineStageFlagBits::eComputeShader;
+        dependencies[1].srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
      
     // then finally by the big daddy render pass
     vk::RenderPassCreateInfo createInfo = { };
@@ -1602,8 +2253,8 @@ vk::Result VulkanApp::createRasterRenderPass ()
         createInfo.pAttachments    = attachmentDescriptions;
         createInfo.subpassCount    = 1;
         createInfo.pSubpasses      = &subpass[0];
-        createInfo.dependencyCount = 1;
-        createInfo.pDependencies   = &dependencies;
+        createInfo.dependencyCount = occlusion.supported ? 2 : 1;
+        createInfo.pDependencies   = dependencies;
         
     result = core.logicalDevice.createRenderPass(&createInfo, nullptr, &pipelines.raster.renderPass);
     
@@ -1622,15 +2273,16 @@ vk::Result VulkanApp::createShadingFrameBuffer ()
     { // VulkanApp :: createShadingFrameBuffer
     vk::Result result = vk::Result::eSuccess;
     
-    vk::ImageView attachments [4] = {
+    vk::ImageView attachments [5] = {
         shading.position.view,
         shading.normal.view,
         shading.color.view,
-        shading.result.view};
+        shading.result.view,
+        shading.coverage.view};
     
     vk::FramebufferCreateInfo framebufferCreateInfo = { };
         framebufferCreateInfo.renderPass = pipelines.shading.renderPass;
-        framebufferCreateInfo.attachmentCount = 4;
+        framebufferCreateInfo.attachmentCount = 5;
         framebufferCreateInfo.pAttachments = attachments;
         framebufferCreateInfo.width = shading.BUFFER_SIZE;
         framebufferCreateInfo.height = shading.BUFFER_SIZE;
@@ -2002,14 +2654,26 @@ vk::Result VulkanApp::createGeometryPipeline ()
         dynamicStateCreateInfo.dynamicStateCount = 2;
         dynamicStateCreateInfo.pDynamicStates    = dynamicStates;
         
+    // every texel drawn is marked as covered for the lighting subpass
+    vk::StencilOpState coverageWrite = { };
+        coverageWrite.failOp      = vk::StencilOp::eKeep;
+        coverageWrite.passOp      = vk::StencilOp::eReplace;
+        coverageWrite.depthFailOp = vk::StencilOp::eKeep;
+        coverageWrite.compareOp   = vk::CompareOp::eAlways;
+        coverageWrite.compareMask = 0xff;
+        coverageWrite.writeMask   = 0xff;
+        coverageWrite.reference   = 1;
+
     vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo = { };
-        depthStencilCreateInfo.depthTestEnable       = VK_TRUE;
-        depthStencilCreateInfo.depthWriteEnable      = VK_TRUE;
+        depthStencilCreateInfo.depthTestEnable       = VK_FALSE;
+        depthStencilCreateInfo.depthWriteEnable      = VK_FALSE;
         depthStencilCreateInfo.depthCompareOp        = vk::CompareOp::eGreater;
         depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
         depthStencilCreateInfo.minDepthBounds        = 0.0f;
         depthStencilCreateInfo.maxDepthBounds        = 1.0f;
-        depthStencilCreateInfo.stencilTestEnable     = VK_FALSE;
+        depthStencilCreateInfo.stencilTestEnable     = VK_TRUE;
+        depthStencilCreateInfo.front                 = coverageWrite;
+        depthStencilCreateInfo.back                  = coverageWrite;
         
     vk::PipelineLayoutCreateInfo layoutCreateInfo = { };
         layoutCreateInfo.setLayoutCount = 1;
@@ -2056,6 +2720,18 @@ vk::Result VulkanApp::createShadingPipeline ()
         VulkanShaders::loadShader(core.logicalDevice, "shaders/lighting.vert.spv", vk::ShaderStageFlagBits::eVertex),
         VulkanShaders::loadShader(core.logicalDevice, "shaders/lighting.frag.spv", vk::ShaderStageFlagBits::eFragment)
         };
+
+    // the mask is indexed by block, so the fragment shader needs
+    // to know how many blocks make up a row of the atlas
+    vk::SpecializationMapEntry specializationEntry = { 0, 0, sizeof(uint32_t) };
+
+    vk::SpecializationInfo specializationInfo = { };
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries   = &specializationEntry;
+        specializationInfo.dataSize      = sizeof(uint32_t);
+        specializationInfo.pData         = &feedback.blocksPerRow;
+
+    shaderStages[1].pSpecializationInfo = &specializationInfo;
     
     vk::VertexInputBindingDescription inputBinding = { };
         inputBinding.binding    = 0;
@@ -2142,16 +2818,28 @@ vk::Result VulkanApp::createShadingPipeline ()
         colorBlendCreateInfo.blendConstants[2] = 0.0f;
         colorBlendCreateInfo.blendConstants[3] = 0.0f;
         
+    // the scissor is set per draw so the lighting quad can be
+    // confined to the atlas tiles that need shading
     vk::DynamicState dynamicStates[] =
         {
-        vk::DynamicState::eViewport,
-        vk::DynamicState::eLineWidth
+        vk::DynamicState::eScissor
         };
         
     vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo = { };
-        dynamicStateCreateInfo.dynamicStateCount = 2;
+        dynamicStateCreateInfo.dynamicStateCount = 1;
         dynamicStateCreateInfo.pDynamicStates    = dynamicStates;
         
+    // texels no chart covered fail before the fragment shader runs,
+    // as nothing here writes the stencil
+    vk::StencilOpState coverageTest = { };
+        coverageTest.failOp      = vk::StencilOp::eKeep;
+        coverageTest.passOp      = vk::StencilOp::eKeep;
+        coverageTest.depthFailOp = vk::StencilOp::eKeep;
+        coverageTest.compareOp   = vk::CompareOp::eEqual;
+        coverageTest.compareMask = 0xff;
+        coverageTest.writeMask   = 0x00;
+        coverageTest.reference   = 1;
+
     vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo = { };
         depthStencilCreateInfo.depthTestEnable       = VK_FALSE;
         depthStencilCreateInfo.depthWriteEnable      = VK_FALSE;
@@ -2159,7 +2847,9 @@ vk::Result VulkanApp::createShadingPipeline ()
         depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
         depthStencilCreateInfo.minDepthBounds        = 0.0f;
         depthStencilCreateInfo.maxDepthBounds        = 1.0f;
-        depthStencilCreateInfo.stencilTestEnable     = VK_FALSE;
+        depthStencilCreateInfo.stencilTestEnable     = VK_TRUE;
+        depthStencilCreateInfo.front                 = coverageTest;
+        depthStencilCreateInfo.back                  = coverageTest;
         
     vk::PipelineLayoutCreateInfo layoutCreateInfo = { };
         layoutCreateInfo.setLayoutCount = 1;
@@ -2183,7 +2873,7 @@ vk::Result VulkanApp::createShadingPipeline ()
         pipelineCreateInfo.pMultisampleState    = &multisampleCreateInfo;
         pipelineCreateInfo.pDepthStencilState   = &depthStencilCreateInfo;
         pipelineCreateInfo.pColorBlendState     = &colorBlendCreateInfo;
-        pipelineCreateInfo.pDynamicState        = nullptr; // Optional
+        pipelineCreateInfo.pDynamicState        = &dynamicStateCreateInfo;
         pipelineCreateInfo.layout               = pipelines.shading.shadingLayout;
         pipelineCreateInfo.renderPass           = pipelines.shading.renderPass;
         pipelineCreateInfo.subpass              = 1;
@@ -2288,10 +2978,12 @@ vk::Result VulkanApp::createRasterPipeline ()
         colorBlendCreateInfo.blendConstants[2] = 0.0f;
         colorBlendCreateInfo.blendConstants[3] = 0.0f;
         
+    // the viewport and scissor follow the swapchain extent, so they're
+    // left dynamic to let a resize keep the pipeline as it is
     vk::DynamicState dynamicStates[] =
         {
         vk::DynamicState::eViewport,
-        vk::DynamicState::eLineWidth
+        vk::DynamicState::eScissor
         };
         
     vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo = { };
@@ -2328,7 +3020,7 @@ vk::Result VulkanApp::createRasterPipeline ()
         pipelineCreateInfo.pMultisampleState    = &multisampleCreateInfo;
         pipelineCreateInfo.pDepthStencilState   = &depthStencilCreateInfo;
         pipelineCreateInfo.pColorBlendState     = &colorBlendCreateInfo;
-        pipelineCreateInfo.pDynamicState        = nullptr; // Optional
+        pipelineCreateInfo.pDynamicState        = &dynamicStateCreateInfo;
         pipelineCreateInfo.layout               = pipelines.raster.layout;
         pipelineCreateInfo.renderPass           = pipelines.raster.renderPass;
         pipelineCreateInfo.subpass              = 0;
@@ -2345,336 +3037,4720 @@ vk::Result VulkanApp::createRasterPipeline ()
 
 
 //
-//  createShadingCommandBuffers
+//  createCullingBuffers
 //
-//  sets up a graphics command buffer for fulfilling
-//  our rendering needs, if we require compute we'll
-//  need (ideally) another command buffer
+//  sets up the buffers the culling shader reads the objects from
+//  and writes the indirect draws for both passes into
 //
-vk::Result VulkanApp::createShadingCommandBuffers ()
-    { // VulkanApp :: createShadingCommandBuffers
+vk::Result VulkanApp::createCullingBuffers ()
+    { // VulkanApp :: createCullingBuffers
     vk::Result result = vk::Result::eSuccess;
 
-    vk::CommandBufferAllocateInfo allocationInfo = { };
-        allocationInfo.commandPool        = command.pool;
-        allocationInfo.level              = vk::CommandBufferLevel::ePrimary;
-        allocationInfo.commandBufferCount = 1;
-  
-    result = core.logicalDevice.allocateCommandBuffers(&allocationInfo, &shading.commandBuffer);
-  
-    if (result != vk::Result::eSuccess)
-        return result;
-    
-    vk::CommandBufferBeginInfo beginInfo = { };
-        beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-        beginInfo.pInheritanceInfo = nullptr;
+    // the index ranges and bounds never change, only the
+    // transforms are rewritten each frame
+    culling.objects.resize(nObjects);
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        culling.objects[i].model        = glm::mat4(1.0f);
+        culling.objects[i].bounds       = culling.meshBounds;
+        culling.objects[i].firstIndex   = meshes.objects[i].firstIndex;
+        culling.objects[i].indexCount   = meshes.objects[i].indexCount;
+        culling.objects[i].vertexOffset = meshes.objects[i].vertexOffset;
+        culling.objects[i].shade        = 1;
+        } // for each object
 
-    // we define a clear value for our colour buffer and our
-    // stencil buffer so they can be reset at the start of render
-    vk::ClearColorValue color = { WINDOW_CLEAR };
-    vk::ClearDepthStencilValue depth = { 1.0f, 0 };
-    
-    std::array<vk::ClearValue, 4> clearValues = {};
-        clearValues[0].color        = color;
-        clearValues[1].color        = color;
-        clearValues[2].color        = color;
-        clearValues[3].color        = color;
+    vk::DeviceSize drawSize = sizeof(vk::DrawIndexedIndirectCommand) * nObjects;
 
-    vk::RenderPassBeginInfo renderPassBeginInfo = { };
-        renderPassBeginInfo.renderPass        = pipelines.shading.renderPass;
-        renderPassBeginInfo.framebuffer       = shading.framebuffer;
-        renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
-        renderPassBeginInfo.renderArea.extent.width = shading.BUFFER_SIZE;
-		renderPassBeginInfo.renderArea.extent.height = shading.BUFFER_SIZE;
-        renderPassBeginInfo.clearValueCount   = 4;
-        renderPassBeginInfo.pClearValues      = clearValues.data();
-    
-    vk::DeviceSize offsets[] = { 0 };
-    
-    shading.commandBuffer.begin(&beginInfo);
-    shading.commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
-    
-        //  Subpass One: Populate geometry buffers in preperation for lighting computation
-        shading.commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryPipeline);
-        shading.commandBuffer.bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
-        shading.commandBuffer.bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
-        shading.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryLayout, 0, 1, &pipelines.shading.geometryDescriptorSet, 0, nullptr);
-        shading.commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.scene.indices.size()), 1, 0, 0, 0);
+    // the geometry pass draws each object a cluster at a time
+    uint32_t clusterCount = static_cast<uint32_t>(clusters.list.size());
 
-		shading.commandBuffer.nextSubpass(vk::SubpassContents::eInline);
-       
-        //  Subpass Two: Compute lighting and store in buffer
-        shading.commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.shadingPipeline);
-        shading.commandBuffer.bindVertexBuffers(0, 1, &buffers.quadVertex.buffer, offsets);
-        shading.commandBuffer.bindIndexBuffer(buffers.quadIndex.buffer, 0, vk::IndexType::eUint32);
-        shading.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.shadingLayout, 0, 1, &pipelines.shading.shadingDescriptorSet, 0, nullptr);
-        shading.commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.quad.indices.size()), 1, 0, 0, 0);
+    createStagedBuffer(sizeof(UniformBufferObjects::CullingUBO),    vk::BufferUsageFlagBits::eUniformBuffer, buffers.cullingUniform);
+    createStagedBuffer(sizeof(CullingState::Object) * nObjects,     vk::BufferUsageFlagBits::eStorageBuffer, buffers.cullingObjects);
 
-    shading.commandBuffer.endRenderPass();
-    shading.commandBuffer.end();
+    createBuffer(
+        sizeof(ClusterCulling::Cluster) * clusterCount,
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        buffers.cullingClusters.buffer,
+        buffers.cullingClusters.memory);
+
+    void* data;
+    core.logicalDevice.mapMemory(buffers.cullingClusters.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags{}, &data);
+    memcpy(data, clusters.list.data(), sizeof(ClusterCulling::Cluster) * clusterCount);
+    core.logicalDevice.unmapMemory(buffers.cullingClusters.memory);
+
+    // the draws never leave the device
+    createBuffer(
+        drawSize * clusterCount,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.geometryIndirect.buffer,
+        buffers.geometryIndirect.memory);
+
+    createBuffer(
+        drawSize,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.rasterIndirect.buffer,
+        buffers.rasterIndirect.memory);
+
+    // the count is cleared on the device before every dispatch and
+    // copied out with the frame's readback for reporting
+    createBuffer(
+        sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.cullingCount.buffer,
+        buffers.cullingCount.memory);
 
     return result;
-        
-    } // VulkanApp :: createShadingCommandBuffers
+    } // VulkanApp :: createCullingBuffers
 
 
 //
-//  createRasterCommandBuffers
+//  createVisibilityBuffer
 //
-//  sets up a graphics command buffer for fulfilling
-//  our rendering needs, if we require compute we'll
-//  need (ideally) another command buffer
+//  sets up the per object flags the raster pass writes and the
+//  host state that tracks what was seen and what was shaded
 //
-vk::Result VulkanApp::createRasterCommandBuffers ()
-    { // VulkanApp :: createRasterCommandBuffers
+vk::Result VulkanApp::createVisibilityBuffer ()
+    { // VulkanApp :: createVisibilityBuffer
     vk::Result result = vk::Result::eSuccess;
 
-    swapchain.commandBuffers.resize(swapchain.nImages);
-    
-    vk::CommandBufferAllocateInfo allocationInfo = { };
-        allocationInfo.commandPool        = command.pool;
-        allocationInfo.level              = vk::CommandBufferLevel::ePrimary;
-        allocationInfo.commandBufferCount = swapchain.nImages;
-  
-    result = core.logicalDevice.allocateCommandBuffers(&allocationInfo, swapchain.commandBuffers.data());
-  
-    if (result != vk::Result::eSuccess)
-        return result;
-        
-    // once we allocate our memory we can initialize a command
-    // buffer for each swapchain image
-    for (uint32_t i = 0; i < swapchain.nImages; ++i)
-        { // for each swapchain image
-        
-        vk::CommandBufferBeginInfo beginInfo = { };
-            beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
-            beginInfo.pInheritanceInfo = nullptr;
-        swapchain.commandBuffers[i].begin(&beginInfo);
+    // without fragment stores nothing is ever reported back, so
+    // every tile has to be shaded
+    feedback.enabled = core.features.fragmentStoresAndAtomics == VK_TRUE;
+
+    feedback.flags    .assign(nObjects, 0);
+    feedback.lastSeen .assign(nObjects, 0);
+    feedback.fresh    .assign(nObjects, 0);
+    feedback.shade    .assign(nObjects, 1);
+    feedback.shadeCount = nObjects;
+
+    // the flags are cleared on the device as they're copied out
+    createBuffer(
+        sizeof(uint32_t) * nObjects,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.visibility.buffer,
+        buffers.visibility.memory);
+
+    // the culling shader's count is copied out after the flags
+    for (VulkanBuffers::VulkanBuffer& readback : buffers.frameReadback)
+        {
+        createBuffer(
+            sizeof(uint32_t) * (nObjects + 1),
+            vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            readback.buffer,
+            readback.memory);
 
-        // we define a clear value for our colour buffer and our
-        // stencil buffer so they can be reset at the start of render
-        vk::ClearColorValue color = { WINDOW_CLEAR };
-        vk::ClearDepthStencilValue depth = { 1.0f, 0 };
-        
-        std::array<vk::ClearValue, 3> clearValues = {};
-            clearValues[0].color        = color;
-            clearValues[1].color        = color;
-            clearValues[2].depthStencil = depth;
+        void* data;
 
-        vk::RenderPassBeginInfo renderPassBeginInfo = { };
-            renderPassBeginInfo.renderPass        = pipelines.raster.renderPass;
-            renderPassBeginInfo.framebuffer       = swapchain.framebuffers[i];
-            renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
-            renderPassBeginInfo.renderArea.extent = swapchain.extent;
-            renderPassBeginInfo.clearValueCount   = 3;
-            renderPassBeginInfo.pClearValues      = clearValues.data();
-        
-        vk::DeviceSize offsets[] = { 0 };
-        
-        swapchain.commandBuffers[i].beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
-        swapchain.commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.raster.pipeline);
-        swapchain.commandBuffers[i].bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
-        swapchain.commandBuffers[i].bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
-        swapchain.commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.raster.layout, 0, 1, &pipelines.raster.descriptorSet, 0, nullptr);
-        swapchain.commandBuffers[i].drawIndexed(static_cast<uint32_t>(meshes.scene.indices.size()), 1, 0, 0, 0);
-        swapchain.commandBuffers[i].endRenderPass();
-        swapchain.commandBuffers[i].end();
+        result = core.logicalDevice.mapMemory(readback.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data);
+        if (result != vk::Result::eSuccess)
+            return result;
+
+        memset(data, 0, sizeof(uint32_t) * (nObjects + 1));
+
+        core.logicalDevice.unmapMemory(readback.memory);
+        }
+
+    vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
+    commandBuffer.fillBuffer(buffers.visibility.buffer, 0, VK_WHOLE_SIZE, 0);
+    VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
 
-        } // for each swapchain image
-        
     return result;
-        
-    } // VulkanApp :: createRasterCommandBuffers
+    } // VulkanApp :: createVisibilityBuffer
 
 
 //
+//  createFeedbackBuffers
 //
+//  sets up the per block flags the raster pass marks as it samples
+//  the atlas, and the dilated mask the lighting pass reads
 //
-void VulkanApp::arrangeObjects ()
-    { // VulkanApp :: arrangeObjects
+vk::Result VulkanApp::createFeedbackBuffers ()
+    { // VulkanApp :: createFeedbackBuffers
+    vk::Result result = vk::Result::eSuccess;
 
-    if (!arrangement.arranged)
-        {
-        int m = sqrt(nObjects);
-        arrangement.translations.resize(nObjects);
-        arrangement.centre = { 0.0f, 0.0f, 0.0f };
+    feedback.blocksPerRow = (shading.BUFFER_SIZE + feedback.BLOCK_SIZE - 1) / feedback.BLOCK_SIZE;
 
-	for (Vertex& v : meshes.scene.vertices)
-            { // for each vertex
-            arrangement.translations[v.id] = {
-                (v.id % m) * offset,
-                0.0f, 
-                (v.id / m) * offset};
-            } // for each vertex
+    vk::DeviceSize size = sizeof(uint32_t) * feedback.blocksPerRow * feedback.blocksPerRow;
 
-        for (uint32_t i = 0; i < nObjects; ++i)
-	    arrangement.centre += arrangement.translations[i];
+    createStagedBuffer(sizeof(UniformBufferObjects::FeedbackUBO), vk::BufferUsageFlagBits::eUniformBuffer, buffers.feedbackUniform);
 
-        arrangement.centre /= nObjects;
-        arrangement.arranged = true;
-        }
+    createBuffer(
+        size,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.sampledBlocks.buffer,
+        buffers.sampledBlocks.memory);
 
-        for (uint32_t i = 0; i < nObjects; ++i)
-            { // for each object	
-            ubo.geometry.model[i] = glm::mat4(1.0f);
-            ubo.geometry.model[i] = glm::translate(ubo.geometry.model[i], arrangement.translations[i] - arrangement.centre);
-            ubo.geometry.model[i] = glm::scale(ubo.geometry.model[i], glm::vec3(0.5f, 0.5f, 0.5f));
-            ubo.geometry.model[i] = glm::rotate(ubo.geometry.model[i], glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-            ubo.raster.model[i] = ubo.geometry.model[i];
-            simulation.positions[i] = arrangement.translations[i] - arrangement.centre;
-            } // for each object
+    createBuffer(
+        size,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.shadingMask.buffer,
+        buffers.shadingMask.memory);
 
-	} // VulkanApp :: arrangeObjects
+    // refreshes are kept per block rather than per object, so what
+    // the dilation reads grows with the atlas and not the scene
+    createStagedBuffer(size, vk::BufferUsageFlagBits::eStorageBuffer, buffers.refreshBlocks);
 
+    // nothing has been sampled yet, while the first passes shade everything
+    ubo.feedback.full        = 1;
+    ubo.feedback.atlasSize   = shading.BUFFER_SIZE;
 
-//
-//
-//
-void VulkanApp::createPhysicsState ()
-    { // VulkanApp :: createPhysicsState
-		
-    std::uniform_real_distribution<float> posDist (-0.01, 0.01);
-    std::uniform_real_distribution<float> angDist(-10.0, 10.0);
+    feedback.refresh.assign(feedback.blocksPerRow * feedback.blocksPerRow, 0);
+    feedback.refreshed = false;
 
-    simulation.positions.resize(nObjects);
-    simulation.velocities.resize(nObjects);
-    simulation.orientations.resize(nObjects);
-    simulation.rotations.resize(nObjects);
+    memcpy(stageBuffer(buffers.refreshBlocks,   0, size),                                    feedback.refresh.data(), (size_t)size);
+    memcpy(stageBuffer(buffers.feedbackUniform, 0, sizeof(UniformBufferObjects::FeedbackUBO)), &ubo.feedback,           sizeof(UniformBufferObjects::FeedbackUBO));
 
-    for (uint32_t i = 0; i < nObjects; ++i)
-        { // for each object
-        simulation.velocities[i]   = glm::vec3(posDist(rng), posDist(rng), posDist(rng));
-        simulation.rotations[i]    = glm::vec3(angDist(rng), angDist(rng), angDist(rng));
-        simulation.orientations[i] = glm::vec3(0.0f, 0.0f, 0.0f);
-        simulation.bounds          = 2.0f;
-        } // for each object
+    vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
+    commandBuffer.fillBuffer(buffers.sampledBlocks.buffer, 0, VK_WHOLE_SIZE, 0);
+    commandBuffer.fillBuffer(buffers.shadingMask.buffer,   0, VK_WHOLE_SIZE, 1);
+    VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
 
-    } // VulkanApp :: createPhysicsState
+    return result;
+    } // VulkanApp :: createFeedbackBuffers
 
 
 //
+//  createDepthPyramid
 //
+//  sizes the pyramid to the swapchain and sets up the buffers it
+//  and the host's copy of its coarse levels live in
 //
-void VulkanApp::updatePhysicsState ()
-    { // VulkanApp :: updatePhysicsState
+vk::Result VulkanApp::createDepthPyramid ()
+    { // VulkanApp :: createDepthPyramid
+    vk::Result result = vk::Result::eSuccess;
 
-    // advance the simulation
+    occlusion.pyramid.layout(swapchain.extent.width, swapchain.extent.height);
+    occlusion.hostLevel = occlusion.pyramid.hostLevel(OcclusionState::HOST_WIDTH);
+
+    uint32_t hostOffset = occlusion.pyramid.levels[occlusion.hostLevel].offset;
+    uint32_t hostCount  = occlusion.pyramid.size - hostOffset;
+
+    createBuffer(
+        sizeof(float) * occlusion.pyramid.size,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffers.depthPyramid.buffer,
+        buffers.depthPyramid.memory);
+
+    // until a frame has been drawn everything is as far away as it
+    // can be, which never hides anything
+    std::vector<float> farthest (hostCount, 1.0f);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        { // for each frame in flight
+        createBuffer(
+            sizeof(float) * hostCount,
+            vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            buffers.depthReadback[i].buffer,
+            buffers.depthReadback[i].memory);
+
+        void* data;
+
+        result = core.logicalDevice.mapMemory(buffers.depthReadback[i].memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data);
+        if (result != vk::Result::eSuccess)
+            return result;
+
+        memcpy(data, farthest.data(), sizeof(float) * hostCount);
+
+        core.logicalDevice.unmapMemory(buffers.depthReadback[i].memory);
+
+        occlusion.readbackViewProjection[i] = glm::mat4(1.0f);
+        } // for each frame in flight
+
+    uint32_t one;
+    memcpy(&one, &farthest[0], sizeof(uint32_t));
+
+    vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
+    commandBuffer.fillBuffer(buffers.depthPyramid.buffer, 0, VK_WHOLE_SIZE, one);
+    VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
+
+    return result;
+    } // VulkanApp :: createDepthPyramid
+
+
+//
+//  createCullingDescriptorSet
+//
+//  binds the culling uniforms, the object buffer, both sets of
+//  indirect draws, the visible count and the mesh's clusters for
+//  the compute stage
+//
+vk::Result VulkanApp::createCullingDescriptorSet ()
+    { // VulkanApp :: createCullingDescriptorSet
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::DescriptorSetLayoutBinding layoutBindings [7];
+
+        // Uniform Buffer
+        layoutBindings[0].binding             = 0;
+        layoutBindings[0].descriptorCount     = 1;
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eUniformBuffer;
+        layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[0].pImmutableSamplers  = nullptr;
+
+        // Objects, Geometry Draws, Raster Draws, Visible Count, Depth Pyramid, Clusters
+        for (uint32_t i = 1; i < 7; ++i)
+            {
+            layoutBindings[i].binding             = i;
+            layoutBindings[i].descriptorCount     = 1;
+            layoutBindings[i].descriptorType      = vk::DescriptorType::eStorageBuffer;
+            layoutBindings[i].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+            layoutBindings[i].pImmutableSamplers  = nullptr;
+            }
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
+        layoutCreateInfo.bindingCount  = 7;
+        layoutCreateInfo.pBindings     = layoutBindings;
+
+    result = core.logicalDevice.createDescriptorSetLayout(
+        &layoutCreateInfo,
+        nullptr,
+        &pipelines.culling.descriptorLayout);
+
+    if (result != vk::Result::eSuccess)
+        { // failed to create layout
+        std::cout << "Failed to create culling descriptor set layout" << std::endl;
+        return result;
+        } // failed to create layout
+
+    vk::DescriptorSetAllocateInfo allocationInfo = { };
+        allocationInfo.descriptorPool      = pipelines.descriptorPool;
+        allocationInfo.descriptorSetCount  = 1;
+        allocationInfo.pSetLayouts         = &pipelines.culling.descriptorLayout;
+
+    result = core.logicalDevice.allocateDescriptorSets(&allocationInfo, &pipelines.culling.descriptorSet);
+    if (result != vk::Result::eSuccess)
+        { // failed to allocate set
+        std::cout << "Failed to create culling descriptor set" << std::endl;
+        return result;
+        } // failed to allocate set
+
+    vk::DescriptorBufferInfo bufferInfos [6];
+        bufferInfos[0] = vk::DescriptorBufferInfo { buffers.cullingUniform.buffer,   0, sizeof(UniformBufferObjects::CullingUBO) };
+        bufferInfos[1] = vk::DescriptorBufferInfo { buffers.cullingObjects.buffer,   0, VK_WHOLE_SIZE };
+        bufferInfos[2] = vk::DescriptorBufferInfo { buffers.geometryIndirect.buffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[3] = vk::DescriptorBufferInfo { buffers.rasterIndirect.buffer,   0, VK_WHOLE_SIZE };
+        bufferInfos[4] = vk::DescriptorBufferInfo { buffers.cullingCount.buffer,     0, VK_WHOLE_SIZE };
+        bufferInfos[5] = vk::DescriptorBufferInfo { buffers.cullingClusters.buffer,  0, VK_WHOLE_SIZE };
+
+    // binding 5 is skipped over
+    uint32_t bindings [6] = { 0, 1, 2, 3, 4, 6 };
+
+    vk::WriteDescriptorSet descriptorWrites [6];
+    for (uint32_t i = 0; i < 6; ++i)
+        { // for each binding
+        descriptorWrites[i].dstSet           = pipelines.culling.descriptorSet;
+        descriptorWrites[i].dstBinding       = bindings[i];
+        descriptorWrites[i].dstArrayElement  = 0;
+        descriptorWrites[i].descriptorType   = layoutBindings[bindings[i]].descriptorType;
+        descriptorWrites[i].descriptorCount  = 1;
+        descriptorWrites[i].pBufferInfo      = &bufferInfos[i];
+        } // for each binding
+
+    // the pyramid is replaced along with the swapchain, so it's
+    // written by writeOcclusionDescriptors
+    core.logicalDevice.updateDescriptorSets (6, descriptorWrites, 0, nullptr);
+
+    return result;
+    } // VulkanApp :: createCullingDescriptorSet
+
+
+//
+//  createCullingPipeline
+//
+vk::Result VulkanApp::createCullingPipeline ()
+    { // VulkanApp :: createCullingPipeline
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = { };
+        pipelineLayoutCreateInfo.setLayoutCount         = 1;
+        pipelineLayoutCreateInfo.pSetLayouts            = &pipelines.culling.descriptorLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+        pipelineLayoutCreateInfo.pPushConstantRanges    = nullptr;
+
+    result = core.logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelines.culling.layout);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = { };
+        pipelineCreateInfo.stage  = VulkanShaders::loadShader(core.logicalDevice, "shaders/cull.comp.spv", vk::ShaderStageFlagBits::eCompute);
+        pipelineCreateInfo.layout = pipelines.culling.layout;
+
+    result = core.logicalDevice.createComputePipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.culling.pipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    // the cluster shader shares the layout, reading the same objects
+    pipelineCreateInfo.stage = VulkanShaders::loadShader(core.logicalDevice, "shaders/cluster.comp.spv", vk::ShaderStageFlagBits::eCompute);
+
+    result = core.logicalDevice.createComputePipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.culling.clusterPipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    VulkanShaders::tidy(core.logicalDevice);
+
+    return result;
+    } // VulkanApp :: createCullingPipeline
+
+
+//
+//  createFeedbackDescriptorSet
+//
+//  binds the feedback uniform, the sampled blocks, the shading mask
+//  and the blocks to refresh for the dilation shader
+//
+vk::Result VulkanApp::createFeedbackDescriptorSet ()
+    { // VulkanApp :: createFeedbackDescriptorSet
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::DescriptorSetLayoutBinding layoutBindings [4];
+
+        // Uniform Buffer
+        layoutBindings[0].binding             = 0;
+        layoutBindings[0].descriptorCount     = 1;
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eUniformBuffer;
+        layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[0].pImmutableSamplers  = nullptr;
+
+        // Sampled Blocks
+        layoutBindings[1].binding             = 1;
+        layoutBindings[1].descriptorCount     = 1;
+        layoutBindings[1].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[1].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[1].pImmutableSamplers  = nullptr;
+
+        // Shading Mask
+        layoutBindings[2].binding             = 2;
+        layoutBindings[2].descriptorCount     = 1;
+        layoutBindings[2].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[2].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[2].pImmutableSamplers  = nullptr;
+
+        // Refreshed Blocks
+        layoutBindings[3].binding             = 3;
+        layoutBindings[3].descriptorCount     = 1;
+        layoutBindings[3].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[3].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[3].pImmutableSamplers  = nullptr;
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
+        layoutCreateInfo.bindingCount  = 4;
+        layoutCreateInfo.pBindings     = layoutBindings;
+
+    result = core.logicalDevice.createDescriptorSetLayout(
+        &layoutCreateInfo,
+        nullptr,
+        &pipelines.feedback.descriptorLayout);
+
+    if (result != vk::Result::eSuccess)
+        { // failed to create layout
+        std::cout << "Failed to create feedback descriptor set layout" << std::endl;
+        return result;
+        } // failed to create layout
+
+    vk::DescriptorSetAllocateInfo allocationInfo = { };
+        allocationInfo.descriptorPool      = pipelines.descriptorPool;
+        allocationInfo.descriptorSetCount  = 1;
+        allocationInfo.pSetLayouts         = &pipelines.feedback.descriptorLayout;
+
+    result = core.logicalDevice.allocateDescriptorSets(&allocationInfo, &pipelines.feedback.descriptorSet);
+    if (result != vk::Result::eSuccess)
+        { // failed to allocate set
+        std::cout << "Failed to create feedback descriptor set" << std::endl;
+        return result;
+        } // failed to allocate set
+
+    vk::DescriptorBufferInfo bufferInfos [4];
+        bufferInfos[0] = vk::DescriptorBufferInfo { buffers.feedbackUniform.buffer, 0, sizeof(UniformBufferObjects::FeedbackUBO) };
+        bufferInfos[1] = vk::DescriptorBufferInfo { buffers.sampledBlocks.buffer,   0, VK_WHOLE_SIZE };
+        bufferInfos[2] = vk::DescriptorBufferInfo { buffers.shadingMask.buffer,     0, VK_WHOLE_SIZE };
+        bufferInfos[3] = vk::DescriptorBufferInfo { buffers.refreshBlocks.buffer,   0, VK_WHOLE_SIZE };
+
+    vk::WriteDescriptorSet descriptorWrites [4];
+    for (uint32_t i = 0; i < 4; ++i)
+        { // for each binding
+        descriptorWrites[i].dstSet           = pipelines.feedback.descriptorSet;
+        descriptorWrites[i].dstBinding       = i;
+        descriptorWrites[i].dstArrayElement  = 0;
+        descriptorWrites[i].descriptorType   = layoutBindings[i].descriptorType;
+        descriptorWrites[i].descriptorCount  = 1;
+        descriptorWrites[i].pBufferInfo      = &bufferInfos[i];
+        } // for each binding
+
+    core.logicalDevice.updateDescriptorSets (4, descriptorWrites, 0, nullptr);
+
+    return result;
+    } // VulkanApp :: createFeedbackDescriptorSet
+
+
+//
+//  createFeedbackPipeline
+//
+vk::Result VulkanApp::createFeedbackPipeline ()
+    { // VulkanApp :: createFeedbackPipeline
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = { };
+        pipelineLayoutCreateInfo.setLayoutCount         = 1;
+        pipelineLayoutCreateInfo.pSetLayouts            = &pipelines.feedback.descriptorLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+        pipelineLayoutCreateInfo.pPushConstantRanges    = nullptr;
+
+    result = core.logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelines.feedback.layout);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    // the atlas size and margin are fixed for the run, so they're
+    // baked into the shader rather than passed every dispatch
+    uint32_t constants[] = { feedback.blocksPerRow, feedback.margin };
+
+    vk::SpecializationMapEntry specializationEntries[] =
+        {
+        { 0, 0,                sizeof(uint32_t) },
+        { 1, sizeof(uint32_t), sizeof(uint32_t) }
+        };
+
+    vk::SpecializationInfo specializationInfo = { };
+        specializationInfo.mapEntryCount = 2;
+        specializationInfo.pMapEntries   = specializationEntries;
+        specializationInfo.dataSize      = sizeof(constants);
+        specializationInfo.pData         = constants;
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = { };
+        pipelineCreateInfo.stage  = VulkanShaders::loadShader(core.logicalDevice, "shaders/dilate.comp.spv", vk::ShaderStageFlagBits::eCompute);
+        pipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+        pipelineCreateInfo.layout = pipelines.feedback.layout;
+
+    result = core.logicalDevice.createComputePipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.feedback.pipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    VulkanShaders::tidy(core.logicalDevice);
+
+    return result;
+    } // VulkanApp :: createFeedbackPipeline
+
+
+//
+//  createLightingBuffers
+//
+//  picks the largest tile the device can run as one workgroup, up
+//  to the default, and sizes the tile list for every object to be
+//  lit whole at full shading level
+//
+vk::Result VulkanApp::createLightingBuffers ()
+    { // VulkanApp :: createLightingBuffers
+    vk::Result result = vk::Result::eSuccess;
+
+    // the geometry buffers and result have to be storage images,
+    // which VulkanShadingResource asks for whenever the format allows
+    vk::FormatProperties properties = core.physicalDevice.getFormatProperties(pipelines.shading.format);
+    tiledLighting.supported = (bool)(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage);
+    tiledLighting.enabled   = tiledLighting.enabled && tiledLighting.supported;
+
+    // each invocation keeps three texels of the tile in shared memory,
+    // next to the tile's bounds and its list of lights
+    vk::PhysicalDeviceLimits limits = core.physicalDevice.getProperties().limits;
+    uint32_t& t = tiledLighting.tileSize;
+    while (t > 1 && (
+        t * t > limits.maxComputeWorkGroupInvocations ||
+        t > limits.maxComputeWorkGroupSize[0] ||
+        t > limits.maxComputeWorkGroupSize[1] ||
+        3 * sizeof(glm::vec4) * t * t + sizeof(uint32_t) * (8 + LightState::MAX_TILE_LIGHTS) > limits.maxComputeSharedMemorySize))
+        t /= 2;
+
+    // no object is given more than a page
+    uint32_t texels  = paging.table.pageSize;
+    uint32_t perSide = (texels + t - 1) / t;
+
+    tiledLighting.capacity = nObjects * perSide * perSide;
+    tiledLighting.tiles.reserve(tiledLighting.capacity);
+
+    createStagedBuffer(sizeof(TiledLightingState::Tile) * tiledLighting.capacity, vk::BufferUsageFlagBits::eStorageBuffer, buffers.lightingTiles);
+
+    return result;
+    } // VulkanApp :: createLightingBuffers
+
+
+//
+//  createMipBuffers
+//
+//  writes the tiles covering every page of the atlas at each level
+//  of the mip chain to the front of the list, and leaves room after
+//  them for the tiles of each shading pass
+//
+vk::Result VulkanApp::createMipBuffers ()
+    { // VulkanApp :: createMipBuffers
+    vk::Result result = vk::Result::eSuccess;
+
+    if (mips.levels == 1)
+        return result;
+
+    const VirtualAtlas& table = paging.table;
+    uint32_t pages = table.pagesPerSide * table.pagesPerSide;
+
+    // the static recording lights the whole atlas, whatever holds it,
+    // so its charts are the pages themselves
+    mips.tiles.clear();
+    for (uint32_t l = 1; l < mips.levels; ++l)
+        { // for each level
+        mips.whole[l].first = static_cast<uint32_t>(mips.tiles.size());
+
+        for (uint32_t p = 0; p < pages; ++p)
+            {
+            glm::uvec4 page = table.pageRect(p);
+            cutMipTiles(vk::Rect2D { vk::Offset2D { (int32_t)page.x, (int32_t)page.y }, vk::Extent2D { table.pageSize, table.pageSize } }, l);
+            }
+
+        mips.whole[l].count = static_cast<uint32_t>(mips.tiles.size()) - mips.whole[l].first;
+        } // for each level
+
+    uint32_t whole = static_cast<uint32_t>(mips.tiles.size());
+
+    // a pass shades no more than every cell of every page, and cut
+    // cell by cell the atlas gives at least as many tiles as any
+    // blocks of cells would
+    uint32_t cell = table.pageSize / VirtualAtlas::CELLS;
+    for (uint32_t l = 1; l < mips.levels; ++l)
+        for (uint32_t y = 0; y < shading.BUFFER_SIZE; y += cell)
+            for (uint32_t x = 0; x < shading.BUFFER_SIZE; x += cell)
+                cutMipTiles(vk::Rect2D { vk::Offset2D { (int32_t)x, (int32_t)y }, vk::Extent2D { cell, cell } }, l);
+
+    mips.capacity = static_cast<uint32_t>(mips.tiles.size());
+
+    createStagedBuffer(sizeof(MipState::Tile) * mips.capacity, vk::BufferUsageFlagBits::eStorageBuffer, buffers.mipTiles);
+    memcpy(stageBuffer(buffers.mipTiles, 0, sizeof(MipState::Tile) * whole), mips.tiles.data(), sizeof(MipState::Tile) * whole);
+
+    mips.tiles.clear();
+
+    return result;
+    } // VulkanApp :: createMipBuffers
+
+
+//
+//  createLightingDescriptorSet
+//
+//  the shading uniforms, the geometry buffers and result as storage
+//  images, the shading mask, the tile list, the point lights, the
+//  result's history and the objects for the tiled lighting shader.
+//  Left unwritten if the device can't run it
+//
+vk::Result VulkanApp::createLightingDescriptorSet ()
+    { // VulkanApp :: createLightingDescriptorSet
+    vk::Result result = vk::Result::eSuccess;
+
+    if (!tiledLighting.supported)
+        return result;
+
+    vk::DescriptorSetLayoutBinding layoutBindings [11];
+    for (uint32_t i = 0; i < 11; ++i)
+        { // for each binding
+        layoutBindings[i].binding             = i;
+        layoutBindings[i].descriptorCount     = 1;
+        layoutBindings[i].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[i].pImmutableSamplers  = nullptr;
+        } // for each binding
+
+        // Uniform Buffer
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eUniformBuffer;
+
+        // Geometry Buffers and Result
+        layoutBindings[1].descriptorType      = vk::DescriptorType::eStorageImage;
+        layoutBindings[2].descriptorType      = vk::DescriptorType::eStorageImage;
+        layoutBindings[3].descriptorType      = vk::DescriptorType::eStorageImage;
+        layoutBindings[4].descriptorType      = vk::DescriptorType::eStorageImage;
+
+        // Shading Mask, Tiles and Point Lights
+        layoutBindings[5].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[6].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[7].descriptorType      = vk::DescriptorType::eStorageBuffer;
+
+        // History
+        layoutBindings[8].descriptorType      = vk::DescriptorType::eStorageImage;
+
+        // Objects
+        layoutBindings[9].descriptorType      = vk::DescriptorType::eStorageBuffer;
+
+        // Shadow Layers
+        layoutBindings[10].descriptorType     = vk::DescriptorType::eCombinedImageSampler;
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
+        layoutCreateInfo.bindingCount  = 11;
+        layoutCreateInfo.pBindings     = layoutBindings;
+
+    result = core.logicalDevice.createDescriptorSetLayout(
+        &layoutCreateInfo,
+        nullptr,
+        &pipelines.lighting.descriptorLayout);
+
+    if (result != vk::Result::eSuccess)
+        { // failed to create layout
+        std::cout << "Failed to create lighting descriptor set layout" << std::endl;
+        return result;
+        } // failed to create layout
+
+    vk::DescriptorSetAllocateInfo allocationInfo = { };
+        allocationInfo.descriptorPool      = pipelines.descriptorPool;
+        allocationInfo.descriptorSetCount  = 1;
+        allocationInfo.pSetLayouts         = &pipelines.lighting.descriptorLayout;
+
+    result = core.logicalDevice.allocateDescriptorSets(&allocationInfo, &pipelines.lighting.descriptorSet);
+    if (result != vk::Result::eSuccess)
+        { // failed to allocate set
+        std::cout << "Failed to create lighting descriptor set" << std::endl;
+        return result;
+        } // failed to allocate set
+
+    vk::DescriptorBufferInfo bufferInfos [5];
+        bufferInfos[0] = vk::DescriptorBufferInfo { buffers.shadingUniform.buffer, 0, sizeof(UniformBufferObjects::ShadingUBO) };
+        bufferInfos[1] = vk::DescriptorBufferInfo { buffers.shadingMask.buffer,    0, VK_WHOLE_SIZE };
+        bufferInfos[2] = vk::DescriptorBufferInfo { buffers.lightingTiles.buffer,  0, VK_WHOLE_SIZE };
+        bufferInfos[3] = vk::DescriptorBufferInfo { buffers.lights.buffer,         0, VK_WHOLE_SIZE };
+        bufferInfos[4] = vk::DescriptorBufferInfo { buffers.shadingObjects.buffer, 0, VK_WHOLE_SIZE };
+
+    // the images are only ever in the general layout while the
+    // shader runs, see recordTiledLighting
+    vk::DescriptorImageInfo imageInfos [5];
+        imageInfos[0] = vk::DescriptorImageInfo { vk::Sampler { }, shading.position.view, vk::ImageLayout::eGeneral };
+        imageInfos[1] = vk::DescriptorImageInfo { vk::Sampler { }, shading.normal.view,   vk::ImageLayout::eGeneral };
+        imageInfos[2] = vk::DescriptorImageInfo { vk::Sampler { }, shading.color.view,    vk::ImageLayout::eGeneral };
+        imageInfos[3] = vk::DescriptorImageInfo { vk::Sampler { }, shading.result.view,   vk::ImageLayout::eGeneral };
+        imageInfos[4] = vk::DescriptorImageInfo { vk::Sampler { }, shading.history.view,  vk::ImageLayout::eGeneral };
+
+    vk::DescriptorImageInfo shadowInfo = { shadows.sampler, shadows.view, vk::ImageLayout::eDepthStencilReadOnlyOptimal };
+
+    vk::WriteDescriptorSet descriptorWrites [11];
+    for (uint32_t i = 0; i < 11; ++i)
+        { // for each binding
+        descriptorWrites[i].dstSet           = pipelines.lighting.descriptorSet;
+        descriptorWrites[i].dstBinding       = i;
+        descriptorWrites[i].dstArrayElement  = 0;
+        descriptorWrites[i].descriptorType   = layoutBindings[i].descriptorType;
+        descriptorWrites[i].descriptorCount  = 1;
+
+        if (i == 0)
+            descriptorWrites[i].pBufferInfo = &bufferInfos[0];
+        else if (i < 5)
+            descriptorWrites[i].pImageInfo  = &imageInfos[i - 1];
+        else if (i < 8)
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i - 4];
+        else if (i == 8)
+            descriptorWrites[i].pImageInfo  = &imageInfos[4];
+        else if (i == 9)
+            descriptorWrites[i].pBufferInfo = &bufferInfos[4];
+        else
+            descriptorWrites[i].pImageInfo  = &shadowInfo;
+        } // for each binding
+
+    core.logicalDevice.updateDescriptorSets (11, descriptorWrites, 0, nullptr);
+
+    return result;
+    } // VulkanApp :: createLightingDescriptorSet
+
+
+//
+//  createLightingPipeline
+//
+//  the tile size is the workgroup size, so it's specialized into
+//  the shader along with the shading mask's width
+//
+vk::Result VulkanApp::createLightingPipeline ()
+    { // VulkanApp :: createLightingPipeline
+    vk::Result result = vk::Result::eSuccess;
+
+    if (!tiledLighting.supported)
+        return result;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = { };
+        pipelineLayoutCreateInfo.setLayoutCount         = 1;
+        pipelineLayoutCreateInfo.pSetLayouts            = &pipelines.lighting.descriptorLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+        pipelineLayoutCreateInfo.pPushConstantRanges    = nullptr;
+
+    result = core.logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelines.lighting.layout);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    uint32_t constants[] = { tiledLighting.tileSize, tiledLighting.tileSize, feedback.blocksPerRow };
+
+    vk::SpecializationMapEntry specializationEntries[] =
+        {
+        { 0, 0,                    sizeof(uint32_t) },
+        { 1, sizeof(uint32_t),     sizeof(uint32_t) },
+        { 2, sizeof(uint32_t) * 2, sizeof(uint32_t) }
+        };
+
+    vk::SpecializationInfo specializationInfo = { };
+        specializationInfo.mapEntryCount = 3;
+        specializationInfo.pMapEntries   = specializationEntries;
+        specializationInfo.dataSize      = sizeof(constants);
+        specializationInfo.pData         = constants;
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = { };
+        pipelineCreateInfo.stage  = VulkanShaders::loadShader(core.logicalDevice, "shaders/lighting.comp.spv", vk::ShaderStageFlagBits::eCompute);
+        pipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+        pipelineCreateInfo.layout = pipelines.lighting.layout;
+
+    result = core.logicalDevice.createComputePipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.lighting.pipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    VulkanShaders::tidy(core.logicalDevice);
+
+    return result;
+    } // VulkanApp :: createLightingPipeline
+
+
+//
+//  createMipDescriptorSets
+//
+//  a set for every level of the result below the first, binding it
+//  and the level above it as storage images, along with the normals
+//  that tell which texels of the first level are covered, and the
+//  tile list. Nothing is created if the result has no mip chain
+//
+vk::Result VulkanApp::createMipDescriptorSets ()
+    { // VulkanApp :: createMipDescriptorSets
+    vk::Result result = vk::Result::eSuccess;
+
+    if (mips.levels == 1)
+        return result;
+
+    vk::DescriptorSetLayoutBinding layoutBindings [4];
+    for (uint32_t i = 0; i < 4; ++i)
+        { // for each binding
+        layoutBindings[i].binding             = i;
+        layoutBindings[i].descriptorCount     = 1;
+        layoutBindings[i].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[i].pImmutableSamplers  = nullptr;
+        } // for each binding
+
+        // Source, Destination and Normals
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eStorageImage;
+        layoutBindings[1].descriptorType      = vk::DescriptorType::eStorageImage;
+        layoutBindings[2].descriptorType      = vk::DescriptorType::eStorageImage;
+
+        // Tiles
+        layoutBindings[3].descriptorType      = vk::DescriptorType::eStorageBuffer;
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
+        layoutCreateInfo.bindingCount  = 4;
+        layoutCreateInfo.pBindings     = layoutBindings;
+
+    result = core.logicalDevice.createDescriptorSetLayout(
+        &layoutCreateInfo,
+        nullptr,
+        &pipelines.mips.descriptorLayout);
+
+    if (result != vk::Result::eSuccess)
+        { // failed to create layout
+        std::cout << "Failed to create mip descriptor set layout" << std::endl;
+        return result;
+        } // failed to create layout
+
+    uint32_t sets = mips.levels - 1;
+    std::vector<vk::DescriptorSetLayout> layouts (sets, pipelines.mips.descriptorLayout);
+    pipelines.mips.descriptorSets.resize(sets);
+
+    vk::DescriptorSetAllocateInfo allocationInfo = { };
+        allocationInfo.descriptorPool      = pipelines.descriptorPool;
+        allocationInfo.descriptorSetCount  = sets;
+        allocationInfo.pSetLayouts         = layouts.data();
+
+    result = core.logicalDevice.allocateDescriptorSets(&allocationInfo, pipelines.mips.descriptorSets.data());
+    if (result != vk::Result::eSuccess)
+        { // failed to allocate set
+        std::cout << "Failed to create mip descriptor sets" << std::endl;
+        return result;
+        } // failed to allocate set
+
+    vk::DescriptorBufferInfo bufferInfo = { buffers.mipTiles.buffer, 0, VK_WHOLE_SIZE };
+
+    for (uint32_t l = 1; l < mips.levels; ++l)
+        { // for each level
+
+        // the first level leaves the attachment layout while the
+        // shader runs, see recordMipGeneration
+        vk::DescriptorImageInfo imageInfos [3];
+            imageInfos[0] = vk::DescriptorImageInfo { vk::Sampler { }, shading.result.levelViews[l - 1], vk::ImageLayout::eGeneral };
+            imageInfos[1] = vk::DescriptorImageInfo { vk::Sampler { }, shading.result.levelViews[l],     vk::ImageLayout::eGeneral };
+            imageInfos[2] = vk::DescriptorImageInfo { vk::Sampler { }, shading.normal.view,              vk::ImageLayout::eGeneral };
+
+        vk::WriteDescriptorSet descriptorWrites [4];
+        for (uint32_t i = 0; i < 4; ++i)
+            { // for each binding
+            descriptorWrites[i].dstSet           = pipelines.mips.descriptorSets[l - 1];
+            descriptorWrites[i].dstBinding       = i;
+            descriptorWrites[i].dstArrayElement  = 0;
+            descriptorWrites[i].descriptorType   = layoutBindings[i].descriptorType;
+            descriptorWrites[i].descriptorCount  = 1;
+
+            if (i < 3)
+                descriptorWrites[i].pImageInfo  = &imageInfos[i];
+            else
+                descriptorWrites[i].pBufferInfo = &bufferInfo;
+            } // for each binding
+
+        core.logicalDevice.updateDescriptorSets (4, descriptorWrites, 0, nullptr);
+        } // for each level
+
+    return result;
+    } // VulkanApp :: createMipDescriptorSets
+
+
+//
+//  createMipPipeline
+//
+vk::Result VulkanApp::createMipPipeline ()
+    { // VulkanApp :: createMipPipeline
+    vk::Result result = vk::Result::eSuccess;
+
+    if (mips.levels == 1)
+        return result;
+
+    // each level is averaged by its own dispatch, which is told where
+    // its tiles start and whether it reads the first level through
+    // push constants
+    vk::PushConstantRange pushConstantRange = { };
+        pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+        pushConstantRange.offset     = 0;
+        pushConstantRange.size       = sizeof(uint32_t) * 2;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = { };
+        pipelineLayoutCreateInfo.setLayoutCount         = 1;
+        pipelineLayoutCreateInfo.pSetLayouts            = &pipelines.mips.descriptorLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges    = &pushConstantRange;
+
+    result = core.logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelines.mips.layout);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = { };
+        pipelineCreateInfo.stage  = VulkanShaders::loadShader(core.logicalDevice, "shaders/downsample.comp.spv", vk::ShaderStageFlagBits::eCompute);
+        pipelineCreateInfo.layout = pipelines.mips.layout;
+
+    result = core.logicalDevice.createComputePipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.mips.pipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    VulkanShaders::tidy(core.logicalDevice);
+
+    return result;
+    } // VulkanApp :: createMipPipeline
+
+
+//
+//  createOcclusionDescriptorSet
+//
+//  binds the depth buffer and the pyramid for the reduction shader.
+//  The culling shader reads the pyramid whether or not the device
+//  can build it, so its binding is always written
+//
+vk::Result VulkanApp::createOcclusionDescriptorSet ()
+    { // VulkanApp :: createOcclusionDescriptorSet
+    vk::Result result = vk::Result::eSuccess;
+
+    if (!occlusion.supported)
+        {
+        writeOcclusionDescriptors();
+        return result;
+        }
+
+    vk::SamplerCreateInfo samplerCreateInfo = { };
+        samplerCreateInfo.minFilter        = vk::Filter::eNearest;
+        samplerCreateInfo.magFilter        = vk::Filter::eNearest;
+        samplerCreateInfo.mipmapMode       = vk::SamplerMipmapMode::eNearest;
+        samplerCreateInfo.addressModeU     = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeV     = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeW     = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.mipLodBias       = 0.0f;
+        samplerCreateInfo.anisotropyEnable = VK_FALSE;
+        samplerCreateInfo.maxAnisotropy    = 1.0f;
+        samplerCreateInfo.compareEnable    = VK_FALSE;
+        samplerCreateInfo.compareOp        = vk::CompareOp::eNever;
+        samplerCreateInfo.minLod           = 0.0f;
+        samplerCreateInfo.maxLod           = 0.0f;
+        samplerCreateInfo.borderColor      = vk::BorderColor::eFloatOpaqueWhite;
+
+    result = core.logicalDevice.createSampler(&samplerCreateInfo, nullptr, &occlusion.sampler);
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::DescriptorSetLayoutBinding layoutBindings [2];
+
+        // Depth Buffer
+        layoutBindings[0].binding             = 0;
+        layoutBindings[0].descriptorCount     = 1;
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eCombinedImageSampler;
+        layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[0].pImmutableSamplers  = nullptr;
+
+        // Depth Pyramid
+        layoutBindings[1].binding             = 1;
+        layoutBindings[1].descriptorCount     = 1;
+        layoutBindings[1].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[1].stageFlags          = vk::ShaderStageFlagBits::eCompute;
+        layoutBindings[1].pImmutableSamplers  = nullptr;
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
+        layoutCreateInfo.bindingCount  = 2;
+        layoutCreateInfo.pBindings     = layoutBindings;
+
+    result = core.logicalDevice.createDescriptorSetLayout(
+        &layoutCreateInfo,
+        nullptr,
+        &pipelines.occlusion.descriptorLayout);
+
+    if (result != vk::Result::eSuccess)
+        { // failed to create layout
+        std::cout << "Failed to create occlusion descriptor set layout" << std::endl;
+        return result;
+        } // failed to create layout
+
+    vk::DescriptorSetAllocateInfo allocationInfo = { };
+        allocationInfo.descriptorPool      = pipelines.descriptorPool;
+        allocationInfo.descriptorSetCount  = 1;
+        allocationInfo.pSetLayouts         = &pipelines.occlusion.descriptorLayout;
+
+    result = core.logicalDevice.allocateDescriptorSets(&allocationInfo, &pipelines.occlusion.descriptorSet);
+    if (result != vk::Result::eSuccess)
+        { // failed to allocate set
+        std::cout << "Failed to create occlusion descriptor set" << std::endl;
+        return result;
+        } // failed to allocate set
+
+    writeOcclusionDescriptors();
+
+    return result;
+    } // VulkanApp :: createOcclusionDescriptorSet
+
+
+//
+//  writeOcclusionDescriptors
+//
+//  points the descriptors at the current depth buffer and pyramid,
+//  which are replaced whenever the swapchain is
+//
+void VulkanApp::writeOcclusionDescriptors ()
+    { // VulkanApp :: writeOcclusionDescriptors
+
+    vk::DescriptorBufferInfo pyramidInfo = { buffers.depthPyramid.buffer, 0, VK_WHOLE_SIZE };
+
+    vk::DescriptorImageInfo depthInfo = { };
+        depthInfo.imageLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+        depthInfo.imageView   = depth.view;
+        depthInfo.sampler     = occlusion.sampler;
+
+    vk::WriteDescriptorSet descriptorWrites [3];
+
+        // Culling Depth Pyramid
+        descriptorWrites[0].dstSet           = pipelines.culling.descriptorSet;
+        descriptorWrites[0].dstBinding       = 5;
+        descriptorWrites[0].dstArrayElement  = 0;
+        descriptorWrites[0].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[0].descriptorCount  = 1;
+        descriptorWrites[0].pBufferInfo      = &pyramidInfo;
+
+        // Depth Buffer
+        descriptorWrites[1].dstSet           = pipelines.occlusion.descriptorSet;
+        descriptorWrites[1].dstBinding       = 0;
+        descriptorWrites[1].dstArrayElement  = 0;
+        descriptorWrites[1].descriptorType   = vk::DescriptorType::eCombinedImageSampler;
+        descriptorWrites[1].descriptorCount  = 1;
+        descriptorWrites[1].pImageInfo       = &depthInfo;
+
+        // Depth Pyramid
+        descriptorWrites[2].dstSet           = pipelines.occlusion.descriptorSet;
+        descriptorWrites[2].dstBinding       = 1;
+        descriptorWrites[2].dstArrayElement  = 0;
+        descriptorWrites[2].descriptorType   = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[2].descriptorCount  = 1;
+        descriptorWrites[2].pBufferInfo      = &pyramidInfo;
+
+    core.logicalDevice.updateDescriptorSets (occlusion.supported ? 3 : 1, descriptorWrites, 0, nullptr);
+
+    } // VulkanApp :: writeOcclusionDescriptors
+
+
+//
+//  createOcclusionPipeline
+//
+vk::Result VulkanApp::createOcclusionPipeline ()
+    { // VulkanApp :: createOcclusionPipeline
+    vk::Result result = vk::Result::eSuccess;
+
+    if (!occlusion.supported)
+        return result;
+
+    // each level is reduced by its own dispatch, which is told the
+    // source and destination levels through push constants
+    vk::PushConstantRange pushConstantRange = { };
+        pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+        pushConstantRange.offset     = 0;
+        pushConstantRange.size       = sizeof(glm::uvec4) * 2;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = { };
+        pipelineLayoutCreateInfo.setLayoutCount         = 1;
+        pipelineLayoutCreateInfo.pSetLayouts            = &pipelines.occlusion.descriptorLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+        pipelineLayoutCreateInfo.pPushConstantRanges    = &pushConstantRange;
+
+    result = core.logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelines.occlusion.layout);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = { };
+        pipelineCreateInfo.stage  = VulkanShaders::loadShader(core.logicalDevice, "shaders/hiz.comp.spv", vk::ShaderStageFlagBits::eCompute);
+        pipelineCreateInfo.layout = pipelines.occlusion.layout;
+
+    result = core.logicalDevice.createComputePipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.occlusion.pipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    VulkanShaders::tidy(core.logicalDevice);
+
+    return result;
+    } // VulkanApp :: createOcclusionPipeline
+
+
+//
+//  createShadowMaps
+//
+//  the depth the light sees, in two layers of one image, with a view
+//  of each to draw into and one of both for the lighting to sample
+//  through a sampler that never blends depths together
+//
+vk::Result VulkanApp::createShadowMaps ()
+    { // VulkanApp :: createShadowMaps
+    vk::Result result = vk::Result::eSuccess;
+
+    // every device samples 16 bit depth, but a frustum as deep as the
+    // scene bands with it, so 32 bit is taken wherever it's sampled
+    vk::FormatFeatureFlags sampledDepth = vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage;
+
+    vk::FormatProperties properties;
+    core.physicalDevice.getFormatProperties(vk::Format::eD32Sfloat, &properties);
+
+    if ((properties.optimalTilingFeatures & sampledDepth) == sampledDepth)
+        shadows.format = vk::Format::eD32Sfloat;
+
+    // everything is taken to have kept still until it first moves
+    shadows.stillFrames.assign(nObjects, 0xffffffff);
+    shadows.dynamic.assign(nObjects, 0);
+
+    vk::ImageCreateInfo createInfo = { };
+        createInfo.imageType             = vk::ImageType::e2D;
+        createInfo.format                = shadows.format;
+        createInfo.extent.width          = ShadowState::SIZE;
+        createInfo.extent.height         = ShadowState::SIZE;
+        createInfo.extent.depth          = 1;
+        createInfo.mipLevels             = 1;
+        createInfo.arrayLayers           = ShadowState::eLayerCount;
+        createInfo.samples               = vk::SampleCountFlagBits::e1;
+        createInfo.tiling                = vk::ImageTiling::eOptimal;
+        createInfo.initialLayout         = vk::ImageLayout::eUndefined;
+        createInfo.usage                 = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
+        createInfo.queueFamilyIndexCount = 0;
+        createInfo.pQueueFamilyIndices   = nullptr;
+        createInfo.sharingMode           = vk::SharingMode::eExclusive;
+
+    result = core.logicalDevice.createImage(&createInfo, nullptr, &shadows.image);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::MemoryRequirements memoryRequirements = { };
+        core.logicalDevice.getImageMemoryRequirements(shadows.image, &memoryRequirements);
+
+    vk::MemoryAllocateInfo allocationInfo = { };
+        allocationInfo.allocationSize  = memoryRequirements.size;
+        allocationInfo.memoryTypeIndex = VulkanHelpers::findMemoryType(core.physicalDevice, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    result = core.logicalDevice.allocateMemory(&allocationInfo, nullptr, &shadows.memory);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    core.logicalDevice.bindImageMemory(shadows.image, shadows.memory, 0);
+
+    vk::ImageViewCreateInfo viewCreateInfo = { };
+        viewCreateInfo.image                           = shadows.image;
+        viewCreateInfo.format                          = shadows.format;
+        viewCreateInfo.components.r                    = vk::ComponentSwizzle::eR;
+        viewCreateInfo.components.g                    = vk::ComponentSwizzle::eG;
+        viewCreateInfo.components.b                    = vk::ComponentSwizzle::eB;
+        viewCreateInfo.components.a                    = vk::ComponentSwizzle::eA;
+        viewCreateInfo.subresourceRange.aspectMask     = vk::ImageAspectFlagBits::eDepth;
+        viewCreateInfo.subresourceRange.baseMipLevel   = 0;
+        viewCreateInfo.subresourceRange.levelCount     = 1;
+        viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        viewCreateInfo.subresourceRange.layerCount     = ShadowState::eLayerCount;
+        viewCreateInfo.viewType                        = vk::ImageViewType::e2DArray;
+
+    result = core.logicalDevice.createImageView(&viewCreateInfo, nullptr, &shadows.view);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    for (uint32_t l = 0; l < ShadowState::eLayerCount; ++l)
+        { // for each layer
+        viewCreateInfo.subresourceRange.baseArrayLayer = l;
+        viewCreateInfo.subresourceRange.layerCount     = 1;
+        viewCreateInfo.viewType                        = vk::ImageViewType::e2D;
+
+        result = core.logicalDevice.createImageView(&viewCreateInfo, nullptr, &shadows.layerViews[l]);
+
+        if (result != vk::Result::eSuccess)
+            return result;
+        } // for each layer
+
+    // the filter is done in the shader, a depth comparison at a time
+    vk::SamplerCreateInfo samplerCreateInfo = { };
+        samplerCreateInfo.minFilter        = vk::Filter::eNearest;
+        samplerCreateInfo.magFilter        = vk::Filter::eNearest;
+        samplerCreateInfo.mipmapMode       = vk::SamplerMipmapMode::eNearest;
+        samplerCreateInfo.addressModeU     = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeV     = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.addressModeW     = vk::SamplerAddressMode::eClampToEdge;
+        samplerCreateInfo.mipLodBias       = 0.0f;
+        samplerCreateInfo.anisotropyEnable = VK_FALSE;
+        samplerCreateInfo.maxAnisotropy    = 1.0f;
+        samplerCreateInfo.compareEnable    = VK_FALSE;
+        samplerCreateInfo.compareOp        = vk::CompareOp::eNever;
+        samplerCreateInfo.minLod           = 0.0f;
+        samplerCreateInfo.maxLod           = 0.0f;
+        samplerCreateInfo.borderColor      = vk::BorderColor::eFloatOpaqueWhite;
+
+    result = core.logicalDevice.createSampler(&samplerCreateInfo, nullptr, &shadows.sampler);
+
+    return result;
+    } // VulkanApp :: createShadowMaps
+
+
+//
+//  createShadowRenderPass
+//
+//  a depth only pass drawing one layer, with a framebuffer for each,
+//  which are both cleared the once here so that nothing is shadowed
+//  before the first shading pass has drawn them
+//
+vk::Result VulkanApp::createShadowRenderPass ()
+    { // VulkanApp :: createShadowRenderPass
+    vk::Result result = vk::Result::eSuccess;
+
+    // a layer is cleared whatever it last held, and left ready for
+    // the lighting to sample
+    vk::AttachmentDescription attachmentDescription = { };
+        attachmentDescription.format          = shadows.format;
+        attachmentDescription.samples         = vk::SampleCountFlagBits::e1;
+        attachmentDescription.loadOp          = vk::AttachmentLoadOp::eClear;
+        attachmentDescription.storeOp         = vk::AttachmentStoreOp::eStore;
+        attachmentDescription.stencilLoadOp   = vk::AttachmentLoadOp::eDontCare;
+        attachmentDescription.stencilStoreOp  = vk::AttachmentStoreOp::eDontCare;
+        attachmentDescription.initialLayout   = vk::ImageLayout::eUndefined;
+        attachmentDescription.finalLayout     = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+
+    vk::AttachmentReference depthAttachment = { 0, vk::ImageLayout::eDepthStencilAttachmentOptimal };
+
+    vk::SubpassDescription subpass = { };
+        subpass.pipelineBindPoint       = vk::PipelineBindPoint::eGraphics;
+        subpass.colorAttachmentCount    = 0;
+        subpass.pDepthStencilAttachment = &depthAttachment;
+
+    // the last pass's lighting has to be done reading a layer before
+    // it's cleared, and this pass's waits for it to be drawn, by the
+    // subpass or by the tiled shader
+    vk::SubpassDependency dependencies [2];
+        dependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass    = 0;
+        dependencies[0].srcStageMask  = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+        dependencies[0].dstStageMask  = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependencies[0].srcAccessMask = vk::AccessFlagBits::eShaderRead;
+        dependencies[0].dstAccessMask =
+            vk::AccessFlagBits::eDepthStencilAttachmentRead |
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+        dependencies[1].srcSubpass    = 0;
+        dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask  = vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependencies[1].dstStageMask  = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+        dependencies[1].srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    vk::RenderPassCreateInfo createInfo = { };
+        createInfo.attachmentCount = 1;
+        createInfo.pAttachments    = &attachmentDescription;
+        createInfo.subpassCount    = 1;
+        createInfo.pSubpasses      = &subpass;
+        createInfo.dependencyCount = 2;
+        createInfo.pDependencies   = dependencies;
+
+    result = core.logicalDevice.createRenderPass(&createInfo, nullptr, &pipelines.shadows.renderPass);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    for (uint32_t l = 0; l < ShadowState::eLayerCount; ++l)
+        { // for each layer
+        vk::FramebufferCreateInfo framebufferCreateInfo = { };
+            framebufferCreateInfo.renderPass      = pipelines.shadows.renderPass;
+            framebufferCreateInfo.attachmentCount = 1;
+            framebufferCreateInfo.pAttachments    = &shadows.layerViews[l];
+            framebufferCreateInfo.width           = ShadowState::SIZE;
+            framebufferCreateInfo.height          = ShadowState::SIZE;
+            framebufferCreateInfo.layers          = 1;
+
+        result = core.logicalDevice.createFramebuffer(&framebufferCreateInfo, nullptr, &shadows.framebuffers[l]);
+
+        if (result != vk::Result::eSuccess)
+            return result;
+        } // for each layer
+
+    vk::ClearValue clearValue;
+        clearValue.depthStencil = vk::ClearDepthStencilValue { 1.0f, 0 };
+
+    vk::RenderPassBeginInfo renderPassBeginInfo = { };
+        renderPassBeginInfo.renderPass        = pipelines.shadows.renderPass;
+        renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
+        renderPassBeginInfo.renderArea.extent = vk::Extent2D { ShadowState::SIZE, ShadowState::SIZE };
+        renderPassBeginInfo.clearValueCount   = 1;
+        renderPassBeginInfo.pClearValues      = &clearValue;
+
+    vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
+
+    for (uint32_t l = 0; l < ShadowState::eLayerCount; ++l)
+        {
+        renderPassBeginInfo.framebuffer = shadows.framebuffers[l];
+        commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+        commandBuffer.endRenderPass();
+        }
+
+    VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
+
+    return result;
+    } // VulkanApp :: createShadowRenderPass
+
+
+//
+//  createShadowDescriptorSet
+//
+//  the shading uniforms, for the light's frustum, and the objects'
+//  transforms, which are all the shadow pass draws with
+//
+vk::Result VulkanApp::createShadowDescriptorSet ()
+    { // VulkanApp :: createShadowDescriptorSet
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::DescriptorSetLayoutBinding layoutBindings [2];
+
+        // Uniform Buffer
+        layoutBindings[0].binding             = 0;
+        layoutBindings[0].descriptorCount     = 1;
+        layoutBindings[0].descriptorType      = vk::DescriptorType::eUniformBuffer;
+        layoutBindings[0].stageFlags          = vk::ShaderStageFlagBits::eVertex;
+        layoutBindings[0].pImmutableSamplers  = nullptr;
+
+        // Objects
+        layoutBindings[1].binding             = 1;
+        layoutBindings[1].descriptorCount     = 1;
+        layoutBindings[1].descriptorType      = vk::DescriptorType::eStorageBuffer;
+        layoutBindings[1].stageFlags          = vk::ShaderStageFlagBits::eVertex;
+        layoutBindings[1].pImmutableSamplers  = nullptr;
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = { };
+        layoutCreateInfo.bindingCount  = 2;
+        layoutCreateInfo.pBindings     = layoutBindings;
+
+    result = core.logicalDevice.createDescriptorSetLayout(
+        &layoutCreateInfo,
+        nullptr,
+        &pipelines.shadows.descriptorLayout);
+
+    if (result != vk::Result::eSuccess)
+        { // failed to create layout
+        std::cout << "Failed to create shadow descriptor set layout" << std::endl;
+        return result;
+        } // failed to create layout
+
+    vk::DescriptorSetAllocateInfo allocationInfo = { };
+        allocationInfo.descriptorPool      = pipelines.descriptorPool;
+        allocationInfo.descriptorSetCount  = 1;
+        allocationInfo.pSetLayouts         = &pipelines.shadows.descriptorLayout;
+
+    result = core.logicalDevice.allocateDescriptorSets(&allocationInfo, &pipelines.shadows.descriptorSet);
+    if (result != vk::Result::eSuccess)
+        { // failed to allocate set
+        std::cout << "Failed to create shadow descriptor set" << std::endl;
+        return result;
+        } // failed to allocate set
+
+    vk::DescriptorBufferInfo bufferInfos [2];
+        bufferInfos[0] = vk::DescriptorBufferInfo { buffers.shadingUniform.buffer, 0, sizeof(UniformBufferObjects::ShadingUBO) };
+        bufferInfos[1] = vk::DescriptorBufferInfo { buffers.shadingObjects.buffer, 0, VK_WHOLE_SIZE };
+
+    vk::WriteDescriptorSet descriptorWrites [2];
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each binding
+        descriptorWrites[i].dstSet           = pipelines.shadows.descriptorSet;
+        descriptorWrites[i].dstBinding       = i;
+        descriptorWrites[i].dstArrayElement  = 0;
+        descriptorWrites[i].descriptorType   = layoutBindings[i].descriptorType;
+        descriptorWrites[i].descriptorCount  = 1;
+        descriptorWrites[i].pBufferInfo      = &bufferInfos[i];
+        } // for each binding
+
+    core.logicalDevice.updateDescriptorSets (2, descriptorWrites, 0, nullptr);
+
+    return result;
+    } // VulkanApp :: createShadowDescriptorSet
+
+
+//
+//  createShadowPipeline
+//
+//  draws the scene's depth from the light with no fragment shader,
+//  biased by the slope of each triangle so lit surfaces don't end
+//  up behind their own depth when they're looked up
+//
+vk::Result VulkanApp::createShadowPipeline ()
+    { // VulkanApp :: createShadowPipeline
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::PipelineShaderStageCreateInfo shaderStage = VulkanShaders::loadShader(core.logicalDevice, "shaders/shadow.vert.spv", vk::ShaderStageFlagBits::eVertex);
+
+    vk::VertexInputBindingDescription inputBinding = { };
+        inputBinding.binding    = 0;
+        inputBinding.stride     = sizeof(Vertex);
+        inputBinding.inputRate  = vk::VertexInputRate::eVertex;
+
+    // only the position and the object id are read
+    std::array<vk::VertexInputAttributeDescription, 5> attributes = Vertex::attributeDescriptions();
+    vk::VertexInputAttributeDescription shadowAttributes[] = { attributes[0], attributes[4] };
+
+    vk::PipelineVertexInputStateCreateInfo vertexInputInfo = { };
+        vertexInputInfo.vertexBindingDescriptionCount   = 1;
+        vertexInputInfo.vertexAttributeDescriptionCount = 2;
+
+        vertexInputInfo.pVertexBindingDescriptions      = &inputBinding;
+        vertexInputInfo.pVertexAttributeDescriptions    = shadowAttributes;
+
+    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo = { };
+        inputAssemblyInfo.topology = vk::PrimitiveTopology::eTriangleList;
+        inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+    vk::Viewport viewport = { };
+        viewport.x        = 0.0f;
+        viewport.y        = 0.0f;
+        viewport.width    = (float)ShadowState::SIZE;
+        viewport.height   = (float)ShadowState::SIZE;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+    vk::Rect2D scissor = { };
+        scissor.offset.x      = 0;
+        scissor.offset.y      = 0;
+        scissor.extent.width  = ShadowState::SIZE;
+        scissor.extent.height = ShadowState::SIZE;
+
+    vk::PipelineViewportStateCreateInfo viewportCreateInfo = { };
+        viewportCreateInfo.viewportCount = 1;
+        viewportCreateInfo.pViewports    = &viewport;
+        viewportCreateInfo.scissorCount  = 1;
+        viewportCreateInfo.pScissors     = &scissor;
+
+    // both faces are drawn, as the light may see into the mesh
+    vk::PipelineRasterizationStateCreateInfo rasterizationCreateInfo = { };
+        rasterizationCreateInfo.depthClampEnable        = VK_FALSE;
+        rasterizationCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+        rasterizationCreateInfo.polygonMode             = vk::PolygonMode::eFill;
+        rasterizationCreateInfo.lineWidth               = 1.0f;
+        rasterizationCreateInfo.cullMode                = vk::CullModeFlagBits::eNone;
+        rasterizationCreateInfo.frontFace               = vk::FrontFace::eCounterClockwise;
+        rasterizationCreateInfo.depthBiasEnable         = VK_TRUE;
+        rasterizationCreateInfo.depthBiasConstantFactor = 1.25f;
+        rasterizationCreateInfo.depthBiasClamp          = 0.0f;
+        rasterizationCreateInfo.depthBiasSlopeFactor    = 1.75f;
+
+    vk::PipelineMultisampleStateCreateInfo multisampleCreateInfo = { };
+        multisampleCreateInfo.sampleShadingEnable   = VK_FALSE;
+        multisampleCreateInfo.rasterizationSamples  = vk::SampleCountFlagBits::e1;
+        multisampleCreateInfo.minSampleShading      = 1.0f;
+        multisampleCreateInfo.pSampleMask           = nullptr;
+        multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
+        multisampleCreateInfo.alphaToOneEnable      = VK_FALSE;
+
+    vk::PipelineDepthStencilStateCreateInfo depthStencilCreateInfo = { };
+        depthStencilCreateInfo.depthTestEnable       = VK_TRUE;
+        depthStencilCreateInfo.depthWriteEnable      = VK_TRUE;
+        depthStencilCreateInfo.depthCompareOp        = vk::CompareOp::eLess;
+        depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+        depthStencilCreateInfo.minDepthBounds        = 0.0f;
+        depthStencilCreateInfo.maxDepthBounds        = 1.0f;
+        depthStencilCreateInfo.stencilTestEnable     = VK_FALSE;
+
+    vk::PipelineColorBlendStateCreateInfo colorBlendCreateInfo = { };
+        colorBlendCreateInfo.logicOpEnable   = VK_FALSE;
+        colorBlendCreateInfo.attachmentCount = 0;
+        colorBlendCreateInfo.pAttachments    = nullptr;
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = { };
+        pipelineLayoutCreateInfo.setLayoutCount         = 1;
+        pipelineLayoutCreateInfo.pSetLayouts            = &pipelines.shadows.descriptorLayout;
+        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+        pipelineLayoutCreateInfo.pPushConstantRanges    = nullptr;
+
+    result = core.logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelines.shadows.layout);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::GraphicsPipelineCreateInfo pipelineCreateInfo = { };
+        pipelineCreateInfo.stageCount           = 1;
+        pipelineCreateInfo.pStages              = &shaderStage;
+        pipelineCreateInfo.pVertexInputState    = &vertexInputInfo;
+        pipelineCreateInfo.pInputAssemblyState  = &inputAssemblyInfo;
+        pipelineCreateInfo.pViewportState       = &viewportCreateInfo;
+        pipelineCreateInfo.pRasterizationState  = &rasterizationCreateInfo;
+        pipelineCreateInfo.pMultisampleState    = &multisampleCreateInfo;
+        pipelineCreateInfo.pDepthStencilState   = &depthStencilCreateInfo;
+        pipelineCreateInfo.pColorBlendState     = &colorBlendCreateInfo;
+        pipelineCreateInfo.pDynamicState        = nullptr;
+        pipelineCreateInfo.layout               = pipelines.shadows.layout;
+        pipelineCreateInfo.renderPass           = pipelines.shadows.renderPass;
+        pipelineCreateInfo.subpass              = 0;
+
+    result = core.logicalDevice.createGraphicsPipelines(vk::PipelineCache {}, 1, &pipelineCreateInfo, nullptr, &pipelines.shadows.pipeline);
+
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    VulkanShaders::tidy(core.logicalDevice);
+
+    return result;
+    } // VulkanApp :: createShadowPipeline
+
+
+//
+//  createShadingCache
+//
+//  the staging buffer the result passes through on its way to and
+//  from disk, and the copy of every level into it, which is only
+//  ever submitted the once so is recorded up front
+//
+vk::Result VulkanApp::createShadingCache ()
+    { // VulkanApp :: createShadingCache
+    vk::Result result = vk::Result::eSuccess;
+
+    // texels are compressed as a word each
+    shadingCache.enabled = pipelines.shading.format == vk::Format::eR16G16B16A16Sfloat;
+    if (!shadingCache.enabled)
+        return result;
+
+    shadingCache.scene = ShadingCache::hash(meshes.scene.vertices.data(), sizeof(Vertex) * meshes.scene.vertices.size());
+    shadingCache.scene = ShadingCache::hash(meshes.scene.indices.data(), sizeof(uint32_t) * meshes.scene.indices.size(), shadingCache.scene);
+
+    shadingCache.regions.clear();
+    shadingCache.texels = 0;
+    for (uint32_t l = 0; l < mips.levels; ++l)
+        { // for each level
+        uint32_t side = shading.BUFFER_SIZE >> l;
+
+        vk::BufferImageCopy region = { };
+            region.bufferOffset      = sizeof(uint64_t) * shadingCache.texels;
+            region.bufferRowLength   = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource  = vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, l, 0, 1 };
+            region.imageOffset       = vk::Offset3D { 0, 0, 0 };
+            region.imageExtent       = vk::Extent3D { side, side, 1 };
+
+        shadingCache.regions.push_back(region);
+        shadingCache.texels += (uint64_t)side * side;
+        } // for each level
+
+    createBuffer(
+        sizeof(uint64_t) * shadingCache.texels,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        buffers.shadingCache.buffer,
+        buffers.shadingCache.memory);
+
+    vk::CommandBufferAllocateInfo allocationInfo = { };
+        allocationInfo.commandPool        = command.pool;
+        allocationInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocationInfo.commandBufferCount = 1;
+
+    result = core.logicalDevice.allocateCommandBuffers(&allocationInfo, &shadingCache.readback);
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    vk::CommandBuffer& commandBuffer = shadingCache.readback;
+    commandBuffer.begin(&beginInfo);
+
+    // it follows the shading commands in the same submission, so it
+    // only has to wait on what they wrote. The first level is left
+    // as an attachment between passes, the rest are only ever storage
+    vk::ImageMemoryBarrier barriers [2];
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each part of the chain
+        barriers[i].srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eShaderWrite;
+        barriers[i].dstAccessMask       = vk::AccessFlagBits::eTransferRead;
+        barriers[i].oldLayout           = (i == 0) ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eGeneral;
+        barriers[i].newLayout           = (i == 0) ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::eGeneral;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].image               = shading.result.image;
+        barriers[i].subresourceRange    = (i == 0)
+            ? vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 }
+            : vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 1, mips.levels - 1, 0, 1 };
+        } // for each part of the chain
+
+    uint32_t parts = (mips.levels > 1) ? 2 : 1;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, parts, barriers);
+
+    commandBuffer.copyImageToBuffer(shading.result.image, vk::ImageLayout::eTransferSrcOptimal, buffers.shadingCache.buffer, 1, &shadingCache.regions[0]);
+    if (mips.levels > 1)
+        commandBuffer.copyImageToBuffer(shading.result.image, vk::ImageLayout::eGeneral, buffers.shadingCache.buffer, mips.levels - 1, &shadingCache.regions[1]);
+
+    // the next pass draws to the first level again, while the host
+    // reads the copy once the fence of this submission has signalled
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each part of the chain
+        barriers[i].srcAccessMask = vk::AccessFlagBits::eTransferRead;
+        barriers[i].dstAccessMask = (i == 0)
+            ? vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite
+            : vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        std::swap(barriers[i].oldLayout, barriers[i].newLayout);
+        } // for each part of the chain
+
+    vk::MemoryBarrier copied = { };
+        copied.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        copied.dstAccessMask = vk::AccessFlagBits::eHostRead;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags { }, 1, &copied, 0, nullptr, parts, barriers);
+
+    commandBuffer.end();
+
+    return result;
+    } // VulkanApp :: createShadingCache
+
+
+//
+//  createShadingCommandBuffers
+//
+//  sets up a graphics command buffer for fulfilling
+//  our rendering needs, if we require compute we'll
+//  need (ideally) another command buffer
+//
+vk::Result VulkanApp::createShadingCommandBuffers ()
+    { // VulkanApp :: createShadingCommandBuffers
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::CommandBufferAllocateInfo allocationInfo = { };
+        allocationInfo.commandPool        = command.pool;
+        allocationInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocationInfo.commandBufferCount = 1;
+  
+    result = core.logicalDevice.allocateCommandBuffers(&allocationInfo, &shading.commandBuffer);
+  
+    if (result != vk::Result::eSuccess)
+        return result;
+    
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+        beginInfo.pInheritanceInfo = nullptr;
+
+    // we define a clear value for our colour buffer and our
+    // stencil buffer so they can be reset at the start of render
+    vk::ClearColorValue color = { WINDOW_CLEAR };
+    vk::ClearDepthStencilValue depth = { 1.0f, 0 };
+    
+    std::array<vk::ClearValue, 5> clearValues = {};
+        clearValues[0].color        = color;
+        clearValues[1].color        = color;
+        clearValues[2].color        = color;
+        clearValues[3].color        = color;
+        clearValues[4].depthStencil = vk::ClearDepthStencilValue { 1.0f, 0 };
+
+    vk::RenderPassBeginInfo renderPassBeginInfo = { };
+        renderPassBeginInfo.renderPass        = pipelines.shading.renderPass;
+        renderPassBeginInfo.framebuffer       = shading.framebuffer;
+        renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
+        renderPassBeginInfo.renderArea.extent.width = shading.BUFFER_SIZE;
+		renderPassBeginInfo.renderArea.extent.height = shading.BUFFER_SIZE;
+        renderPassBeginInfo.clearValueCount   = 5;
+        renderPassBeginInfo.pClearValues      = clearValues.data();
+    
+    vk::DeviceSize offsets[] = { 0 };
+
+    vk::Rect2D atlas = { vk::Offset2D { 0, 0 }, vk::Extent2D { shading.BUFFER_SIZE, shading.BUFFER_SIZE } };
+    
+    shading.commandBuffer.begin(&beginInfo);
+    recordFeedbackDilation(shading.commandBuffer);
+    recordShadowLayers(shading.commandBuffer, true);
+    shading.commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+    
+        //  Subpass One: Populate geometry buffers in preperation for lighting computation
+        shading.commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryPipeline);
+        shading.commandBuffer.bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
+        shading.commandBuffer.bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
+        shading.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryLayout, 0, 1, &pipelines.shading.geometryDescriptorSet, 0, nullptr);
+        shading.commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.scene.indices.size()), 1, 0, 0, 0);
+
+		shading.commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+       
+        //  Subpass Two: Compute lighting and store in buffer
+        shading.commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.shadingPipeline);
+        shading.commandBuffer.bindVertexBuffers(0, 1, &buffers.quadVertex.buffer, offsets);
+        shading.commandBuffer.bindIndexBuffer(buffers.quadIndex.buffer, 0, vk::IndexType::eUint32);
+        shading.commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.shadingLayout, 0, 1, &pipelines.shading.shadingDescriptorSet, 0, nullptr);
+        shading.commandBuffer.setScissor(0, 1, &atlas);
+        shading.commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.quad.indices.size()), 1, 0, 0, 0);
+
+    shading.commandBuffer.endRenderPass();
+
+    // every tile is lit, so the whole mip chain is averaged again
+    recordMipGeneration(shading.commandBuffer, true);
+
+    shading.commandBuffer.end();
+
+    return result;
+        
+    } // VulkanApp :: createShadingCommandBuffers
+
+
+//
+//  createRasterCommandBuffers
+//
+//  sets up a graphics command buffer for fulfilling
+//  our rendering needs, if we require compute we'll
+//  need (ideally) another command buffer
+//
+vk::Result VulkanApp::createRasterCommandBuffers ()
+    { // VulkanApp :: createRasterCommandBuffers
+    vk::Result result = vk::Result::eSuccess;
+
+    swapchain.commandBuffers.resize(swapchain.nImages);
+    
+    vk::CommandBufferAllocateInfo allocationInfo = { };
+        allocationInfo.commandPool        = command.pool;
+        allocationInfo.level              = vk::CommandBufferLevel::ePrimary;
+        allocationInfo.commandBufferCount = swapchain.nImages;
+  
+    result = core.logicalDevice.allocateCommandBuffers(&allocationInfo, swapchain.commandBuffers.data());
+  
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    // once we allocate our memory we can initialize a command
+    // buffer for each swapchain image
+    for (uint32_t i = 0; i < swapchain.nImages; ++i)
+        { // for each swapchain image
+        
+        vk::CommandBufferBeginInfo beginInfo = { };
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+            beginInfo.pInheritanceInfo = nullptr;
+        swapchain.commandBuffers[i].begin(&beginInfo);
+
+        // we define a clear value for our colour buffer and our
+        // stencil buffer so they can be reset at the start of render
+        vk::ClearColorValue color = { WINDOW_CLEAR };
+        vk::ClearDepthStencilValue depth = { 1.0f, 0 };
+        
+        std::array<vk::ClearValue, 3> clearValues = {};
+            clearValues[0].color        = color;
+            clearValues[1].color        = color;
+            clearValues[2].depthStencil = depth;
+
+        vk::RenderPassBeginInfo renderPassBeginInfo = { };
+            renderPassBeginInfo.renderPass        = pipelines.raster.renderPass;
+            renderPassBeginInfo.framebuffer       = swapchain.framebuffers[i];
+            renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
+            renderPassBeginInfo.renderArea.extent = swapchain.extent;
+            renderPassBeginInfo.clearValueCount   = 3;
+            renderPassBeginInfo.pClearValues      = clearValues.data();
+        
+        vk::DeviceSize offsets[] = { 0 };
+
+        vk::Viewport viewport = { 0.0f, 0.0f, (float)swapchain.extent.width, (float)swapchain.extent.height, 0.0f, 1.0f };
+        vk::Rect2D   scissor  = { vk::Offset2D { 0, 0 }, swapchain.extent };
+        
+        swapchain.commandBuffers[i].beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+        swapchain.commandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.raster.pipeline);
+        swapchain.commandBuffers[i].setViewport(0, 1, &viewport);
+        swapchain.commandBuffers[i].setScissor(0, 1, &scissor);
+        swapchain.commandBuffers[i].bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
+        swapchain.commandBuffers[i].bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
+        swapchain.commandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.raster.layout, 0, 1, &pipelines.raster.descriptorSet, 0, nullptr);
+        swapchain.commandBuffers[i].drawIndexed(static_cast<uint32_t>(meshes.scene.indices.size()), 1, 0, 0, 0);
+        swapchain.commandBuffers[i].endRenderPass();
+
+        recordDepthPyramid(swapchain.commandBuffers[i]);
+
+        swapchain.commandBuffers[i].end();
+
+        } // for each swapchain image
+        
+    return result;
+        
+    } // VulkanApp :: createRasterCommandBuffers
+
+
+//
+//  createInitialUploads
+//
+//  copies across everything staged while setting up, so the first
+//  frame finds every buffer the passes read filled in
+//
+vk::Result VulkanApp::createInitialUploads ()
+    { // VulkanApp :: createInitialUploads
+    vk::Result result = vk::Result::eSuccess;
+
+    vk::CommandBuffer commandBuffer = VulkanHelpers::beginSingleUseCommand(core.logicalDevice, command.pool);
+    recordUploads(commandBuffer);
+    VulkanHelpers::endSingleUseCommand(core.logicalDevice, command.pool, commandBuffer, queues.graphics);
+
+    return result;
+    } // VulkanApp :: createInitialUploads
+
+
+//
+//  recordShadingCommands
+//
+//  records the shading pass for this frame. The geometry subpass
+//  draws each object from secondary buffers recorded in parallel,
+//  or from the culling shader's indirect draws when culling on the
+//  device, while the lighting subpass is a single quad and stays inline.
+//  Only the tiles of objects picked by selectShadingTiles are touched.
+//  With the geometry buffers cached, the geometry subpass only clears
+//  and redraws the few tiles that need it, inline, and is usually empty
+//
+vk::CommandBuffer VulkanApp::recordShadingCommands (uint32_t frame, vk::CommandBufferUsageFlags usage)
+    { // VulkanApp :: recordShadingCommands
+
+    vk::CommandBuffer commandBuffer = command.recorder.primary(frame);
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = usage;
+        beginInfo.pInheritanceInfo = nullptr;
+
+    vk::ClearColorValue color = { WINDOW_CLEAR };
+    
+    std::array<vk::ClearValue, 5> clearValues = {};
+        clearValues[0].color        = color;
+        clearValues[1].color        = color;
+        clearValues[2].color        = color;
+        clearValues[3].color        = color;
+        clearValues[4].depthStencil = vk::ClearDepthStencilValue { 1.0f, 0 };
+
+    vk::RenderPassBeginInfo renderPassBeginInfo = { };
+        renderPassBeginInfo.renderPass        = pipelines.shading.renderPass;
+        renderPassBeginInfo.framebuffer       = shading.framebuffer;
+        renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
+        renderPassBeginInfo.renderArea.extent.width  = shading.BUFFER_SIZE;
+        renderPassBeginInfo.renderArea.extent.height = shading.BUFFER_SIZE;
+        renderPassBeginInfo.clearValueCount   = 5;
+        renderPassBeginInfo.pClearValues      = clearValues.data();
+
+    VulkanCommandRecorder::Target target = { };
+        target.renderPass    = pipelines.shading.renderPass;
+        target.subpass       = shading.eGenerateGeometryBuffers;
+        target.framebuffer   = shading.framebuffer;
+        target.pipeline      = pipelines.shading.geometryPipeline;
+        target.layout        = pipelines.shading.geometryLayout;
+        target.descriptorSet = pipelines.shading.geometryDescriptorSet;
+        target.vertexBuffer  = buffers.sceneVertex.buffer;
+        target.indexBuffer   = buffers.sceneIndex.buffer;
+        target.usage         = usage;
+
+    bool inlineDraws = culling.gpu || geometryCache.enabled;
+
+    if (geometryCache.enabled)
+        renderPassBeginInfo.renderPass = pipelines.shading.cachedRenderPass;
+
+    std::vector<vk::CommandBuffer> secondaries;
+    if (!inlineDraws)
+        command.recorder.record(frame, target, command.shadingDraws.data(), static_cast<uint32_t>(command.shadingDraws.size()), secondaries);
+
+    vk::DeviceSize offsets[] = { 0 };
+    
+    commandBuffer.begin(&beginInfo);
+
+    if (culling.gpu)
+        recordCullingDispatch(commandBuffer);
+
+    recordFeedbackDilation(commandBuffer);
+    recordShadowLayers(commandBuffer, false);
+
+    commandBuffer.beginRenderPass(&renderPassBeginInfo, inlineDraws ? vk::SubpassContents::eInline : vk::SubpassContents::eSecondaryCommandBuffers);
+    
+        //  Subpass One: Populate geometry buffers in preperation for lighting computation
+        if (geometryCache.enabled)
+            recordGeometryRedraws(commandBuffer);
+        else if (culling.gpu)
+            {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryPipeline);
+            commandBuffer.bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
+            commandBuffer.bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryLayout, 0, 1, &pipelines.shading.geometryDescriptorSet, 0, nullptr);
+            recordIndirectDraws(commandBuffer, buffers.geometryIndirect.buffer, nObjects * static_cast<uint32_t>(clusters.list.size()));
+            }
+        else if (!secondaries.empty())
+            commandBuffer.executeCommands(static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+		commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+       
+        //  Subpass Two: Compute lighting and store in buffer, which is
+        //  left empty when the tiled shader lights the atlas instead
+        if (!tiledLighting.enabled)
+            {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.shadingPipeline);
+            commandBuffer.bindVertexBuffers(0, 1, &buffers.quadVertex.buffer, offsets);
+            commandBuffer.bindIndexBuffer(buffers.quadIndex.buffer, 0, vk::IndexType::eUint32);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.shadingLayout, 0, 1, &pipelines.shading.shadingDescriptorSet, 0, nullptr);
+
+            // the quad covers the whole atlas, so skipped tiles, and the
+            // parts of tiles their shading level leaves unused, are left
+            // out by scissoring it down to what's being shaded
+            if (feedback.shadeCount == nObjects && !lod.reduced)
+                {
+                vk::Rect2D atlas = { vk::Offset2D { 0, 0 }, vk::Extent2D { shading.BUFFER_SIZE, shading.BUFFER_SIZE } };
+                commandBuffer.setScissor(0, 1, &atlas);
+                commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.quad.indices.size()), 1, 0, 0, 0);
+                }
+            else for (uint32_t i = 0; i < nObjects; ++i)
+                {
+                if (!feedback.shade[i])
+                    continue;
+
+                vk::Rect2D tile = atlasTile(i);
+                commandBuffer.setScissor(0, 1, &tile);
+                commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.quad.indices.size()), 1, 0, 0, 0);
+                }
+            }
+
+    commandBuffer.endRenderPass();
+
+    if (tiledLighting.enabled)
+        recordTiledLighting(commandBuffer);
+
+    recordMipGeneration(commandBuffer, false);
+
+    commandBuffer.end();
+
+    return commandBuffer;
+
+    } // VulkanApp :: recordShadingCommands
+
+
+//
+//  recordRasterCommands
+//
+//  records the raster pass for this frame into the given
+//  swapchain image, with object draws split across workers
+//
+vk::CommandBuffer VulkanApp::recordRasterCommands (uint32_t frame, uint32_t image, vk::CommandBufferUsageFlags usage)
+    { // VulkanApp :: recordRasterCommands
+
+    vk::CommandBuffer commandBuffer = command.recorder.primary(frame);
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = usage;
+        beginInfo.pInheritanceInfo = nullptr;
+
+    vk::ClearColorValue color = { WINDOW_CLEAR };
+    vk::ClearDepthStencilValue depth = { 1.0f, 0 };
+    
+    std::array<vk::ClearValue, 3> clearValues = {};
+        clearValues[0].color        = color;
+        clearValues[1].color        = color;
+        clearValues[2].depthStencil = depth;
+
+    vk::RenderPassBeginInfo renderPassBeginInfo = { };
+        renderPassBeginInfo.renderPass        = pipelines.raster.renderPass;
+        renderPassBeginInfo.framebuffer       = swapchain.framebuffers[image];
+        renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
+        renderPassBeginInfo.renderArea.extent = swapchain.extent;
+        renderPassBeginInfo.clearValueCount   = 3;
+        renderPassBeginInfo.pClearValues      = clearValues.data();
+
+    VulkanCommandRecorder::Target target = { };
+        target.renderPass      = pipelines.raster.renderPass;
+        target.subpass         = 0;
+        target.framebuffer     = swapchain.framebuffers[image];
+        target.pipeline        = pipelines.raster.pipeline;
+        target.layout          = pipelines.raster.layout;
+        target.descriptorSet   = pipelines.raster.descriptorSet;
+        target.vertexBuffer    = buffers.sceneVertex.buffer;
+        target.indexBuffer     = buffers.sceneIndex.buffer;
+        target.dynamicViewport = true;
+        target.viewport        = vk::Viewport { 0.0f, 0.0f, (float)swapchain.extent.width, (float)swapchain.extent.height, 0.0f, 1.0f };
+        target.scissor         = vk::Rect2D { vk::Offset2D { 0, 0 }, swapchain.extent };
+        target.usage           = usage;
+
+    std::vector<vk::CommandBuffer> secondaries;
+    command.recorder.record(frame, target, command.rasterDraws.data(), static_cast<uint32_t>(command.rasterDraws.size()), secondaries);
+
+    commandBuffer.begin(&beginInfo);
+
+    if (culling.gpu)
+        recordCullingDispatch(commandBuffer);
+
+    commandBuffer.beginRenderPass(&renderPassBeginInfo, culling.gpu ? vk::SubpassContents::eInline : vk::SubpassContents::eSecondaryCommandBuffers);
+
+    if (culling.gpu)
+        {
+        vk::DeviceSize offsets[] = { 0 };
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.raster.pipeline);
+        commandBuffer.setViewport(0, 1, &target.viewport);
+        commandBuffer.setScissor(0, 1, &target.scissor);
+        commandBuffer.bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
+        commandBuffer.bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.raster.layout, 0, 1, &pipelines.raster.descriptorSet, 0, nullptr);
+        recordIndirectDraws(commandBuffer, buffers.rasterIndirect.buffer, nObjects);
+        }
+    else if (!secondaries.empty())
+        commandBuffer.executeCommands(static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+    commandBuffer.endRenderPass();
+
+    recordDepthPyramid(commandBuffer);
+
+    commandBuffer.end();
+
+    return commandBuffer;
+
+    } // VulkanApp :: recordRasterCommands
+
+
+//
+//  recordCullingDispatch
+//
+//  clears the visible count and runs the culling shader over every
+//  object and the cluster shader over every cluster of every object,
+//  rewriting the indirect draws both passes read. Recorded
+//  outside of any render pass, ahead of the draws it feeds
+//
+void VulkanApp::recordCullingDispatch (vk::CommandBuffer& commandBuffer)
+    { // VulkanApp :: recordCullingDispatch
+
+    // the previous submission's draws may still be reading the
+    // commands and count we're about to overwrite, and the last
+    // raster frame's pyramid has to be visible to the shader
+    vk::MemoryBarrier before = { };
+        before.srcAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderWrite;
+        before.dstAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags { }, 1, &before, 0, nullptr, 0, nullptr);
+
+    commandBuffer.fillBuffer(buffers.cullingCount.buffer, 0, sizeof(uint32_t), 0);
+
+    vk::MemoryBarrier cleared = { };
+        cleared.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        cleared.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags { }, 1, &cleared, 0, nullptr, 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.culling.pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelines.culling.layout, 0, 1, &pipelines.culling.descriptorSet, 0, nullptr);
+    commandBuffer.dispatch((nObjects + 63) / 64, 1, 1);
+
+    // the geometry draws only depend on the objects, not on what
+    // the culling shader wrote, so the two dispatches can overlap
+    uint32_t clusterDraws = nObjects * static_cast<uint32_t>(clusters.list.size());
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.culling.clusterPipeline);
+    commandBuffer.dispatch((clusterDraws + 63) / 64, 1, 1);
+
+    // the draws can't be fetched until the shader has written them,
+    // while the count waits for the frame's readback to copy it out
+    vk::MemoryBarrier written = { };
+        written.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        written.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eDrawIndirect,
+        vk::DependencyFlags { }, 1, &written, 0, nullptr, 0, nullptr);
+
+    } // VulkanApp :: recordCullingDispatch
+
+
+//
+//  recordGeometryRedraws
+//
+//  clears and redraws the tiles of the cached geometry buffers that
+//  selectGeometryRedraws found out of date. Recorded inline at the
+//  start of the geometry subpass, which is otherwise left empty
+//
+void VulkanApp::recordGeometryRedraws (vk::CommandBuffer& commandBuffer)
+    { // VulkanApp :: recordGeometryRedraws
+
+    if (geometryCache.redrawCount == 0)
+        return;
+
+    vk::DeviceSize offsets[] = { 0 };
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryPipeline);
+    commandBuffer.bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
+    commandBuffer.bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shading.geometryLayout, 0, 1, &pipelines.shading.geometryDescriptorSet, 0, nullptr);
+
+    // the whole tile is cleared, as it may have been drawn at a
+    // lower shading level that used more of it
+    std::vector<vk::ClearRect> tiles;
+    for (uint32_t i = 0; i < nObjects; ++i)
+        if (geometryCache.redraw[i])
+            tiles.push_back(vk::ClearRect { atlasTile(i), 0, 1 });
+
+    vk::ClearValue color;
+        color.color = vk::ClearColorValue { WINDOW_CLEAR };
+
+    vk::ClearValue coverage;
+        coverage.depthStencil = vk::ClearDepthStencilValue { 1.0f, 0 };
+
+    vk::ClearAttachment clears [4];
+        clears[0] = vk::ClearAttachment { vk::ImageAspectFlagBits::eColor,   0, color };
+        clears[1] = vk::ClearAttachment { vk::ImageAspectFlagBits::eColor,   1, color };
+        clears[2] = vk::ClearAttachment { vk::ImageAspectFlagBits::eColor,   2, color };
+        clears[3] = vk::ClearAttachment { vk::ImageAspectFlagBits::eStencil, 0, coverage };
+
+    commandBuffer.clearAttachments(4, clears, static_cast<uint32_t>(tiles.size()), tiles.data());
+
+    if (culling.gpu)
+        recordIndirectDraws(commandBuffer, buffers.geometryIndirect.buffer, nObjects * static_cast<uint32_t>(clusters.list.size()));
+    else for (const vk::DrawIndexedIndirectCommand& draw : command.shadingDraws)
+        commandBuffer.drawIndexed(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+
+    } // VulkanApp :: recordGeometryRedraws
+
+
+//
+//  recordTiledLighting
+//
+//  lights the tiles of the atlas being shaded with the compute
+//  shader, taking the geometry buffers and result out of the
+//  attachment layout for it and back again. Recorded after the
+//  shading render pass, whose lighting subpass is left empty
+//
+void VulkanApp::recordTiledLighting (vk::CommandBuffer& commandBuffer)
+    { // VulkanApp :: recordTiledLighting
+
+    if (tiledLighting.tiles.empty())
+        return;
+
+    VulkanShadingResource* images[] = { &shading.position, &shading.normal, &shading.color, &shading.result };
+
+    vk::ImageMemoryBarrier barriers [4];
+    for (uint32_t i = 0; i < 4; ++i)
+        { // for each image
+        barriers[i].srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite;
+        barriers[i].dstAccessMask       = (i < 3) ? vk::AccessFlagBits::eShaderRead : vk::AccessFlagBits::eShaderWrite;
+        barriers[i].oldLayout           = vk::ImageLayout::eColorAttachmentOptimal;
+        barriers[i].newLayout           = vk::ImageLayout::eGeneral;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].image               = images[i]->image;
+        barriers[i].subresourceRange    = vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+        } // for each image
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 4, barriers);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.lighting.pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelines.lighting.layout, 0, 1, &pipelines.lighting.descriptorSet, 0, nullptr);
+    commandBuffer.dispatch(static_cast<uint32_t>(tiledLighting.tiles.size()), 1, 1);
+
+    // the next pass draws the geometry buffers as attachments again,
+    // and the raster pass samples the result, which the semaphores
+    // between the passes make visible
+    for (uint32_t i = 0; i < 4; ++i)
+        { // for each image
+        std::swap(barriers[i].srcAccessMask, barriers[i].dstAccessMask);
+        std::swap(barriers[i].oldLayout,     barriers[i].newLayout);
+        barriers[i].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+        } // for each image
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 4, barriers);
+
+    } // VulkanApp :: recordTiledLighting
+
+
+//
+//  recordMipGeneration
+//
+//  averages each level of the result's mip chain below the first
+//  from the level above it, under the tiles shaded this pass or
+//  under every tile. The first level and the normals are taken out
+//  of the attachment layout for it, while the levels below stay in
+//  the general layout throughout
+//
+void VulkanApp::recordMipGeneration (vk::CommandBuffer& commandBuffer, bool whole)
+    { // VulkanApp :: recordMipGeneration
+
+    const MipState::Range* ranges = whole ? mips.whole : mips.pass;
+
+    if (mips.levels == 1 || ranges[1].count == 0)
+        return;
+
+    VulkanShadingResource* images[] = { &shading.result, &shading.normal };
+
+    vk::ImageMemoryBarrier barriers [2];
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each image
+        barriers[i].srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite;
+        barriers[i].dstAccessMask       = vk::AccessFlagBits::eShaderRead;
+        barriers[i].oldLayout           = vk::ImageLayout::eColorAttachmentOptimal;
+        barriers[i].newLayout           = vk::ImageLayout::eGeneral;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].image               = images[i]->image;
+        barriers[i].subresourceRange    = vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+        } // for each image
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 2, barriers);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.mips.pipeline);
+
+    // each level reads what the dispatch before it wrote
+    vk::MemoryBarrier written = { };
+        written.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        written.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    for (uint32_t l = 1; l < mips.levels; ++l)
+        { // for each level
+        if (ranges[l].count == 0)
+            continue;
+
+        uint32_t level[] = { ranges[l].first, (l == 1) ? 1u : 0u };
+
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelines.mips.layout, 0, 1, &pipelines.mips.descriptorSets[l - 1], 0, nullptr);
+        commandBuffer.pushConstants(pipelines.mips.layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(level), level);
+        commandBuffer.dispatch(ranges[l].count, 1, 1);
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags { }, 1, &written, 0, nullptr, 0, nullptr);
+        } // for each level
+
+    // the next pass draws to both as attachments again, and the
+    // raster pass samples the chain, which the semaphores between
+    // the passes make visible
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each image
+        barriers[i].srcAccessMask = vk::AccessFlagBits::eShaderRead;
+        barriers[i].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+        std::swap(barriers[i].oldLayout, barriers[i].newLayout);
+        } // for each image
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 2, barriers);
+
+    } // VulkanApp :: recordMipGeneration
+
+
+//
+//  recordShadowLayers
+//
+//  draws the layers this pass needs from the light, each cleared
+//  first. Static recordings draw the whole scene into the static
+//  layer, and leave the dynamic one empty
+//
+void VulkanApp::recordShadowLayers (vk::CommandBuffer& commandBuffer, bool whole)
+    { // VulkanApp :: recordShadowLayers
+
+    if (!whole && !shadows.enabled)
+        return;
+
+    vk::ClearValue clearValue;
+        clearValue.depthStencil = vk::ClearDepthStencilValue { 1.0f, 0 };
+
+    vk::RenderPassBeginInfo renderPassBeginInfo = { };
+        renderPassBeginInfo.renderPass        = pipelines.shadows.renderPass;
+        renderPassBeginInfo.renderArea.offset = vk::Offset2D { 0, 0 };
+        renderPassBeginInfo.renderArea.extent = vk::Extent2D { ShadowState::SIZE, ShadowState::SIZE };
+        renderPassBeginInfo.clearValueCount   = 1;
+        renderPassBeginInfo.pClearValues      = &clearValue;
+
+    vk::DeviceSize offsets[] = { 0 };
+
+    for (uint32_t l = 0; l < ShadowState::eLayerCount; ++l)
+        { // for each layer
+        bool     dynamic = (l == ShadowState::eDynamic);
+        uint32_t count   = dynamic ? shadows.dynamicCount : nObjects - shadows.dynamicCount;
+
+        if (whole)
+            count = dynamic ? 0 : nObjects;
+
+        // the dynamic layer is still cleared once the last of what
+        // it held has kept still long enough to leave it
+        bool needed = whole || (dynamic ? (count > 0 || shadows.dynamicHeld) : shadows.redrawStatic);
+        if (!needed)
+            continue;
+
+        renderPassBeginInfo.framebuffer = shadows.framebuffers[l];
+        commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
+
+        if (count > 0)
+            {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines.shadows.pipeline);
+            commandBuffer.bindVertexBuffers(0, 1, &buffers.sceneVertex.buffer, offsets);
+            commandBuffer.bindIndexBuffer(buffers.sceneIndex.buffer, 0, vk::IndexType::eUint32);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelines.shadows.layout, 0, 1, &pipelines.shadows.descriptorSet, 0, nullptr);
+
+            // a layer holding every object takes the batched scene whole
+            if (count == nObjects)
+                commandBuffer.drawIndexed(static_cast<uint32_t>(meshes.scene.indices.size()), 1, 0, 0, 0);
+            else for (uint32_t i = 0; i < nObjects; ++i)
+                {
+                if ((shadows.dynamic[i] != 0) != dynamic)
+                    continue;
+
+                const vk::DrawIndexedIndirectCommand& draw = meshes.objects[i];
+                commandBuffer.drawIndexed(draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+                }
+            }
+
+        commandBuffer.endRenderPass();
+        } // for each layer
+
+    } // VulkanApp :: recordShadowLayers
+
+
+//
+//  recordIndirectDraws
+//
+//  draws every slot in the given indirect buffer. Culled objects and
+//  clusters are left in place with no instances, as the draw count
+//  commands aren't available to us
+//
+void VulkanApp::recordIndirectDraws (vk::CommandBuffer& commandBuffer, vk::Buffer& draws, uint32_t count)
+    { // VulkanApp :: recordIndirectDraws
+
+    uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+    if (core.features.multiDrawIndirect)
+        commandBuffer.drawIndexedIndirect(draws, 0, count, stride);
+    else for (uint32_t i = 0; i < count; ++i)
+        commandBuffer.drawIndexedIndirect(draws, i * stride, 1, stride);
+
+    } // VulkanApp :: recordIndirectDraws
+
+
+//
+//  recordFeedbackDilation
+//
+//  grows the blocks sampled since the last shading pass into the
+//  mask this pass shades, then clears them for the raster frames
+//  that follow. Recorded ahead of the shading render pass
+//
+void VulkanApp::recordFeedbackDilation (vk::CommandBuffer& commandBuffer)
+    { // VulkanApp :: recordFeedbackDilation
+
+    // the raster frames have to be done marking blocks, and the last
+    // lighting pass done reading the mask we're about to replace
+    vk::MemoryBarrier sampled = { };
+        sampled.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        sampled.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags { }, 1, &sampled, 0, nullptr, 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.feedback.pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelines.feedback.layout, 0, 1, &pipelines.feedback.descriptorSet, 0, nullptr);
+    commandBuffer.dispatch((feedback.blocksPerRow + 7) / 8, (feedback.blocksPerRow + 7) / 8, 1);
+
+    // the mask feeds the lighting subpass or shader, and the sampled
+    // blocks can't be cleared until the dilation has read them
+    vk::MemoryBarrier dilated = { };
+        dilated.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        dilated.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags { }, 1, &dilated, 0, nullptr, 0, nullptr);
+
+    commandBuffer.fillBuffer(buffers.sampledBlocks.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    vk::MemoryBarrier cleared = { };
+        cleared.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        cleared.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        vk::DependencyFlags { }, 1, &cleared, 0, nullptr, 0, nullptr);
+
+    } // VulkanApp :: recordFeedbackDilation
+
+
+//
+//  recordDepthPyramid
+//
+//  reduces the depth buffer the raster pass just wrote into the
+//  pyramid, one level per dispatch, and copies the coarse levels
+//  out for the host. Recorded after the raster render pass
+//
+void VulkanApp::recordDepthPyramid (vk::CommandBuffer& commandBuffer)
+    { // VulkanApp :: recordDepthPyramid
+
+    if (!occlusion.supported)
+        return;
+
+    const OcclusionCulling::Pyramid& pyramid = occlusion.pyramid;
+
+    // the culling shader and the last copy to the host may still be
+    // reading the pyramid we're about to overwrite
+    vk::MemoryBarrier before = { };
+        before.srcAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead;
+        before.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags { }, 1, &before, 0, nullptr, 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelines.occlusion.pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelines.occlusion.layout, 0, 1, &pipelines.occlusion.descriptorSet, 0, nullptr);
+
+    // each level reads the one above it, and the last is read by
+    // the copy to the host
+    vk::MemoryBarrier reduced = { };
+        reduced.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        reduced.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead;
+
+    for (uint32_t l = 0; l < pyramid.levelCount; ++l)
+        { // for each level
+        const OcclusionCulling::Level& level = pyramid.levels[l];
+
+        glm::uvec4 levels[2];
+        if (l == 0)
+            levels[0] = glm::uvec4(0, swapchain.extent.width, swapchain.extent.height, 1);
+        else
+            levels[0] = glm::uvec4(pyramid.levels[l - 1].offset, pyramid.levels[l - 1].width, pyramid.levels[l - 1].height, 0);
+        levels[1] = glm::uvec4(level.offset, level.width, level.height, 0);
+
+        commandBuffer.pushConstants(pipelines.occlusion.layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(levels), levels);
+        commandBuffer.dispatch((level.width + 7) / 8, (level.height + 7) / 8, 1);
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags { }, 1, &reduced, 0, nullptr, 0, nullptr);
+        } // for each level
+
+    } // VulkanApp :: recordDepthPyramid
+
+
+//
+//  recordUploads
+//
+//  copies the ranges staged since the last submission across and
+//  empties the list. Earlier frames may still be reading what's
+//  overwritten, which the barrier ahead of the copies waits out
+//
+void VulkanApp::recordUploads (vk::CommandBuffer& commandBuffer)
+    { // VulkanApp :: recordUploads
+
+    vk::PipelineStageFlags readers = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+
+    commandBuffer.pipelineBarrier(
+        readers,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    for (const VulkanBuffers::Upload& upload : buffers.uploads)
+        commandBuffer.copyBuffer(upload.source, upload.destination, 1, &upload.region);
+
+    vk::MemoryBarrier copied = { };
+        copied.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        copied.dstAccessMask = vk::AccessFlagBits::eUniformRead | vk::AccessFlagBits::eShaderRead;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        readers,
+        vk::DependencyFlags { }, 1, &copied, 0, nullptr, 0, nullptr);
+
+    buffers.uploads.clear();
+
+    } // VulkanApp :: recordUploads
+
+
+//
+//  shadingCommands
+//
+//  returns the shading pass command buffer for this frame
+//  according to the recording mode
+//
+vk::CommandBuffer VulkanApp::shadingCommands (uint32_t frame)
+    { // VulkanApp :: shadingCommands
+
+    auto start = std::chrono::steady_clock::now();
+    vk::CommandBuffer commandBuffer;
+
+    switch (command.recording)
+        {
+        case VulkanCommandState::eStatic:
+            commandBuffer = shading.commandBuffer;
+            break;
+
+        case VulkanCommandState::eDynamic:
+            commandBuffer = recordShadingCommands(frame, vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+            break;
+
+        default:
+            validateCommandCache();
+            if (!command.cache.shading)
+                command.cache.shading = recordShadingCommands(command.CACHE_SLOT, vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+            commandBuffer = command.cache.shading;
+            break;
+        }
+
+    command.frameRecordTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return commandBuffer;
+
+    } // VulkanApp :: shadingCommands
+
+
+//
+//  rasterCommands
+//
+//  returns the raster pass command buffer for this frame and
+//  swapchain image according to the recording mode
+//
+vk::CommandBuffer VulkanApp::rasterCommands (uint32_t frame, uint32_t image)
+    { // VulkanApp :: rasterCommands
+
+    auto start = std::chrono::steady_clock::now();
+    vk::CommandBuffer commandBuffer;
+
+    switch (command.recording)
+        {
+        case VulkanCommandState::eStatic:
+            commandBuffer = swapchain.commandBuffers[image];
+            break;
+
+        case VulkanCommandState::eDynamic:
+            commandBuffer = recordRasterCommands(frame, image, vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+            break;
+
+        default:
+            validateCommandCache();
+            if (command.cache.raster.size() != swapchain.nImages)
+                command.cache.raster.resize(swapchain.nImages);
+            if (!command.cache.raster[image])
+                command.cache.raster[image] = recordRasterCommands(command.CACHE_SLOT, image, vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+            commandBuffer = command.cache.raster[image];
+            break;
+        }
+
+    command.frameRecordTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return commandBuffer;
+
+    } // VulkanApp :: rasterCommands
+
+
+//
+//  uploadCommands
+//
+//  returns a command buffer copying across what the frame staged,
+//  to go ahead of its passes, or nothing when it staged nothing
+//
+vk::CommandBuffer VulkanApp::uploadCommands (uint32_t frame)
+    { // VulkanApp :: uploadCommands
+
+    if (buffers.uploads.empty())
+        return vk::CommandBuffer { };
+
+    vk::CommandBuffer commandBuffer = command.recorder.primary(frame);
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    commandBuffer.begin(&beginInfo);
+    recordUploads(commandBuffer);
+    commandBuffer.end();
+
+    return commandBuffer;
+
+    } // VulkanApp :: uploadCommands
+
+
+//
+//  readbackCommands
+//
+//  returns a command buffer copying out what the host reads of the
+//  frame, the visibility flags and visible count to the slot's
+//  readback and the pyramid's coarse levels to the slot's copy of
+//  them, then clearing the flags for the next frame to set
+//
+vk::CommandBuffer VulkanApp::readbackCommands (uint32_t frame)
+    { // VulkanApp :: readbackCommands
+
+    vk::CommandBuffer commandBuffer = command.recorder.primary(frame);
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    commandBuffer.begin(&beginInfo);
+
+    // the flags are set by the raster pass, the count by the culling
+    // shader and the levels by the pyramid's reduction
+    vk::MemoryBarrier written = { };
+        written.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        written.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags { }, 1, &written, 0, nullptr, 0, nullptr);
+
+    vk::Buffer readback = buffers.frameReadback[frame].buffer;
+
+    if (core.features.fragmentStoresAndAtomics)
+        {
+        vk::BufferCopy flags = { 0, 0, sizeof(uint32_t) * nObjects };
+        commandBuffer.copyBuffer(buffers.visibility.buffer, readback, 1, &flags);
+        }
+
+    if (culling.gpu)
+        {
+        vk::BufferCopy count = { 0, sizeof(uint32_t) * nObjects, sizeof(uint32_t) };
+        commandBuffer.copyBuffer(buffers.cullingCount.buffer, readback, 1, &count);
+        }
+
+    if (occlusion.supported)
+        {
+        uint32_t hostOffset = occlusion.pyramid.levels[occlusion.hostLevel].offset;
+
+        vk::BufferCopy levels = { sizeof(float) * hostOffset, 0, sizeof(float) * (occlusion.pyramid.size - hostOffset) };
+        commandBuffer.copyBuffer(buffers.depthPyramid.buffer, buffers.depthReadback[frame].buffer, 1, &levels);
+        }
+
+    if (core.features.fragmentStoresAndAtomics)
+        {
+        vk::MemoryBarrier copied = { };
+            copied.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+            copied.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags { }, 1, &copied, 0, nullptr, 0, nullptr);
+
+        commandBuffer.fillBuffer(buffers.visibility.buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+
+    vk::MemoryBarrier landed = { };
+        landed.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        landed.dstAccessMask = vk::AccessFlagBits::eHostRead | vk::AccessFlagBits::eShaderWrite;
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eFragmentShader,
+        vk::DependencyFlags { }, 1, &landed, 0, nullptr, 0, nullptr);
+
+    commandBuffer.end();
+
+    return commandBuffer;
+
+    } // VulkanApp :: readbackCommands
+
+
+//
+//  shadowCommands
+//
+//  returns a command buffer drawing the shadow layers alone, for a
+//  shading frame whose diffuse lighting is left out, or nothing when
+//  neither layer needs drawing
+//
+vk::CommandBuffer VulkanApp::shadowCommands (uint32_t frame)
+    { // VulkanApp :: shadowCommands
+
+    // static recordings draw both layers whole every pass
+    bool whole = command.recording == VulkanCommandState::eStatic;
+
+    if (!whole && (!shadows.enabled || (!shadows.redrawStatic && shadows.dynamicCount == 0 && !shadows.dynamicHeld)))
+        return vk::CommandBuffer { };
+
+    auto start = std::chrono::steady_clock::now();
+
+    vk::CommandBuffer commandBuffer = command.recorder.primary(frame);
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    commandBuffer.begin(&beginInfo);
+    recordShadowLayers(commandBuffer, whole);
+    commandBuffer.end();
+
+    command.frameRecordTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return commandBuffer;
+
+    } // VulkanApp :: shadowCommands
+
+
+//
+//  buildDrawList
+//
+//  gathers this frame's draws into the compact lists the recorder
+//  works from. The atlas shades the objects selected from visibility
+//  feedback, minus their clusters facing away from the camera, while
+//  the raster pass only draws what survived culling
+//
+void VulkanApp::buildDrawList ()
+    { // VulkanApp :: buildDrawList
+
+    glm::vec3 eyes[] = { clusters.eye, clusters.predictedEye };
+
+    clusters.culled = 0;
+    command.shadingDraws.clear();
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        if (!geometryCache.redraw[i])
+            continue;
+
+        // a cached tile is lit from wherever the camera goes next,
+        // so it needs every cluster
+        if (clusters.enabled && !geometryCache.enabled)
+            clusters.culled += ClusterCulling::append(clusters.list, meshes.objects[i], objects.model[i], eyes, 2, command.shadingDraws);
+        else
+            command.shadingDraws.push_back(meshes.objects[i]);
+        } // for each object
+
+    // culling on the device records the same raster commands every
+    // frame whatever is visible
+    if (culling.gpu)
+        {
+        command.rasterDraws.clear();
+        return;
+        }
+
+    if (culling.enabled)
+        {
+        command.rasterDraws.resize(culling.visible.size());
+        for (size_t i = 0; i < culling.visible.size(); ++i)
+            command.rasterDraws[i] = meshes.objects[culling.visible[i]];
+        }
+    else command.rasterDraws.assign(meshes.objects.begin(), meshes.objects.end());
+
+    } // VulkanApp :: buildDrawList
+
+
+//
+//  validateCommandCache
+//
+//  drops the cached recordings if anything they were recorded
+//  from has changed since
+//
+void VulkanApp::validateCommandCache ()
+    { // VulkanApp :: validateCommandCache
+
+    uint64_t hash = recordingHash();
+
+    if (command.cache.valid && command.cache.hash == hash)
+        return;
+
+    invalidateCommandCache();
+
+    command.cache.valid = true;
+    command.cache.hash  = hash;
+
+    } // VulkanApp :: validateCommandCache
+
+
+//
+//  recordingHash
+//
+//  hashes everything recordShadingCommands and recordRasterCommands
+//  decide what to record from. It's taken when the recordings are
+//  asked for, so the lighting and mip tiles committed after the draw
+//  list was built are part of it
+//
+uint64_t VulkanApp::recordingHash ()
+    { // VulkanApp :: recordingHash
+
+    // which passes are recorded, and which paths through them
+    const uint32_t paths[] = {
+        culling.gpu,
+        geometryCache.enabled,
+        geometryCache.redrawCount,
+        tiledLighting.enabled,
+        static_cast<uint32_t>(tiledLighting.tiles.size()),
+        feedback.shadeCount == nObjects && !lod.reduced,
+        shadows.enabled,
+        shadows.redrawStatic,
+        shadows.dynamicHeld,
+        shadows.dynamicCount,
+        swapchain.extent.width,
+        swapchain.extent.height
+    };
+
+    uint64_t result = ShadingCache::hash(paths, sizeof(paths));
+
+    // the draws themselves
+    result = ShadingCache::hash(command.shadingDraws.data(), sizeof(vk::DrawIndexedIndirectCommand) * command.shadingDraws.size(), result);
+    result = ShadingCache::hash(command.rasterDraws.data(),  sizeof(vk::DrawIndexedIndirectCommand) * command.rasterDraws.size(),  result);
+
+    // which tiles are lit and cleared, and where the page table has
+    // put them, which is what they're scissored to
+    result = ShadingCache::hash(feedback.shade.data(),        feedback.shade.size(),        result);
+    result = ShadingCache::hash(geometryCache.redraw.data(),  geometryCache.redraw.size(),  result);
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        if (!feedback.shade[i] && !geometryCache.redraw[i])
+            continue;
+
+        glm::uvec4 rect = paging.table.rect(i);
+        result = ShadingCache::hash(&rect, sizeof(rect), result);
+        } // for each object
+
+    // the mip passes dispatched under them
+    result = ShadingCache::hash(mips.pass, sizeof(mips.pass), result);
+
+    // and what's drawn into which shadow layer, though not the light
+    // it's drawn from, which is only a uniform
+    result = ShadingCache::hash(&shadows.setHash, sizeof(shadows.setHash), result);
+
+    return result;
+
+    } // VulkanApp :: recordingHash
+
+
+//
+//  invalidateCommandCache
+//
+//  throws away every cached recording, waiting for any submission
+//  that could still be executing one of them
+//
+void VulkanApp::invalidateCommandCache ()
+    { // VulkanApp :: invalidateCommandCache
+
+    if (command.cache.shading || !command.cache.raster.empty())
+        {
+        timeline.wait(VulkanTimeline::eLighting, timeline.submitted(VulkanTimeline::eLighting));
+        timeline.wait(VulkanTimeline::eRaster,   timeline.submitted(VulkanTimeline::eRaster));
+        command.recorder.reset(command.CACHE_SLOT);
+        }
+
+    command.cache.valid   = false;
+    command.cache.shading = vk::CommandBuffer { };
+    command.cache.raster.clear();
+
+    } // VulkanApp :: invalidateCommandCache
+
+
+//
+//  benchmarkRecording
+//
+//  measures the host cost of producing a frame's command buffers,
+//  for draw lists scaled up from the scene's own objects: recording
+//  them afresh, reusing the cached recordings of a scene that isn't
+//  changing, and recording the cache again because a draw changed.
+//  Both cached rows include hashing what the recordings are made
+//  from. Nothing recorded here is submitted. Results are appended
+//  to recording_<id>.txt as
+//
+//      draws  record(ms)  reuse(ms)  rerecord(ms)
+//
+void VulkanApp::benchmarkRecording ()
+    { // VulkanApp :: benchmarkRecording
+
+    if (meshes.objects.empty())
+        return;
+
+    // the benchmark borrows the first frame's pools, so the device
+    // has to be done with everything before they're reset
+    timeline.wait(VulkanTimeline::eLighting, timeline.submitted(VulkanTimeline::eLighting));
+    timeline.wait(VulkanTimeline::eRaster,   timeline.submitted(VulkanTimeline::eRaster));
+
+    VulkanCommandState::Recording live = command.recording;
+
+    // the benchmark measures the host's recording, which culling on
+    // the device skips entirely
+    bool gpu = culling.gpu;
+    culling.gpu = false;
+
+    // and the cached geometry buffers draw next to nothing
+    bool cached = geometryCache.enabled;
+    geometryCache.enabled = false;
+
+    const uint32_t counts[] = { 64, 1024, 4096, 16384 };
+    const uint32_t runs     = 100;
+
+    std::ofstream file ("recording_" + std::to_string(runID) + ".txt", std::ios_base::app);
+
+    std::cout << std::endl << "recording benchmark (" << command.recorder.threads() << " workers)" << std::endl;
+
+    // the average time to produce both passes' buffers, changing the
+    // first draw before each frame when asked to
+    auto measure = [&] (bool change)
+        {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < runs; ++r)
+            {
+            command.recorder.reset(0);
+            if (change)
+                command.shadingDraws[0].firstInstance ^= 1;
+
+            shadingCommands(0);
+            rasterCommands(0, 0);
+            }
+        auto stop = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::milli>(stop - start).count() / (double)runs;
+        };
+
+    for (uint32_t count : counts)
+        { // for each draw list size
+
+        command.shadingDraws.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+            command.shadingDraws[i] = meshes.objects[i % meshes.objects.size()];
+        command.rasterDraws = command.shadingDraws;
+
+        command.recording = VulkanCommandState::eDynamic;
+        double record = measure(false);
+
+        // the cache is warmed first, so reusing it never records
+        command.recording = VulkanCommandState::eCached;
+        invalidateCommandCache();
+        shadingCommands(0);
+        rasterCommands(0, 0);
+
+        double reuse    = measure(false);
+        double rerecord = measure(true);
+
+        std::cout << "  " << count << " draws : record " << record << "ms, reuse " << reuse << "ms, re-record " << rerecord << "ms" << std::endl;
+        file << count << " " << record << " " << reuse << " " << rerecord << "\n";
+
+        } // for each draw list size
+
+    // put the scene back the way the frame loop left it
+    command.recording     = live;
+    culling.gpu           = gpu;
+    geometryCache.enabled = cached;
+    invalidateCommandCache();
+    command.recorder.reset(0);
+    buildDrawList();
+
+    command.frameRecordTime = 0.0;
+
+    } // VulkanApp :: benchmarkRecording
+
+
+//
+//  benchmarkSceneData
+//
+//  times the host's share of the per-object storage buffers for more
+//  objects than the scene holds, building each object's transforms
+//  the way updateGeometryUniforms does and copying the shading,
+//  raster and culling records into staging as the frame does. The
+//  buffers are sized when the renderer is built, so the device's
+//  side is given as what it's handed, the bytes uploaded and the
+//  draws cluster.comp writes. Results are appended to scene_<id>.txt as
+//
+//      objects  build(ms)  copy(ms)  upload(bytes)  cluster draws  indirect(bytes)
+//
+void VulkanApp::benchmarkSceneData ()
+    { // VulkanApp :: benchmarkSceneData
+
+    const uint32_t counts[] = { 1000, 10000, 100000 };
+    const uint32_t runs     = 20;
+
+    std::default_random_engine            generator (0);
+    std::uniform_real_distribution<float> spread (-12.0f, 12.0f);
+
+    std::ofstream file ("scene_" + std::to_string(runID) + ".txt", std::ios_base::app);
+
+    uint64_t clusterCount = clusters.list.size();
+
+    for (uint32_t count : counts)
+        { // for each object count
+
+        std::vector<glm::vec3> positions (count), orientations (count);
+        for (uint32_t i = 0; i < count; ++i)
+            {
+            positions[i]    = glm::vec3(spread(generator), spread(generator), spread(generator));
+            orientations[i] = glm::vec3(spread(generator), spread(generator), spread(generator)) * 15.0f;
+            }
+
+        std::vector<ObjectData::Shading>  shading (count);
+        std::vector<ObjectData::Raster>   raster  (count);
+        std::vector<CullingState::Object> cull    (count);
+
+        // stand ins for the mapped staging, which holds nObjects
+        std::vector<uint8_t> staging (count * (sizeof(ObjectData::Shading) + sizeof(ObjectData::Raster) + sizeof(CullingState::Object)));
+
+        double build = 0.0;
+        double copy  = 0.0;
+
+        for (uint32_t r = 0; r < runs; ++r)
+            { // for each run
+            auto start = std::chrono::steady_clock::now();
+
+            for (uint32_t i = 0; i < count; ++i)
+                {
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, positions[i]);
+                model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
+                model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+                model = glm::rotate(model, glm::radians(orientations[i].z), glm::vec3(0.0f, 0.0f, 1.0f));
+                model = glm::rotate(model, glm::radians(orientations[i].y), glm::vec3(0.0f, 1.0f, 0.0f));
+                model = glm::rotate(model, glm::radians(orientations[i].x), glm::vec3(1.0f, 0.0f, 0.0f));
+
+                shading[i].model = model;
+                raster[i].model  = model;
+                cull[i].model    = model;
+                }
+
+            auto built = std::chrono::steady_clock::now();
+
+            uint8_t* at = staging.data();
+            memcpy(at, shading.data(), sizeof(ObjectData::Shading) * count);  at += sizeof(ObjectData::Shading) * count;
+            memcpy(at, raster.data(),  sizeof(ObjectData::Raster) * count);   at += sizeof(ObjectData::Raster) * count;
+            memcpy(at, cull.data(),    sizeof(CullingState::Object) * count);
+
+            auto stop = std::chrono::steady_clock::now();
+
+            build += std::chrono::duration<double, std::milli>(built - start).count();
+            copy  += std::chrono::duration<double, std::milli>(stop - built).count();
+            } // for each run
+
+        // every frame takes the shading and raster records across, and
+        // the culling ones too when culling runs on the device
+        uint64_t upload   = (uint64_t)count * (sizeof(ObjectData::Shading) + sizeof(ObjectData::Raster) + (culling.gpu ? sizeof(CullingState::Object) : 0));
+        uint64_t draws    = (uint64_t)count * clusterCount;
+        uint64_t indirect = (draws + count) * sizeof(vk::DrawIndexedIndirectCommand);
+
+        std::cout << "  " << count << " objects : build " << build / runs << "ms, copy " << copy / runs << "ms, " << upload / 1000 << "kb uploaded, " << draws << " cluster draws (" << indirect / 1000 << "kb indirect)" << std::endl;
+        file << count << " " << build / runs << " " << copy / runs << " " << upload << " " << draws << " " << indirect << "\n";
+
+        } // for each object count
+
+    } // VulkanApp :: benchmarkSceneData
+
+
+//
+//  benchmarkLighting
+//
+//  times shading passes over the whole atlas with more and more
+//  point lights, lit by the subpass, by the tiled shader going
+//  through every light, and by the tiled shader culling them per
+//  tile. Each pass is waited on alone, so what's measured is the
+//  pass on the device plus a submission
+//
+void VulkanApp::benchmarkLighting ()
+    { // VulkanApp :: benchmarkLighting
+
+    timeline.wait(VulkanTimeline::eLighting, timeline.submitted(VulkanTimeline::eLighting));
+    timeline.wait(VulkanTimeline::eRaster,   timeline.submitted(VulkanTimeline::eRaster));
+
+    uint32_t liveCount  = lights.count;
+    bool     liveCulled = lights.culled;
+    bool     liveTiled  = tiledLighting.enabled;
+
+    VulkanCommandState::Recording live = command.recording;
+    std::vector<uint8_t> liveShade     = feedback.shade;
+    uint32_t liveShadeCount            = feedback.shadeCount;
+    uint32_t liveFull                  = ubo.feedback.full;
+
+    // every tile is lit whole, and recorded fresh each pass
+    command.recording = VulkanCommandState::eDynamic;
+    std::fill(feedback.shade.begin(), feedback.shade.end(), 1);
+    feedback.shadeCount = nObjects;
+    ubo.feedback.full   = 1;
+
+    selectResidency();
+    selectGeometryRedraws();
+    updateCullingBuffers();
+    buildDrawList();
+    commitShadingLevels();
+
+    const uint32_t counts[] = { 16, 256, 1024, 4096 };
+    const uint32_t runs     = 20;
+
+    std::ofstream file ("lighting_" + std::to_string(runID) + ".txt", std::ios_base::app);
+
+    std::cout << std::endl << "lighting benchmark (" << tiledLighting.tileSize << " texel tiles)" << std::endl;
+
+    for (uint32_t count : counts)
+        { // for each light count
+
+        double times[3] = { };
+
+        for (uint32_t mode = 0; mode < 3; ++mode)
+            { // for each lighting path
+            if (mode > 0 && !tiledLighting.supported)
+                continue;
+
+            tiledLighting.enabled = mode > 0;
+            lights.culled         = mode == 2;
+            lights.count          = count;
+            generateLights();
+            commitLightingTiles();
+
+            for (uint32_t r = 0; r < runs; ++r)
+                {
+                command.recorder.reset(0);
+
+                // the first run of each path takes its lights across
+                vk::CommandBuffer uploads = uploadCommands(0);
+                vk::CommandBuffer commandBuffers[] = { uploads, recordShadingCommands(0, vk::CommandBufferUsageFlagBits::eOneTimeSubmit) };
+
+                uint32_t first = uploads ? 0 : 1;
+
+                VulkanTimeline::Batch batch;
+                    batch.signal (VulkanTimeline::eLighting);
+
+                auto start = std::chrono::steady_clock::now();
+                timeline.wait(VulkanTimeline::eLighting, timeline.submit(queues.graphics, batch, commandBuffers + first, 2 - first));
+                times[mode] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                }
+
+            times[mode] /= (double)runs;
+            } // for each lighting path
+
+        std::cout << "  " << count << " lights : subpass " << times[0] << "ms, tiles " << times[1] << "ms, culled tiles " << times[2] << "ms" << std::endl;
+        file << count << " " << times[0] << " " << times[1] << " " << times[2] << "\n";
+
+        } // for each light count
+
+    // the benchmark lit every tile last
+    shading.atlasVersion = timeline.submitted(VulkanTimeline::eLighting);
+    std::fill(feedback.fresh.begin(), feedback.fresh.end(), 1);
+
+    // put the scene back the way the frame loop left it
+    lights.count          = liveCount;
+    lights.culled         = liveCulled;
+    tiledLighting.enabled = liveTiled;
+    command.recording     = live;
+    feedback.shade        = liveShade;
+    feedback.shadeCount   = liveShadeCount;
+    ubo.feedback.full     = liveFull;
+
+    generateLights();
+    selectResidency();
+    selectGeometryRedraws();
+    updateCullingBuffers();
+    invalidateCommandCache();
+    command.recorder.reset(0);
+    buildDrawList();
+
+    } // VulkanApp :: benchmarkLighting
+
+
+//
+//  recreateSwapChain
+//
+//  rebuilds only the resources that depend on the swapchain extent
+//  (depth buffer, framebuffers and raster command buffers). The
+//  shading atlas, render passes and pipelines are left untouched
+//
+vk::Result VulkanApp::recreateSwapChain ()
+    { // VulkanApp :: recreateSwapChain
+    vk::Result result = vk::Result::eSuccess;
+
+    // a minimized window has no extent to render to, so we
+    // sit on the event queue until it comes back
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    while (width == 0 || height == 0)
+        {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(window, &width, &height);
+        }
+
+    // the raster frames touch the resources we're about to replace,
+    // and the shading pass culls against the depth pyramid
+    timeline.wait(VulkanTimeline::eLighting, timeline.submitted(VulkanTimeline::eLighting));
+    timeline.wait(VulkanTimeline::eRaster,   timeline.submitted(VulkanTimeline::eRaster));
+
+    // cached recordings point at the framebuffers being replaced
+    invalidateCommandCache();
+
+    // the swapchain's images may still be queued for presentation,
+    // so it and what was made for them outlive this call
+    VulkanSwapChain::Retired retired;
+        retired.swapchain    = swapchain.swapchain;
+        retired.views        = std::move(swapchain.views);
+        retired.framebuffers = std::move(swapchain.framebuffers);
+        retired.lastPresent  = timeline.submitted(VulkanTimeline::eRaster);
+
+    swapchain.retired.push_back(retired);
+    swapchain.views.clear();
+    swapchain.framebuffers.clear();
+
+    destroySwapChainResources();
+
+    result = createSwapChain();
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    result = createDepthBuffer();
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    result = createDepthPyramid();
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    writeOcclusionDescriptors();
+
+    result = createRasterFrameBuffers();
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    result = createRasterCommandBuffers();
+    if (result != vk::Result::eSuccess)
+        return result;
+
+    framebufferResized = false;
+
+    return result;
+
+    } // VulkanApp :: recreateSwapChain
+
+
+//
+//  destroySwapChainResources
+//
+//  releases everything created against the current swapchain
+//  extent. The swapchain handle itself is kept alive so that
+//  it can be retired into its replacement
+//
+void VulkanApp::destroySwapChainResources ()
+    { // VulkanApp :: destroySwapChainResources
+
+    if (!swapchain.commandBuffers.empty())
+        core.logicalDevice.freeCommandBuffers(command.pool, static_cast<uint32_t>(swapchain.commandBuffers.size()), swapchain.commandBuffers.data());
+    swapchain.commandBuffers.clear();
+
+    for (vk::Framebuffer& framebuffer : swapchain.framebuffers)
+        core.logicalDevice.destroyFramebuffer(framebuffer);
+    swapchain.framebuffers.clear();
+
+    core.logicalDevice.destroyImageView(depth.view);
+    core.logicalDevice.destroyImage(depth.image);
+    core.logicalDevice.freeMemory(depth.memory);
+
+    core.logicalDevice.destroyBuffer(buffers.depthPyramid.buffer);
+    core.logicalDevice.freeMemory(buffers.depthPyramid.memory);
+
+    for (VulkanBuffers::VulkanBuffer& readback : buffers.depthReadback)
+        {
+        core.logicalDevice.destroyBuffer(readback.buffer);
+        core.logicalDevice.freeMemory(readback.memory);
+        }
+
+    for (vk::ImageView& view : swapchain.views)
+        core.logicalDevice.destroyImageView(view);
+    swapchain.views.clear();
+
+    } // VulkanApp :: destroySwapChainResources
+
+
+//
+//  destroyRetiredSwapChains
+//
+//  destroys the swapchains recreateSwapChain replaced, with the views
+//  and framebuffers of their images, once the raster frames after the
+//  last one presented to them have finished. By then the presentation
+//  engine has moved on to the new swapchain's images. Everything goes
+//  when the app closes
+//
+void VulkanApp::destroyRetiredSwapChains (bool all)
+    { // VulkanApp :: destroyRetiredSwapChains
+
+    if (swapchain.retired.empty())
+        return;
+
+    uint64_t completed = timeline.completed(VulkanTimeline::eRaster);
+
+    for (size_t i = 0; i < swapchain.retired.size(); )
+        { // for each retired swapchain
+        VulkanSwapChain::Retired& retired = swapchain.retired[i];
+
+        if (!all && completed < retired.lastPresent + MAX_FRAMES_IN_FLIGHT)
+            {
+            ++i;
+            continue;
+            }
+
+        for (vk::Framebuffer& framebuffer : retired.framebuffers)
+            core.logicalDevice.destroyFramebuffer(framebuffer);
+
+        for (vk::ImageView& view : retired.views)
+            core.logicalDevice.destroyImageView(view);
+
+        core.logicalDevice.destroySwapchainKHR(retired.swapchain);
+
+        swapchain.retired.erase(swapchain.retired.begin() + i);
+        } // for each retired swapchain
+
+    } // VulkanApp :: destroyRetiredSwapChains
+
+
+//
+//
+//
+void VulkanApp::arrangeObjects ()
+    { // VulkanApp :: arrangeObjects
+
+    if (!arrangement.arranged)
+        {
+        int m = sqrt(nObjects);
+        arrangement.translations.resize(nObjects);
+        arrangement.centre = { 0.0f, 0.0f, 0.0f };
+
+	for (Vertex& v : meshes.scene.vertices)
+            { // for each vertex
+            arrangement.translations[v.id] = {
+                (v.id % m) * offset,
+                0.0f, 
+                (v.id / m) * offset};
+            } // for each vertex
+
+        for (uint32_t i = 0; i < nObjects; ++i)
+	    arrangement.centre += arrangement.translations[i];
+
+        arrangement.centre /= nObjects;
+        arrangement.arranged = true;
+        }
+
+        for (uint32_t i = 0; i < nObjects; ++i)
+            { // for each object	
+            objects.model[i] = glm::mat4(1.0f);
+            objects.model[i] = glm::translate(objects.model[i], arrangement.translations[i] - arrangement.centre);
+            objects.model[i] = glm::scale(objects.model[i], glm::vec3(0.5f, 0.5f, 0.5f));
+            objects.model[i] = glm::rotate(objects.model[i], glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+            objects.raster[i].model = objects.model[i];
+            simulation.positions[i] = arrangement.translations[i] - arrangement.centre;
+            } // for each object
+
+        // the tree follows the arrangement too, as the shadow frustum
+        // is fitted to it before the simulation first steps
+        simulation.bvh.update(simulation.positions, simulation.bounds * 0.5f);
+
+	} // VulkanApp :: arrangeObjects
+
+
+//
+//
+//
+void VulkanApp::createPhysicsState ()
+    { // VulkanApp :: createPhysicsState
+		
+    std::uniform_real_distribution<float> posDist (-0.01, 0.01);
+    std::uniform_real_distribution<float> angDist(-10.0, 10.0);
+
+    simulation.positions.resize(nObjects);
+    simulation.velocities.resize(nObjects);
+    simulation.orientations.resize(nObjects);
+    simulation.rotations.resize(nObjects);
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        simulation.velocities[i]   = glm::vec3(posDist(rng), posDist(rng), posDist(rng));
+        simulation.rotations[i]    = glm::vec3(angDist(rng), angDist(rng), angDist(rng));
+        simulation.orientations[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+        simulation.bounds          = 2.0f;
+        } // for each object
+
+    } // VulkanApp :: createPhysicsState
+
+
+//
+//
+//
+void VulkanApp::updatePhysicsState ()
+    { // VulkanApp :: updatePhysicsState
+
+    // advance the simulation
+    for (uint32_t i = 0; i < nObjects; ++i)
+        {
+        simulation.positions[i] += simulation.velocities[i] * (float)timing.delta * 0.05f;
+        simulation.orientations[i] += simulation.rotations[i] * (float)timing.delta * 0.005f;
+        }
+
+    // collide with boundary
+    for (uint32_t i = 0; i < nObjects; ++i)
+        if (glm::length(simulation.positions[i]) > 12.0f)
+            { 
+            //simulation.positions[i] = glm::normalize(simulation.positions[i]) * (nObjects * 0.9f);
+            simulation.velocities[i] = glm::normalize(simulation.positions[i]) * -0.01f;
+            }
+
+    simulation.bvh.update(simulation.positions, simulation.bounds * 0.5f);
+
+    // collide with eachother
+    for (uint32_t i = 0; i < nObjects; ++i)
+        {
+        simulation.bvh.sphere(simulation.positions[i], simulation.bounds * 0.5f, simulation.nearby);
+
+        for (uint32_t j : simulation.nearby)
+            {
+            if (i == j) 
+                continue;
+
+            float minDist = simulation.bounds;
+            float actDist = glm::length(simulation.positions[i] - simulation.positions[j]);
+            if (actDist < minDist)
+                { 
+                simulation.velocities[i] = glm::normalize(simulation.positions[i] - simulation.positions[j]) * 0.01f;
+                simulation.velocities[j] = glm::normalize(simulation.positions[j] - simulation.positions[i]) * 0.01f;
+                }
+            }
+        }
+
+	} // VulkanApp :: updatePhysicsState
+
+
+//
+//
+//
+void VulkanApp::updateGeometryUniforms ()
+    { // VulkanApp :: updateGeometryUniforms
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        {
+        objects.model[i] = glm::mat4(1.0f);
+        objects.model[i] = glm::translate(objects.model[i], simulation.positions[i]);
+        objects.model[i] = glm::scale(objects.model[i], glm::vec3(0.5f, 0.5f, 0.5f));
+        objects.model[i] = glm::rotate(objects.model[i], glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        objects.model[i] = glm::rotate(objects.model[i], glm::radians(simulation.orientations[i].z), glm::vec3(0.0f, 0.0f, 1.0f));
+        objects.model[i] = glm::rotate(objects.model[i], glm::radians(simulation.orientations[i].y), glm::vec3(0.0f, 1.0f, 0.0f));
+        objects.model[i] = glm::rotate(objects.model[i], glm::radians(simulation.orientations[i].x), glm::vec3(1.0f, 0.0f, 0.0f));
+        }
+
+    // the geometry subpass draws in model space, so only the shading
+    // and raster passes take the transforms, as they upload their own
+
+    } // VulkanApp :: updateGeometryUniforms
+
+
+//
+//
+//
+void VulkanApp::updateShadingUniforms ()
+    { // VulkanApp :: updateShadingUniforms
+
+	if (animateLights)
+        {
+        ubo.shading.lightPosition.x = sin (timing.timer * 0.1f) * 4.0f;
+        ubo.shading.lightPosition.y = cos (timing.timer * 0.1f) * 4.0f;
+        }
+
+	if (regenerateMaterials)
+		{
+		rng.seed(time(0));
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		for (uint32_t i = 0; i < nObjects; ++i)
+			objects.shading[i].material = { 
+                dist(rng), 
+                dist(rng), 
+                dist(rng), 
+                dist(rng) };
+
+		regenerateMaterials = false;
+		}
+
+	for (uint32_t i = 0; i < nObjects; ++i)
+		objects.shading[i].model = objects.model[i];
+
+	// only read when the specular layer is lit into the atlas
+	ubo.shading.eyePosition = glm::vec4(eyePosition, 1.0f);
+	ubo.shading.lighting.z  = (layers.specular == ShadingLayerState::eAtlas) ? 1 : 0;
+
+	ubo.shading.temporal = glm::vec4(temporal.weight, temporal.distance, 0.0f, 0.0f);
+	ubo.shading.history  = glm::uvec4(temporal.enabled ? 1 : 0, temporal.subset, temporal.passes % temporal.subset, 0);
+
+	// the shadow layers are drawn and looked up through the same frustum
+	ubo.shading.lightViewProjection = lightViewProjection();
+	ubo.shading.shadowing           = glm::uvec4(shadows.enabled ? 1 : 0, 0, 0, 0);
+
+	memcpy(stageBuffer(buffers.shadingUniform, 0, sizeof(UniformBufferObjects::ShadingUBO)),          &ubo.shading,           sizeof(UniformBufferObjects::ShadingUBO));
+	memcpy(stageBuffer(buffers.shadingObjects, 0, sizeof(ObjectData::Shading) * nObjects), objects.shading.data(), sizeof(ObjectData::Shading) * nObjects);
+
+    } // VulkanApp :: updateShadingUniforms
+
+
+//
+//  generateLights
+//
+//  scatters the point lights over the objects and uploads them with
+//  the shading uniforms. The same count always places the same
+//  lights, so benchmarks can be compared between runs
+//
+void VulkanApp::generateLights ()
+    { // VulkanApp :: generateLights
+
+    std::default_random_engine generator (lights.count);
+
+    float extent = 0.5f * sqrt((float)nObjects) * offset + offset;
+    std::uniform_real_distribution<float> across (-extent, extent);
+    std::uniform_real_distribution<float> height (-1.0f, 1.0f);
+    std::uniform_real_distribution<float> tint   (0.2f, 1.0f);
+
+    // the lights are dimmed by how many of them reach an average
+    // point, so the scene doesn't wash out as more are added
+    float volume  = 4.0f * extent * extent * 2.0f;
+    float reach   = 4.0f / 3.0f * 3.14159265f * lights.radius * lights.radius * lights.radius;
+    float dimming = 1.0f / std::max(1.0f, (float)lights.count * reach / volume);
+
+    lights.list.resize(lights.count);
+    for (LightState::Light& light : lights.list)
+        { // for each light
+        light.position = glm::vec4(across(generator), height(generator), across(generator), lights.radius);
+        light.color    = glm::vec4(tint(generator), tint(generator), tint(generator), 1.0f) * dimming;
+        } // for each light
+
+    ubo.shading.lighting = glm::uvec4(lights.count, lights.culled ? 1 : 0, (layers.specular == ShadingLayerState::eAtlas) ? 1 : 0, 0);
+
+    if (!lights.list.empty())
+        memcpy(stageBuffer(buffers.lights, 0, sizeof(LightState::Light) * lights.list.size()), lights.list.data(), sizeof(LightState::Light) * lights.list.size());
+
+    memcpy(stageBuffer(buffers.shadingUniform, 0, sizeof(UniformBufferObjects::ShadingUBO)), &ubo.shading, sizeof(UniformBufferObjects::ShadingUBO));
+
+    } // VulkanApp :: generateLights
+
+
+//
+//
+//
+void VulkanApp::updateRasterUniforms ()
+    { // VulkanApp :: updateRasterUniforms
+
+	// the pyramid the last frame left behind was drawn with the
+	// camera we're about to replace
+	occlusion.viewProjection = ubo.raster.proj * ubo.raster.view;
+
+	for (uint32_t i = 0; i < nObjects; ++i)
+		{
+		objects.raster[i].model    = objects.model[i];
+		objects.raster[i].material = objects.shading[i].material;
+		}
+
+	float aspect = (float)swapchain.extent.width / (float)swapchain.extent.height;
+
+	ubo.raster.proj = glm::perspective(1.0f, aspect, 0.01f, 100.0f);
+	ubo.raster.proj[1][1] *= -1;
+	ubo.raster.view = glm::lookAt(
+		eyePosition,                      // position
+		eyePosition + glm::vec3{ 0.0f, -1.0f, 0.0f },  // center
+		glm::vec3{ 0.0f, 0.0f, 1.00f }); // world up
+
+	ubo.raster.lightPosition = ubo.shading.lightPosition;
+	ubo.raster.eyePosition   = glm::vec4(eyePosition, 1.0f);
+	ubo.raster.layers        = glm::uvec4((layers.specular == ShadingLayerState::eRaster) ? 1 : 0, 0, 0, 0);
+
+	ubo.raster.lightViewProjection = shadows.drawnWith;
+	ubo.raster.shadowing           = ubo.shading.shadowing;
+
+	memcpy(stageBuffer(buffers.rasterUniform, 0, sizeof(UniformBufferObjects::RasterUBO)),          &ubo.raster,           sizeof(UniformBufferObjects::RasterUBO));
+	memcpy(stageBuffer(buffers.rasterObjects, 0, sizeof(ObjectData::Raster) * nObjects), objects.raster.data(), sizeof(ObjectData::Raster) * nObjects);
+
+    } // VulkanApp :: updateRasterUniforms
+
+
+//
+//  cullObjects
+//
+//  places each object's bounding sphere with its model matrix and
+//  tests them all against the raster camera's frustum
+//
+void VulkanApp::cullObjects ()
+    { // VulkanApp :: cullObjects
+
+    occlusion.occluded = 0;
+
+    if (!culling.enabled || culling.gpu)
+        return;
+
+    if (culling.spheres.count != nObjects)
+        culling.spheres.resize(nObjects);
+
+    glm::vec4 centroid = glm::vec4(glm::vec3(culling.meshBounds), 1.0f);
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        const glm::mat4& model = objects.raster[i].model;
+
+        // the sphere grows with the largest scale on any axis
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        culling.spheres.set(i, glm::vec3(model * centroid), culling.meshBounds.w * scale);
+        } // for each object
+
+    FrustumCulling::Frustum frustum = FrustumCulling::extract(ubo.raster.proj * ubo.raster.view);
+    FrustumCulling::cull(frustum, culling.spheres, culling.visible);
+
+    if (!occlusion.enabled || !occlusion.supported)
+        return;
+
+    // the loop has waited on the last frame in this slot, so the
+    // levels it copied out can be read in place, against its camera
+    uint32_t slot = timing.frame % MAX_FRAMES_IN_FLIGHT;
+
+    void* data;
+    core.logicalDevice.mapMemory(buffers.depthReadback[slot].memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data);
+    occlusion.occluded = OcclusionCulling::cull(
+        occlusion.pyramid,
+        occlusion.hostLevel,
+        static_cast<const float*>(data),
+        occlusion.readbackViewProjection[slot],
+        culling.spheres,
+        culling.visible);
+    core.logicalDevice.unmapMemory(buffers.depthReadback[slot].memory);
+
+    } // VulkanApp :: cullObjects
+
+
+//
+//  updateClusterCulling
+//
+//  works out where the camera will be by the time the next shading
+//  pass is replaced, assuming it keeps its predicted velocity. Whether
+//  a cluster faces a point is a half space test, so a cluster facing
+//  neither end of a straight path faces none of it
+//
+void VulkanApp::updateClusterCulling ()
+    { // VulkanApp :: updateClusterCulling
+
+    clusters.eye          = eyePosition;
+    clusters.predictedEye = eyePosition + prediction.velocity * (float)shading.interval;
+
+    } // VulkanApp :: updateClusterCulling
+
+
+//
+//  updateCullingBuffers
+//
+//  hands the culling shader this frame's transforms and frustum,
+//  and picks up the visible count the last dispatch left behind
+//
+void VulkanApp::updateCullingBuffers ()
+    { // VulkanApp :: updateCullingBuffers
+
+    if (!culling.gpu)
+        return;
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        {
+        culling.objects[i].model = objects.raster[i].model;
+        culling.objects[i].shade = geometryCache.redraw[i];
+        }
+
+    // with culling switched off every object passes a frustum that
+    // rejects nothing
+    FrustumCulling::Frustum frustum = FrustumCulling::extract(ubo.raster.proj * ubo.raster.view);
+    for (uint32_t p = 0; p < 6; ++p)
+        ubo.culling.planes[p] = culling.enabled ? frustum.planes[p] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    ubo.culling.objectCount = nObjects;
+
+    ubo.culling.eye            = glm::vec4(clusters.eye, 1.0f);
+    ubo.culling.predictedEye   = glm::vec4(clusters.predictedEye, 1.0f);
+    ubo.culling.clusterCount   = static_cast<uint32_t>(clusters.list.size());
+    ubo.culling.clusterCulling = (clusters.enabled && !geometryCache.enabled) ? 1 : 0;
+
+    // the pyramid is tested against by the same frame it was built
+    // for the next, so it's only skipped with culling off altogether
+    ubo.culling.occlusionViewProjection = occlusion.viewProjection;
+    ubo.culling.occlusion               = (culling.enabled && occlusion.enabled && occlusion.supported) ? 1 : 0;
+    ubo.culling.levelCount              = occlusion.pyramid.levelCount;
+
+    for (uint32_t l = 0; l < occlusion.pyramid.levelCount; ++l)
+        {
+        const OcclusionCulling::Level& level = occlusion.pyramid.levels[l];
+        ubo.culling.levels[l] = glm::uvec4(level.offset, level.width, level.height, 0);
+        }
+
+    memcpy(stageBuffer(buffers.cullingUniform, 0, sizeof(UniformBufferObjects::CullingUBO)),      &ubo.culling,           sizeof(UniformBufferObjects::CullingUBO));
+    memcpy(stageBuffer(buffers.cullingObjects, 0, sizeof(CullingState::Object) * nObjects), culling.objects.data(), sizeof(CullingState::Object) * nObjects);
+
+    // the count the last frame in this slot copied out after its flags
+    uint32_t slot = timing.frame % MAX_FRAMES_IN_FLIGHT;
+
+    void* data;
+    core.logicalDevice.mapMemory(buffers.frameReadback[slot].memory, sizeof(uint32_t) * nObjects, sizeof(uint32_t), vk::MemoryMapFlags{}, &data);
+    memcpy(&culling.gpuVisible, data, sizeof(uint32_t));
+    core.logicalDevice.unmapMemory(buffers.frameReadback[slot].memory);
+
+    } // VulkanApp :: updateCullingBuffers
+
+
+//
+//  readVisibilityFeedback
+//
+//  collects the flags copied out by the last raster frame in this
+//  frame's slot, which the loop has already waited on. That costs a
+//  frame in flight of latency but never a stall. The copy is cleared
+//  after reading, in case the frame in the slot was dropped
+//
+void VulkanApp::readVisibilityFeedback ()
+    { // VulkanApp :: readVisibilityFeedback
+
+    if (!core.features.fragmentStoresAndAtomics)
+        return;
+
+    uint32_t slot = timing.frame % MAX_FRAMES_IN_FLIGHT;
+
+    void* data;
+    core.logicalDevice.mapMemory(buffers.frameReadback[slot].memory, 0, sizeof(uint32_t) * nObjects, vk::MemoryMapFlags{}, &data);
+    memcpy(feedback.flags.data(), data, sizeof(uint32_t) * nObjects);
+    memset(data, 0, sizeof(uint32_t) * nObjects);
+    core.logicalDevice.unmapMemory(buffers.frameReadback[slot].memory);
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        if (!feedback.flags[i])
+            continue;
+
+        // an object that was just put on screen with a tile the last
+        // pass skipped is showing stale shading, so it can't wait
+        if (feedback.enabled && !feedback.fresh[i])
+            feedback.urgent = true;
+
+        feedback.lastSeen[i] = timing.frame;
+        } // for each object
+
+    } // VulkanApp :: readVisibilityFeedback
+
+
+//
+//  predictVisibility
+//
+//  extrapolates the camera's recent motion over the frames the next
+//  shading pass has to cover, and finds the objects that come into
+//  view along the way, so their tiles are already shaded by the time
+//  they're seen rather than being caught by the feedback a frame late
+//
+void VulkanApp::predictVisibility ()
+    { // VulkanApp :: predictVisibility
+
+    // smoothed, as the keys move the camera a fixed step each frame
+    // but scrolling moves it in bursts
+    glm::vec3 step = eyePosition - prediction.lastEye;
+    prediction.velocity = glm::mix(prediction.velocity, step, prediction.smoothing);
+    prediction.lastEye  = eyePosition;
+
+    prediction.visible.clear();
+
+    if (!prediction.enabled || glm::length(prediction.velocity) < 0.001f)
+        return;
+
+    if (prediction.spheres.count != nObjects)
+        prediction.spheres.resize(nObjects);
+
+    glm::vec4 centroid = glm::vec4(glm::vec3(culling.meshBounds), 1.0f);
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        const glm::mat4& model = objects.model[i];
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        prediction.spheres.set(i, glm::vec3(model * centroid), culling.meshBounds.w * scale);
+        } // for each object
+
+    prediction.seen.assign(nObjects, 0);
+
+    // the pass after next can be up to two intervals away, and until
+    // it's drawn the atlas holds whatever the next one shaded. Moving
+    // the eye is the same as moving the world the other way
+    uint32_t horizon = 2 * shading.interval;
+    for (uint32_t k = 1; k <= horizon; ++k)
+        { // for each frame ahead
+        glm::mat4 view = ubo.raster.view * glm::translate(glm::mat4(1.0f), -prediction.velocity * (float)k);
+
+        FrustumCulling::Frustum frustum = FrustumCulling::extract(ubo.raster.proj * view);
+        FrustumCulling::cull(frustum, prediction.spheres, prediction.found);
+
+        for (uint32_t i : prediction.found)
+            prediction.seen[i] = 1;
+        } // for each frame ahead
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        if (prediction.seen[i])
+            prediction.visible.push_back(i);
+
+    } // VulkanApp :: predictVisibility
+
+
+//
+//  selectShadingTiles
+//
+//  picks the atlas tiles the next shading pass will light, which
+//  are those of every object seen within the last few frames, and
+//  whether the blocks within them are masked by what was sampled
+//
+void VulkanApp::selectShadingTiles ()
+    { // VulkanApp :: selectShadingTiles
+
+    feedback.shadeCount = 0;
+
+    // once the pyramid has narrowed down the frustum's list, what the
+    // host culling kept is a frame earlier than the raster pass can
+    // report, so an object coming out from behind another doesn't
+    // have to be drawn stale before its tile is shaded
+    if (feedback.enabled && culling.enabled && !culling.gpu && occlusion.enabled && occlusion.supported)
+        for (uint32_t i : culling.visible)
+            { // for each predicted visible object
+            if (!feedback.fresh[i])
+                feedback.urgent = true;
+
+            feedback.lastSeen[i] = timing.frame;
+            } // for each predicted visible object
+
+    // objects the camera is heading towards are shaded with the next
+    // scheduled pass, which is early enough not to need an urgent one
+    prediction.ahead = 0;
+    if (feedback.enabled)
+        for (uint32_t i : prediction.visible)
+            { // for each object about to come into view
+            if (timing.frame - feedback.lastSeen[i] > feedback.linger)
+                prediction.ahead++;
+
+            feedback.lastSeen[i] = timing.frame;
+            } // for each object about to come into view
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        {
+        feedback.shade[i] = !feedback.enabled || (timing.frame - feedback.lastSeen[i] <= feedback.linger);
+        feedback.shadeCount += feedback.shade[i];
+        }
+
+    // until there's been time for anything to be sampled, and whenever
+    // feedback is off, the dilation marks every block of the atlas.
+    // Tiles are only refreshed whole by the pass that moves them
+    ubo.feedback.full = (!feedback.enabled || timing.frame <= feedback.linger) ? 1 : 0;
+
+    memcpy(stageBuffer(buffers.feedbackUniform, 0, sizeof(UniformBufferObjects::FeedbackUBO)), &ubo.feedback, sizeof(UniformBufferObjects::FeedbackUBO));
+
+    } // VulkanApp :: selectShadingTiles
+
+
+//
+//  selectShadingLevels
+//
+//  picks the resolution each object's next shading pass draws it
+//  at, from the size its bounding sphere covers on the screen
+//
+void VulkanApp::selectShadingLevels ()
+    { // VulkanApp :: selectShadingLevels
+
+    float tileSize = (float)paging.table.pageSize;
+
+    glm::vec4 centroid = glm::vec4(glm::vec3(culling.meshBounds), 1.0f);
+
+    std::fill(std::begin(lod.counts), std::end(lod.counts), 0);
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        uint32_t level = 0;
+
+        const glm::mat4& model = objects.model[i];
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        lod.pixels[i] = ShadingLevels::projectedSize(
+            ubo.raster.view,
+            ubo.raster.proj,
+            (float)swapchain.extent.height,
+            glm::vec3(model * centroid),
+            culling.meshBounds.w * scale);
+
+        if (lod.enabled)
+            level = ShadingLevels::select(lod.target[i], tileSize, lod.pixels[i]);
+
+        lod.target[i] = level;
+        lod.counts[level]++;
+        } // for each object
+
+    lod.reduced = lod.counts[0] != nObjects;
+
+    } // VulkanApp :: selectShadingLevels
+
+
+//
+//  selectResidency
+//
+//  gives every object being shaded a place in the paged atlas at
+//  its chosen level, largest on screen first, evicting the objects
+//  used least recently when the pages run out. Objects that can't
+//  have their level are moved to the finest one that fits, and an
+//  object that has moved has its cached geometry drawn again
+//
+void VulkanApp::selectResidency ()
+    { // VulkanApp :: selectResidency
+
+    VirtualAtlas& table = paging.table;
+    uint64_t frame = ++paging.frame;
+
+    // static recordings shade every object
+    bool everything = command.recording == VulkanCommandState::eStatic;
+
+    std::vector<uint32_t> requests;
+    for (uint32_t i = 0; i < nObjects; ++i)
+        if (everything || feedback.shade[i])
+            requests.push_back(i);
+
+    std::stable_sort(requests.begin(), requests.end(), [&] (uint32_t a, uint32_t b) { return lod.pixels[a] > lod.pixels[b]; });
+
+    // what's asked for this frame is kept from eviction, and every
+    // object still without a page needs at least a cell left for it
+    uint32_t reserve = 0;
+    for (uint32_t i : requests)
+        {
+        if (table.entries[i].resident)
+            table.touch(i, frame);
+        else reserve++;
+        }
+
+    std::vector<VirtualAtlas::Entry> before = table.entries;
+
+    for (uint32_t i : requests)
+        { // for each request
+        if (!table.entries[i].resident)
+            reserve--;
+
+        // which the reserve rules out, but an object left without a
+        // page can't be shaded
+        if (!table.request(i, lod.target[i], frame, reserve))
+            { // no room
+            if (feedback.shade[i])
+                feedback.shadeCount--;
+
+            feedback.shade[i] = 0;
+            continue;
+            } // no room
+
+        lod.target[i] = table.entries[i].level;
+        } // for each request
+
+    // evicted objects have lost their geometry along with their cells
+    for (uint32_t i = 0; i < nObjects; ++i)
+        {
+        const VirtualAtlas::Entry& entry = table.entries[i];
+        if (entry.resident != before[i].resident || entry.page != before[i].page || entry.x != before[i].x || entry.y != before[i].y || entry.level != before[i].level)
+            geometryCache.valid[i] = 0;
+        }
+
+    std::fill(std::begin(lod.counts), std::end(lod.counts), 0);
+    for (uint32_t level : lod.target)
+        lod.counts[level]++;
+
+    lod.reduced = lod.counts[0] != nObjects;
+
+    } // VulkanApp :: selectResidency
+
+
+//
+//  selectGeometryRedraws
+//
+//  picks the shaded tiles whose geometry has to be drawn again this
+//  pass, which with the cache off is every one of them
+//
+void VulkanApp::selectGeometryRedraws ()
+    { // VulkanApp :: selectGeometryRedraws
+
+    geometryCache.redrawCount = 0;
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        bool stale = !geometryCache.enabled || !geometryCache.valid[i] || geometryCache.level[i] != lod.target[i];
+
+        geometryCache.redraw[i] = feedback.shade[i] && stale;
+        geometryCache.redrawCount += geometryCache.redraw[i];
+        } // for each object
+
+    } // VulkanApp :: selectGeometryRedraws
+
+
+//
+//  commitShadingLevels
+//
+//  hands the chosen levels to the shading pass about to be submitted.
+//  The raster pass keeps sampling each tile the way it was last shaded
+//  until this pass has redrawn it, and a tile whose level changed is
+//  lit whole, as what was sampled of it no longer lines up
+//
+void VulkanApp::commitShadingLevels ()
+    { // VulkanApp :: commitShadingLevels
+
+    uint32_t m = std::max(1u, (uint32_t)sqrt(nObjects));
+
+    // static recordings draw every object whatever was selected
+    bool everything = command.recording == VulkanCommandState::eStatic;
+
+    // the last pass's refreshes are cleared, which only needs doing
+    // when it had any
+    bool refreshed = feedback.refreshed;
+    if (feedback.refreshed)
+        std::fill(feedback.refresh.begin(), feedback.refresh.end(), 0);
+
+    feedback.refreshed = false;
+
+    // objects without a page are drawn outside the atlas, where the
+    // geometry subpass clips them away rather than letting them draw
+    // over the objects that have their cells now, and raster.frag
+    // lights them itself
+    const glm::vec4 unplaced = glm::vec4(0.0f, 0.0f, -1.0f, -1.0f);
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+
+        glm::vec4 previous = objects.atlas[i];
+
+        glm::vec2 origin = glm::vec2((float)(i % m), (float)(i / m)) / (float)m;
+        objects.atlas[i] = paging.table.entries[i].resident
+            ? paging.table.transform(i, origin, 1.0f / (float)m)
+            : unplaced;
+
+        // a tile that isn't being shaded keeps being sampled where
+        // it was, unless the page table has given its cells away or
+        // moved it, when there's nothing of it left to sample
+        if (!everything && !feedback.shade[i])
+            {
+            if (objects.atlas[i] != previous)
+                objects.raster[i].atlas = unplaced;
+            continue;
+            }
+
+        // a tile that changed level or moved to another page holds
+        // nothing the raster pass sampled where it is now
+        if (objects.raster[i].atlas != objects.atlas[i] && paging.table.entries[i].resident)
+            { // refresh the tile's blocks
+            glm::uvec4 texels = paging.table.rect(i);
+            glm::uvec4 blocks = glm::uvec4(texels.x, texels.y, texels.z + feedback.BLOCK_SIZE - 1, texels.w + feedback.BLOCK_SIZE - 1) / feedback.BLOCK_SIZE;
+
+            for (uint32_t y = blocks.y; y < blocks.w && y < feedback.blocksPerRow; ++y)
+                for (uint32_t x = blocks.x; x < blocks.z && x < feedback.blocksPerRow; ++x)
+                    feedback.refresh[y * feedback.blocksPerRow + x] = 1;
+
+            feedback.refreshed = true;
+            } // refresh the tile's blocks
+
+        lod.shaded[i]           = lod.target[i];
+        objects.raster[i].atlas = objects.atlas[i];
+        } // for each object
+
+    memcpy(stageBuffer(buffers.geometryObjects, 0, sizeof(glm::vec4) * nObjects),                 objects.atlas.data(),  sizeof(glm::vec4) * nObjects);
+    memcpy(stageBuffer(buffers.rasterObjects,   0, sizeof(ObjectData::Raster) * nObjects),       objects.raster.data(), sizeof(ObjectData::Raster) * nObjects);
+    memcpy(stageBuffer(buffers.feedbackUniform, 0, sizeof(UniformBufferObjects::FeedbackUBO)), &ubo.feedback,         sizeof(UniformBufferObjects::FeedbackUBO));
+
+    if (refreshed || feedback.refreshed)
+        memcpy(stageBuffer(buffers.refreshBlocks, 0, sizeof(uint32_t) * feedback.refresh.size()), feedback.refresh.data(), sizeof(uint32_t) * feedback.refresh.size());
+
+    } // VulkanApp :: commitShadingLevels
+
+
+//
+//  commitLightingTiles
+//
+//  cuts the tiles being shaded this pass, at their shading level,
+//  into the workgroups the lighting shader is dispatched over
+//
+void VulkanApp::commitLightingTiles ()
+    { // VulkanApp :: commitLightingTiles
+
+    tiledLighting.tiles.clear();
+
+    // static recordings light the atlas with the subpass
+    if (!tiledLighting.enabled || command.recording == VulkanCommandState::eStatic)
+        return;
+
+    uint32_t t = tiledLighting.tileSize;
+
+    for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        if (!feedback.shade[i])
+            continue;
+
+        vk::Rect2D rect = atlasTile(i);
+        glm::uvec2 limit = glm::uvec2(rect.offset.x + rect.extent.width, rect.offset.y + rect.extent.height);
+
+        for (uint32_t y = rect.offset.y; y < limit.y; y += t)
+            for (uint32_t x = rect.offset.x; x < limit.x; x += t)
+                tiledLighting.tiles.push_back(TiledLightingState::Tile { glm::uvec2(x, y), limit });
+        } // for each object
+
+    if (tiledLighting.tiles.empty())
+        return;
+
+    memcpy(stageBuffer(buffers.lightingTiles, 0, sizeof(TiledLightingState::Tile) * tiledLighting.tiles.size()), tiledLighting.tiles.data(), sizeof(TiledLightingState::Tile) * tiledLighting.tiles.size());
+
+    } // VulkanApp :: commitLightingTiles
+
+
+//
+//  commitMipTiles
+//
+//  cuts the tiles being shaded this pass, at their shading level,
+//  into the workgroups each level of the mip chain is averaged by,
+//  and writes them after the whole atlas's tiles
+//
+void VulkanApp::commitMipTiles ()
+    { // VulkanApp :: commitMipTiles
+
+    mips.tiles.clear();
+    for (uint32_t l = 0; l < MipState::MAX_LEVELS; ++l)
+        mips.pass[l] = MipState::Range { };
+
+    // static recordings average the whole atlas's tiles
+    if (mips.levels == 1 || command.recording == VulkanCommandState::eStatic)
+        return;
+
+    uint32_t base = mips.whole[mips.levels - 1].first + mips.whole[mips.levels - 1].count;
+
+    for (uint32_t l = 1; l < mips.levels; ++l)
+        { // for each level
+        mips.pass[l].first = base + static_cast<uint32_t>(mips.tiles.size());
+
+        for (uint32_t i = 0; i < nObjects; ++i)
+            if (feedback.shade[i])
+                cutMipTiles(atlasTile(i), l);
+
+        mips.pass[l].count = base + static_cast<uint32_t>(mips.tiles.size()) - mips.pass[l].first;
+        } // for each level
+
+    if (mips.tiles.empty())
+        return;
+
+    memcpy(stageBuffer(buffers.mipTiles, sizeof(MipState::Tile) * base, sizeof(MipState::Tile) * mips.tiles.size()), mips.tiles.data(), sizeof(MipState::Tile) * mips.tiles.size());
+
+    } // VulkanApp :: commitMipTiles
+
+
+//
+//  cutMipTiles
+//
+//  appends the tiles covering a rect of the first level at the given
+//  level of the mip chain, rounded outwards, each keeping the rect at
+//  the level above as the chart its average is confined to
+//
+void VulkanApp::cutMipTiles (vk::Rect2D rect, uint32_t level)
+    { // VulkanApp :: cutMipTiles
+
+    uint32_t t = MipState::GROUP_SIZE;
+
+    uint32_t x0 = (uint32_t)rect.offset.x;
+    uint32_t y0 = (uint32_t)rect.offset.y;
+    uint32_t x1 = x0 + rect.extent.width;
+    uint32_t y1 = y0 + rect.extent.height;
+
+    // the rect at a level, from the first texel it touches to past
+    // the last
+    auto scaled = [&] (uint32_t l)
+        {
+        uint32_t round = (1u << l) - 1;
+        return glm::uvec4(x0 >> l, y0 >> l, (x1 + round) >> l, (y1 + round) >> l);
+        };
+
+    glm::uvec4 limits = scaled(level);
+    glm::uvec4 chart  = scaled(level - 1);
+
+    for (uint32_t y = limits.y; y < limits.w; y += t)
+        for (uint32_t x = limits.x; x < limits.z; x += t)
+            {
+            glm::uvec4 block = glm::uvec4(x, y, (x + t < limits.z) ? x + t : limits.z, (y + t < limits.w) ? y + t : limits.w);
+            mips.tiles.push_back(MipState::Tile { block, chart });
+            }
+
+    } // VulkanApp :: cutMipTiles
+
+
+//
+//  atlasTile
+//
+//  the texels of the atlas the page table gives an object, which
+//  are sized for the shading level it was last made resident at
+//
+vk::Rect2D VulkanApp::atlasTile (uint32_t id)
+    { // VulkanApp :: atlasTile
+
+    glm::uvec4 rect = paging.table.rect(id);
+
+    return vk::Rect2D { vk::Offset2D { (int32_t)rect.x, (int32_t)rect.y }, vk::Extent2D { rect.z - rect.x, rect.w - rect.y } };
+
+    } // VulkanApp :: atlasTile
+
+
+//
+//  shadowReach
+//
+//  how far from the middle of the scene any object reaches now, from
+//  the simulation's tree. Its root bounds the collision spheres, so
+//  is shrunk back to the centres and grown again by the mesh as the
+//  models scale it
+//
+float VulkanApp::shadowReach ()
+    { // VulkanApp :: shadowReach
+
+    if (simulation.bvh.nodes.empty())
+        return shadows.radius;
+
+    const SceneBVH::Node& root = simulation.bvh.nodes[0];
+    float sphere = simulation.bounds * 0.5f;
+
+    glm::vec3 corner = glm::max(glm::abs(root.min + sphere), glm::abs(root.max - sphere));
+    float     mesh   = 0.5f * (glm::length(glm::vec3(culling.meshBounds)) + culling.meshBounds.w);
+
+    return glm::length(corner) + mesh;
+
+    } // VulkanApp :: shadowReach
+
+
+//
+//  lightViewProjection
+//
+//  the moving light's frustum, looking at the middle of the scene and
+//  just wide enough to take in the sphere the objects reach to, with
+//  depth in the range vulkan clips to
+//
+glm::mat4 VulkanApp::lightViewProjection ()
+    { // VulkanApp :: lightViewProjection
+
+    // refitting only as the light moves keeps the frustum, and so the
+    // static layer, as it was while the light keeps still
+    float reach = shadowReach();
+    if (!shadows.fitted || ubo.shading.lightPosition != shadows.fittedLight || reach > shadows.radius)
+        {
+        shadows.radius      = reach;
+        shadows.fittedLight = ubo.shading.lightPosition;
+        shadows.fitted      = true;
+        }
+
+    glm::vec3 light    = glm::vec3(ubo.shading.lightPosition);
+    float     distance = glm::length(light);
+
+    // straight at the middle, unless the light is sat on it
+    glm::vec3 direction = (distance > 0.001f) ? -light / distance : glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 up        = (fabs(direction.z) < 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+    float fov = (distance > shadows.radius) ? 2.0f * asin(shadows.radius / distance) : shadows.maxFov;
+    fov = std::min(fov, shadows.maxFov);
+
+    float nearPlane = std::max(distance - shadows.radius, 0.1f);
+    float farPlane  = distance + shadows.radius;
+
+    // glm leaves depth in [-1, 1], which is halved and moved up
+    glm::mat4 clip = glm::mat4(1.0f);
+        clip[2][2] = 0.5f;
+        clip[3][2] = 0.5f;
+
+    return clip * glm::perspective(fov, 1.0f, nearPlane, farPlane) * glm::lookAt(light, light + direction, up);
+
+    } // VulkanApp :: lightViewProjection
+
+
+//
+//  selectShadowLayers
+//
+//  sorts the objects into the static and dynamic layers by how long
+//  they've kept still, and works out whether the static layer still
+//  holds what the light would see of its objects now
+//
+void VulkanApp::selectShadowLayers ()
+    { // VulkanApp :: selectShadowLayers
+
+    // nothing has moved before the first frame
+    if (shadows.lastModel.size() != nObjects)
+        shadows.lastModel = objects.model;
+
+    uint32_t still = shadows.settle * shading.interval;
+
+    shadows.dynamicCount = 0;
     for (uint32_t i = 0; i < nObjects; ++i)
+        { // for each object
+        if (memcmp(&shadows.lastModel[i], &objects.model[i], sizeof(glm::mat4)) != 0)
+            {
+            shadows.lastModel[i]   = objects.model[i];
+            shadows.stillFrames[i] = 0;
+            }
+        else if (shadows.stillFrames[i] < still)
+            shadows.stillFrames[i]++;
+
+        shadows.dynamic[i] = (shadows.stillFrames[i] < still) ? 1 : 0;
+        shadows.dynamicCount += shadows.dynamic[i];
+        } // for each object
+
+    shadows.setHash = ShadingCache::hash(shadows.dynamic.data(), shadows.dynamic.size());
+    shadows.hash    = ShadingCache::hash(&ubo.shading.lightViewProjection, sizeof(glm::mat4), shadows.setHash);
+
+    shadows.redrawStatic = shadows.enabled && shadows.hash != shadows.drawnHash;
+
+    } // VulkanApp :: selectShadowLayers
+
+
+//
+//  commitShadowLayers
+//
+//  notes what the pass just submitted left in each layer. A static
+//  recording draws every object into the static layer, which then
+//  holds the wrong set for any other until it's drawn again
+//
+void VulkanApp::commitShadowLayers ()
+    { // VulkanApp :: commitShadowLayers
+
+    if (command.recording == VulkanCommandState::eStatic)
+        {
+        shadows.drawnHash   = 0;
+        shadows.dynamicHeld = false;
+        shadows.staticDraws++;
+        return;
+        }
+
+    if (!shadows.enabled)
+        return;
+
+    if (shadows.redrawStatic)
+        {
+        shadows.drawnHash = shadows.hash;
+        shadows.staticDraws++;
+        }
+
+    shadows.dynamicHeld = shadows.dynamicCount > 0;
+
+    } // VulkanApp :: commitShadowLayers
+
+
+//
+//  shadingCacheStill
+//
+//  whether nothing the atlas is lit from is moving, which is the
+//  only time what's in it is worth keeping, or standing in for a pass
+//
+bool VulkanApp::shadingCacheStill ()
+    { // VulkanApp :: shadingCacheStill
+
+    return shadingCache.enabled && !animateLights && reset == 0;
+
+    } // VulkanApp :: shadingCacheStill
+
+
+//
+//  shadingCacheKey
+//
+//  the hash of everything that decides where the atlas's texels are
+//  and what they hold the surface of, which names the cache file
+//
+uint64_t VulkanApp::shadingCacheKey ()
+    { // VulkanApp :: shadingCacheKey
+
+    uint32_t layout[] = { nObjects, shading.BUFFER_SIZE, paging.table.pageSize, paging.table.pagesPerSide, mips.levels, (uint32_t)pipelines.shading.format, (uint32_t)layers.specular, shadows.enabled ? 1u : 0u };
+
+    uint64_t key = ShadingCache::hash(layout, sizeof(layout), shadingCache.scene);
+    key = ShadingCache::hash(objects.model.data(), sizeof(glm::mat4) * nObjects, key);
+
+    // where each tile sits, but not when it was last asked for
+    for (const VirtualAtlas::Entry& entry : paging.table.entries)
+        {
+        uint32_t placement[] = { entry.resident ? 1u : 0u, entry.page, entry.level, entry.x, entry.y };
+        key = ShadingCache::hash(placement, sizeof(placement), key);
+        }
+
+    return key;
+
+    } // VulkanApp :: shadingCacheKey
+
+
+//
+//  shadingCacheHash
+//
+//  the key carried on over the materials and lights the atlas was
+//  lit with, which a file is checked against once they're read in
+//
+uint64_t VulkanApp::shadingCacheHash (uint64_t key, const std::vector<glm::vec4>& materials, const glm::vec4& lightPosition, uint32_t lightCount)
+    { // VulkanApp :: shadingCacheHash
+
+    uint64_t hash = ShadingCache::hash(materials.data(), sizeof(glm::vec4) * materials.size(), key);
+    hash = ShadingCache::hash(&lightPosition, sizeof(glm::vec4), hash);
+    hash = ShadingCache::hash(&lightCount, sizeof(uint32_t), hash);
+    hash = ShadingCache::hash(&lights.radius, sizeof(float), hash);
+
+    return hash;
+
+    } // VulkanApp :: shadingCacheHash
+
+
+//
+//  restoreShadingCache
+//
+//  whether this frame's diffuse lighting can be left out, as the
+//  atlas read from disk already holds what it would light. The file is
+//  only looked for once, on the first of the frames everything is
+//  shaded in that nothing is moving, and is restored from on the
+//  first shading frame after the reader has finished with it
+//
+bool VulkanApp::restoreShadingCache ()
+    { // VulkanApp :: restoreShadingCache
+
+    if (timing.frame > feedback.linger || shadingCache.saved || !shadingCacheStill())
+        return false;
+
+    uint64_t key = shadingCacheKey();
+
+    if (!shadingCache.attempted)
         {
-        simulation.positions[i] += simulation.velocities[i] * (float)timing.delta * 0.05f;
-        simulation.orientations[i] += simulation.rotations[i] * (float)timing.delta * 0.005f;
+        shadingCache.attempted = true;
+        loadShadingCache(key);
         }
 
-    // collide with boundary
-    for (uint32_t i = 0; i < nObjects; ++i)
-        if (glm::length(simulation.positions[i]) > 12.0f)
-            { 
-            //simulation.positions[i] = glm::normalize(simulation.positions[i]) * (nObjects * 0.9f);
-            simulation.velocities[i] = glm::normalize(simulation.positions[i]) * -0.01f;
-            }
+    // the reader is only checked on, and the passes go on lighting
+    // the atlas as usual until it's done
+    if (shadingCache.reader.valid())
+        {
+        if (shadingCache.reader.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
 
-    // collide with eachother
-    for (uint32_t i = 0; i < nObjects; ++i)
-        for (uint32_t j = 0; j < nObjects; ++j)
-            {
-            if (i == j) 
-                continue;
+        shadingCache.loaded = shadingCache.reader.get() && uploadShadingCache(key);
+        }
 
-            float minDist = simulation.bounds;
-            float actDist = glm::length(simulation.positions[i] - simulation.positions[j]);
-            if (actDist < minDist)
-                { 
-                simulation.velocities[i] = glm::normalize(simulation.positions[i] - simulation.positions[j]) * 0.01f;
-                simulation.velocities[j] = glm::normalize(simulation.positions[j] - simulation.positions[i]) * 0.01f;
-                }
-            }
+    // the camera can still move the tiles about before the frames
+    // are up, which leaves the pass to light them where they are now
+    if (!shadingCache.loaded || key != shadingCache.key)
+        return false;
 
-	} // VulkanApp :: updatePhysicsState
+    return true;
+
+    } // VulkanApp :: restoreShadingCache
 
 
 //
+//  settleDiffuseLayer
 //
+//  whether this frame's diffuse lighting can be left out, as the
+//  layer it would light is what the last passes already lit. Urgent
+//  passes are for tiles that were never lit, so always go ahead
 //
-void VulkanApp::updateGeometryUniforms ()
-    { // VulkanApp :: updateGeometryUniforms
+bool VulkanApp::settleDiffuseLayer ()
+    { // VulkanApp :: settleDiffuseLayer
 
+    if (!layers.still)
+        return false;
+
+    std::vector<glm::vec4> materials (nObjects);
     for (uint32_t i = 0; i < nObjects; ++i)
+        materials[i] = objects.shading[i].material;
+
+    // what the cache tells an atlas by, along with what decides which
+    // texels a pass lights and how, but not the temporal rotation
+    uint64_t hash = shadingCacheHash(shadingCacheKey(), materials, ubo.shading.lightPosition, lights.count);
+
+    uint32_t settings[] = { ubo.feedback.full, feedback.enabled ? 1u : 0u, tiledLighting.enabled ? 1u : 0u, lights.culled ? 1u : 0u, ubo.shading.history.x, temporal.subset, (uint32_t)command.recording, (uint32_t)layers.specular, shadows.enabled ? 1u : 0u };
+    hash = ShadingCache::hash(settings, sizeof(settings), hash);
+    hash = ShadingCache::hash(&ubo.shading.temporal, sizeof(glm::vec4), hash);
+    hash = ShadingCache::hash(feedback.shade.data(), feedback.shade.size(), hash);
+
+    // the blocks the feedback has lit follow what the raster pass
+    // sampled, and a specular layer in the atlas follows the eye
+    if (feedback.enabled || layers.specular == ShadingLayerState::eAtlas)
+        hash = ShadingCache::hash(&ubo.raster.view, sizeof(glm::mat4), hash);
+
+    // with history a pass only moves a texel part of the way to what
+    // it's lit with now, and only the texels whose turn it is, so a
+    // change takes this many passes to settle
+    uint32_t settle = 1;
+    if (temporal.enabled && temporal.weight < 1.0f)
+        settle = temporal.subset * (uint32_t)ceil(log(0.01f) / log(1.0f - temporal.weight));
+
+    bool same = hash == layers.hash;
+    layers.hash = hash;
+
+    if (same && !feedback.urgent && layers.settled >= settle)
         {
-        ubo.geometry.model[i] = glm::mat4(1.0f);
-        ubo.geometry.model[i] = glm::translate(ubo.geometry.model[i], simulation.positions[i]);
-        ubo.geometry.model[i] = glm::scale(ubo.geometry.model[i], glm::vec3(0.5f, 0.5f, 0.5f));
-        ubo.geometry.model[i] = glm::rotate(ubo.geometry.model[i], glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.geometry.model[i] = glm::rotate(ubo.geometry.model[i], glm::radians(simulation.orientations[i].z), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.geometry.model[i] = glm::rotate(ubo.geometry.model[i], glm::radians(simulation.orientations[i].y), glm::vec3(0.0f, 1.0f, 0.0f));
-        ubo.geometry.model[i] = glm::rotate(ubo.geometry.model[i], glm::radians(simulation.orientations[i].x), glm::vec3(1.0f, 0.0f, 0.0f));
+        layers.skipped++;
+        return true;
         }
 
-    void* data;
-    core.logicalDevice.mapMemory(buffers.geometryUniform.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags{}, &data);
-    memcpy(data, &ubo.geometry, sizeof(UniformBufferObjects::GeometryUBO));
-    core.logicalDevice.unmapMemory(buffers.geometryUniform.memory);
+    layers.settled = same ? layers.settled + 1 : 1;
+    return false;
 
-    } // VulkanApp :: updateGeometryUniforms
+    } // VulkanApp :: settleDiffuseLayer
 
 
 //
+//  commitFreshTiles
 //
+//  takes the tiles the pass just shaded, or one left out would have,
+//  as holding what the raster pass should sample
 //
-void VulkanApp::updateShadingUniforms ()
-    { // VulkanApp :: updateShadingUniforms
+void VulkanApp::commitFreshTiles ()
+    { // VulkanApp :: commitFreshTiles
 
-	if (animateLights)
+    // static recordings shade everything regardless of the selection
+    if (command.recording == VulkanCommandState::eStatic)
+        std::fill(feedback.fresh.begin(), feedback.fresh.end(), 1);
+    else feedback.fresh = feedback.shade;
+    feedback.urgent = false;
+
+    } // VulkanApp :: commitFreshTiles
+
+
+//
+//  loadShadingCache
+//
+//  starts a worker reading the file for the key, which checks it
+//  against what this run places in the atlas and decompresses its
+//  texels straight into the copy's buffer. The materials and lights
+//  it was lit with are left in the header and materials for
+//  uploadShadingCache to put back
+//
+void VulkanApp::loadShadingCache (uint64_t key)
+    { // VulkanApp :: loadShadingCache
+
+    vk::Device              device    = core.logicalDevice;
+    vk::DeviceMemory        memory    = buffers.shadingCache.memory;
+    uint32_t                objects   = nObjects;
+    uint64_t                texels    = shadingCache.texels;
+    ShadingCache::Header*   header    = &shadingCache.header;
+    std::vector<glm::vec4>* materials = &shadingCache.materials;
+
+    shadingCache.reader = std::async(std::launch::async, [device, memory, key, objects, texels, header, materials] ()
+        { // reader
+        std::vector<uint64_t> words;
+        if (!ShadingCache::readCacheFile(ShadingCache::path(key), objects, texels, *header, *materials, words))
+            return false;
+
+        if (header->key != key || header->lightCount > LightState::MAX_LIGHTS)
+            return false;
+
+        void* data;
+        if (device.mapMemory(memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data) != vk::Result::eSuccess)
+            return false;
+
+        bool decoded = ShadingCache::decompress(words, static_cast<uint64_t*>(data), texels);
+        device.unmapMemory(memory);
+
+        return decoded;
+        }); // reader
+
+    } // VulkanApp :: loadShadingCache
+
+
+//
+//  uploadShadingCache
+//
+//  puts back the materials and lights of the file the reader has
+//  finished with, and submits the copy of its texels into every
+//  level of the result as a pass of its own, which the raster pass
+//  waits on like any other. A file for tiles the camera has since
+//  moved, or lit with anything else, leaves the atlas as it was
+//
+bool VulkanApp::uploadShadingCache (uint64_t key)
+    { // VulkanApp :: uploadShadingCache
+
+    const ShadingCache::Header&   header    = shadingCache.header;
+    const std::vector<glm::vec4>& materials = shadingCache.materials;
+
+    if (header.key != key)
+        return false;
+
+    if (shadingCacheHash(key, materials, header.lightPosition, header.lightCount) != header.hash)
+        return false;
+
+    for (uint32_t i = 0; i < nObjects; ++i)
         {
-        ubo.shading.lightPosition.x = sin (timing.timer * 0.1f) * 4.0f;
-        ubo.shading.lightPosition.y = cos (timing.timer * 0.1f) * 4.0f;
+        objects.shading[i].material = materials[i];
+        objects.raster[i].material  = materials[i];
         }
 
-	if (regenerateMaterials)
-		{
-		rng.seed(time(0));
-		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-		for (uint32_t i = 0; i < nObjects; ++i)
-			ubo.shading.materials[i] = { 
-                dist(rng), 
-                dist(rng), 
-                dist(rng), 
-                dist(rng) };
+    ubo.shading.lightPosition = header.lightPosition;
+    if (lights.count != header.lightCount)
+        {
+        lights.count = header.lightCount;
+        generateLights();
+        }
 
-		regenerateMaterials = false;
-		}
+    updateShadingUniforms();
 
-	void* data;
-	core.logicalDevice.mapMemory(buffers.shadingUniform.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags{}, &data);
-	memcpy(data, &ubo.shading, sizeof(UniformBufferObjects::ShadingUBO));
-	core.logicalDevice.unmapMemory(buffers.shadingUniform.memory);
+    vk::ImageMemoryBarrier barriers [2];
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each part of the chain
+        barriers[i].srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        barriers[i].dstAccessMask       = vk::AccessFlagBits::eTransferWrite;
+        barriers[i].oldLayout           = (i == 0) ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eGeneral;
+        barriers[i].newLayout           = vk::ImageLayout::eTransferDstOptimal;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].image               = shading.result.image;
+        barriers[i].subresourceRange    = (i == 0)
+            ? vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 }
+            : vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 1, mips.levels - 1, 0, 1 };
+        } // for each part of the chain
 
-    } // VulkanApp :: updateShadingUniforms
+    uint32_t parts     = (mips.levels > 1) ? 2 : 1;
+    uint32_t frameSlot = timing.frame % MAX_FRAMES_IN_FLIGHT;
+
+    vk::CommandBuffer commandBuffer = command.recorder.primary(frameSlot);
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    commandBuffer.begin(&beginInfo);
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, parts, barriers);
+
+    commandBuffer.copyBufferToImage(buffers.shadingCache.buffer, shading.result.image, vk::ImageLayout::eTransferDstOptimal, static_cast<uint32_t>(shadingCache.regions.size()), shadingCache.regions.data());
+
+    for (uint32_t i = 0; i < 2; ++i)
+        { // for each part of the chain
+        barriers[i].srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barriers[i].dstAccessMask = (i == 0)
+            ? vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eShaderRead
+            : vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        std::swap(barriers[i].oldLayout, barriers[i].newLayout);
+        } // for each part of the chain
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
+        vk::DependencyFlags { }, 0, nullptr, 0, nullptr, parts, barriers);
+
+    commandBuffer.end();
+
+    // the copy overwrites the atlas like a shading pass, so it waits
+    // for the raster frames still sampling it in the same way
+    VulkanTimeline::Batch uploadBatch;
+        uploadBatch.wait   (VulkanTimeline::eRaster, timeline.submitted(VulkanTimeline::eRaster), vk::PipelineStageFlagBits::eTransfer);
+        uploadBatch.signal (VulkanTimeline::eLighting);
+
+    shading.atlasVersion = timeline.submit(queues.graphics, uploadBatch, &commandBuffer, 1);
+    command.inFlight[frameSlot].lighting = shading.atlasVersion;
+
+    shadingCache.key = key;
+    return true;
+
+    } // VulkanApp :: uploadShadingCache
 
 
 //
+//  saveShadingCache
 //
+//  takes down what the pass just submitted with the readback was
+//  lit with, for the writer once the copy has landed
 //
-void VulkanApp::updateRasterUniforms ()
-    { // VulkanApp :: updateRasterUniforms
+void VulkanApp::saveShadingCache ()
+    { // VulkanApp :: saveShadingCache
 
-	for (uint32_t i = 0; i < nObjects; ++i)
-		{
-		ubo.raster.model[i] = ubo.geometry.model[i];
-		}
+    shadingCache.materials.resize(nObjects);
+    for (uint32_t i = 0; i < nObjects; ++i)
+        shadingCache.materials[i] = objects.shading[i].material;
 
-	ubo.raster.proj = glm::perspective((float)(WINDOW_WIDTH / WINDOW_HEIGHT), 1.0f, 0.01f, 100.0f);
-	ubo.raster.proj[1][1] *= -1;
-	ubo.raster.view = glm::lookAt(
-		eyePosition,                      // position
-		eyePosition + glm::vec3{ 0.0f, -1.0f, 0.0f },  // center
-		glm::vec3{ 0.0f, 0.0f, 1.00f }); // world up
+    shadingCache.key = shadingCacheKey();
 
-	void* data;
-	core.logicalDevice.mapMemory(buffers.rasterUniform.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags{}, &data);
-	memcpy(data, &ubo.raster, sizeof(UniformBufferObjects::RasterUBO));
-	core.logicalDevice.unmapMemory(buffers.rasterUniform.memory);
+    ShadingCache::Header& header = shadingCache.header;
+        header.magic         = ShadingCache::MAGIC;
+        header.version       = ShadingCache::VERSION;
+        header.key           = shadingCache.key;
+        header.hash          = shadingCacheHash(shadingCache.key, shadingCache.materials, ubo.shading.lightPosition, lights.count);
+        header.objects       = nObjects;
+        header.lightCount    = lights.count;
+        header.lightPosition = ubo.shading.lightPosition;
+        header.texels        = shadingCache.texels;
+        header.words         = 0;
 
-    } // VulkanApp :: updateRasterUniforms
+    shadingCache.pending = shading.atlasVersion;
+    shadingCache.saved   = true;
+
+    } // VulkanApp :: saveShadingCache
+
+
+//
+//  pollShadingCache
+//
+//  hands the copy of a saved pass to the writer once the pass has
+//  finished, which is checked for without waiting on it
+//
+void VulkanApp::pollShadingCache ()
+    { // VulkanApp :: pollShadingCache
+
+    if (shadingCache.pending == 0 || timeline.completed(VulkanTimeline::eLighting) < shadingCache.pending)
+        return;
+
+    shadingCache.pending = 0;
+
+    // nothing copies through the buffer again once a pass is saved,
+    // so it's left to the writer until the app closes
+    vk::Device             device    = core.logicalDevice;
+    vk::DeviceMemory       memory    = buffers.shadingCache.memory;
+    ShadingCache::Header   header    = shadingCache.header;
+    std::vector<glm::vec4> materials = std::move(shadingCache.materials);
+
+    shadingCache.writer = std::thread([device, memory, header, materials] ()
+        { // writer
+        void* data;
+        if (device.mapMemory(memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data) != vk::Result::eSuccess)
+            return;
+
+        std::vector<uint64_t> words;
+        ShadingCache::compress(static_cast<const uint64_t*>(data), header.texels, words);
+        device.unmapMemory(memory);
+
+        ShadingCache::Header written = header;
+            written.words = words.size();
+
+        ShadingCache::writeCacheFile(ShadingCache::path(header.key), written, materials, words);
+        }); // writer
+
+    } // VulkanApp :: pollShadingCache
 
 
 #include <windows.h>
@@ -2727,16 +7803,61 @@ void VulkanApp::report ()
 
 	uint32_t depthBufferMemorySize = ((WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(uint32_t) / 1000) / 1000);
 	uint32_t frameBufferMemorySize = ((WINDOW_WIDTH * WINDOW_HEIGHT * sizeof(glm::vec3) / 1000) / 1000);
-	uint32_t shadingBufferMemorySize = ((shading.BUFFER_SIZE * shading.BUFFER_SIZE * sizeof(glm::vec4) / 1000) / 1000) * 4;
+	uint32_t shadingBufferMemorySize = ((shading.BUFFER_SIZE * shading.BUFFER_SIZE * sizeof(glm::vec4) / 1000) / 1000) * 5;
+
+	// the result's mip chain adds about a third of it again
+	if (mips.levels > 1)
+		shadingBufferMemorySize += ((shading.BUFFER_SIZE * shading.BUFFER_SIZE * sizeof(glm::vec4) / 1000) / 1000) / 3;
 	
 	uint32_t textureMemoryOccupation = (depthBufferMemorySize + frameBufferMemorySize) * swapchain.nImages;
 	textureMemoryOccupation += shadingBufferMemorySize;
 
+	// both shadow layers, at 4 or 2 bytes a texel
+	uint32_t shadowBytes = (shadows.format == vk::Format::eD32Sfloat) ? 4 : 2;
+	textureMemoryOccupation += ((ShadowState::SIZE * ShadowState::SIZE * shadowBytes / 1000) / 1000) * ShadowState::eLayerCount;
+
+	// what each object takes up in the buffers sized by the object
+	// count, its transforms, materials and atlas placements, culling
+	// record, visibility flag, and the indirect draws of it whole for
+	// the raster pass and of each of its clusters for the geometry pass
+	uint32_t objectMemorySize = sizeof(glm::vec4) + sizeof(ObjectData::Shading) + sizeof(ObjectData::Raster);
+	objectMemorySize += sizeof(CullingState::Object) + sizeof(uint32_t);
+	objectMemorySize += (uint32_t)(1 + clusters.list.size()) * sizeof(vk::DrawIndexedIndirectCommand);
+
 	std::cout << std::endl;
 	std::cout << "  average fps    : " << timing.fps << std::endl;
+	std::cout << "  frame pacing   : " << pacer.name() << std::endl;
+	std::cout << "  input latency  : " << pacer.averageLatency() << "ms" << std::endl;
+	std::cout << "  recording      : " << (command.recording == VulkanCommandState::eStatic ? "static" : command.recording == VulkanCommandState::eDynamic ? "dynamic" : "cached") << std::endl;
+	std::cout << "  record time    : " << command.recordTime << "ms" << std::endl;
 	std::cout << "  mesh memory    : " << meshMemoryOccupation << "mb" << std::endl;
 	std::cout << "  texture memory : " << textureMemoryOccupation << "mb" << std::endl;
 	std::cout << "  object count   : " << nObjects << std::endl;
+	std::cout << "  object memory  : " << objectMemorySize << " bytes each, " << ((uint64_t)objectMemorySize * nObjects) / 1000 << "kb" << std::endl;
+	std::cout << "  culling        : " << (culling.gpu ? "device" : "host") << std::endl;
+	std::cout << "  occlusion      : " << (!occlusion.supported ? "unsupported" : occlusion.enabled ? "on" : "off");
+	if (occlusion.enabled && !culling.gpu)
+		std::cout << " (" << occlusion.occluded << " hidden)";
+	std::cout << std::endl;
+	std::cout << "  back clusters  : " << (!clusters.enabled ? "off" : culling.gpu ? "on" : std::to_string(clusters.culled) + " of " + std::to_string(clusters.list.size() * feedback.shadeCount) + " culled") << std::endl;
+	std::cout << "  shading levels : ";
+	if (lod.enabled)
+		for (uint32_t l = 0; l <= ShadingLevels::MAX_LEVEL; ++l)
+			std::cout << (l ? " / " : "") << lod.counts[l];
+	else std::cout << "off";
+	std::cout << std::endl;
+	std::cout << "  atlas pages    : " << paging.table.pagesUsed() << " of " << paging.table.pagesPerSide * paging.table.pagesPerSide << " in use, " << paging.table.evictions << " evictions" << std::endl;
+	std::cout << "  geometry cache : " << (geometryCache.enabled ? std::to_string(geometryCache.redrawCount) + " tiles redrawn" : "off") << std::endl;
+	std::cout << "  tiled lighting : " << (!tiledLighting.supported ? "unsupported" : tiledLighting.enabled ? std::to_string(tiledLighting.tiles.size()) + " tiles of " + std::to_string(tiledLighting.tileSize) : "off") << std::endl;
+	std::cout << "  point lights   : " << lights.count << (lights.count == 0 ? "" : tiledLighting.enabled ? " (culled per tile)" : " (unculled)") << std::endl;
+	std::cout << "  mip chain      : " << (mips.levels == 1 ? "unsupported" : std::to_string(mips.levels) + " levels, " + std::to_string(mips.tiles.size()) + " tiles averaged") << std::endl;
+	std::cout << "  shading cache  : " << (!shadingCache.enabled ? "unsupported" : shadingCache.loaded ? "loaded" : shadingCache.saved ? "saved" : "none") << std::endl;
+	std::cout << "  shading layers : diffuse every " << shading.interval << " frames" << (layers.still ? " (" + std::to_string(layers.skipped) + " passes left out)" : "") << ", specular " << (layers.specular == ShadingLayerState::eRaster ? "per pixel" : layers.specular == ShadingLayerState::eAtlas ? "in atlas" : "off") << std::endl;
+	std::cout << "  shadows        : " << (!shadows.enabled ? "off" : std::to_string(shadows.dynamicCount) + " of " + std::to_string(nObjects) + " objects moving, static layer drawn " + std::to_string(shadows.staticDraws) + " times") << std::endl;
+	std::cout << "  temporal       : " << (!temporal.enabled ? "off" : "1 in " + std::to_string(temporal.subset) + " texels a pass" + (tiledLighting.enabled ? "" : " (tiled lighting off)")) << std::endl;
+	std::cout << "  prediction     : " << (prediction.enabled ? std::to_string(prediction.ahead) + " ahead of view" : "off") << std::endl;
+	std::cout << "  shaded tiles   : " << feedback.shadeCount << (feedback.enabled ? "" : " (feedback off)") << std::endl;
+	std::cout << "  visible count  : " << (culling.gpu ? culling.gpuVisible : culling.enabled ? (uint32_t)culling.visible.size() : nObjects) << std::endl;
 
 	std::stringstream ss;
 	ss.imbue(std::locale(""));
@@ -2749,92 +7870,122 @@ void VulkanApp::report ()
 	} // VulkanApp :: report
 
 //
+//  fullRender
 //
+//  shades the atlas and then rasterizes the frame. The shading
+//  submission signals a new lighting value, which becomes the
+//  atlas version every raster frame depends on. Without
+//  the diffuse lighting the atlas is left as it is, but the shading
+//  levels and tiles are still committed as lit, and the shadow
+//  layers still drawn for the passes after it
 //
-void VulkanApp::fullRender ()
+void VulkanApp::fullRender (bool diffuse)
 	{ // VulkanApp :: fullRender
 
 	// Shade Scene
 
-	vk::PipelineStageFlags shadingWaitStages[] = { vk::PipelineStageFlagBits::eTopOfPipe };
-	vk::Semaphore shadingSignalSemaphore[]     = { semaphores.shadingComplete };
-	vk::Semaphore shadingWaitSemaphore[]       = { semaphores.rasterComplete };
+	// the atlas is overwritten by this pass, so it may not start
+	// writing before the last raster frame has finished sampling it.
+	// Neither may its uploads and dispatches overwrite the visibility,
+	// sampled blocks and pyramid that frame still reads and copies out
+	VulkanTimeline::Batch shadingBatch;
+		shadingBatch.wait   (VulkanTimeline::eRaster, timeline.submitted(VulkanTimeline::eRaster), vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer);
+		shadingBatch.signal (VulkanTimeline::eLighting);
 
-	vk::SubmitInfo shadingSubmit = {};
-		shadingSubmit.waitSemaphoreCount    = 0;
-		shadingSubmit.pWaitSemaphores       = nullptr;
-		shadingSubmit.signalSemaphoreCount  = 1;
-		shadingSubmit.pSignalSemaphores     = shadingSignalSemaphore;
-		shadingSubmit.pWaitDstStageMask     = shadingWaitStages;
-		shadingSubmit.commandBufferCount    = 1;
-		shadingSubmit.pCommandBuffers       = &shading.commandBuffer;
+	uint32_t frameSlot = timing.frame % MAX_FRAMES_IN_FLIGHT;
 
-	vk::Result result = queues.graphics.submit(1, &shadingSubmit, nullptr);
+	// either way the layers are drawn from this frame's frustum, which
+	// the raster pass has to look them up through from now on. Nothing
+	// has been submitted yet, so the staged uniforms can still change
+	shadows.drawnWith              = ubo.shading.lightViewProjection;
+	ubo.raster.lightViewProjection = shadows.drawnWith;
+	memcpy(stageBuffer(buffers.rasterUniform, 0, sizeof(UniformBufferObjects::RasterUBO)), &ubo.raster, sizeof(UniformBufferObjects::RasterUBO));
 
-	if (result != vk::Result::eSuccess)
-		std::cout << std::endl << "queue submission: " << vk::to_string(result) << std::endl;
+	commitShadingLevels();
 
-	// Raster Scene
+	if (!diffuse)
+		{
+		VulkanTimeline::Batch shadowBatch;
+			shadowBatch.wait   (VulkanTimeline::eRaster, timeline.submitted(VulkanTimeline::eRaster), vk::PipelineStageFlagBits::eTransfer);
+			shadowBatch.signal (VulkanTimeline::eLighting);
 
-	// before we begin rendering we'll want to know
-	// which framebuffer in the swapchain we're going
-	// to be writing to. We can query the device for
-	// the index of this framebuffer
-	uint32_t framebufferIndex = UINT32_MAX;
-	result = core.logicalDevice.acquireNextImageKHR(
-		swapchain.swapchain,
-		UINT64_MAX,
-		semaphores.presentReady,
-		nullptr,
-		&framebufferIndex);
+		// the layers are drawn from the transforms the frame staged
+		vk::CommandBuffer uploads = uploadCommands(frameSlot);
+		vk::CommandBuffer layers  = shadowCommands(frameSlot);
+		vk::CommandBuffer commandBuffers[] = { uploads, layers };
 
-	if (result != vk::Result::eSuccess)
-		std::cout << std::endl << "framebuffer index query: " << vk::to_string(result) << std::endl;
+		uint32_t first = uploads ? 0 : 1;
+		uint32_t count = layers  ? 2 : 1;
 
-	// to hand to the API for this frame's render
-	vk::PipelineStageFlags rasterWaitStages[] = { vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eColorAttachmentOutput };
-	vk::Semaphore rasterSignalSemaphores[]    = { semaphores.renderComplete };
-	vk::Semaphore rasterWaitSemaphores[]      = { semaphores.shadingComplete, semaphores.presentReady };
+		if (count > first)
+			command.inFlight[frameSlot].lighting = timeline.submit(queues.graphics, shadowBatch, commandBuffers + first, count - first);
 
-	vk::SubmitInfo rasterSubmit = {};
-		rasterSubmit.waitSemaphoreCount    = 2;
-		rasterSubmit.pWaitSemaphores       = rasterWaitSemaphores;
-		rasterSubmit.signalSemaphoreCount  = 1;
-		rasterSubmit.pSignalSemaphores     = rasterSignalSemaphores;
-		rasterSubmit.pWaitDstStageMask     = rasterWaitStages;
-		rasterSubmit.commandBufferCount    = 1;
-		rasterSubmit.pCommandBuffers       = &swapchain.commandBuffers[framebufferIndex];
+		commitFreshTiles();
+		commitShadowLayers();
 
-	result = queues.graphics.submit(1, &rasterSubmit, nullptr);
+		halfRender();
+		return;
+		}
 
-	if (result != vk::Result::eSuccess)
-		std::cout << std::endl << "queue submission: " << vk::to_string(result) << std::endl;
+	commitLightingTiles();
+	commitMipTiles();
 
-	// after submitting our queue we can present the
-	// render on the screen using the KHR functions
-	vk::SwapchainKHR swapchains[] = { swapchain.swapchain };
+	// the first pass to light everything while nothing moves has the
+	// atlas copied out after it, for the next run to start from, once
+	// the reader is done with the buffer it's copied to
+	bool save = !shadingCache.saved && !shadingCache.reader.valid() && shadingCacheStill() && timing.frame <= feedback.linger && feedback.shadeCount == nObjects;
 
-	vk::PresentInfoKHR presentInfo = {};
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &semaphores.renderComplete;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapchains;
-	presentInfo.pImageIndices = &framebufferIndex;
-	presentInfo.pResults = nullptr;
+	// what the frame staged is copied across ahead of the pass
+	vk::CommandBuffer uploads = uploadCommands(frameSlot);
+	vk::CommandBuffer commandBuffers[] = { uploads, shadingCommands(frameSlot), shadingCache.readback };
+
+	uint32_t first = uploads ? 0 : 1;
 
-	queues.present.presentKHR(&presentInfo);
-	queues.present.waitIdle();
+	shading.atlasVersion = timeline.submit(queues.graphics, shadingBatch, commandBuffers + first, (save ? 3 : 2) - first);
+	command.inFlight[frameSlot].lighting = shading.atlasVersion;
 
+	if (save)
+		saveShadingCache();
+
+	// the next pass lights the next texels of the rotation
+	temporal.passes++;
+
+	commitFreshTiles();
+	commitShadowLayers();
+
+	// static recordings also draw every object whole, while without
+	// the cache this pass cleared what it didn't draw
+	for (uint32_t i = 0; i < nObjects; ++i)
+		{
+		if (command.recording == VulkanCommandState::eStatic)
+			geometryCache.valid[i] = 1;
+		else if (!geometryCache.enabled)
+			geometryCache.valid[i] = 0;
+		else if (geometryCache.redraw[i])
+			geometryCache.valid[i] = 1;
+		else continue;
+
+		geometryCache.level[i] = lod.target[i];
+		}
+
+	// Raster Scene
+	halfRender();
 
 	} // VulkanApp :: fullRender
 
 
 //
+//  halfRender
 //
+//  rasterizes the frame using whichever atlas version is current
 //
 void VulkanApp::halfRender ()
 	{ // VulkanApp :: halfRender
 
+	uint32_t frameSlot = timing.frame % MAX_FRAMES_IN_FLIGHT;
+
+	// anything staged since the shading pass goes ahead of the frame
+	vk::CommandBuffer uploads = uploadCommands(frameSlot);
 	
 	// before we begin rendering we'll want to know
 	// which framebuffer in the swapchain we're going
@@ -2844,31 +7995,49 @@ void VulkanApp::halfRender ()
 	vk::Result result = core.logicalDevice.acquireNextImageKHR(
 		swapchain.swapchain,
 		UINT64_MAX,
-		semaphores.presentReady,
+		semaphores.presentReady[frameSlot],
 		nullptr,
 		&framebufferIndex);
 
-	if (result != vk::Result::eSuccess)
+	// an out of date swapchain can't be presented to at all, so the frame
+	// is dropped and the extent dependent resources are rebuilt. Suboptimal
+	// images are still presentable and get replaced after this frame
+	if (result == vk::Result::eErrorOutOfDateKHR)
+		{
+		// the uploads still have to land before this slot's staging
+		// buffers are written again
+		if (uploads)
+			{
+			VulkanTimeline::Batch uploadBatch;
+				uploadBatch.signal (VulkanTimeline::eRaster);
+
+			command.inFlight[frameSlot].raster = timeline.submit(queues.graphics, uploadBatch, &uploads, 1);
+			}
+
+		recreateSwapChain();
+		return;
+		}
+
+	if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
 		std::cout << std::endl << "framebuffer index query: " << vk::to_string(result) << std::endl;
 
-	// to hand to the API for this frame's render
-	vk::PipelineStageFlags rasterWaitStages[] = { vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eColorAttachmentOutput };
-	vk::Semaphore rasterSignalSemaphores[]    = { semaphores.renderComplete };
-	vk::Semaphore rasterWaitSemaphores[]      = { semaphores.presentReady };
+	// the raster pass samples the atlas in the fragment shader, so it
+	// only needs the atlas version it's displaying to have been lit
+	VulkanTimeline::Batch rasterBatch;
+		rasterBatch.wait   (VulkanTimeline::eLighting, shading.atlasVersion, vk::PipelineStageFlagBits::eFragmentShader);
+		rasterBatch.wait   (semaphores.presentReady[frameSlot], vk::PipelineStageFlagBits::eColorAttachmentOutput);
+		rasterBatch.signal (VulkanTimeline::eRaster);
+		rasterBatch.signal (semaphores.renderComplete[frameSlot]);
 
-	vk::SubmitInfo rasterSubmit = {};
-		rasterSubmit.waitSemaphoreCount    = 1;
-		rasterSubmit.pWaitSemaphores       = rasterWaitSemaphores;
-		rasterSubmit.signalSemaphoreCount  = 1;
-		rasterSubmit.pSignalSemaphores     = rasterSignalSemaphores;
-		rasterSubmit.pWaitDstStageMask     = rasterWaitStages;
-		rasterSubmit.commandBufferCount    = 1;
-		rasterSubmit.pCommandBuffers       = &swapchain.commandBuffers[framebufferIndex];
+	// the frame's flags, count and coarse pyramid levels are copied
+	// out after it, for the host to read when the slot comes round
+	vk::CommandBuffer commandBuffers[] = { uploads, rasterCommands(frameSlot, framebufferIndex), readbackCommands(frameSlot) };
 
-	result = queues.graphics.submit(1, &rasterSubmit, nullptr);
+	uint32_t first = uploads ? 0 : 1;
 
-	if (result != vk::Result::eSuccess)
-		std::cout << std::endl << "queue submission: " << vk::to_string(result) << std::endl;
+	occlusion.readbackViewProjection[frameSlot] = ubo.raster.proj * ubo.raster.view;
+
+	command.inFlight[frameSlot].raster = timeline.submit(queues.graphics, rasterBatch, commandBuffers + first, 3 - first);
 
 	// after submitting our queue we can present the
 	// render on the screen using the KHR functions
@@ -2876,14 +8045,16 @@ void VulkanApp::halfRender ()
 
 	vk::PresentInfoKHR presentInfo = {};
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = &semaphores.renderComplete;
+		presentInfo.pWaitSemaphores = &semaphores.renderComplete[frameSlot];
 		presentInfo.swapchainCount = 1;
 		presentInfo.pSwapchains = swapchains;
 		presentInfo.pImageIndices = &framebufferIndex;
 		presentInfo.pResults = nullptr;
 
-	queues.present.presentKHR(&presentInfo);
-	queues.present.waitIdle();
+	result = queues.present.presentKHR(&presentInfo);
+
+	if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || framebufferResized)
+		recreateSwapChain();
 
 	} // VulkanApp :: halfRender
 
@@ -2898,7 +8069,18 @@ void VulkanApp::loop ()
 
     while ((!glfwWindowShouldClose(window)))
         { // while the window is open
+
+		pacer.beginFrame();
+
         glfwPollEvents();
+
+		if (cyclePacing)
+			{
+			cyclePacing = false;
+			if (pacer.cycle())
+				recreateSwapChain();
+			std::cout << "frame pacing: " << pacer.name() << std::endl;
+			}
 	//	report();
     
 		if (forwards)  eyePosition.y -= parameters.movementSpeed;
@@ -2924,18 +8106,194 @@ void VulkanApp::loop ()
 		if (reset == 1)
 			updatePhysicsState ();
 
+		// this frame's staging buffers, readbacks and command pools are
+		// only free once the last frame in its slot has finished with
+		// them, while the frame before it can still be running
+		uint32_t frameSlot = timing.frame % MAX_FRAMES_IN_FLIGHT;
+		if (timeline.wait(VulkanTimeline::eLighting, command.inFlight[frameSlot].lighting) != vk::Result::eSuccess ||
+			timeline.wait(VulkanTimeline::eRaster,   command.inFlight[frameSlot].raster)   != vk::Result::eSuccess)
+			ErrorHandler::fatal("Frame slot wait failure");
+		command.recorder.reset(frameSlot);
+		buffers.stagingSlot = frameSlot;
+
+		destroyRetiredSwapChains(false);
+
         updateGeometryUniforms ();
         updateShadingUniforms  ();
         updateRasterUniforms   ();
+        cullObjects            ();
+
+        readVisibilityFeedback ();
+        predictVisibility      ();
+        selectShadingTiles     ();
+        selectShadingLevels    ();
+        selectResidency        ();
+        selectGeometryRedraws  ();
+        selectShadowLayers     ();
+        updateClusterCulling   ();
+        updateCullingBuffers   ();
+
+
+		if (cycleRecording)
+			{
+			cycleRecording = false;
+			command.recording = (VulkanCommandState::Recording)((command.recording + 1) % VulkanCommandState::eRecordingCount);
+			}
+
+		if (runRecordingBenchmark)
+			{
+			runRecordingBenchmark = false;
+			benchmarkRecording();
+			}
+
+		if (toggleCulling)
+			{
+			toggleCulling = false;
+			culling.enabled = !culling.enabled;
+			}
+
+		if (toggleFeedback)
+			{
+			toggleFeedback = false;
+			feedback.enabled = !feedback.enabled && core.features.fragmentStoresAndAtomics;
+			selectShadingTiles();
+			selectResidency();
+			selectGeometryRedraws();
+			updateCullingBuffers();
+			}
+
+		if (toggleOcclusion)
+			{
+			toggleOcclusion = false;
+			occlusion.enabled = !occlusion.enabled && occlusion.supported;
+			updateCullingBuffers();
+			}
+
+		if (toggleClusters)
+			{
+			toggleClusters = false;
+			clusters.enabled = !clusters.enabled;
+			updateCullingBuffers();
+			}
+
+		if (toggleLevels)
+			{
+			toggleLevels = false;
+			lod.enabled = !lod.enabled;
+			selectShadingLevels();
+			selectResidency();
+			selectGeometryRedraws();
+			updateCullingBuffers();
+			}
+
+		if (togglePrediction)
+			{
+			togglePrediction = false;
+			prediction.enabled = !prediction.enabled;
+			}
+
+		if (toggleGeometryCache)
+			{
+			toggleGeometryCache = false;
+			geometryCache.enabled = !geometryCache.enabled;
+			std::fill(geometryCache.valid.begin(), geometryCache.valid.end(), 0);
+			selectGeometryRedraws();
+			updateCullingBuffers();
+			}
+
+		if (toggleTiledLighting)
+			{
+			toggleTiledLighting = false;
+			tiledLighting.enabled = !tiledLighting.enabled && tiledLighting.supported;
+			}
+
+		if (cycleLights)
+			{
+			cycleLights = false;
+			lights.count = (lights.count == 0) ? 16 : (lights.count < LightState::MAX_LIGHTS) ? lights.count * 4 : 0;
+			generateLights();
+			}
+
+		if (toggleTemporal)
+			{
+			toggleTemporal = false;
+			temporal.enabled = !temporal.enabled;
+			}
+
+		if (cycleTemporalSubset)
+			{
+			cycleTemporalSubset = false;
+			temporal.subset = (temporal.subset < 4) ? temporal.subset * 2 : 1;
+			}
+
+		if (cycleSpecular)
+			{
+			cycleSpecular = false;
+			layers.specular = (ShadingLayerState::Specular)((layers.specular + 1) % ShadingLayerState::eSpecularCount);
+			}
+
+		// the lighting has to see the change in this frame's pass
+		if (toggleShadows)
+			{
+			toggleShadows = false;
+			shadows.enabled = !shadows.enabled;
+			updateShadingUniforms();
+			selectShadowLayers();
+			}
+
+		if (runLightingBenchmark)
+			{
+			runLightingBenchmark = false;
+			benchmarkLighting();
+			}
+
+		if (toggleGpuCulling)
+			{
+			toggleGpuCulling = false;
+			culling.gpu = !culling.gpu;
+
+			// the buffers were skipped above while it was off
+			updateCullingBuffers();
+			}
+
+		if (runCullingBenchmark)
+			{
+			runCullingBenchmark = false;
+			std::cout << std::endl << "culling benchmark" << std::endl;
+			FrustumCulling::benchmark(runID);
+
+			std::cout << std::endl << "bvh benchmark" << std::endl;
+			SceneBVH::benchmark(runID);
 
+			std::cout << std::endl << "atlas benchmark" << std::endl;
+			VirtualAtlas::benchmark(runID);
 
-		if (((timing.frame - 1) % shading.interval) == 0) 
-			fullRender();
+			std::cout << std::endl << "scene data benchmark" << std::endl;
+			benchmarkSceneData();
+			}
+
+		buildDrawList();
+
+		// an atlas read from disk, or one the scene hasn't changed
+		// since, stands in for the diffuse lighting that would only
+		// light what it already holds
+		if (((timing.frame - 1) % shading.interval) == 0 || feedback.urgent)
+			fullRender(!restoreShadingCache() && !settleDiffuseLayer());
 		else 
 			halfRender();
 
+		pollShadingCache();
+
+		command.recordTime      = command.recordTime * 0.95 + command.frameRecordTime * 0.05;
+		command.frameRecordTime = 0.0;
+
+		pacer.endFrame();
+
 		if (timing.shouldClose)
+			{
+			pacer.log(runID);
 			glfwSetWindowShouldClose(window, 1);
+			}
     
         } // while the window is open
     
@@ -2950,7 +8308,7 @@ void VulkanApp::createBuffer (
         vk::BufferUsageFlags    usage,
         vk::MemoryPropertyFlags properties,
         vk::Buffer&             buffer,
-        vk::DeviceMemory        memory)
+        vk::DeviceMemory&       memory)
     { // VulkanApp :: createBuffer
     
     vk::Result result = vk::Result::eSuccess;
@@ -2984,3 +8342,69 @@ void VulkanApp::createBuffer (
     core.logicalDevice.bindBufferMemory(buffer, memory, 0);
 
     } // VulkanApp :: createBuffer
+
+
+//
+//  createStagedBuffer
+//
+//  creates a buffer on the device along with a staging buffer for
+//  each frame in flight, which are kept mapped for the host
+//
+void VulkanApp::createStagedBuffer (
+        vk::DeviceSize                     size,
+        vk::BufferUsageFlags               usage,
+        VulkanBuffers::VulkanStagedBuffer& buffer)
+    { // VulkanApp :: createStagedBuffer
+
+    createBuffer(
+        size,
+        usage | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        buffer.buffer,
+        buffer.memory);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+        { // for each frame in flight
+        createBuffer(
+            size,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            buffer.staging[i].buffer,
+            buffer.staging[i].memory);
+
+        void* data;
+        if (core.logicalDevice.mapMemory(buffer.staging[i].memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags { }, &data) != vk::Result::eSuccess)
+            ErrorHandler::fatal("Failed to map staging buffer");
+
+        buffer.mapped[i] = static_cast<uint8_t*>(data);
+        } // for each frame in flight
+
+    } // VulkanApp :: createStagedBuffer
+
+
+//
+//  stageBuffer
+//
+//  returns where the host writes a range of the buffer for this
+//  frame, and queues the range to be copied across ahead of the
+//  frame's next submission. A range written twice is copied once
+//
+void* VulkanApp::stageBuffer (
+        VulkanBuffers::VulkanStagedBuffer& buffer,
+        vk::DeviceSize                     offset,
+        vk::DeviceSize                     size)
+    { // VulkanApp :: stageBuffer
+
+    uint32_t   slot   = buffers.stagingSlot;
+    vk::Buffer source = buffer.staging[slot].buffer;
+
+    bool queued = false;
+    for (const VulkanBuffers::Upload& upload : buffers.uploads)
+        queued = queued || (upload.source == source && upload.region.srcOffset == offset && upload.region.size == size);
+
+    if (!queued)
+        buffers.uploads.push_back(VulkanBuffers::Upload { source, buffer.buffer, vk::BufferCopy { offset, offset, size } });
+
+    return buffer.mapped[slot] + offset;
+
+    } // VulkanApp :: stageBuffer
@@ -21,10 +21,21 @@
 #include <random>
 #include <string>
 #include <chrono>
+#include <future>
 #include <thread>
 
 #include "VulkanVertex.hpp"
 #include "VulkanShadingResource.hpp"
+#include "VulkanTimeline.hpp"
+#include "VulkanCommandRecorder.hpp"
+#include "FrustumCulling.hpp"
+#include "OcclusionCulling.hpp"
+#include "ClusterCulling.hpp"
+#include "ShadingLevels.hpp"
+#include "SceneBVH.hpp"
+#include "VirtualAtlas.hpp"
+#include "ShadingCache.hpp"
+#include "FramePacer.hpp"
 #include "Timer.hpp"
 
 class VulkanApp
@@ -46,6 +57,7 @@ class VulkanApp
 	
     uint32_t runID;
     Timer timing;
+    FramePacer pacer;
     
     private:
 
@@ -59,12 +71,20 @@ class VulkanApp
     vk::Result createSwapChain              ();
     vk::Result createDepthBuffer            ();
     vk::Result createCommandPool            ();
+    vk::Result createCommandRecorder        ();
+    vk::Result createVirtualAtlas           ();
     vk::Result createShadingResources       ();
+    vk::Result createCoverageBuffer         ();
     
     // Uniform Buffers
-    vk::Result createGeometryUniformBuffer  ();
+    vk::Result createObjectBuffers          ();
     vk::Result createShadingUniformBuffer   ();
+    vk::Result createLightBuffer            ();
     vk::Result createRasterUniformBuffer    ();
+    vk::Result createVisibilityBuffer       ();
+    vk::Result createFeedbackBuffers        ();
+    vk::Result createLightingBuffers        ();
+    vk::Result createMipBuffers             ();
     
     // Descriptor Sets
     vk::Result createDescriptorPool         ();
@@ -86,9 +106,65 @@ class VulkanApp
     vk::Result createGeometryPipeline       ();
     vk::Result createShadingPipeline        ();
     vk::Result createRasterPipeline         ();
+
+    // GPU Driven Culling
+    vk::Result createCullingBuffers         ();
+    vk::Result createCullingDescriptorSet   ();
+    vk::Result createCullingPipeline        ();
+
+    // Shading Feedback
+    vk::Result createFeedbackDescriptorSet  ();
+    vk::Result createFeedbackPipeline       ();
+
+    // Tiled Lighting
+    vk::Result createLightingDescriptorSet  ();
+    vk::Result createLightingPipeline       ();
+
+    // Result Mip Chain
+    vk::Result createMipDescriptorSets      ();
+    vk::Result createMipPipeline            ();
+
+    // Occlusion Culling
+    vk::Result createDepthPyramid           ();
+    vk::Result createOcclusionDescriptorSet ();
+    vk::Result createOcclusionPipeline      ();
+    void       writeOcclusionDescriptors    ();
+
+    // Shadow Layers
+    vk::Result createShadowMaps             ();
+    vk::Result createShadowRenderPass       ();
+    vk::Result createShadowDescriptorSet    ();
+    vk::Result createShadowPipeline         ();
+
+    // Shading Cache
+    vk::Result createShadingCache           ();
     
     vk::Result createShadingCommandBuffers  ();
     vk::Result createRasterCommandBuffers   ();
+    vk::Result createInitialUploads         ();
+
+    // Per Frame Recording
+    vk::CommandBuffer recordShadingCommands (uint32_t frame, vk::CommandBufferUsageFlags usage);
+    vk::CommandBuffer recordRasterCommands  (uint32_t frame, uint32_t image, vk::CommandBufferUsageFlags usage);
+
+    vk::CommandBuffer shadingCommands       (uint32_t frame);
+    vk::CommandBuffer rasterCommands        (uint32_t frame, uint32_t image);
+    vk::CommandBuffer uploadCommands        (uint32_t frame);
+    vk::CommandBuffer readbackCommands      (uint32_t frame);
+    vk::CommandBuffer shadowCommands        (uint32_t frame);
+
+    void buildDrawList           ();
+    void validateCommandCache    ();
+    uint64_t recordingHash       ();
+    void invalidateCommandCache  ();
+    void benchmarkRecording      ();
+    void benchmarkLighting       ();
+    void benchmarkSceneData      ();
+
+    // Swapchain Recreation
+    vk::Result recreateSwapChain            ();
+    void       destroySwapChainResources    ();
+    void       destroyRetiredSwapChains     (bool all);
 
     void arrangeObjects          ();
 
@@ -97,22 +173,110 @@ class VulkanApp
     
     void updateGeometryUniforms  ();
     void updateShadingUniforms   ();
+    void generateLights          ();
     void updateRasterUniforms    ();
+
+    void cullObjects             ();
+    void updateClusterCulling    ();
+    void updateCullingBuffers    ();
+
+    void readVisibilityFeedback  ();
+    void predictVisibility       ();
+    void selectShadingTiles      ();
+    void selectShadingLevels     ();
+    void selectResidency         ();
+    void selectGeometryRedraws   ();
+    void commitShadingLevels     ();
+    void commitLightingTiles     ();
+    void commitMipTiles          ();
+    void cutMipTiles             (vk::Rect2D rect, uint32_t level);
+    vk::Rect2D atlasTile         (uint32_t id);
+
+    float     shadowReach         ();
+    glm::mat4 lightViewProjection ();
+    void      selectShadowLayers  ();
+    void      commitShadowLayers  ();
+
+    void recordFeedbackDilation  (vk::CommandBuffer& commandBuffer);
+    void recordGeometryRedraws   (vk::CommandBuffer& commandBuffer);
+    void recordTiledLighting     (vk::CommandBuffer& commandBuffer);
+    void recordMipGeneration     (vk::CommandBuffer& commandBuffer, bool whole);
+    void recordShadowLayers      (vk::CommandBuffer& commandBuffer, bool whole);
+
+    void recordCullingDispatch   (vk::CommandBuffer& commandBuffer);
+    void recordDepthPyramid      (vk::CommandBuffer& commandBuffer);
+    void recordUploads           (vk::CommandBuffer& commandBuffer);
+    void recordIndirectDraws     (vk::CommandBuffer& commandBuffer, vk::Buffer& draws, uint32_t count);
+
+    uint64_t shadingCacheKey     ();
+    uint64_t shadingCacheHash    (uint64_t key, const std::vector<glm::vec4>& materials, const glm::vec4& lightPosition, uint32_t lightCount);
+    bool     shadingCacheStill   ();
+    bool     restoreShadingCache ();
+    bool     settleDiffuseLayer  ();
+    void     commitFreshTiles    ();
+    void     loadShadingCache    (uint64_t key);
+    bool     uploadShadingCache  (uint64_t key);
+    void     saveShadingCache    ();
+    void     pollShadingCache    ();
     
     void report     ();
 
-    void fullRender ();
+    void fullRender (bool diffuse);
     void halfRender ();
     void loop       ();
     
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
     struct VulkanCore {
         vk::Instance       instance;
         vk::PhysicalDevice physicalDevice;
         vk::Device         logicalDevice;
+
+        // the optional features that were enabled on the device
+        vk::PhysicalDeviceFeatures features;
     } core;
     
     struct VulkanCommandState {
         vk::CommandPool   pool;
+
+        // object draws are recorded across worker threads from the
+        // draw list, either every frame or only when the list changes.
+        // The buffers baked at startup are kept for comparison
+        VulkanCommandRecorder recorder;
+
+        enum Recording {
+            eStatic,
+            eDynamic,
+            eCached,
+            eRecordingCount
+        } recording = eCached;
+
+        // the atlas shades every object while the raster pass only
+        // draws those that survived culling
+        std::vector<vk::DrawIndexedIndirectCommand> shadingDraws;
+        std::vector<vk::DrawIndexedIndirectCommand> rasterDraws;
+
+        // the recorder pool set aside for cached recordings, which
+        // is only reset when the cache is invalidated
+        static constexpr uint32_t CACHE_SLOT = MAX_FRAMES_IN_FLIGHT;
+
+        struct Cache {
+            bool     valid = false;
+            uint64_t hash  = 0;
+
+            vk::CommandBuffer              shading;
+            std::vector<vk::CommandBuffer> raster; // per swapchain image
+        } cache;
+
+        // host time spent producing command buffers, in milliseconds
+        double frameRecordTime = 0.0;
+        double recordTime      = 0.0;
+
+        // the timeline values that last used each frame's buffers
+        struct InFlight {
+            uint64_t lighting = 0;
+            uint64_t raster   = 0;
+        } inFlight [MAX_FRAMES_IN_FLIGHT];
     } command;
     
     struct VulkanQueues {
@@ -136,6 +300,18 @@ class VulkanApp
         uint32_t currentImage = 0;
         uint32_t nImages      = 0;
 
+        // swapchains replaced by a resize, with the views and
+        // framebuffers made for their images, and the last raster
+        // frame presented to each. The presentation engine can still
+        // be showing them after that frame's fence has signalled
+        struct Retired {
+            vk::SwapchainKHR             swapchain;
+            std::vector<vk::ImageView>   views;
+            std::vector<vk::Framebuffer> framebuffers;
+            uint64_t                     lastPresent = 0;
+        };
+        std::vector<Retired> retired;
+
         struct Support {
             vk::SurfaceCapabilitiesKHR      capabilities;
             std::vector<vk::SurfaceFormatKHR>    formats;
@@ -149,8 +325,15 @@ class VulkanApp
     
         struct VulkanShadingPipeline {
             vk::RenderPass renderPass;
+
+            // the same pass, but keeping the geometry buffers and the
+            // coverage from one pass to the next rather than clearing
+            vk::RenderPass cachedRenderPass;
             
             vk::Format format = vk::Format::eR16G16B16A16Sfloat;
+
+            // only the stencil of this is used, whatever else it holds
+            vk::Format coverageFormat = vk::Format::eS8Uint;
             
             vk::DescriptorSetLayout geometryDescriptorlayout;
             vk::DescriptorSetLayout shadingDescriptorLayout;
@@ -180,6 +363,62 @@ class VulkanApp
             vk::Pipeline            pipeline;
             
         } raster;
+
+        struct VulkanCullingPipeline {
+            vk::DescriptorSetLayout descriptorLayout;
+            vk::DescriptorSet       descriptorSet;
+
+            vk::PipelineLayout      layout;
+            vk::Pipeline            pipeline;
+
+            // writes the geometry draws, one for each cluster
+            vk::Pipeline            clusterPipeline;
+        } culling;
+
+        struct VulkanFeedbackPipeline {
+            vk::DescriptorSetLayout descriptorLayout;
+            vk::DescriptorSet       descriptorSet;
+
+            vk::PipelineLayout      layout;
+            vk::Pipeline            pipeline;
+        } feedback;
+
+        struct VulkanLightingPipeline {
+            vk::DescriptorSetLayout descriptorLayout;
+            vk::DescriptorSet       descriptorSet;
+
+            vk::PipelineLayout      layout;
+            vk::Pipeline            pipeline;
+        } lighting;
+
+        struct VulkanMipPipeline {
+            vk::DescriptorSetLayout        descriptorLayout;
+
+            // one set a level below the first, reading the level above
+            std::vector<vk::DescriptorSet> descriptorSets;
+
+            vk::PipelineLayout             layout;
+            vk::Pipeline                   pipeline;
+        } mips;
+
+        struct VulkanOcclusionPipeline {
+            vk::DescriptorSetLayout descriptorLayout;
+            vk::DescriptorSet       descriptorSet;
+
+            vk::PipelineLayout      layout;
+            vk::Pipeline            pipeline;
+        } occlusion;
+
+        struct VulkanShadowPipeline {
+            // depth only, drawn from the light into one layer at a time
+            vk::RenderPass          renderPass;
+
+            vk::DescriptorSetLayout descriptorLayout;
+            vk::DescriptorSet       descriptorSet;
+
+            vk::PipelineLayout      layout;
+            vk::Pipeline            pipeline;
+        } shadows;
     
     } pipelines;
 
@@ -195,55 +434,198 @@ class VulkanApp
         vk::ImageView      view;
     } depth;
     
+    // the swapchain still speaks binary semaphores, everything
+    // else is ordered through the per-pass timeline
     struct VulkanSemaphores {
-        vk::Semaphore presentReady;
-		vk::Semaphore renderComplete;
-
-		vk::Semaphore shadingComplete;
-        vk::Semaphore rasterComplete;
+        vk::Semaphore presentReady   [MAX_FRAMES_IN_FLIGHT];
+		vk::Semaphore renderComplete [MAX_FRAMES_IN_FLIGHT];
     } semaphores;
+
+    VulkanTimeline timeline;
     
     struct VulkanBuffers {
         struct VulkanBuffer {
             vk::Buffer       buffer;
             vk::DeviceMemory memory;
         };
+
+        // kept on the device and written by the host through a mapped
+        // staging buffer per frame in flight, so a frame can be filled
+        // in while the one before it is still reading
+        struct VulkanStagedBuffer : VulkanBuffer {
+            VulkanBuffer staging [MAX_FRAMES_IN_FLIGHT];
+            uint8_t*     mapped  [MAX_FRAMES_IN_FLIGHT] = { };
+        };
+
+        // the ranges staged since the last submission, copied across
+        // at the start of the next, and the frame slot being staged to
+        struct Upload {
+            vk::Buffer     source;
+            vk::Buffer     destination;
+            vk::BufferCopy region;
+        };
+        std::vector<Upload> uploads;
+        uint32_t stagingSlot = 0;
         
-        VulkanBuffer geometryUniform;
-        VulkanBuffer shadingUniform;
-        VulkanBuffer rasterUniform;
+        VulkanStagedBuffer shadingUniform;
+        VulkanStagedBuffer rasterUniform;
+
+        // what each pass reads per object, as many as there are
+        VulkanStagedBuffer geometryObjects;
+        VulkanStagedBuffer shadingObjects;
+        VulkanStagedBuffer rasterObjects;
         
         VulkanBuffer sceneVertex;
         VulkanBuffer quadVertex;
         
         VulkanBuffer sceneIndex;
         VulkanBuffer quadIndex;
+
+        // written by the host every frame, read by the culling shader
+        VulkanStagedBuffer cullingUniform;
+        VulkanStagedBuffer cullingObjects;
+
+        // the mesh's clusters, written once at startup
+        VulkanBuffer cullingClusters;
+
+        // written by the culling shader, consumed as indirect draws
+        VulkanBuffer geometryIndirect;
+        VulkanBuffer rasterIndirect;
+        VulkanBuffer cullingCount;
+
+        // object visibility written by the raster pass
+        VulkanBuffer visibility;
+
+        // the visibility flags followed by the visible count, copied
+        // out at the end of each frame for the host to read once the
+        // frame's slot comes round again
+        VulkanBuffer frameReadback [MAX_FRAMES_IN_FLIGHT];
+
+        // atlas blocks sampled by the raster pass, and the dilated
+        // mask of them the lighting pass shades
+        VulkanStagedBuffer feedbackUniform;
+        VulkanBuffer sampledBlocks;
+        VulkanBuffer shadingMask;
+
+        // blocks of tiles the next pass shades whole, written by the
+        // host as it moves them
+        VulkanStagedBuffer refreshBlocks;
+
+        // the atlas tiles the lighting shader is dispatched over,
+        // written by the host before each shading pass
+        VulkanStagedBuffer lightingTiles;
+
+        // the point lights, rewritten whenever their count changes
+        VulkanStagedBuffer lights;
+
+        // the tiles of each level of the result's mip chain to be
+        // downsampled again, for the whole atlas and for this pass
+        VulkanStagedBuffer mipTiles;
+
+        // the hierarchical depth built after each raster frame, and
+        // the coarse levels of it each frame copies out for the host
+        VulkanBuffer depthPyramid;
+        VulkanBuffer depthReadback [MAX_FRAMES_IN_FLIGHT];
+
+        // every level of the result, on its way to or from disk
+        VulkanBuffer shadingCache;
     } buffers;
 
     VkDebugReportCallbackEXT callback;
 
-    static constexpr uint32_t maxObjects = 64;
 	const uint32_t nObjects;
 	static constexpr float offset = 2.5f;
 
     struct UniformBufferObjects {
-        struct GeometryUBO {
-            glm::mat4 model[maxObjects];
-        } geometry;
-    
         struct ShadingUBO {
             glm::vec4 lightPosition;
             glm::vec4 eyePosition;
-			glm::vec4 materials[maxObjects];
 
+            // the point light count (x), and whether the tiled
+            // lighting culls them per tile (y)
+            glm::uvec4 lighting;
+
+            // the weight new results are blended in with (x), and how
+            // far a texel may move before its history is dropped (y)
+            glm::vec4  temporal;
+
+            // whether history is kept (x), one in how many texels are
+            // lit each pass (y), and which of them this pass (z)
+            glm::uvec4 history;
+
+            // what the shadow layers were drawn from, and whether the
+            // lighting looks them up at all (x)
+            glm::mat4  lightViewProjection;
+            glm::uvec4 shadowing;
         } shading;
         
         struct RasterUBO {
-            glm::mat4 model[maxObjects];
-            glm::mat4 view;
-            glm::mat4 proj;
+            glm::mat4  view;
+            glm::mat4  proj;
+
+            // what the view dependent layer is lit with, when it's
+            // lit per pixel rather than into the atlas
+            glm::vec4  lightPosition;
+            glm::vec4  eyePosition;
+            glm::uvec4 layers;
+
+            // what the last shading pass drew the shadow layers with,
+            // so what's lit here is shadowed the way the atlas was
+            glm::mat4  lightViewProjection;
+            glm::uvec4 shadowing;
         } raster;
+
+        struct CullingUBO {
+            glm::vec4  planes[6];
+            glm::mat4  occlusionViewProjection;
+            glm::uvec4 levels[OcclusionCulling::MAX_LEVELS];
+            glm::vec4  eye;
+            glm::vec4  predictedEye;
+            uint32_t   objectCount;
+            uint32_t   occlusion;
+            uint32_t   levelCount;
+            uint32_t   clusterCount;
+            uint32_t   clusterCulling;
+        } culling;
+
+        struct FeedbackUBO {
+            uint32_t full;
+            uint32_t atlasSize;
+        } feedback;
     } ubo;
+
+    // the per object data the shaders index by id, which lives in
+    // storage buffers so the object count isn't bound by how much
+    // a uniform buffer can hold. The layouts match the shaders'
+    struct ObjectData {
+        struct Shading {
+            // the geometry buffers hold model space positions and
+            // normals, which the lighting moves into the world
+            glm::mat4 model;
+            glm::vec4 material;
+        };
+
+        struct Raster {
+            glm::mat4 model;
+
+            // the atlas placement each object was last shaded with,
+            // which lags the geometry pass's until a shading pass
+            // has written it
+            glm::vec4 atlas;
+
+            // for the view dependent layer lit per pixel
+            glm::vec4 material;
+        };
+
+        // where each object is now, and the scale (xy) and offset
+        // (zw) placing its uvs in the cells its page table entry
+        // gives it, which the geometry pass reads
+        std::vector<glm::mat4> model;
+        std::vector<glm::vec4> atlas;
+
+        std::vector<Shading> shading;
+        std::vector<Raster>  raster;
+    } objects;
     
     struct VulkanMeshes {
         struct Mesh {
@@ -254,6 +636,9 @@ class VulkanApp
         Mesh scene;
         
         Mesh quad;
+
+        // the range of the batched scene each object occupies
+        std::vector<vk::DrawIndexedIndirectCommand> objects;
     
     } meshes;
 
@@ -264,8 +649,399 @@ class VulkanApp
 		std::vector<glm::vec3> orientations; //
 		std::vector<glm::vec3> rotations;    // angular velocities
 		float bounds = 0.0f;                          // size of the bounding spheres
+
+		// follows the positions after every step, so collisions are
+		// only tested between objects whose spheres overlap
+		SceneBVH              bvh;
+		std::vector<uint32_t> nearby;
 	} simulation;
 
+	struct CullingState {
+		bool enabled = true;
+
+		// model space centroid (xyz) and radius (w) of the mesh
+		glm::vec4 meshBounds;
+
+		FrustumCulling::Spheres spheres;
+		std::vector<uint32_t>   visible;
+
+		// when the culling runs on the device the draws come straight
+		// from the indirect buffers it writes, so the host never sees
+		// the per object results, only the count read back after
+		bool gpu = false;
+		uint32_t gpuVisible = 0;
+
+		// laid out to match the std430 object buffer in cull.comp
+		struct Object {
+			glm::mat4 model;
+			glm::vec4 bounds;
+			uint32_t  firstIndex;
+			uint32_t  indexCount;
+			int32_t   vertexOffset;
+			uint32_t  shade;
+		};
+
+		std::vector<Object> objects;
+	} culling;
+
+	struct FeedbackState {
+		bool enabled = true;
+
+		// the raster pass flags every object it draws a visible
+		// fragment of, which the host picks up a frame later and
+		// uses to choose which atlas tiles the next pass shades
+		std::vector<uint32_t> flags;
+
+		// an object keeps being shaded for a few frames after it was
+		// last seen, so objects on the edge of view don't go stale
+		uint32_t linger = 8;
+		std::vector<uint32_t> lastSeen;
+
+		// whether each tile was shaded by the most recent pass,
+		// and what the next pass will shade
+		std::vector<uint8_t> fresh;
+		std::vector<uint8_t> shade;
+		uint32_t shadeCount = 0;
+
+		// set when an object comes into view with a stale tile, so
+		// it's shaded on the next frame rather than the next interval
+		bool urgent = false;
+
+		// within a tile, only the blocks of texels the raster pass
+		// sampled since the last shading pass are lit, grown by a
+		// margin of blocks. BLOCK_SIZE has to match the shaders
+		static constexpr uint32_t BLOCK_SIZE = 8;
+		uint32_t blocksPerRow = 0;
+		uint32_t margin       = 1;
+
+		// a flag for each block the next pass shades whole, as the
+		// tile over it moved since it was last sampled
+		std::vector<uint32_t> refresh;
+		bool refreshed = false;
+	} feedback;
+
+	struct OcclusionState {
+		// the depth buffer has to be sampled to be reduced, which
+		// not every device allows for its depth format
+		bool supported = false;
+		bool enabled   = true;
+
+		// the pyramid the last raster frame left behind, and the
+		// camera that frame was drawn from
+		OcclusionCulling::Pyramid pyramid;
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+
+		// the camera of the frame each slot's copy of the coarse
+		// levels was taken from
+		glm::mat4 readbackViewProjection [MAX_FRAMES_IN_FLIGHT];
+
+		// the host only reads back the levels from here down
+		static constexpr uint32_t HOST_WIDTH = 128;
+		uint32_t hostLevel = 0;
+
+		vk::Sampler sampler;
+
+		// objects the frustum kept but the pyramid rejected
+		uint32_t occluded = 0;
+	} occlusion;
+
+	struct PredictionState {
+		bool enabled = true;
+
+		// the camera's step per frame, smoothed over the last few, and
+		// where it was a frame ago
+		glm::vec3 lastEye   = glm::vec3(0.0f);
+		glm::vec3 velocity  = glm::vec3(0.0f);
+		float     smoothing = 0.5f;
+
+		FrustumCulling::Spheres spheres;
+		std::vector<uint32_t>   found;
+		std::vector<uint8_t>    seen;
+
+		// objects expected to come into view before the shading pass
+		// after next, and how many of those wouldn't otherwise be shaded
+		std::vector<uint32_t> visible;
+		uint32_t ahead = 0;
+	} prediction;
+
+	struct ClusterState {
+		bool enabled = true;
+
+		// the clusters of the one mesh every object shares
+		std::vector<ClusterCulling::Cluster> list;
+
+		// the atlas keeps what a shading pass drew until the next
+		// one, so clusters are kept if they face the camera either
+		// now or where it's heading by then
+		glm::vec3 eye          = glm::vec3(0.0f);
+		glm::vec3 predictedEye = glm::vec3(0.0f);
+
+		// clusters left out of the last host built draw list
+		uint32_t culled = 0;
+	} clusters;
+
+	struct LevelState {
+		bool enabled = true;
+
+		// the level each object's next shading pass draws it at, and
+		// the level its tile in the atlas was last shaded at, which is
+		// what the raster pass has to sample it with
+		std::vector<uint32_t> target;
+		std::vector<uint32_t> shaded;
+
+		// the pixels each object covers on screen, which also ranks
+		// them for pages of the atlas
+		std::vector<float> pixels;
+
+		// objects at each level, and whether any tile is below full
+		uint32_t counts[ShadingLevels::MAX_LEVEL + 1] = { };
+		bool reduced = false;
+	} lod;
+
+	struct GeometryCacheState {
+		bool enabled = true;
+
+		// objects only ever move rigidly, so what the geometry subpass
+		// draws of them in model space stays right until the object's
+		// tile changes shape. Whether each tile holds its object, and
+		// at which shading level it was drawn
+		std::vector<uint8_t>  valid;
+		std::vector<uint32_t> level;
+
+		// the shaded tiles the next pass has to draw again first
+		std::vector<uint8_t> redraw;
+		uint32_t redrawCount = 0;
+	} geometryCache;
+
+	struct TiledLightingState {
+		bool enabled   = true;
+		bool supported = false;
+
+		// the atlas is lit by a compute shader a workgroup of
+		// tileSize by tileSize texels at a time, instead of the
+		// lighting subpass. Tiles are cut from the rects of the
+		// objects being shaded, so nothing else is dispatched
+		struct Tile {
+			glm::uvec2 origin;
+			glm::uvec2 limit;
+		};
+
+		uint32_t tileSize = 16;
+		uint32_t capacity = 0;
+		std::vector<Tile> tiles;
+	} tiledLighting;
+
+	struct LightState {
+		// point lights lighting the scene alongside the moving light.
+		// The tiled lighting gathers the lights reaching each tile
+		// into a list of at most MAX_TILE_LIGHTS, which has to match
+		// lighting.comp, and tiles reached by more go through them all
+		static constexpr uint32_t MAX_LIGHTS      = 4096;
+		static constexpr uint32_t MAX_TILE_LIGHTS = 256;
+
+		struct Light {
+			glm::vec4 position; // world space centre (xyz) and radius (w)
+			glm::vec4 color;
+		};
+
+		std::vector<Light> list;
+		uint32_t count  = 0;
+		float    radius = 2.0f;
+		bool     culled = true;
+	} lights;
+
+	struct TemporalState {
+		bool enabled = false;
+
+		// the tiled lighting blends each new result into what the
+		// texel held before, unless the geometry under it has moved
+		// too far since, in which case it's lit from scratch
+		float weight   = 0.25f;
+		float distance = 0.02f;
+
+		// texels with history can be left to it on most passes, and
+		// lit in a rotating pattern one in every subset passes
+		uint32_t subset = 1;
+		uint32_t passes = 0;
+	} temporal;
+
+	struct ShadingLayerState {
+		// the diffuse layer the atlas holds doesn't depend on the eye,
+		// only on the lights, materials and where objects are, so a
+		// scheduled pass is left out while neither those nor the tiles
+		// it would cover have changed since the passes that settled it.
+		// It's otherwise lit every shading interval
+		bool     still   = true;
+		uint64_t hash    = 0;
+		uint32_t settled = 0;
+		uint32_t skipped = 0;
+
+		// the specular layer does depend on the eye, so it's lit per
+		// pixel by the raster pass every frame, or into the atlas at
+		// the diffuse layer's rate, where it goes stale as the eye
+		// moves between passes, or left out altogether
+		enum Specular {
+			eRaster,
+			eAtlas,
+			eOff,
+			eSpecularCount
+		};
+
+		Specular specular = eRaster;
+	} layers;
+
+	struct ShadowState {
+		bool enabled = true;
+
+		// only the moving light casts shadows, from a frustum looking
+		// at the middle of the scene wide enough to take in a sphere
+		// of this radius around it, or maxFov when the light is inside
+		// it, beyond which nothing is shadowed. Point lights would need
+		// a cube of them each, and a light far off, cascades. The
+		// sphere is fitted to the objects again whenever the light
+		// moves from where it was fitted, and grown in between should
+		// any of them leave it
+		static constexpr uint32_t SIZE = 2048;
+		float     radius = 0.0f;
+		glm::vec4 fittedLight;
+		bool      fitted = false;
+		float maxFov = 2.0f;
+
+		// the sampled depth formats are tried from the most precise
+		vk::Format format = vk::Format::eD16Unorm;
+
+		// the depth is kept in two layers, the nearer of which
+		// shadows a texel. Objects that have kept still for settle
+		// shading passes are in the static layer, drawn again only
+		// once the light moves or one of them does, and the rest in
+		// the dynamic layer, drawn again every shading pass
+		enum Layer {
+			eStatic,
+			eDynamic,
+			eLayerCount
+		};
+
+		uint32_t settle = 2;
+
+		std::vector<glm::mat4> lastModel;
+		std::vector<uint32_t>  stillFrames;
+		std::vector<uint8_t>   dynamic;
+		uint32_t dynamicCount = 0;
+
+		// the dynamic set, which decides what a pass records, and it
+		// along with the light, which the static layer holds while
+		// the one it was last drawn with matches
+		uint64_t setHash   = 0;
+		uint64_t hash      = 0;
+		uint64_t drawnHash = 0;
+
+		// the frustum the last shading pass drew the layers from, which
+		// the raster passes after it look them up through
+		glm::mat4 drawnWith = glm::mat4(1.0f);
+
+		// what the next pass draws, and whether the dynamic layer
+		// holds anything the last one drew that would need clearing
+		bool     redrawStatic = true;
+		bool     dynamicHeld  = true;
+		uint32_t staticDraws  = 0;
+
+		vk::Image        image;
+		vk::DeviceMemory memory;
+		vk::Sampler      sampler;
+
+		// both layers for the lighting to sample, and each on its own
+		// for the shadow pass to draw into
+		vk::ImageView    view;
+		vk::ImageView    layerViews   [eLayerCount];
+		vk::Framebuffer  framebuffers [eLayerCount];
+	} shadows;
+
+	struct PagingState {
+		// the atlas holds as many pages, each the size a tile of the
+		// requested resolution would have been, as fit the device and
+		// this budget, in megabytes across the five shading images.
+		// Objects beyond that share pages at coarser shading levels,
+		// and the ones used least recently lose theirs
+		uint32_t budget = 160;
+
+		// bumped for each selection, which is what entries are aged by
+		uint64_t frame = 0;
+
+		VirtualAtlas table;
+	} paging;
+
+	struct MipState {
+		// the result carries a mip chain down to where an object's
+		// tile is TILE_MIN texels a side, for the raster pass to
+		// sample distant objects from. Each shading pass averages the
+		// levels under the tiles it shaded again, GROUP_SIZE texels
+		// square a workgroup, which has to match downsample.comp
+		static constexpr uint32_t MAX_LEVELS = 6;
+		static constexpr uint32_t TILE_MIN   = 8;
+		static constexpr uint32_t GROUP_SIZE = 8;
+
+		struct Tile {
+			glm::uvec4 rect;  // destination texels, origin (xy) to limit (zw)
+			glm::uvec4 chart; // the object's texels in the level above
+		};
+
+		// where each level's tiles sit in the list
+		struct Range {
+			uint32_t first = 0;
+			uint32_t count = 0;
+		};
+
+		// 1 where the device can't write the result as storage
+		uint32_t levels = 1;
+
+		// every object's whole tile, written once for the static
+		// recording, followed by the tiles shaded this pass
+		Range whole [MAX_LEVELS];
+		Range pass  [MAX_LEVELS];
+
+		uint32_t capacity = 0;
+		std::vector<Tile> tiles;
+	} mips;
+
+	struct ShadingCacheState {
+		// the first pass to light everything while nothing moves is
+		// written to disk, in a file named by the key, the hash of
+		// the mesh, transforms and page table that place the atlas's
+		// texels. A later run coming to the same key reads it back,
+		// with the materials and lights it was lit with, and leaves
+		// out the shading passes of its first frames
+		bool enabled = true;
+
+		// the mesh never changes, so it's only hashed the once
+		uint64_t scene = 0;
+		uint64_t key   = 0;
+
+		bool attempted = false;
+		bool loaded    = false;
+		bool saved     = false;
+
+		// every level copied out in one, to these offsets, by a
+		// command buffer recorded up front and submitted along with
+		// the pass being saved, whose lighting value is then polled
+		// for rather than waited on
+		std::vector<vk::BufferImageCopy> regions;
+		uint64_t texels = 0;
+		vk::CommandBuffer readback;
+		uint64_t pending = 0;
+
+		// what the pass was lit with, taken when it was submitted, or
+		// what the file being restored says it was lit with
+		ShadingCache::Header   header;
+		std::vector<glm::vec4> materials;
+
+		// compresses and writes the copy while the loop goes on
+		std::thread writer;
+
+		// reads and decompresses the file into the copy's buffer while
+		// the loop goes on, which nothing else may touch until it's done
+		std::future<bool> reader;
+	} shadingCache;
+
 	struct InputParameters {
 		float movementSpeed = 0.1f;
 	} parameters;
@@ -279,6 +1055,9 @@ class VulkanApp
     struct VulkanShadingState {
 
 		uint32_t interval = 3;
+
+		// the lighting timeline value that last wrote the atlas
+		uint64_t atlasVersion = 0;
     
         vk::CommandBuffer commandBuffer;
         vk::Framebuffer framebuffer;
@@ -291,12 +1070,26 @@ class VulkanApp
         
         // the shaded scene data
         VulkanShadingResource result;
+
+        // the world position each texel of the result was last lit
+        // at, and its object's id plus one, for the tiled lighting
+        // to tell whether the result is still worth blending with
+        VulkanShadingResource history;
+
+        // stencil set wherever the geometry subpass drew, so the
+        // lighting subpass skips the empty space between uv charts
+        struct VulkanCoverageBuffer {
+            vk::Image        image;
+            vk::DeviceMemory memory;
+            vk::ImageView    view;
+        } coverage;
         
         enum Attachments {
             ePosition,
             eNormal,
             eColor,
-            eLighting
+            eLighting,
+            eCoverage
         };
         
         enum Subpasses {
@@ -311,7 +1104,17 @@ class VulkanApp
         vk::BufferUsageFlags    usage,
         vk::MemoryPropertyFlags properties,
         vk::Buffer&             buffer,
-        vk::DeviceMemory        memory);
+        vk::DeviceMemory&       memory);
+
+    void createStagedBuffer (
+        vk::DeviceSize                     size,
+        vk::BufferUsageFlags               usage,
+        VulkanBuffers::VulkanStagedBuffer& buffer);
+
+    void* stageBuffer (
+        VulkanBuffers::VulkanStagedBuffer& buffer,
+        vk::DeviceSize                     offset,
+        vk::DeviceSize                     size);
     
     std::default_random_engine rng;
     
@@ -0,0 +1,270 @@
+//
+//  VulkanCommandRecorder.cpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#include "VulkanCommandRecorder.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+//
+//
+//
+vk::Result VulkanCommandRecorder::init (vk::Device& logical, uint32_t queueFamily, uint32_t frames, uint32_t threads)
+    { // VulkanCommandRecorder :: init
+    vk::Result result = vk::Result::eSuccess;
+
+    device = logical;
+
+    // hardware_concurrency is allowed to report nothing, and one
+    // core is left for the thread submitting the frames
+    if (threads == 0)
+        {
+        uint32_t cores = std::thread::hardware_concurrency();
+        threads = (cores > 1) ? cores - 1 : 1;
+        }
+
+    // buffers are recorded once per frame and thrown away, so the
+    // pools are transient and reset as a whole rather than per buffer
+    vk::CommandPoolCreateInfo poolCreateInfo = { };
+        poolCreateInfo.flags            = vk::CommandPoolCreateFlagBits::eTransient;
+        poolCreateInfo.queueFamilyIndex = queueFamily;
+
+    pools.resize(frames);
+    for (std::vector<Pool>& frame : pools)
+        { // for each frame in flight
+        frame.resize(threads + 1);
+        for (Pool& pool : frame)
+            {
+            result = device.createCommandPool(&poolCreateInfo, nullptr, &pool.pool);
+            if (result != vk::Result::eSuccess)
+                return result;
+            }
+        } // for each frame in flight
+
+    for (uint32_t i = 0; i < threads; ++i)
+        workers.emplace_back(&VulkanCommandRecorder::work, this, i);
+
+    return result;
+
+    } // VulkanCommandRecorder :: init
+
+//
+//
+//
+vk::Result VulkanCommandRecorder::tidy ()
+    { // VulkanCommandRecorder :: tidy
+
+        { // stop the workers
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+        } // stop the workers
+
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+
+    // destroying a pool frees every buffer allocated from it
+    for (std::vector<Pool>& frame : pools)
+        for (Pool& pool : frame)
+            device.destroyCommandPool(pool.pool);
+    pools.clear();
+
+    return vk::Result::eSuccess;
+
+    } // VulkanCommandRecorder :: tidy
+
+//
+//
+//
+void VulkanCommandRecorder::reset (uint32_t frame)
+    { // VulkanCommandRecorder :: reset
+
+    for (Pool& pool : pools[frame])
+        { // for each thread's pool
+        device.resetCommandPool(pool.pool, vk::CommandPoolResetFlags { });
+        pool.usedPrimaries   = 0;
+        pool.usedSecondaries = 0;
+        } // for each thread's pool
+
+    } // VulkanCommandRecorder :: reset
+
+//
+//
+//
+vk::CommandBuffer VulkanCommandRecorder::primary (uint32_t frame)
+    { // VulkanCommandRecorder :: primary
+
+    return allocate(pools[frame].back(), vk::CommandBufferLevel::ePrimary);
+
+    } // VulkanCommandRecorder :: primary
+
+//
+//
+//
+void VulkanCommandRecorder::record (uint32_t frame, const Target& target, const vk::DrawIndexedIndirectCommand* draws, uint32_t count, std::vector<vk::CommandBuffer>& secondaries)
+    { // VulkanCommandRecorder :: record
+
+    if (count == 0)
+        return;
+
+    // rounding the batch size up can leave the last batches empty,
+    // so the count is worked back out from the size
+    uint32_t batches  = std::min(threads(), (count + MIN_BATCH - 1) / MIN_BATCH);
+    uint32_t perBatch = (count + batches - 1) / batches;
+             batches  = (count + perBatch - 1) / perBatch;
+    size_t   first    = secondaries.size();
+
+    secondaries.resize(first + batches);
+
+    // a single batch isn't worth the hand off, so it's recorded here
+    // from the caller's own pool
+    if (batches == 1)
+        {
+        recordBatch(pools[frame].back(), target, draws, count, secondaries[first]);
+        return;
+        }
+
+        { // queue a job per batch
+        std::lock_guard<std::mutex> lock (mutex);
+
+        for (uint32_t b = 0; b < batches; ++b)
+            { // for each batch
+            uint32_t begin = b * perBatch;
+            uint32_t end   = std::min(count, begin + perBatch);
+
+            vk::CommandBuffer* output = &secondaries[first + b];
+
+            jobs.push_back([this, frame, &target, draws, begin, end, output] (uint32_t worker)
+                {
+                recordBatch(pools[frame][worker], target, draws + begin, end - begin, *output);
+                });
+            } // for each batch
+
+        pending += batches;
+        } // queue a job per batch
+
+    wake.notify_all();
+
+    // the target and draws are borrowed by the jobs, so we can't
+    // return until every one of them has finished
+    std::unique_lock<std::mutex> lock (mutex);
+    done.wait(lock, [this] { return pending == 0; });
+
+    } // VulkanCommandRecorder :: record
+
+//
+//  allocate
+//
+//  buffers are only allocated the first time a frame needs that
+//  many, afterwards the pool reset hands the same ones back
+//
+vk::CommandBuffer VulkanCommandRecorder::allocate (Pool& pool, vk::CommandBufferLevel level)
+    { // VulkanCommandRecorder :: allocate
+
+    bool primary = level == vk::CommandBufferLevel::ePrimary;
+
+    std::vector<vk::CommandBuffer>& buffers = primary ? pool.primaries     : pool.secondaries;
+    uint32_t&                       used    = primary ? pool.usedPrimaries : pool.usedSecondaries;
+
+    if (used == buffers.size())
+        { // grow the pool
+        vk::CommandBufferAllocateInfo allocationInfo = { };
+            allocationInfo.commandPool        = pool.pool;
+            allocationInfo.level              = level;
+            allocationInfo.commandBufferCount = 1;
+
+        vk::CommandBuffer buffer;
+        vk::Result result = device.allocateCommandBuffers(&allocationInfo, &buffer);
+
+        if (result != vk::Result::eSuccess)
+            std::cout << std::endl << "command buffer allocation: " << vk::to_string(result) << std::endl;
+
+        buffers.push_back(buffer);
+        } // grow the pool
+
+    return buffers[used++];
+
+    } // VulkanCommandRecorder :: allocate
+
+//
+//  recordBatch
+//
+//  records a contiguous run of the draw list into a secondary
+//  buffer that continues the target's render pass
+//
+void VulkanCommandRecorder::recordBatch (Pool& pool, const Target& target, const vk::DrawIndexedIndirectCommand* draws, uint32_t count, vk::CommandBuffer& secondary)
+    { // VulkanCommandRecorder :: recordBatch
+
+    secondary = allocate(pool, vk::CommandBufferLevel::eSecondary);
+
+    vk::CommandBufferInheritanceInfo inheritanceInfo = { };
+        inheritanceInfo.renderPass  = target.renderPass;
+        inheritanceInfo.subpass     = target.subpass;
+        inheritanceInfo.framebuffer = target.framebuffer;
+
+    vk::CommandBufferBeginInfo beginInfo = { };
+        beginInfo.flags            = target.usage | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    vk::DeviceSize offsets[] = { 0 };
+
+    secondary.begin(&beginInfo);
+    secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, target.pipeline);
+
+    if (target.dynamicViewport)
+        {
+        secondary.setViewport(0, 1, &target.viewport);
+        secondary.setScissor(0, 1, &target.scissor);
+        }
+
+    secondary.bindVertexBuffers(0, 1, &target.vertexBuffer, offsets);
+    secondary.bindIndexBuffer(target.indexBuffer, 0, vk::IndexType::eUint32);
+    secondary.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, target.layout, 0, 1, &target.descriptorSet, 0, nullptr);
+
+    for (uint32_t i = 0; i < count; ++i)
+        secondary.drawIndexed(draws[i].indexCount, draws[i].instanceCount, draws[i].firstIndex, draws[i].vertexOffset, draws[i].firstInstance);
+
+    secondary.end();
+
+    } // VulkanCommandRecorder :: recordBatch
+
+//
+//  work
+//
+//  the body of each worker thread, pulling jobs off the queue
+//  and recording them from the worker's own pool
+//
+void VulkanCommandRecorder::work (uint32_t index)
+    { // VulkanCommandRecorder :: work
+
+    while (true)
+        { // until told to stop
+        std::function<void (uint32_t)> job;
+
+            { // take a job
+            std::unique_lock<std::mutex> lock (mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (stopping && jobs.empty())
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            } // take a job
+
+        job(index);
+
+            { // report back
+            std::lock_guard<std::mutex> lock (mutex);
+            if (--pending == 0)
+                done.notify_all();
+            } // report back
+
+        } // until told to stop
+
+    } // VulkanCommandRecorder :: work
@@ -0,0 +1,117 @@
+//
+//  VulkanCommandRecorder.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef VulkanCommandRecorder_hpp
+#define VulkanCommandRecorder_hpp
+
+#include <vulkan/vulkan.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <vector>
+
+//
+//  VulkanCommandRecorder
+//
+//  records object draws into secondary command buffers across a
+//  pool of worker threads. Command pools can only be used from one
+//  thread at a time, so every worker owns a pool for every frame in
+//  flight, and resetting a frame's pools recycles all of the buffers
+//  recorded from them in one call.
+//
+//  the last pool of each frame belongs to the calling thread, which
+//  is where primary command buffers come from
+//
+struct VulkanCommandRecorder
+    {
+
+    //
+    //  everything a secondary buffer needs to know about the
+    //  render pass it will be executed inside of
+    //
+    struct Target {
+        vk::RenderPass     renderPass;
+        uint32_t           subpass = 0;
+        vk::Framebuffer    framebuffer;
+
+        vk::Pipeline       pipeline;
+        vk::PipelineLayout layout;
+        vk::DescriptorSet  descriptorSet;
+
+        vk::Buffer         vertexBuffer;
+        vk::Buffer         indexBuffer;
+
+        // dynamic state isn't inherited from the primary buffer,
+        // so pipelines that use it need it set in every secondary
+        bool               dynamicViewport = false;
+        vk::Viewport       viewport;
+        vk::Rect2D         scissor;
+
+        // recordings that get kept and resubmitted can't be one time
+        vk::CommandBufferUsageFlags usage = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    };
+
+    // fewer draws than this aren't worth waking a worker for
+    static constexpr uint32_t MIN_BATCH = 32;
+
+    vk::Result init (vk::Device& logical, uint32_t queueFamily, uint32_t frames, uint32_t threads = 0);
+    vk::Result tidy ();
+
+    //
+    //  recycles every buffer recorded for the frame. The caller
+    //  must know the device has finished with them
+    //
+    void reset (uint32_t frame);
+
+    //
+    //  hands out a primary command buffer from the calling
+    //  thread's pool for the frame
+    //
+    vk::CommandBuffer primary (uint32_t frame);
+
+    //
+    //  splits the draws into batches recorded in parallel, appending
+    //  one secondary buffer per batch in draw order
+    //
+    void record (uint32_t frame, const Target& target, const vk::DrawIndexedIndirectCommand* draws, uint32_t count, std::vector<vk::CommandBuffer>& secondaries);
+
+    uint32_t threads () const { return static_cast<uint32_t>(workers.size()); }
+
+    private:
+
+    struct Pool {
+        vk::CommandPool                pool;
+        std::vector<vk::CommandBuffer> primaries;
+        std::vector<vk::CommandBuffer> secondaries;
+        uint32_t usedPrimaries   = 0;
+        uint32_t usedSecondaries = 0;
+    };
+
+    vk::Device device;
+
+    // pools[frame][thread], the last thread being the caller
+    std::vector<std::vector<Pool>> pools;
+
+    std::vector<std::thread>                   workers;
+    std::deque<std::function<void (uint32_t)>> jobs;
+    std::mutex                                 mutex;
+    std::condition_variable                    wake;
+    std::condition_variable                    done;
+    uint32_t                                   pending  = 0;
+    bool                                       stopping = false;
+
+    vk::CommandBuffer allocate (Pool& pool, vk::CommandBufferLevel level);
+
+    void recordBatch (Pool& pool, const Target& target, const vk::DrawIndexedIndirectCommand* draws, uint32_t count, vk::CommandBuffer& secondary);
+
+    void work (uint32_t index);
+    };
+
+#endif /* VulkanCommandRecorder_hpp */
@@ -14,6 +14,7 @@
 #include <vulkan/vulkan.hpp>
 
 
+#include <algorithm>
 #include <iostream>
 
 struct VulkanHelpers
@@ -42,20 +43,16 @@ struct VulkanHelpers
     //
     //
     //
-    static vk::PresentModeKHR querySwapChainPresentMode (std::vector<vk::PresentModeKHR>& available)
+    static vk::PresentModeKHR querySwapChainPresentMode (std::vector<vk::PresentModeKHR>& available, const std::vector<vk::PresentModeKHR>& preferred)
         { // VulkanHelpers :: querySwapChainPresentMode
         
-        vk::PresentModeKHR ideal = vk::PresentModeKHR::eFifo;
-        
-        for (const vk::PresentModeKHR& mode : available)
-            { // for each available present mode
-            if (mode == vk::PresentModeKHR::eMailbox)
-                return mode;
-            if (mode == vk::PresentModeKHR::eImmediate)
-                ideal = mode;
-            } // for each available present mode
-
-        return ideal;
+        // FIFO is the only mode the spec guarantees
+        for (const vk::PresentModeKHR& wanted : preferred)
+            for (const vk::PresentModeKHR& mode : available)
+                if (mode == wanted)
+                    return mode;
+
+        return vk::PresentModeKHR::eFifo;
         
         } // VulkanHelpers :: querySwapChainPresentMode
     
@@ -68,10 +65,13 @@ struct VulkanHelpers
             return capabilities.currentExtent;
         else
             {
+            // the framebuffer size is in pixels, which is what the
+            // surface wants after a resize on high dpi displays
             int width, height;
-            glfwGetWindowSize(window, &width, &height);
+            glfwGetFramebufferSize(window, &width, &height);
             
-            uint32_t w = width, h = height;
+            uint32_t w = std::max(capabilities.minImageExtent.width,  std::min(capabilities.maxImageExtent.width,  (uint32_t)width));
+            uint32_t h = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, (uint32_t)height));
             vk::Extent2D actualExtent = { w, h };
             return actualExtent;
             }
@@ -13,7 +13,7 @@
 //
 //
 //
-vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice& physical, vk::Format format, uint32_t _size)
+vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice& physical, vk::Format format, uint32_t _size, uint32_t _levels)
     { // VulkanShadingResource :: init
     vk::Result result = vk::Result::eSuccess;
         
@@ -21,6 +21,7 @@ vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice&
 
 	layout = vk::ImageLayout::eUndefined;
     size = _size;
+    levels = _levels;
     
     // create image handle
     vk::ImageCreateInfo imageCreateInfo = { };
@@ -29,7 +30,7 @@ vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice&
         imageCreateInfo.extent.width          = size;
         imageCreateInfo.extent.height         = size;
         imageCreateInfo.extent.depth          = 1;
-        imageCreateInfo.mipLevels             = 1;
+        imageCreateInfo.mipLevels             = levels;
         imageCreateInfo.arrayLayers           = 1;
         imageCreateInfo.samples               = vk::SampleCountFlagBits::e1;
         imageCreateInfo.tiling                = vk::ImageTiling::eOptimal;
@@ -37,11 +38,17 @@ vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice&
         imageCreateInfo.usage                 =
             vk::ImageUsageFlagBits::eColorAttachment |
             vk::ImageUsageFlagBits::eInputAttachment |
-            vk::ImageUsageFlagBits::eSampled;
+            vk::ImageUsageFlagBits::eSampled |
+            vk::ImageUsageFlagBits::eTransferSrc |
+            vk::ImageUsageFlagBits::eTransferDst;
         imageCreateInfo.queueFamilyIndexCount = 0;
         imageCreateInfo.pQueueFamilyIndices   = nullptr;
         imageCreateInfo.sharingMode           = vk::SharingMode::eExclusive;
         imageCreateInfo.flags                 = vk::ImageCreateFlagBits {};
+
+    // lit in place by the tiled lighting shader where it can be
+    if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage)
+        imageCreateInfo.usage |= vk::ImageUsageFlagBits::eStorage;
     
     result = logical.createImage(&imageCreateInfo, nullptr, &image);
     if (result != vk::Result::eSuccess) return result;
@@ -66,7 +73,7 @@ vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice&
     vk::SamplerCreateInfo samplerCreateInfo = { };
         samplerCreateInfo.minFilter        = vk::Filter::eLinear;
         samplerCreateInfo.magFilter        = vk::Filter::eLinear;
-        samplerCreateInfo.mipmapMode       = vk::SamplerMipmapMode::eNearest;
+        samplerCreateInfo.mipmapMode       = vk::SamplerMipmapMode::eLinear;
         samplerCreateInfo.addressModeU     = vk::SamplerAddressMode::eClampToEdge;
         samplerCreateInfo.addressModeV     = vk::SamplerAddressMode::eClampToEdge;
         samplerCreateInfo.addressModeW     = vk::SamplerAddressMode::eClampToEdge;
@@ -76,7 +83,7 @@ vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice&
         samplerCreateInfo.compareEnable    = VK_FALSE;
         samplerCreateInfo.compareOp        = vk::CompareOp::eNever;
         samplerCreateInfo.minLod           = 0.0f;
-        samplerCreateInfo.maxLod           = 0.0f;
+        samplerCreateInfo.maxLod           = (float)(levels - 1);
         samplerCreateInfo.borderColor      = vk::BorderColor::eFloatOpaqueWhite;
         
         result = logical.createSampler(&samplerCreateInfo, nullptr, &sampler);
@@ -99,6 +106,29 @@ vk::Result VulkanShadingResource::init (vk::Device& logical, vk::PhysicalDevice&
         
         result = logical.createImageView(&viewCreateInfo, nullptr, &view);
         if (result != vk::Result::eSuccess) return result;
+
+    sampledView = view;
+    levelViews.assign(1, view);
+
+    if (levels == 1)
+        return result;
+
+    // the whole chain for sampling, and every level on its own
+    viewCreateInfo.subresourceRange.levelCount = levels;
+
+        result = logical.createImageView(&viewCreateInfo, nullptr, &sampledView);
+        if (result != vk::Result::eSuccess) return result;
+
+    viewCreateInfo.subresourceRange.levelCount = 1;
+    levelViews.resize(levels);
+
+    for (uint32_t l = 1; l < levels; ++l)
+        { // for each level
+        viewCreateInfo.subresourceRange.baseMipLevel = l;
+
+        result = logical.createImageView(&viewCreateInfo, nullptr, &levelViews[l]);
+        if (result != vk::Result::eSuccess) return result;
+        } // for each level
         
     return result;
     
@@ -111,6 +141,14 @@ vk::Result VulkanShadingResource::tidy (vk::Device& logical)
     { // VulkanShadingResource :: tidy
     
     logical.destroyImageView (view);
+
+    // the first level's view is view itself
+    if (levels > 1)
+        {
+        logical.destroyImageView(sampledView);
+        for (uint32_t l = 1; l < levels; ++l)
+            logical.destroyImageView(levelViews[l]);
+        }
     logical.destroySampler   (sampler);
     logical.destroyImage     (image);
 	logical.freeMemory       (memory);
@@ -180,6 +218,42 @@ vk::Result VulkanShadingResource::transition (vk::CommandBuffer& commandBuffer,
 
 		} // pre-render transition
 
+	else if (layout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
+		{ // pre-clear transition
+
+		memoryBarrier.srcAccessMask = vk::AccessFlagBits { };
+		memoryBarrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+		srcStage = vk::PipelineStageFlagBits::eTopOfPipe;
+		dstStage = vk::PipelineStageFlagBits::eTransfer;
+
+		} // pre-clear transition
+
+	else if (layout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eColorAttachmentOptimal)
+		{ // post-clear transition
+
+		memoryBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		memoryBarrier.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+
+		// the cleared contents have to land before anything is
+		// loaded from or drawn to the image
+		srcStage = vk::PipelineStageFlagBits::eTransfer;
+		dstStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+
+		} // post-clear transition
+
+	else if (layout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eGeneral)
+		{ // post-clear storage transition
+
+		memoryBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		memoryBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+		// images only ever used as storage stay in the general layout
+		srcStage = vk::PipelineStageFlagBits::eTransfer;
+		dstStage = vk::PipelineStageFlagBits::eComputeShader;
+
+		} // post-clear storage transition
+
 	else std::cout << "transition not recognised" << std::endl;
 
 	commandBuffer.pipelineBarrier(
@@ -189,5 +263,7 @@ vk::Result VulkanShadingResource::transition (vk::CommandBuffer& commandBuffer,
 		0, nullptr,						// buffer memory barriers
 		1, &memoryBarrier);				// image memory barriers
 
+	layout = newLayout;
+
 	return result;
 	} // VulkanShadingResource :: transition
\ No newline at end of file
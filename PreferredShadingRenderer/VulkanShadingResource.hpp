@@ -11,6 +11,8 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <vector>
+
 struct VulkanShadingResource
     {
     vk::Image        image;
@@ -20,8 +22,15 @@ struct VulkanShadingResource
    
     vk::Sampler sampler;
 	uint32_t size;
+
+    // images with a mip chain are sampled through a view of every
+    // level, while view and levelViews see a single level each,
+    // as attachments and storage images have to
+    uint32_t                   levels;
+    vk::ImageView              sampledView;
+    std::vector<vk::ImageView> levelViews;
     
-    vk::Result init (vk::Device& logical, vk::PhysicalDevice& physical, vk::Format format, uint32_t _size);
+    vk::Result init (vk::Device& logical, vk::PhysicalDevice& physical, vk::Format format, uint32_t _size, uint32_t _levels = 1);
     vk::Result tidy (vk::Device& logical);
     
 	vk::Result transition (vk::CommandBuffer& commandBuffer, vk::ImageLayout newLayout);
@@ -0,0 +1,231 @@
+//
+//  VulkanTimeline.cpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#include "VulkanTimeline.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+//
+//
+//
+vk::Result VulkanTimeline::init (vk::Device& logical)
+    { // VulkanTimeline :: init
+    vk::Result result = vk::Result::eSuccess;
+
+    device = logical;
+
+    vk::FenceCreateInfo fenceCreateInfo = { };
+        fenceCreateInfo.flags = vk::FenceCreateFlags { };
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo = { };
+        semaphoreCreateInfo.flags = vk::SemaphoreCreateFlags { };
+
+    for (Timeline& timeline : passes)
+        for (Slot& slot : timeline.ring)
+            { // for each slot of each pass
+            result = device.createFence(&fenceCreateInfo, nullptr, &slot.fence);
+            if (result != vk::Result::eSuccess) return result;
+
+            result = device.createSemaphore(&semaphoreCreateInfo, nullptr, &slot.semaphore);
+            if (result != vk::Result::eSuccess) return result;
+            } // for each slot of each pass
+
+    return result;
+
+    } // VulkanTimeline :: init
+
+//
+//
+//
+vk::Result VulkanTimeline::tidy ()
+    { // VulkanTimeline :: tidy
+
+    for (Timeline& timeline : passes)
+        for (Slot& slot : timeline.ring)
+            { // for each slot of each pass
+            device.destroyFence(slot.fence);
+            device.destroySemaphore(slot.semaphore);
+            } // for each slot of each pass
+
+    return vk::Result::eSuccess;
+
+    } // VulkanTimeline :: tidy
+
+//
+//
+//
+uint64_t VulkanTimeline::submit (vk::Queue& queue, Batch& batch, vk::CommandBuffer* commandBuffers, uint32_t count)
+    { // VulkanTimeline :: submit
+
+    std::vector<vk::Semaphore>          waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitStages;
+
+    for (const Batch::Dependency& dependency : batch.dependencies)
+        { // for each dependency on another pass
+
+        // values the host has already seen complete need no wait at all
+        if (dependency.value == 0 || dependency.value <= completed(dependency.pass))
+            continue;
+
+        // a semaphore signal covers everything submitted before it, so the
+        // semaphore of any value at or past the one we need will do. Binary
+        // semaphores can only be waited on once, which means if every candidate
+        // has already been consumed we fall back to waiting on the exact fence
+        Slot* candidate = nullptr;
+        for (Slot& slot : passes[dependency.pass].ring)
+            if (slot.value >= dependency.value && !slot.consumed)
+                if (candidate == nullptr || slot.value < candidate->value)
+                    candidate = &slot;
+
+        if (candidate != nullptr)
+            {
+            candidate->consumed = true;
+            waitSemaphores.push_back(candidate->semaphore);
+            waitStages.push_back(dependency.stage);
+            }
+        else wait(dependency.pass, dependency.value);
+
+        } // for each dependency on another pass
+
+    waitSemaphores.insert(waitSemaphores.end(), batch.externalWaits.begin(), batch.externalWaits.end());
+    waitStages.insert(waitStages.end(), batch.externalStages.begin(), batch.externalStages.end());
+
+    // hand out the next value of every pass the batch signals
+    std::vector<vk::Semaphore> signalSemaphores (batch.externalSignals);
+    std::vector<Slot*>         signalSlots;
+
+    for (Pass pass : batch.signals)
+        { // for each signalled pass
+        Slot& slot = acquire(pass, passes[pass].submitted + 1);
+        passes[pass].submitted = slot.value;
+
+        signalSemaphores.push_back(slot.semaphore);
+        signalSlots.push_back(&slot);
+        } // for each signalled pass
+
+    vk::SubmitInfo submitInfo = { };
+        submitInfo.waitSemaphoreCount   = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores      = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask    = waitStages.data();
+        submitInfo.commandBufferCount   = count;
+        submitInfo.pCommandBuffers      = commandBuffers;
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        submitInfo.pSignalSemaphores    = signalSemaphores.data();
+
+    vk::Fence fence = signalSlots.empty() ? vk::Fence { } : signalSlots[0]->fence;
+    vk::Result result = queue.submit(1, &submitInfo, fence);
+
+    if (result != vk::Result::eSuccess)
+        std::cout << std::endl << "timeline submission: " << vk::to_string(result) << std::endl;
+
+    // a queue submission can only carry one fence, but an empty submission
+    // signals its fence once everything before it has finished which is
+    // exactly the semantics the other passes need
+    for (uint32_t i = 1; i < signalSlots.size(); ++i)
+        queue.submit(0, nullptr, signalSlots[i]->fence);
+
+    return signalSlots.empty() ? 0 : signalSlots[0]->value;
+
+    } // VulkanTimeline :: submit
+
+//
+//
+//
+uint64_t VulkanTimeline::completed (Pass pass)
+    { // VulkanTimeline :: completed
+
+    Timeline& timeline = passes[pass];
+
+    for (Slot& slot : timeline.ring)
+        if (slot.value > timeline.completed && device.getFenceStatus(slot.fence) == vk::Result::eSuccess)
+            timeline.completed = slot.value;
+
+    return timeline.completed;
+
+    } // VulkanTimeline :: completed
+
+//
+//
+//
+vk::Result VulkanTimeline::wait (Pass pass, uint64_t value, uint64_t timeout)
+    { // VulkanTimeline :: wait
+
+    Timeline& timeline = passes[pass];
+
+    if (value <= timeline.completed)
+        return vk::Result::eSuccess;
+
+    Slot* slot = find(pass, value);
+    if (slot == nullptr)
+        return vk::Result::eNotReady;
+
+    vk::Result result = device.waitForFences(1, &slot->fence, VK_TRUE, timeout);
+
+    if (result == vk::Result::eSuccess)
+        timeline.completed = std::max(timeline.completed, slot->value);
+
+    return result;
+
+    } // VulkanTimeline :: wait
+
+//
+//  find
+//
+//  returns the slot holding the smallest value at or past the
+//  requested one, or nothing if it hasn't been submitted yet
+//
+VulkanTimeline::Slot* VulkanTimeline::find (Pass pass, uint64_t value)
+    { // VulkanTimeline :: find
+
+    Slot* found = nullptr;
+
+    for (Slot& slot : passes[pass].ring)
+        if (slot.value >= value && (found == nullptr || slot.value < found->value))
+            found = &slot;
+
+    return found;
+
+    } // VulkanTimeline :: find
+
+//
+//  acquire
+//
+//  recycles the ring slot for the given value, waiting for the
+//  value it held previously if the device hasn't finished with it
+//
+VulkanTimeline::Slot& VulkanTimeline::acquire (Pass pass, uint64_t value)
+    { // VulkanTimeline :: acquire
+
+    Timeline& timeline = passes[pass];
+    Slot&     slot     = timeline.ring[value % DEPTH];
+
+    if (slot.value != 0)
+        { // slot is being recycled
+
+        device.waitForFences(1, &slot.fence, VK_TRUE, UINT64_MAX);
+        timeline.completed = std::max(timeline.completed, slot.value);
+
+        // a binary semaphore that was signalled but never waited on
+        // can't be signalled again, so it's replaced
+        if (!slot.consumed)
+            {
+            vk::SemaphoreCreateInfo semaphoreCreateInfo = { };
+            device.destroySemaphore(slot.semaphore);
+            device.createSemaphore(&semaphoreCreateInfo, nullptr, &slot.semaphore);
+            }
+
+        } // slot is being recycled
+
+    device.resetFences(1, &slot.fence);
+
+    slot.value    = value;
+    slot.consumed = false;
+
+    return slot;
+
+    } // VulkanTimeline :: acquire
@@ -0,0 +1,106 @@
+//
+//  VulkanTimeline.hpp
+//  PreferredRenderer
+//
+//  Copyright © 2018 MastersProject. All rights reserved.
+//
+
+#ifndef VulkanTimeline_hpp
+#define VulkanTimeline_hpp
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <vector>
+
+//
+//  VulkanTimeline
+//
+//  a per-pass frame scheduler. Every pass owns a monotonically
+//  increasing counter and each submission that signals the pass
+//  hands out the next value, so dependencies like "raster frame N
+//  needs atlas version >= K" can be written down directly.
+//
+//  the SDK we build against predates VK_KHR_timeline_semaphore, so
+//  each value is backed by a fence (for precise host waits) and a
+//  binary semaphore (for device waits) held in a small ring per pass
+//
+struct VulkanTimeline
+    {
+    // uploads and readbacks are recorded into the lighting and raster
+    // submissions, so are ordered by those passes' values
+    enum Pass {
+        eLighting,
+        eRaster,
+        ePassCount
+    };
+
+    // how many values per pass can be in flight at once
+    static constexpr uint32_t DEPTH = 8;
+
+    struct Slot {
+        vk::Fence     fence;
+        vk::Semaphore semaphore;
+        uint64_t      value    = 0;
+        bool          consumed = false; // semaphore has been waited on by the device
+    };
+
+    struct Timeline {
+        std::array<Slot, DEPTH> ring;
+        uint64_t submitted = 0;         // last value handed out
+        uint64_t completed = 0;         // last value known to be complete on the host
+    };
+
+    //
+    //  a batch collects the dependencies of a single submission,
+    //  either on other passes' values or on external binary
+    //  semaphores such as those owned by the swapchain
+    //
+    struct Batch {
+        struct Dependency {
+            Pass                   pass;
+            uint64_t               value;
+            vk::PipelineStageFlags stage;
+        };
+
+        std::vector<Dependency>             dependencies;
+        std::vector<vk::Semaphore>          externalWaits;
+        std::vector<vk::PipelineStageFlags> externalStages;
+        std::vector<vk::Semaphore>          externalSignals;
+        std::vector<Pass>                   signals;
+
+        void wait   (Pass pass, uint64_t value, vk::PipelineStageFlags stage) { dependencies.push_back({ pass, value, stage }); }
+        void wait   (vk::Semaphore semaphore, vk::PipelineStageFlags stage)  { externalWaits.push_back(semaphore); externalStages.push_back(stage); }
+        void signal (Pass pass)                                              { signals.push_back(pass); }
+        void signal (vk::Semaphore semaphore)                                { externalSignals.push_back(semaphore); }
+    };
+
+    std::array<Timeline, ePassCount> passes;
+    vk::Device device;
+
+    vk::Result init (vk::Device& logical);
+    vk::Result tidy ();
+
+    //
+    //  submits the command buffers on the queue, resolving the batch's
+    //  dependencies and signalling the next value of each pass it names.
+    //  the returned value is the one signalled for the first pass
+    //
+    uint64_t submit (vk::Queue& queue, Batch& batch, vk::CommandBuffer* commandBuffers, uint32_t count);
+
+    uint64_t submitted (Pass pass) const { return passes[pass].submitted; }
+    uint64_t completed (Pass pass);
+
+    //
+    //  blocks the host until the pass has reached the given value,
+    //  which only ever touches the fence of that value rather than
+    //  idling the whole queue
+    //
+    vk::Result wait (Pass pass, uint64_t value, uint64_t timeout = UINT64_MAX);
+
+    private:
+    Slot* find    (Pass pass, uint64_t value);
+    Slot& acquire (Pass pass, uint64_t value);
+    };
+
+#endif /* VulkanTimeline_hpp */
@@ -14,4 +14,32 @@ C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V lighting.frag -o lighting.frag.s
 C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V raster.vert -o raster.vert.spv
 C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V raster.frag -o raster.frag.spv
 
+@REM culls objects against the raster frustum and writes
+@REM the indirect draws for both passes
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V cull.comp -o cull.comp.spv
+
+@REM dilates the blocks of the atlas sampled by the raster
+@REM pass into the mask the lighting pass shades
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V dilate.comp -o dilate.comp.spv
+
+@REM reduces the raster depth buffer into the pyramid the
+@REM culling tests occlusion against
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V hiz.comp -o hiz.comp.spv
+
+@REM writes a geometry draw for every cluster of every object,
+@REM leaving out the clusters facing away from the camera
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V cluster.comp -o cluster.comp.spv
+
+@REM lights the atlas a tile per workgroup, in place of the
+@REM lighting subpass, skipping tiles nothing was drawn to
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V lighting.comp -o lighting.comp.spv
+
+@REM averages each level of the result's mip chain from the one
+@REM above it, under the tiles the last pass shaded
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V downsample.comp -o downsample.comp.spv
+
+@REM draws the depth the moving light sees into the static
+@REM and dynamic shadow layers
+C:\VulkanSDK\1.0.61.1\Bin32\glslangValidator -V shadow.vert -o shadow.vert.spv
+
 pause
\ No newline at end of file
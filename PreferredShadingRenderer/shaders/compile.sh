@@ -12,4 +12,32 @@ glslangValidator -V lighting.frag -o lighting.frag.spv;
 # shaders for rasterizing the geometry and lighting
 # to the screen in the final pass
 glslangValidator -V raster.vert -o raster.vert.spv;
-glslangValidator -V raster.frag -o raster.frag.spv;
\ No newline at end of file
+glslangValidator -V raster.frag -o raster.frag.spv;
+
+# culls objects against the raster frustum and writes
+# the indirect draws for both passes
+glslangValidator -V cull.comp -o cull.comp.spv;
+
+# dilates the blocks of the atlas sampled by the raster
+# pass into the mask the lighting pass shades
+glslangValidator -V dilate.comp -o dilate.comp.spv;
+
+# reduces the raster depth buffer into the pyramid the
+# culling tests occlusion against
+glslangValidator -V hiz.comp -o hiz.comp.spv;
+
+# writes a geometry draw for every cluster of every object,
+# leaving out the clusters facing away from the camera
+glslangValidator -V cluster.comp -o cluster.comp.spv;
+
+# lights the atlas a tile per workgroup, in place of the
+# lighting subpass, skipping tiles nothing was drawn to
+glslangValidator -V lighting.comp -o lighting.comp.spv;
+
+# averages each level of the result's mip chain from the one
+# above it, under the tiles the last pass shaded
+glslangValidator -V downsample.comp -o downsample.comp.spv;
+
+# draws the depth the moving light sees into the static
+# and dynamic shadow layers
+glslangValidator -V shadow.vert -o shadow.vert.spv;
\ No newline at end of file
@@ -6,8 +6,8 @@
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Interpolated Inputs
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
-layout (location = 0) in vec3 worldPosition;
-layout (location = 1) in vec3 worldNormal;
+layout (location = 0) in vec3 modelPosition;
+layout (location = 1) in vec3 modelNormal;
 layout (location = 2) in vec3 color;
 layout (location = 3) in vec2 uvs;
 layout (location = 4) flat in int id;
@@ -19,11 +19,15 @@ layout (location = 0) out vec4 positionBuffer;
 layout (location = 1) out vec4 normalBuffer;
 layout (location = 2) out vec4 colorBuffer;
 
+// half floats only hold whole numbers exactly up to 2048, so the
+// object id is split between the colour's w and the position's
+#define ID_RANGE 2048
+
 void main () 
     { // main
 
-    positionBuffer = vec4(worldPosition, 1.0);
-    normalBuffer   = vec4(worldNormal, 2.0);
-    colorBuffer    = vec4(color, id);
+    positionBuffer = vec4(modelPosition, float(id / ID_RANGE));
+    normalBuffer   = vec4(modelNormal, 2.0);
+    colorBuffer    = vec4(color, float(id % ID_RANGE));
 
     } // main
\ No newline at end of file
@@ -4,12 +4,16 @@
 #extension GL_ARB_shading_language_420pack : enable
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
- *  Uniforms
+ *  Storage Buffers
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
-#define MAX_OBJECTS 64
-layout (set = 0, binding = 0) uniform UniformBuffer {
-    mat4 model [MAX_OBJECTS];
-} uniforms;
+
+// scale (xy) and offset (zw) placing each object's uvs in the
+// part of its atlas tile its shading level uses. There are no
+// transforms, as the geometry buffers are kept in model space
+// and the lighting pass applies them
+layout (std430, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    vec4 atlas [];
+} objects;
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Per Vertex Inputs
@@ -25,8 +29,8 @@ layout (location = 4) in int id;
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
 out gl_PerVertex { vec4 gl_Position; };
 
-layout (location = 0) out vec3 frag_worldPosition;
-layout (location = 1) out vec3 frag_worldNormal;
+layout (location = 0) out vec3 frag_modelPosition;
+layout (location = 1) out vec3 frag_modelNormal;
 layout (location = 2) out vec3 frag_color;
 layout (location = 3) out vec3 frag_uvs;
 layout (location = 4) out int  frag_id;
@@ -42,14 +46,16 @@ void main ()
     // uv space      :  [ 0 ... 1 ]
     // screen space  :  [-1 ... 1 ]
     //
+    vec2 atlasUvs = uvs * objects.atlas[id].xy + objects.atlas[id].zw;
+
     gl_Position = vec4(
-        -1.0 + (uvs.s * 2.0),
-        -1.0 + ((uvs.t) * 2.0),
+        -1.0 + (atlasUvs.s * 2.0),
+        -1.0 + ((atlasUvs.t) * 2.0),
         0.0,
         1.0);
 
-    frag_worldPosition = (uniforms.model[id] * vec4(position, 1.0)).xyz;
-    frag_worldNormal   = (uniforms.model[id] * vec4(normal, 0.0)).xyz;;
+    frag_modelPosition = position;
+    frag_modelNormal   = normal;
     frag_color         = color;
     frag_id            = id;
     } // main
\ No newline at end of file
@@ -2,15 +2,19 @@
 
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
+#extension GL_GOOGLE_include_directive : require
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Uniforms
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
-#define MAX_OBJECTS 64
 layout (set = 0, binding = 0) uniform UniformBuffer {
     vec4 lightPosition;
     vec4 eyePosition;
-    vec4 materials[MAX_OBJECTS];
+    uvec4 lighting;    // point light count (x), tiles cull them (y), specular lit here (z)
+    vec4  temporal;    // only the tiled lighting keeps history
+    uvec4 history;
+    mat4  lightViewProjection;
+    uvec4 shadowing;   // shadows cast (x)
 } uniforms;
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
@@ -20,6 +24,41 @@ layout (input_attachment_index = 0, binding = 1) uniform subpassInput positionTe
 layout (input_attachment_index = 1, binding = 2) uniform subpassInput normalTexture;
 layout (input_attachment_index = 2, binding = 3) uniform subpassInput colorTexture;
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Shading Mask
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#define BLOCK_SIZE 8
+layout (constant_id = 0) const int BLOCKS_PER_ROW = 320;
+
+layout (std430, set = 0, binding = 4) readonly buffer MaskBuffer {
+    uint blocks [];
+} mask;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Shadow Layers
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// the depth the moving light sees of the objects that have kept
+// still (layer 0) and of those that haven't (layer 1)
+layout (set = 0, binding = 7) uniform sampler2DArray shadowLayers;
+
+// the lights, objects and the shading shared with lighting.comp
+#include "lighting.glsl"
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Point Lights
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+layout (std430, set = 0, binding = 5) readonly buffer LightBuffer {
+    Light lights [];
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Objects
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+layout (std430, set = 0, binding = 6) readonly buffer ObjectBuffer {
+    Object objects [];
+};
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Interpolated Inputs
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
@@ -32,21 +71,24 @@ layout (location = 2) in vec2 uvs;
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
 layout (location = 0) out vec4 result;
 
-// 2D white noise function
-float random (vec2 co)
-	{ // rand
-    return 0.5 + (abs(fract(sin(dot(co.xy ,vec2(12.9898,78.233))) * 43758.5453)) * 0.5); 
-    } // rand
-
 void main () 
     { // main
 
-    vec4 worldPosition = subpassLoad(positionTexture);
-    vec4 worldNormal   = subpassLoad(normalTexture);
-    vec4 albedo        = subpassLoad(colorTexture);
-    int id = int(albedo.w);
+    // blocks the raster pass didn't sample keep their last result
+    ivec2 block = ivec2(gl_FragCoord.xy) / BLOCK_SIZE;
+    if (mask.blocks[block.y * BLOCKS_PER_ROW + block.x] == 0)
+        discard;
+
+    vec4 albedo   = subpassLoad(colorTexture);
+    vec4 position = subpassLoad(positionTexture);
+    int  id       = int(position.w) * ID_RANGE + int(albedo.w);
+
+    // the geometry buffers are in model space, so they stay valid
+    // however the object has moved since they were drawn
+    vec4 worldPosition = objects[id].model * vec4(position.xyz, 1.0);
+    vec4 worldNormal   = objects[id].model * vec4(subpassLoad(normalTexture).xyz, 0.0);
 
-    vec4 material = uniforms.materials[id];
+    vec4 material = objects[id].material;
 
     vec3 l = normalize(lightPosition - worldPosition).xyz;
     vec3 n = normalize(vec3(worldNormal.xyz) + vec3(
@@ -56,17 +98,28 @@ void main ()
 
     float d = dot (n, l);
 
-    float diffuse = max(d, 0.0) * material.x;
+    // only the moving light casts shadows, not the point lights
+    float shadow = shadowing(worldPosition.xyz, normalize(worldNormal.xyz));
 
-    float metallic = pow(max(d, 0.0), 256) * material.z;
-        if (d <= 1.0) metallic = metallic * (d);
-        if (d <  0.0) metallic = 0.0;
+    float diffuse = max(d, 0.0) * material.x * shadow;
+
+    // the view dependent layer is only lit into the atlas when it
+    // isn't left to the raster pass, and goes stale with the eye
+    float metallic = (uniforms.lighting.z != 0)
+        ? specular(n, l, normalize(eyePosition - worldPosition).xyz, material.z) * shadow
+        : 0.0;
 
     float noise = random(uvs) * material.w;
         if (d <= 1.0) noise = noise * (d);
         if (d <  1.0) noise = 0.0;
     
-    result = vec4((albedo.xyz * diffuse) + metallic + noise, 1.0);
+    // there are no tiles to cull the point lights by here, so every
+    // fragment goes through all of them
+    vec3 points = vec3(0.0);
+    for (uint i = 0; i < uniforms.lighting.x; ++i)
+        points += pointLight(lights[i], worldPosition.xyz, n);
+
+    result = vec4((albedo.xyz * (diffuse + points * material.x)) + metallic + noise, 1.0);
 
 
     } // main
\ No newline at end of file
@@ -0,0 +1,40 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Lighting
+ *
+ *  what lighting.frag and lighting.comp light the atlas
+ *  with, included by both once they've declared the
+ *  UniformBuffer as uniforms and the shadowLayers sampler,
+ *  which shadows.glsl looks the light up through
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// the geometry subpass splits the id between the colour's w and
+// the position's, see geometry.frag
+#define ID_RANGE 2048
+
+#include "material.glsl"
+#include "shadows.glsl"
+
+// matches LightState::Light
+struct Light {
+    vec4 position;     // world space centre (xyz) and radius (w)
+    vec4 color;
+};
+
+// matches ObjectData::Shading, the geometry buffers are in model
+// space, and each object's transform moves them into the world
+struct Object {
+    mat4 model;
+    vec4 material;
+};
+
+// diffuse light from a point light, falling off to nothing at its radius
+vec3 pointLight (Light light, vec3 position, vec3 n)
+    { // pointLight
+
+    vec3  l       = light.position.xyz - position;
+    float d       = length(l);
+    float falloff = max(1.0 - d / light.position.w, 0.0);
+
+    return light.color.rgb * max(dot(n, l / max(d, 0.0001)), 0.0) * falloff * falloff;
+
+    } // pointLight
@@ -6,11 +6,9 @@
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Uniforms
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
-#define MAX_OBJECTS 64
 layout (set = 0, binding = 0) uniform UniformBuffer {
     vec4 lightPosition;
     vec4 eyePosition;
-    vec4 materials[MAX_OBJECTS];
 } uniforms;
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
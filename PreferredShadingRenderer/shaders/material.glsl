@@ -0,0 +1,26 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Material
+ *
+ *  how a surface's material roughens and highlights it,
+ *  needing nothing the including shader declares, so
+ *  lighting.glsl and raster.frag both include it
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// 2D white noise function
+float random (vec2 co)
+	{ // rand
+    return 0.5 + (abs(fract(sin(dot(co.xy ,vec2(12.9898,78.233))) * 43758.5453)) * 0.5);
+    } // rand
+
+// the view dependent layer, a highlight where the normal turns
+// halfway between the light and the eye
+float specular (vec3 n, vec3 l, vec3 v, float metallic)
+    { // specular
+
+    float d = dot(n, l);
+    if (d <= 0.0)
+        return 0.0;
+
+    return pow(max(dot(n, normalize(l + v)), 0.0), 256) * metallic * d;
+
+    } // specular
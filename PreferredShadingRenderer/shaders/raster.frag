@@ -2,25 +2,105 @@
 
 #extension GL_ARB_separate_shader_objects  : enable
 #extension GL_ARB_shading_language_420pack : enable
+#extension GL_GOOGLE_include_directive     : require
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Uniforms
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
+layout (set = 0, binding = 0) uniform UniformBuffer {
+    mat4 view;
+    mat4 proj;
+    vec4 lightPosition;
+    vec4 eyePosition;
+    uvec4 layers;      // specular lit here (x)
+    mat4 lightViewProjection;
+    uvec4 shadowing;
+} uniforms;
+
 layout (set = 0, binding = 1) uniform sampler2D lighting;
 
+// flags each object that reaches the screen so that the next
+// shading pass can skip the tiles of those that didn't
+layout (std430, set = 0, binding = 2) buffer VisibilityBuffer {
+    uint flags [];
+} visibility;
+
+// marks the blocks of the atlas this pass samples, so that the
+// next lighting pass can skip the texels nobody looked at
+#define BLOCK_SIZE 8
+layout (std430, set = 0, binding = 3) buffer SampledBuffer {
+    uint blocks [];
+} sampled;
+
+// the layers the atlas was shadowed with, so what's lit here
+// per pixel is shadowed the same way
+layout (set = 0, binding = 5) uniform sampler2DArray shadowLayers;
+
+// only fragments that survive the depth test count as seen
+layout (early_fragment_tests) in;
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Inputs
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
 layout (location = 0) in vec2 frag_uvs;
+layout (location = 1) flat in int frag_id;
+layout (location = 2) in vec3 frag_position;
+layout (location = 3) in vec3 frag_normal;
+layout (location = 4) flat in vec4 frag_material;
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Outputs
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
 layout (location = 0) out vec4 outColour;
 
+// the normal is roughened, highlighted and shadowed the same way
+// the lighting shaders do it for the atlas
+#include "material.glsl"
+#include "shadows.glsl"
+
 void main () 
     { // main
 
-    outColour = texture (lighting, vec2(frag_uvs.s, frag_uvs.t));
+    // an object without a tile in the atlas is placed at (-1, -1),
+    // and lit here by the moving light alone until it's shaded
+    bool placed = frag_uvs.s >= -0.5;
+
+    // only looked up for what's lit here rather than in the atlas
+    float shadow = (!placed || uniforms.layers.x != 0) ? shadowing(frag_position, normalize(frag_normal)) : 1.0;
+
+    if (placed)
+        outColour = texture (lighting, vec2(frag_uvs.s, frag_uvs.t));
+    else
+        {
+        vec3 l = normalize(uniforms.lightPosition.xyz - frag_position);
+
+        outColour = vec4(vec3(max(dot(normalize(frag_normal), l), 0.0) * frag_material.x * shadow), 1.0);
+        }
+
+    // the atlas holds the view independent layer, while the view
+    // dependent one is lit here every frame at the pixel's rate
+    if (uniforms.layers.x != 0)
+        { // specular
+        vec3 n = normalize(frag_normal + vec3(
+            random(vec2(frag_normal.x)) * frag_material.y,
+            random(vec2(frag_normal.y)) * frag_material.y,
+            random(vec2(frag_normal.z)) * frag_material.y));
+
+        vec3 l = normalize(uniforms.lightPosition.xyz - frag_position);
+        vec3 v = normalize(uniforms.eyePosition.xyz - frag_position);
+
+        outColour.rgb += vec3(specular(n, l, v, frag_material.z) * shadow);
+        } // specular
+
+    // every writer stores the same value, so the race is harmless
+    visibility.flags[frag_id] = 1;
+
+    if (!placed)
+        return;
+
+    ivec2 size  = textureSize(lighting, 0);
+    ivec2 texel = clamp(ivec2(frag_uvs * vec2(size)), ivec2(0), size - 1);
+    ivec2 block = texel / BLOCK_SIZE;
+    sampled.blocks[block.y * ((size.x + BLOCK_SIZE - 1) / BLOCK_SIZE) + block.x] = 1;
 
     } // main
\ No newline at end of file
@@ -6,13 +6,33 @@
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Uniforms
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
-#define MAX_OBJECTS 64
 layout (set = 0, binding = 0) uniform UniformBuffer {
-    mat4 model [MAX_OBJECTS];
     mat4 view;
     mat4 proj;
+    vec4 lightPosition;
+    vec4 eyePosition;
+    uvec4 layers;      // specular lit here (x)
+    mat4 lightViewProjection;
+    uvec4 shadowing;
 } uniforms;
 
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Storage Buffers
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// matches ObjectData::Raster, the atlas placement is the one each
+// object was last shaded with, which lags the geometry pass's until
+// a shading pass has written it
+struct Object {
+    mat4 model;
+    vec4 atlas;
+    vec4 material;
+};
+
+layout (std430, set = 0, binding = 4) readonly buffer ObjectBuffer {
+    Object objects [];
+};
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * *
  *  Per Vertex Inputs
  * * * * * * * * * * * * * * * * * * * * * * * * * * */
@@ -28,13 +48,26 @@ layout (location = 4) in int id;
 out gl_PerVertex { vec4 gl_Position; };
 
 layout (location = 0) out vec2 frag_uvs;
+layout (location = 1) flat out int frag_id;
+
+// what the view dependent layer is lit from, in the world
+layout (location = 2) out vec3 frag_position;
+layout (location = 3) out vec3 frag_normal;
+layout (location = 4) flat out vec4 frag_material;
 
 void main () 
     { // main
 
-    gl_Position = uniforms.proj * uniforms.view * uniforms.model[id] * vec4(position, 1.0);
+    vec4 worldPosition = objects[id].model * vec4(position, 1.0);
+
+    gl_Position = uniforms.proj * uniforms.view * worldPosition;
     //gl_Position = vec4((vec2(-1.0, -1.0) + (uvs * 2.0)).xy, 0.0, 1.0);   
 
-   frag_uvs    = uvs;
+   frag_uvs    = uvs * objects[id].atlas.xy + objects[id].atlas.zw;
+   frag_id     = id;
+
+   frag_position = worldPosition.xyz;
+   frag_normal   = (objects[id].model * vec4(normal, 0.0)).xyz;
+   frag_material = objects[id].material;
 
     } // main
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects  : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Uniforms
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// the shading pass's uniforms, of which only the light's view
+// projection is needed here
+layout (set = 0, binding = 0) uniform UniformBuffer {
+    vec4  lightPosition;
+    vec4  eyePosition;
+    uvec4 lighting;
+    vec4  temporal;
+    uvec4 history;
+    mat4  lightViewProjection;
+    uvec4 shadowing;
+} uniforms;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Objects
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+// matches ObjectData::Shading, the geometry buffers are in model
+// space, and each object's transform moves them into the world
+struct Object {
+    mat4 model;
+    vec4 material;
+};
+
+layout (std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    Object objects [];
+};
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Per Vertex Inputs
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+layout (location = 0) in vec3 position;
+layout (location = 4) in int id;
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  PerVertex Outputs
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+out gl_PerVertex { vec4 gl_Position; };
+
+void main () 
+    { // main
+
+    // only depth is written, so nothing is passed on
+    gl_Position = uniforms.lightViewProjection * objects[id].model * vec4(position, 1.0);
+
+    } // main
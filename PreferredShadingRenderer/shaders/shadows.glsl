@@ -0,0 +1,48 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Shadows
+ *
+ *  the lookup into the shadow layers, for any shader that
+ *  has declared a UniformBuffer as uniforms holding the
+ *  lightViewProjection and shadowing the layers were drawn
+ *  with, and the shadowLayers sampler. The lighting shaders
+ *  include it through lighting.glsl, and raster.frag for
+ *  the view dependent layer it lights per pixel
+ * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#define SHADOW_OFFSET 0.02
+
+// how much of the moving light reaches a point, by the nearer of
+// the static and dynamic layers over the 3x3 texels around it. The
+// point is pushed off its surface along the normal so it isn't
+// shadowed by itself, and anywhere the light's frustum doesn't
+// reach is taken as lit
+float shadowing (vec3 position, vec3 normal)
+    { // shadowing
+
+    if (uniforms.shadowing.x == 0)
+        return 1.0;
+
+    vec4 clip = uniforms.lightViewProjection * vec4(position + normal * SHADOW_OFFSET, 1.0);
+    if (clip.w <= 0.0)
+        return 1.0;
+
+    vec3 ndc = clip.xyz / clip.w;
+    vec2 uv  = ndc.xy * 0.5 + 0.5;
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || ndc.z > 1.0)
+        return 1.0;
+
+    vec2  texel = 1.0 / vec2(textureSize(shadowLayers, 0).xy);
+    float lit   = 0.0;
+
+    for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+            {
+            vec2  at      = uv + vec2(x, y) * texel;
+            float nearest = min(texture(shadowLayers, vec3(at, 0.0)).r, texture(shadowLayers, vec3(at, 1.0)).r);
+
+            lit += (ndc.z <= nearest) ? 1.0 : 0.0;
+            }
+
+    return lit / 9.0;
+
+    } // shadowing